@@ -0,0 +1,61 @@
+#include "gpu/blocks/banked_memory.h"
+#include "gpu/util/error.h"
+
+#include <vector>
+
+BankedMemory::BankedMemory(sc_module_name name, size_t sizeInDwords, MemoryInterleaving interleaving, MemoryBackend backend)
+    : banks(std::make_unique<BankPorts[]>(interleaving.banksCount)),
+      sizeInDwords(sizeInDwords),
+      interleaving(interleaving),
+      storage(sizeInDwords, backend) {
+    FATAL_ERROR_IF(interleaving.banksCount == 0, "BankedMemory must have at least one bank");
+    FATAL_ERROR_IF(interleaving.interleaveSizeInDwords == 0, "BankedMemory interleave size cannot be zero");
+    SC_CTHREAD(work, inpClock.pos());
+}
+
+void BankedMemory::work() {
+    struct Burst {
+        size_t address;    // in dwords
+        size_t dwordsLeft; // zero if bank is idle
+        bool write;
+    };
+    std::vector<Burst> bursts(interleaving.banksCount, Burst{});
+
+    while (true) {
+        wait();
+
+        // Banks are independent, so serving them one after another within a single cycle is equivalent to having
+        // a separate process for each of them. Every bank owns different dwords, hence accesses cannot interfere.
+        for (size_t bankIndex = 0; bankIndex < interleaving.banksCount; bankIndex++) {
+            BankPorts &bank = banks[bankIndex];
+            Burst &burst = bursts[bankIndex];
+
+            bank.outCompleted.write(0);
+            bank.outData.write(0);
+
+            if (burst.dwordsLeft == 0) {
+                if (!bank.inpEnable.read()) {
+                    continue;
+                }
+                burst.address = bank.inpAddress.read().to_uint() / memoryDataTypeByteSize;
+                burst.dwordsLeft = bank.inpBurstLength.read().to_uint();
+                burst.write = bank.inpWrite.read();
+                FATAL_ERROR_IF(burst.dwordsLeft == 0 || burst.dwordsLeft > maxMemoryBurstLength, "Invalid memory burst length");
+                FATAL_ERROR_IF(burst.address + burst.dwordsLeft > sizeInDwords, "Memory access out of bounds");
+            }
+
+            // Serve one dword of the burst per cycle, like Memory does
+            const MemoryAddressType address = burst.address * memoryDataTypeByteSize;
+            FATAL_ERROR_IF(interleaving.getBankIndex(address) != bankIndex, "Memory address does not belong to the accessed bank");
+            if (burst.write) {
+                writeDword(burst.address, bank.inpData.read().to_uint());
+            } else {
+                bank.outData.write(readDword(burst.address));
+            }
+            burst.address++;
+            burst.dwordsLeft--;
+
+            bank.outCompleted.write(!burst.write || burst.dwordsLeft == 0);
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "gpu/blocks/memory.h"
+
+// Assignment of addresses to banks. Consecutive blocks of interleaveSizeInDwords dwords belong to consecutive banks,
+// so linear accesses are spread over all of them.
+struct MemoryInterleaving {
+    size_t banksCount = 1;
+    size_t interleaveSizeInDwords = 1;
+
+    size_t getBankIndex(MemoryAddressType address) const {
+        return (address.to_uint() / memoryDataTypeByteSize / interleaveSizeInDwords) % banksCount;
+    }
+};
+
+// Memory divided into banks, which serve requests independently. Each bank has the same ports and timing as Memory
+// and can perform one access per cycle, so up to banksCount accesses are performed in parallel. Addresses passed to
+// a bank are full memory addresses, which must belong to that bank. A burst cannot cross the interleave block.
+SC_MODULE(BankedMemory) {
+    sc_in_clk inpClock;
+
+    struct BankPorts {
+        sc_in<bool> inpEnable;
+        sc_in<bool> inpWrite;
+        sc_in<MemoryAddressType> inpAddress;
+        sc_in<MemoryBurstLengthType> inpBurstLength;
+        sc_in<MemoryDataType> inpData;
+        sc_out<MemoryDataType> outData;
+        sc_out<bool> outCompleted;
+    };
+    std::unique_ptr<BankPorts[]> banks;
+
+    SC_HAS_PROCESS(BankedMemory);
+    BankedMemory(sc_module_name name, size_t sizeInDwords, MemoryInterleaving interleaving, MemoryBackend backend = MemoryBackend::Signals);
+
+    void work();
+
+    const size_t sizeInDwords;
+    const MemoryInterleaving interleaving;
+
+    size_t getResidentPagesCount() const { return storage.getResidentPagesCount(); }
+
+protected:
+    uint32_t readDword(size_t dwordIndex) const { return storage.readDword(dwordIndex); }
+    void writeDword(size_t dwordIndex, uint32_t value) { storage.writeDword(dwordIndex, value); }
+
+private:
+    MemoryStorage storage;
+};
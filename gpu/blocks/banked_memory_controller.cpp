@@ -0,0 +1,205 @@
+#include "gpu/blocks/banked_memory_controller.h"
+#include "gpu/util/error.h"
+
+#include <algorithm>
+#include <vector>
+
+BankedMemoryController::BankedMemoryController(sc_module_name name, size_t clientsCount, MemoryInterleaving interleaving)
+    : clientsCount(clientsCount),
+      interleaving(interleaving),
+      clients(std::make_unique<ClientPorts[]>(clientsCount)),
+      banks(std::make_unique<BankPorts[]>(interleaving.banksCount)),
+      clientsLatched(std::make_unique<ClientLatchedSignals[]>(clientsCount)) {
+    FATAL_ERROR_IF(clientsCount == 0, "BankedMemoryController must have at least one client");
+    FATAL_ERROR_IF(interleaving.banksCount == 0, "BankedMemoryController must have at least one bank");
+    FATAL_ERROR_IF(interleaving.interleaveSizeInDwords == 0, "BankedMemoryController interleave size cannot be zero");
+    profiling.outBankConflicts = std::make_unique<sc_out<sc_uint<32>>[]>(interleaving.banksCount);
+    SC_CTHREAD(main, inpClock.pos());
+    SC_CTHREAD(listenClients, inpClock.pos());
+}
+
+void BankedMemoryController::listenClients() {
+    std::vector<size_t> dwordsReceived(clientsCount, 0);
+    std::vector<size_t> dwordsExpected(clientsCount, 0);
+
+    while (true) {
+        wait();
+        for (unsigned int i = 0; i < clientsCount; i++) {
+            ClientPorts &clientPorts = clients[i];
+            ClientLatchedSignals &clientSignals = clientsLatched[i];
+
+            // Remaining dwords of a write burst come in the cycles following the request
+            if (dwordsReceived[i] < dwordsExpected[i]) {
+                clientSignals.data[dwordsReceived[i]++] = clientPorts.inpData.read().to_uint();
+                continue;
+            }
+
+            if (clientPorts.inpEnable.read()) {
+                const bool write = clientPorts.inpWrite.read();
+                clientSignals.enable.write(1);
+                clientSignals.write.write(write);
+                clientSignals.address.write(clientPorts.inpAddress);
+                clientSignals.burstLength.write(clientPorts.inpBurstLength);
+                clientSignals.data[0] = clientPorts.inpData.read().to_uint();
+                dwordsReceived[i] = 1;
+                dwordsExpected[i] = write ? clientPorts.inpBurstLength.read().to_uint() : 1;
+                FATAL_ERROR_IF(dwordsExpected[i] == 0 || dwordsExpected[i] > maxMemoryBurstLength, "Invalid memory burst length");
+            }
+        }
+    }
+}
+
+void BankedMemoryController::main() {
+    // Requests are not waited for like in MemoryController, because other banks have to be served in the meantime.
+    // Instead, state of every bank and client is updated once per cycle. A burst is served in parts, each of them
+    // fitting in a single interleave block. Only one part of a burst is in flight at a time.
+    constexpr int noClient = -1;
+    std::vector<int> bankClients(interleaving.banksCount, noClient);      // client served by each bank
+    std::vector<bool> bankRequestsIssued(interleaving.banksCount, false); // request was issued in the previous cycle
+    std::vector<size_t> bankPartLengths(interleaving.banksCount, 0);      // dwords in the part of a burst being served
+    std::vector<size_t> bankDwordsSent(interleaving.banksCount, 0);       // dwords of a write part sent to the bank
+    std::vector<size_t> bankDwordsReceived(interleaving.banksCount, 0);   // dwords of a read part returned by the bank
+    std::vector<size_t> clientsDwordsDone(clientsCount, 0);               // dwords of the burst in completed parts
+    std::vector<bool> clientsServed(clientsCount, false);                 // part of the burst is being served
+    std::vector<bool> clientsConflicted(clientsCount, false);             // waiting part was already counted as a bank conflict
+    std::vector<bool> clientsFinished(clientsCount, false);               // completed in this cycle, but still latched
+    std::vector<uint32_t> bankConflicts(interleaving.banksCount, 0);
+    uint32_t readsPerformed = 0;
+    uint32_t writesPerformed = 0;
+    uint32_t bytesTransferred = 0;
+    unsigned int firstClient = 0;
+
+    while (true) {
+        wait();
+
+        // Outputs from the previous cycle are valid for one cycle only
+        for (unsigned int clientIndex = 0; clientIndex < clientsCount; clientIndex++) {
+            clients[clientIndex].outCompleted.write(0);
+            clients[clientIndex].outData.write(0);
+            clientsFinished[clientIndex] = false;
+        }
+
+        // Progress requests being served by banks
+        for (unsigned int bankIndex = 0; bankIndex < interleaving.banksCount; bankIndex++) {
+            const int clientIndex = bankClients[bankIndex];
+            if (clientIndex == noClient) {
+                continue;
+            }
+            BankPorts &bank = banks[bankIndex];
+            ClientPorts &client = clients[clientIndex];
+            ClientLatchedSignals &clientLatched = clientsLatched[clientIndex];
+            const bool memoryWrite = clientLatched.write.read();
+            const size_t partLength = bankPartLengths[bankIndex];
+
+            if (bankRequestsIssued[bankIndex]) {
+                bank.outEnable.write(0);
+                bank.outWrite.write(0);
+                bankRequestsIssued[bankIndex] = false;
+            }
+
+            if (memoryWrite) {
+                // Send the rest of the part, one dword per cycle, then wait until the bank writes all of it
+                if (bankDwordsSent[bankIndex] < partLength) {
+                    bank.outData.write(clientLatched.data[clientsDwordsDone[clientIndex] + bankDwordsSent[bankIndex]++]);
+                    continue;
+                }
+                if (!bank.inpCompleted.read()) {
+                    continue;
+                }
+            } else {
+                // Forward each dword to the client as soon as it is returned by the bank
+                if (!bank.inpCompleted.read()) {
+                    continue;
+                }
+                client.outData.write(bank.inpData.read());
+                client.outCompleted.write(1);
+                if (++bankDwordsReceived[bankIndex] < partLength) {
+                    continue;
+                }
+            }
+
+            // The part is done, the bank is free and the client can proceed with the rest of its burst
+            bankClients[bankIndex] = noClient;
+            clientsServed[clientIndex] = false;
+            clientsDwordsDone[clientIndex] += partLength;
+            bytesTransferred += partLength * memoryDataTypeByteSize;
+            if (clientsDwordsDone[clientIndex] < clientLatched.burstLength.read().to_uint()) {
+                continue;
+            }
+            if (memoryWrite) {
+                writesPerformed++;
+                client.outCompleted.write(1);
+            } else {
+                readsPerformed++;
+            }
+
+            // Disable latched enable signal, so we don't issue it to the memory the second time. Until it is visible,
+            // clientsFinished prevents this client from being dispatched.
+            clientLatched.enable.write(0);
+            clientsDwordsDone[clientIndex] = 0;
+            clientsFinished[clientIndex] = true;
+        }
+
+        // Dispatch new requests to free banks. Clients are checked in round-robin order, so none of them can be
+        // starved by a client with a lower index accessing the same bank.
+        bool busy = false;
+        int lastDispatchedClient = noClient;
+        for (unsigned int i = 0; i < clientsCount; i++) {
+            const unsigned int clientIndex = (firstClient + i) % clientsCount;
+            ClientLatchedSignals &clientLatched = clientsLatched[clientIndex];
+            if (clientsServed[clientIndex]) {
+                busy = true;
+                continue;
+            }
+            if (clientsFinished[clientIndex] || !clientLatched.enable.read()) {
+                continue;
+            }
+            busy = true;
+
+            const size_t dwordsDone = clientsDwordsDone[clientIndex];
+            const size_t dwordAddress = clientLatched.address.read().to_uint() / memoryDataTypeByteSize + dwordsDone;
+            const MemoryAddressType address = dwordAddress * memoryDataTypeByteSize;
+            const size_t bankIndex = interleaving.getBankIndex(address);
+            if (bankClients[bankIndex] != noClient) {
+                if (!clientsConflicted[clientIndex]) {
+                    bankConflicts[bankIndex]++;
+                    clientsConflicted[clientIndex] = true;
+                }
+                continue;
+            }
+
+            const size_t dwordsLeft = clientLatched.burstLength.read().to_uint() - dwordsDone;
+            const size_t dwordsLeftInBlock = interleaving.interleaveSizeInDwords - dwordAddress % interleaving.interleaveSizeInDwords;
+            const size_t partLength = std::min(dwordsLeft, dwordsLeftInBlock);
+
+            BankPorts &bank = banks[bankIndex];
+            const bool memoryWrite = clientLatched.write.read();
+            bank.outEnable.write(1);
+            bank.outWrite.write(memoryWrite);
+            bank.outAddress.write(address);
+            bank.outBurstLength.write(partLength);
+            if (memoryWrite) {
+                bank.outData.write(clientLatched.data[dwordsDone]);
+            }
+            bankClients[bankIndex] = clientIndex;
+            bankRequestsIssued[bankIndex] = true;
+            bankPartLengths[bankIndex] = partLength;
+            bankDwordsSent[bankIndex] = 1;
+            bankDwordsReceived[bankIndex] = 0;
+            clientsServed[clientIndex] = true;
+            clientsConflicted[clientIndex] = false;
+            lastDispatchedClient = clientIndex;
+        }
+        if (lastDispatchedClient != noClient) {
+            firstClient = (lastDispatchedClient + 1) % clientsCount;
+        }
+
+        profiling.outBusy = busy;
+        profiling.outReadsPerformed = readsPerformed;
+        profiling.outWritesPerformed = writesPerformed;
+        profiling.outBytesTransferred = bytesTransferred;
+        for (unsigned int bankIndex = 0; bankIndex < interleaving.banksCount; bankIndex++) {
+            profiling.outBankConflicts[bankIndex] = bankConflicts[bankIndex];
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "gpu/blocks/banked_memory.h"
+#include "gpu/definitions/types.h"
+
+#include <memory>
+#include <systemc.h>
+
+// Counterpart of MemoryController for BankedMemory. Requests of different clients are dispatched in parallel, as
+// long as they target different banks. Each client has its own data output, because several reads can complete
+// in the same cycle. Bursts are split at interleave block boundaries and their parts are sent to consecutive banks.
+SC_MODULE(BankedMemoryController) {
+    SC_HAS_PROCESS(BankedMemoryController);
+    BankedMemoryController(sc_module_name name, size_t clientsCount, MemoryInterleaving interleaving);
+
+    sc_in_clk inpClock;
+    const size_t clientsCount;
+    const MemoryInterleaving interleaving;
+
+    // Interface with clients
+    struct ClientPorts {
+        sc_in<bool> inpEnable;
+        sc_in<bool> inpWrite;
+        sc_in<MemoryAddressType> inpAddress;
+        sc_in<MemoryBurstLengthType> inpBurstLength;
+        sc_in<MemoryDataType> inpData;
+        sc_out<MemoryDataType> outData;
+        sc_out<bool> outCompleted;
+    };
+    std::unique_ptr<ClientPorts[]> clients;
+
+    // Interface with memory banks
+    struct BankPorts {
+        sc_out<bool> outEnable;
+        sc_out<bool> outWrite;
+        sc_out<MemoryAddressType> outAddress;
+        sc_out<MemoryBurstLengthType> outBurstLength;
+        sc_out<MemoryDataType> outData;
+        sc_in<MemoryDataType> inpData;
+        sc_in<bool> inpCompleted;
+    };
+    std::unique_ptr<BankPorts[]> banks;
+
+    struct {
+        sc_out<bool> outBusy;
+        sc_out<sc_uint<32>> outReadsPerformed;
+        sc_out<sc_uint<32>> outWritesPerformed;
+        sc_out<sc_uint<32>> outBytesTransferred; // divided by elapsed cycles gives achieved bandwidth in bytes per cycle
+        std::unique_ptr<sc_out<sc_uint<32>>[]> outBankConflicts; // requests or parts of bursts, which had to wait for another request to the same bank
+    } profiling;
+
+    // Latched values from clients. Dwords of a write burst are collected in a buffer, like in MemoryController.
+    struct ClientLatchedSignals {
+        sc_signal<bool, SC_UNCHECKED_WRITERS> enable;
+        sc_signal<bool> write;
+        sc_signal<MemoryAddressType> address;
+        sc_signal<MemoryBurstLengthType> burstLength;
+        uint32_t data[maxMemoryBurstLength];
+    };
+    std::unique_ptr<ClientLatchedSignals[]> clientsLatched;
+
+private:
+    void listenClients();
+    void main();
+};
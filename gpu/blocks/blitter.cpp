@@ -1,7 +1,10 @@
 #include "gpu/blocks/blitter.h"
 #include "gpu/util/error.h"
+#include "gpu/util/memory_access.h"
 #include "gpu/util/raii_boolean_setter.h"
 
+#include <algorithm>
+
 void Blitter::main() {
     while (true) {
         wait();
@@ -19,29 +22,16 @@ void Blitter::main() {
 
         RaiiBooleanSetter busySetter{profiling.outBusy};
 
-        for (size_t dwordIndex = 0; dwordIndex < sizeInDwords; dwordIndex++) {
-            memory.outEnable = 1;
-            memory.outWrite = isWrite;
-            memory.outAddress = memoryPtr + 4 * dwordIndex;
-
-            if (isWrite) {
-                const size_t userPtrIndex = isFill ? 0 : dwordIndex;
-                memory.outData = userPtr[userPtrIndex];
-            }
-
-            wait(1);
-            memory.outEnable = 0;
-
-            while (!memory.inpCompleted) {
-                wait(1);
-            }
-
-            memory.outWrite = 0;
-            memory.outAddress = 0;
-            memory.outData = 0;
-
-            if (!isWrite) {
-                userPtr[dwordIndex] = memory.inpData.read();
+        // Transfer the data in bursts, so one dword is transferred per cycle after the initial latency
+        for (size_t dwordIndex = 0; dwordIndex < sizeInDwords; dwordIndex += maxMemoryBurstLength) {
+            const size_t burstLength = std::min<size_t>(sizeInDwords - dwordIndex, maxMemoryBurstLength);
+            const MemoryAddressType burstAddress = memoryPtr + 4 * dwordIndex;
+            if (isFill) {
+                MemoryAccess::writeBurst(memory, burstAddress, userPtr, burstLength, true);
+            } else if (isWrite) {
+                MemoryAccess::writeBurst(memory, burstAddress, userPtr + dwordIndex, burstLength);
+            } else {
+                MemoryAccess::readBurst(memory, burstAddress, userPtr + dwordIndex, burstLength);
             }
         }
     }
@@ -1,5 +1,7 @@
 #include "gpu/blocks/command_streamer.h"
+#include "gpu/blocks/shader_array/request.h"
 #include "gpu/util/error.h"
+#include "gpu/util/transfer.h"
 
 void CommandStreamer::main() {
     Command command{};
@@ -37,6 +39,9 @@ void CommandStreamer::main() {
             bltBlock.outUserPtr = 0;
             bltBlock.outSizeInDwords = 0;
             break;
+        case CommandType::Dispatch:
+            dispatchGroups(command.dispatchData.groupsCount);
+            break;
         default:
             FATAL_ERROR("Invalid command type: ", static_cast<int>(command.type));
         }
@@ -45,6 +50,61 @@ void CommandStreamer::main() {
     }
 }
 
+void CommandStreamer::dispatchGroups(uint32_t groupsCount) {
+    struct {
+        ShaderFrontendRequest header = {};
+        uint32_t data[1 + Isa::registerComponentsCount * Isa::maxInputOutputRegisters];
+    } request;
+
+    // Uniforms are the same for all groups
+    size_t dataDwords = 1;
+    const CustomShaderComponents uniformsInfo{computeShader.inpUniforms.read().to_uint()};
+    const size_t totalUniformsCount = uniformsInfo.registersCount;
+    for (size_t uniformIndex = 0u; uniformIndex < totalUniformsCount; uniformIndex++) {
+        const uint32_t componentsCount = uniformsInfo.getCustomComponents(uniformIndex);
+        for (size_t componentIndex = 0u; componentIndex < componentsCount; componentIndex++) {
+            request.data[dataDwords++] = computeShader.inpUniformsData[uniformIndex][componentIndex].read().to_int();
+        }
+    }
+
+    // Compute shader has a single per-thread input holding the thread id. Only id of the first thread is sent,
+    // shader unit calculates the rest. Results are stored to memory, so there are no outputs.
+    request.header.dword0.isaAddress = computeShader.inpShaderAddress.read();
+    request.header.dword1.threadCount = intToNonZeroCount(Isa::simdSize);
+    request.header.dword1.programType = Isa::Command::ProgramType::ComputeShader;
+    request.header.dword2.inputsCount = NonZeroCount::One;
+    request.header.dword2.inputSize0 = NonZeroCount::One;
+    request.header.dword2.uniformsCount = uniformsInfo.registersCount;
+    request.header.dword2.uniformSize0 = uniformsInfo.comp0;
+    request.header.dword2.uniformSize1 = uniformsInfo.comp1;
+    request.header.dword2.uniformSize2 = uniformsInfo.comp2;
+
+    // Send a request for each group. ShaderFrontend distributes them among shader units, which can run them
+    // in parallel. Responses are collected by a separate thread, so they do not block sending new requests.
+    finishedGroupsCount = 0;
+    const size_t dwordsToSend = sizeof(ShaderFrontendRequest) / sizeof(uint32_t) + dataDwords;
+    for (uint32_t groupIndex = 0; groupIndex < groupsCount; groupIndex++) {
+        request.header.dword1.clientToken = groupIndex;
+        request.data[0] = groupIndex * Isa::simdSize;
+        Transfer::sendArray(shaderFrontend.request.inpReceiving, shaderFrontend.request.outSending,
+                            shaderFrontend.request.outData, reinterpret_cast<uint32_t *>(&request), dwordsToSend);
+    }
+
+    while (finishedGroupsCount < groupsCount) {
+        wait();
+    }
+}
+
+void CommandStreamer::dispatchResponseThread() {
+    while (true) {
+        // Response contains a header and the number of threads, which finished execution
+        uint32_t response[sizeof(ShaderFrontendResponse) / sizeof(uint32_t) + 1];
+        Transfer::receiveArray(shaderFrontend.response.inpSending, shaderFrontend.response.inpData,
+                               shaderFrontend.response.outReceiving, response, sizeof(response) / sizeof(uint32_t));
+        finishedGroupsCount++;
+    }
+}
+
 void CommandStreamer::draw(sc_time *outTimeTaken) {
     Command command = {};
     command.type = CommandType::Draw;
@@ -52,6 +112,15 @@ void CommandStreamer::draw(sc_time *outTimeTaken) {
     commands.push(command);
 }
 
+void CommandStreamer::dispatch(uint32_t groupsCount, sc_time *outTimeTaken) {
+    FATAL_ERROR_IF(groupsCount == 0, "Dispatch must have at least one group");
+    Command command = {};
+    command.type = CommandType::Dispatch;
+    command.dispatchData.groupsCount = groupsCount;
+    command.profilingData.outTimeTaken = outTimeTaken;
+    commands.push(command);
+}
+
 void CommandStreamer::blit(Blitter::CommandType blitType, MemoryAddressType memoryPtr, uint32_t *userPtr, size_t sizeInDwords, sc_time *outTimeTaken) {
     Command command = {};
     command.type = CommandType::Blit;
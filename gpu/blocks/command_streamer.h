@@ -1,6 +1,7 @@
 #pragma once
 
 #include "gpu/blocks/blitter.h"
+#include "gpu/definitions/custom_components.h"
 #include "gpu/definitions/types.h"
 
 #include <queue>
@@ -22,6 +23,26 @@ SC_MODULE(CommandStreamer) {
         sc_out<sc_uint<16>> outSizeInDwords;
     } bltBlock;
 
+    // Compute shaders are dispatched directly to the ShaderFrontend, bypassing the graphics pipeline
+    struct {
+        struct {
+            sc_out<bool> outSending;
+            sc_out<sc_uint<32>> outData;
+            sc_in<bool> inpReceiving;
+        } request;
+        struct {
+            sc_out<bool> outReceiving;
+            sc_in<bool> inpSending;
+            sc_in<sc_uint<32>> inpData;
+        } response;
+    } shaderFrontend;
+
+    struct {
+        sc_in<MemoryAddressType> inpShaderAddress;
+        sc_in<CustomShaderComponentsType> inpUniforms;
+        sc_in<VertexPositionFloatType> inpUniformsData[Isa::maxInputOutputRegisters][Isa::registerComponentsCount];
+    } computeShader;
+
     struct {
         sc_out<bool> outBusy;
     } profiling;
@@ -29,9 +50,11 @@ SC_MODULE(CommandStreamer) {
     SC_HAS_PROCESS(CommandStreamer);
     CommandStreamer(sc_module_name name, sc_time clockPeriod) : clockPeriod(clockPeriod) {
         SC_CTHREAD(main, inpClock.pos());
+        SC_CTHREAD(dispatchResponseThread, inpClock.pos());
     }
 
     void draw(sc_time * outTimeTaken);
+    void dispatch(uint32_t groupsCount, sc_time * outTimeTaken); // each group has Isa::simdSize threads
     void blit(Blitter::CommandType blitType, MemoryAddressType memoryPtr, uint32_t * userPtr, size_t sizeInDwords, sc_time * outTimeTaken);
     void blitToMemory(MemoryAddressType memoryPtr, uint32_t * userPtr, size_t sizeInDwords, sc_time * outTimeTaken) { blit(Blitter::CommandType::CopyToMem, memoryPtr, userPtr, sizeInDwords, outTimeTaken); }
     void blitFromMemory(MemoryAddressType memoryPtr, uint32_t * userPtr, size_t sizeInDwords, sc_time * outTimeTaken) { blit(Blitter::CommandType::CopyFromMem, memoryPtr, userPtr, sizeInDwords, outTimeTaken); }
@@ -41,10 +64,13 @@ SC_MODULE(CommandStreamer) {
 
 private:
     void main();
+    void dispatchResponseThread();
+    void dispatchGroups(uint32_t groupsCount);
 
     enum class CommandType {
         Draw,
         Blit,
+        Dispatch,
     };
     struct BlitData {
         Blitter::CommandType blitType;
@@ -52,14 +78,19 @@ private:
         uint32_t *userPtr;
         size_t sizeInDwords;
     };
+    struct DispatchData {
+        uint32_t groupsCount;
+    };
     struct ProfilingData {
         sc_time *outTimeTaken;
     };
     struct Command {
         CommandType type;
         BlitData blitData;
+        DispatchData dispatchData;
         ProfilingData profilingData;
     };
     std::queue<Command> commands = {};
     sc_time clockPeriod;
+    uint32_t finishedGroupsCount = 0; // incremented by dispatchResponseThread
 };
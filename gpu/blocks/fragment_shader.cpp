@@ -23,17 +23,18 @@ void FragmentShader::perFragmentThread() {
     const auto verticesInTriangle = 3u;
 
     const auto perThreadInputDwords = maxThreadsCount * 2;
-    const auto perRequestInputDwords = verticesInTriangle * Isa::maxInputOutputRegisters * Isa::registerComponentsCount;
+    const auto perRequestInputDwords = verticesInTriangle * Isa::maxInputOutputRegisters * Isa::registerComponentsCount +
+                                       Isa::maxInputOutputRegisters * Isa::registerComponentsCount + Isa::matrixDwordsCount; // vertex attributes and uniforms
     struct {
         ShaderFrontendRequest header = {};
         uint32_t data[perThreadInputDwords + perRequestInputDwords];
     } request;
 
-    const auto componentsPerOutputFragment = 5; // RGBA + interpolated depth value
-    const auto outputDwords = maxThreadsCount * componentsPerOutputFragment;
+    const auto maxComponentsPerOutputFragment = 5; // RGBA + interpolated depth value
+    const auto outputDwords = maxThreadsCount * maxComponentsPerOutputFragment;
     struct {
         ShaderFrontendResponse header = {};
-        float data[outputDwords];
+        uint32_t data[outputDwords];
     } response;
 
     ShadedFragment shadedFragments[maxThreadsCount];
@@ -43,6 +44,8 @@ void FragmentShader::perFragmentThread() {
 
         // Prepare some info about the request
         CustomShaderComponents customInputComponents{inpCustomInputComponents.read().to_uint()};
+        const bool packedColorOutput = inpPackedColorOutput.read();
+        const size_t componentsPerOutputFragment = packedColorOutput ? 2 : 5; // color + interpolated depth value
         const size_t customInputRegistersCount = customInputComponents.registersCount;
         const uint32_t triangleAttributesCount = calculateTriangleAttributesCount(customInputComponents);
 
@@ -76,6 +79,12 @@ void FragmentShader::perFragmentThread() {
                 request.data[dataDwords++] = value;
             }
         }
+        const bool hasUniformMatrix = inpHasUniformMatrix.read();
+        if (hasUniformMatrix) {
+            for (size_t dwordIndex = 0u; dwordIndex < Isa::matrixDwordsCount; dwordIndex++) {
+                request.data[dataDwords++] = inpUniformMatrixData[dwordIndex].read().to_int();
+            }
+        }
 
         // Write triangle attribs (per-request data)
         for (auto i = 0u; i < triangleAttributesCount; i++) {
@@ -92,23 +101,34 @@ void FragmentShader::perFragmentThread() {
         request.header.dword2.inputSize1 = customInputComponents.comp0;
         request.header.dword2.inputSize2 = customInputComponents.comp1;
         request.header.dword2.outputsCount = NonZeroCount::Two;
-        request.header.dword2.outputSize0 = NonZeroCount::Four; // color data r,g,b,a
+        request.header.dword2.outputSize0 = packedColorOutput ? NonZeroCount::One : NonZeroCount::Four; // color data r,g,b,a
         request.header.dword2.outputSize1 = NonZeroCount::One;  // interpolated z
         request.header.dword2.uniformsCount = uniformsInfo.registersCount;
         request.header.dword2.uniformSize0 = uniformsInfo.comp0;
         request.header.dword2.uniformSize1 = uniformsInfo.comp1;
         request.header.dword2.uniformSize2 = uniformsInfo.comp2;
+        request.header.dword2.hasUniformMatrix = hasUniformMatrix;
         const size_t requestSize = sizeof(ShaderFrontendRequest) / sizeof(uint32_t) + dataDwords;
         Transfer::sendArray(shaderFrontend.request.inpReceiving, shaderFrontend.request.outSending,
                             shaderFrontend.request.outData, reinterpret_cast<uint32_t *>(&request), requestSize);
 
+        const size_t responseSize = sizeof(ShaderFrontendResponse) / sizeof(uint32_t) + fragmentsCount * componentsPerOutputFragment;
         Transfer::receiveArray(shaderFrontend.response.inpSending, shaderFrontend.response.inpData,
-                               shaderFrontend.response.outReceiving, reinterpret_cast<uint32_t *>(&response), sizeof(response) / sizeof(uint32_t));
+                               shaderFrontend.response.outReceiving, reinterpret_cast<uint32_t *>(&response), responseSize);
 
         // Send results to the next block
         for (size_t i = 0; i < fragmentsCount; i++) {
-            shadedFragments[i].color = packRgbaToUint(response.data + i * componentsPerOutputFragment);
-            shadedFragments[i].z = Conversions::floatBytesToUint(response.data[i * componentsPerOutputFragment + 4]);
+            const uint32_t *fragmentData = response.data + i * componentsPerOutputFragment;
+            if (packedColorOutput) {
+                shadedFragments[i].color = fragmentData[0];
+            } else {
+                float color[4];
+                for (size_t componentIndex = 0; componentIndex < 4; componentIndex++) {
+                    color[componentIndex] = Conversions::uintBytesToFloat(fragmentData[componentIndex]);
+                }
+                shadedFragments[i].color = packRgbaToUint(color);
+            }
+            shadedFragments[i].z = fragmentData[componentsPerOutputFragment - 1];
             Transfer::send(nextBlock.inpReceiving, nextBlock.outSending, nextBlock.outData, shadedFragments[i]);
         }
     }
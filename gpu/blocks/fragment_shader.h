@@ -14,6 +14,9 @@ SC_MODULE(FragmentShader) {
     sc_in<CustomShaderComponentsType> inpCustomInputComponents;
     sc_in<CustomShaderComponentsType> inpUniforms;
     sc_in<VertexPositionFloatType> inpUniformsData[Isa::maxInputOutputRegisters][Isa::registerComponentsCount];
+    sc_in<bool> inpHasUniformMatrix;
+    sc_in<VertexPositionFloatType> inpUniformMatrixData[Isa::matrixDwordsCount];
+    sc_in<bool> inpPackedColorOutput; // shader returns color already packed to RGBA8
 
     struct PreviousBlock {
         struct PerTriangle {
@@ -0,0 +1,96 @@
+#include "gpu/blocks/memory.h"
+#include "gpu/util/error.h"
+
+MemoryStorage::MemoryStorage(size_t sizeInDwords, MemoryBackend backend)
+    : sizeInDwords(sizeInDwords),
+      backend(backend) {
+    FATAL_ERROR_IF(sizeInDwords == 0, "Memory cannot be empty");
+    FATAL_ERROR_IF(sizeInDwords > (uint64_t(1) << memoryAddressBits) / memoryDataTypeByteSize, "Memory is larger than its address space");
+    switch (backend) {
+    case MemoryBackend::Signals:
+        rawMemory = std::make_unique<sc_signal<MemoryDataType>[]>(sizeInDwords);
+        break;
+    case MemoryBackend::Native:
+        nativeMemory.resize(sizeInDwords);
+        break;
+    case MemoryBackend::Sparse:
+        sparsePages.resize((sizeInDwords + pageSizeInDwords - 1) / pageSizeInDwords);
+        break;
+    default:
+        FATAL_ERROR("Unknown memory backend");
+    }
+}
+
+uint32_t MemoryStorage::readDword(size_t dwordIndex) const {
+    switch (backend) {
+    case MemoryBackend::Native:
+        return nativeMemory[dwordIndex];
+    case MemoryBackend::Sparse: {
+        const std::unique_ptr<uint32_t[]> &page = sparsePages[dwordIndex / pageSizeInDwords];
+        return page != nullptr ? page[dwordIndex % pageSizeInDwords] : 0;
+    }
+    default:
+        return rawMemory[dwordIndex].read().to_uint();
+    }
+}
+
+void MemoryStorage::writeDword(size_t dwordIndex, uint32_t value) {
+    // Signals are updated at the end of the delta cycle and the native storage immediately. It makes no difference,
+    // because a single process accesses the storage and each dword is accessed at most once per clock cycle.
+    switch (backend) {
+    case MemoryBackend::Native:
+        nativeMemory[dwordIndex] = value;
+        break;
+    case MemoryBackend::Sparse: {
+        std::unique_ptr<uint32_t[]> &page = sparsePages[dwordIndex / pageSizeInDwords];
+        if (page == nullptr) {
+            page = std::make_unique<uint32_t[]>(pageSizeInDwords); // value-initialized, so untouched dwords stay zero
+            residentPagesCount++;
+        }
+        page[dwordIndex % pageSizeInDwords] = value;
+        break;
+    }
+    default:
+        rawMemory[dwordIndex].write(value);
+        break;
+    }
+}
+
+Memory::Memory(sc_module_name name, size_t sizeInDwords, MemoryBackend backend)
+    : sizeInDwords(sizeInDwords),
+      backend(backend),
+      storage(sizeInDwords, backend) {
+    SC_CTHREAD(work, inpClock.pos());
+}
+
+void Memory::work() {
+    while (true) {
+        wait();
+
+        outCompleted.write(0);
+        outData.write(0);
+
+        if (!inpEnable.read()) {
+            continue;
+        }
+
+        // Serve a burst of consecutive dwords, one per cycle. Write data for the following dwords is sent by the
+        // client in the following cycles. Each read dword is marked as completed, a write only after the last dword.
+        const size_t addr = inpAddress.read().to_uint() / memoryDataTypeByteSize;
+        const size_t burstLength = inpBurstLength.read().to_uint();
+        FATAL_ERROR_IF(burstLength == 0 || burstLength > maxMemoryBurstLength, "Invalid memory burst length");
+        FATAL_ERROR_IF(addr + burstLength > sizeInDwords, "Memory access out of bounds");
+        const bool write = inpWrite.read();
+        for (size_t dwordIndex = 0; dwordIndex < burstLength; dwordIndex++) {
+            if (dwordIndex > 0) {
+                wait();
+            }
+            if (write) {
+                writeDword(addr + dwordIndex, inpData.read().to_uint());
+            } else {
+                outData.write(readDword(addr + dwordIndex));
+            }
+            outCompleted.write(!write || dwordIndex + 1 == burstLength);
+        }
+    }
+}
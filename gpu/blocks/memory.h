@@ -2,47 +2,63 @@
 
 #include "gpu/definitions/types.h"
 
+#include <memory>
 #include <systemc.h>
+#include <vector>
+
+// How Memory stores its contents. All backends have the same port timing and results.
+enum class MemoryBackend {
+    Signals, // one sc_signal per dword, each of them visible to SystemC
+    Native,  // plain array of dwords, which is much cheaper to create and takes only 4 bytes per dword
+    Sparse,  // pages allocated on the first write, so only the used part of a large address space takes host memory
+};
+
+// Contents of a memory module kept in the selected MemoryBackend. Shared by Memory and BankedMemory.
+class MemoryStorage {
+public:
+    MemoryStorage(size_t sizeInDwords, MemoryBackend backend);
+
+    uint32_t readDword(size_t dwordIndex) const;
+    void writeDword(size_t dwordIndex, uint32_t value);
+
+    const size_t sizeInDwords;
+    const MemoryBackend backend;
+
+    // Pages of MemoryBackend::Sparse. Reading a page, which was never written, returns zeros without allocating it.
+    constexpr static size_t pageSizeInDwords = 64 * 1024 / memoryDataTypeByteSize;
+    size_t getResidentPagesCount() const { return residentPagesCount; }
+
+private:
+    std::unique_ptr<sc_signal<MemoryDataType>[]> rawMemory; // used by MemoryBackend::Signals
+    std::vector<uint32_t> nativeMemory;                     // used by MemoryBackend::Native
+    std::vector<std::unique_ptr<uint32_t[]>> sparsePages;   // used by MemoryBackend::Sparse
+    size_t residentPagesCount = 0;
+};
 
-template <unsigned int Size = 1>
 SC_MODULE(Memory) {
     sc_in_clk inpClock;
     sc_in<bool> inpEnable;
     sc_in<bool> inpWrite;
     sc_in<MemoryAddressType> inpAddress;
+    sc_in<MemoryBurstLengthType> inpBurstLength;
     sc_in<MemoryDataType> inpData;
     sc_out<MemoryDataType> outData;
     sc_out<bool> outCompleted;
 
-    SC_CTOR(Memory) {
-        SC_CTHREAD(work, inpClock.pos());
-    }
+    SC_HAS_PROCESS(Memory);
+    Memory(sc_module_name name, size_t sizeInDwords, MemoryBackend backend = MemoryBackend::Signals);
 
     void work();
 
-protected:
-    sc_signal<MemoryDataType> rawMemory[Size];
-};
-
-template <unsigned int Size>
-void Memory<Size>::work() {
-    while (true) {
-        wait();
+    const size_t sizeInDwords;
+    const MemoryBackend backend;
 
-        outCompleted.write(0);
-        outData.write(0);
+    size_t getResidentPagesCount() const { return storage.getResidentPagesCount(); }
 
-        if (!inpEnable.read()) {
-            continue;
-        }
-
-        const auto addr = inpAddress.read().to_int() / memoryDataTypeByteSize;
-        if (inpWrite.read()) {
-            rawMemory[addr].write(inpData.read());
-        } else {
-            outData.write(rawMemory[addr].read());
-        }
+protected:
+    uint32_t readDword(size_t dwordIndex) const { return storage.readDword(dwordIndex); }
+    void writeDword(size_t dwordIndex, uint32_t value) { storage.writeDword(dwordIndex, value); }
 
-        outCompleted.write(1);
-    }
-}
+private:
+    MemoryStorage storage;
+};
@@ -0,0 +1,150 @@
+#include "gpu/blocks/memory_controller.h"
+#include "gpu/util/error.h"
+
+MemoryController::MemoryController(sc_module_name name, size_t clientsCount, size_t requestQueueDepth)
+    : clientsCount(clientsCount),
+      requestQueueDepth(requestQueueDepth),
+      clients(std::make_unique<ClientPorts[]>(clientsCount)),
+      clientStates(std::make_unique<ClientState[]>(clientsCount)) {
+    FATAL_ERROR_IF(clientsCount == 0, "MemoryController must have at least one client");
+    FATAL_ERROR_IF(requestQueueDepth == 0, "MemoryController request queue cannot be empty");
+    SC_CTHREAD(main, inpClock.pos());
+}
+
+void MemoryController::processCompletion() {
+    // Memory serves requests in order, so its completion always refers to the oldest outstanding request
+    if (!memory.inpCompleted.read()) {
+        return;
+    }
+    FATAL_ERROR_IF(outstandingRequests.empty(), "Memory completed a request, which was not issued");
+    OutstandingRequest &request = outstandingRequests.front();
+    ClientPorts &client = clients[request.clientIndex];
+
+    client.outCompleted.write(1);
+    if (!request.write) {
+        client.outData.write(memory.inpData.read());
+        if (--request.dwordsLeft > 0) {
+            return;
+        }
+        readsPerformed++;
+    } else {
+        writesPerformed++;
+    }
+
+    clientStates[request.clientIndex].requestsNotCompleted--;
+    outstandingRequests.pop_front();
+}
+
+void MemoryController::sendWriteData() {
+    // Dwords of a write burst following the first one are sent in consecutive cycles after the request
+    if (writingClient == -1) {
+        return;
+    }
+    std::deque<Request> &queue = clientStates[writingClient].queue;
+    memory.outData.write(queue.front().data[writeDwordsSent++]);
+    if (writeDwordsSent == queue.front().burstLength) {
+        queue.pop_front();
+        writingClient = -1;
+    }
+}
+
+void MemoryController::issueRequest() {
+    memory.outEnable.write(0);
+    memory.outWrite.write(0);
+
+    // Memory serves one dword per cycle and samples the next request right after the last dword of a burst
+    if (cyclesUntilMemoryFree > 0 && --cyclesUntilMemoryFree > 0) {
+        return;
+    }
+
+    // Select the next client with a queued request in round-robin order
+    for (unsigned int i = 0; i < clientsCount; i++) {
+        const unsigned int clientIndex = (nextClient + i) % clientsCount;
+        std::deque<Request> &queue = clientStates[clientIndex].queue;
+        if (queue.empty()) {
+            continue;
+        }
+
+        const Request &request = queue.front();
+        memory.outEnable.write(1);
+        memory.outWrite.write(request.write);
+        memory.outAddress.write(request.address);
+        memory.outBurstLength.write(request.burstLength);
+        if (request.write) {
+            memory.outData.write(request.data[0]);
+        }
+        outstandingRequests.push_back({clientIndex, request.write, request.burstLength});
+        cyclesUntilMemoryFree = request.burstLength;
+        bytesTransferred += request.burstLength * memoryDataTypeByteSize;
+
+        if (request.write && request.burstLength > 1) {
+            writingClient = clientIndex;
+            writeDwordsSent = 1;
+        } else {
+            queue.pop_front();
+        }
+        nextClient = (clientIndex + 1) % clientsCount;
+        return;
+    }
+}
+
+void MemoryController::receiveRequests() {
+    for (unsigned int clientIndex = 0; clientIndex < clientsCount; clientIndex++) {
+        ClientPorts &clientPorts = clients[clientIndex];
+        ClientState &clientState = clientStates[clientIndex];
+
+        // Remaining dwords of a write burst come in the cycles following the request
+        if (!clientState.queue.empty()) {
+            Request &lastRequest = clientState.queue.back();
+            if (lastRequest.write && clientState.writeDwordsReceived < lastRequest.burstLength) {
+                lastRequest.data[clientState.writeDwordsReceived++] = clientPorts.inpData.read().to_uint();
+                continue;
+            }
+        }
+
+        if (!clientPorts.inpEnable.read()) {
+            continue;
+        }
+        FATAL_ERROR_IF(clientState.requestsNotCompleted == requestQueueDepth, "MemoryController request queue overflow");
+        Request request = {};
+        request.write = clientPorts.inpWrite.read();
+        request.address = clientPorts.inpAddress.read();
+        request.burstLength = clientPorts.inpBurstLength.read().to_uint();
+        FATAL_ERROR_IF(request.burstLength == 0 || request.burstLength > maxMemoryBurstLength, "Invalid memory burst length");
+        if (request.write) {
+            request.data.resize(request.burstLength);
+            request.data[0] = clientPorts.inpData.read().to_uint();
+            clientState.writeDwordsReceived = 1;
+        }
+        clientState.queue.push_back(std::move(request));
+        clientState.requestsNotCompleted++;
+    }
+}
+
+void MemoryController::main() {
+    while (true) {
+        wait();
+
+        // Outputs for clients are valid for one cycle only
+        for (unsigned int clientIndex = 0; clientIndex < clientsCount; clientIndex++) {
+            clients[clientIndex].outCompleted.write(0);
+            clients[clientIndex].outData.write(0);
+        }
+
+        // Requests received in this cycle are issued in the next one at the earliest. It corresponds to latching them
+        // in a register, before they can be arbitrated.
+        processCompletion();
+        sendWriteData();
+        issueRequest();
+        receiveRequests();
+
+        bool busy = !outstandingRequests.empty();
+        for (unsigned int clientIndex = 0; clientIndex < clientsCount; clientIndex++) {
+            busy |= clientStates[clientIndex].requestsNotCompleted > 0;
+        }
+        profiling.outBusy = busy;
+        profiling.outReadsPerformed = readsPerformed;
+        profiling.outWritesPerformed = writesPerformed;
+        profiling.outBytesTransferred = bytesTransferred;
+    }
+}
@@ -2,29 +2,41 @@
 
 #include "gpu/definitions/types.h"
 
+#include <deque>
+#include <memory>
 #include <systemc.h>
+#include <vector>
 
-template <unsigned int clientsCount>
+// Arbitrates requests of multiple clients to a single Memory. Requests are queued per client and issued to the memory
+// back-to-back, as soon as it can accept them, without waiting for previous requests to complete. The memory serves
+// requests in order, so completions are matched with the oldest outstanding request. Each client has its own data
+// output, so returning data to one client does not block others.
 SC_MODULE(MemoryController) {
-    static_assert(clientsCount > 0);
+    SC_HAS_PROCESS(MemoryController);
+    MemoryController(sc_module_name name, size_t clientsCount, size_t requestQueueDepth = 4);
 
     sc_in_clk inpClock;
+    const size_t clientsCount;
+    const size_t requestQueueDepth; // maximum number of requests of a single client, which are not completed yet
 
     // Interface with clients
     struct ClientPorts {
         sc_in<bool> inpEnable;
         sc_in<bool> inpWrite;
         sc_in<MemoryAddressType> inpAddress;
+        sc_in<MemoryBurstLengthType> inpBurstLength;
         sc_in<MemoryDataType> inpData;
+        sc_out<MemoryDataType> outData;
         sc_out<bool> outCompleted;
-    } clients[clientsCount];
-    sc_out<MemoryDataType> outData;
+    };
+    std::unique_ptr<ClientPorts[]> clients;
 
     // Interface with memory
     struct MemoryPorts {
         sc_out<bool> outEnable;
         sc_out<bool> outWrite;
         sc_out<MemoryAddressType> outAddress;
+        sc_out<MemoryBurstLengthType> outBurstLength;
         sc_out<MemoryDataType> outData;
         sc_in<MemoryDataType> inpData;
         sc_in<bool> inpCompleted;
@@ -34,106 +46,40 @@ SC_MODULE(MemoryController) {
         sc_out<bool> outBusy;
         sc_out<sc_uint<32>> outReadsPerformed;
         sc_out<sc_uint<32>> outWritesPerformed;
+        sc_out<sc_uint<32>> outBytesTransferred; // divided by elapsed cycles gives achieved bandwidth in bytes per cycle
     } profiling;
 
-    // Latched values from clients
-    struct ClientLatchedSignals {
-        sc_signal<bool, SC_UNCHECKED_WRITERS> enable;
-        sc_signal<bool> write;
-        sc_signal<MemoryAddressType> address;
-        sc_signal<MemoryDataType> data;
-    } clientsLatched[clientsCount];
-
-    void waitForMemory() {
-        do {
-            wait();
-        } while (!memory.inpCompleted.read());
-    }
-
-    void listenClients() {
-        while (true) {
-            wait();
-            for (unsigned int i = 0; i < clientsCount; i++) {
-                ClientPorts &clientPorts = clients[i];
-                ClientLatchedSignals &clientSignals = clientsLatched[i];
-
-                if (clientPorts.inpEnable.read()) {
-                    clientSignals.enable.write(1);
-                    clientSignals.write.write(clientPorts.inpWrite);
-                    clientSignals.address.write(clientPorts.inpAddress);
-                    clientSignals.data.write(clientPorts.inpData);
-                }
-            }
-        }
-    }
-
-    void main() {
-        unsigned int currentClient = clientsCount - 1;
-        int clientForOutputClear = -1;
-
-        while (true) {
-            wait();
-
-            for (unsigned int i = 0; i < clientsCount; i++) {
-                // If we returned data for some client in previous cycle, now we can clear this data back to 0
-                if (clientForOutputClear != -1) {
-                    clients[clientForOutputClear].outCompleted.write(0);
-                    outData.write(0);
-                    clientForOutputClear = -1;
-                }
-
-                // Get our client and go to the next one
-                currentClient = (currentClient + 1) % clientsCount;
-                ClientPorts &client = clients[currentClient];
-                ClientLatchedSignals &clientLatched = clientsLatched[currentClient];
-
-                // Skip iteration this client, if it didn't issue any memory operation
-                if (!clientLatched.enable.read()) {
-                    profiling.outBusy = false;
-                    continue;
-                }
-                profiling.outBusy = true;
-
-                // Make a request to the memory
-                const bool memoryWrite = clientLatched.write.read();
-                memory.outEnable.write(1);
-                memory.outWrite.write(memoryWrite);
-                memory.outAddress.write(clientLatched.address.read());
-                if (memoryWrite) {
-                    memory.outData.write(clientLatched.data.read());
-
-                    wait();
-                    memory.outEnable.write(0);
-                    memory.outWrite.write(0);
-
-                    waitForMemory();
-                    profiling.outWritesPerformed = profiling.outWritesPerformed.read() + 1;
-                } else {
-                    wait();
-                    memory.outEnable.write(0);
-
-                    waitForMemory();
-                    profiling.outReadsPerformed = profiling.outReadsPerformed.read() + 1;
-
-                    outData.write(memory.inpData.read());
-                }
-
-                // Signalize success and save current client index, so the signal will be set back to
-                // 0 during the next cycle.
-                client.outCompleted.write(1);
-                clientForOutputClear = currentClient;
-
-                // Disable latched enable signal, so we don't issue it to the memory the second time
-                clientLatched.enable.write(0);
-
-                // We service only one client per clock - break out
-                break;
-            }
-        }
-    }
-
-    SC_CTOR(MemoryController) {
-        SC_CTHREAD(main, inpClock.pos());
-        SC_CTHREAD(listenClients, inpClock.pos());
-    }
+private:
+    struct Request {
+        bool write;
+        MemoryAddressType address;
+        size_t burstLength;
+        std::vector<uint32_t> data; // dwords of a write burst, received one per cycle
+    };
+    struct OutstandingRequest {
+        unsigned int clientIndex;
+        bool write;
+        size_t dwordsLeft; // read dwords not returned yet
+    };
+    struct ClientState {
+        std::deque<Request> queue;       // requests not issued to memory yet or write bursts still being sent
+        size_t writeDwordsReceived = 0;  // dwords of the last queued write burst received so far
+        size_t requestsNotCompleted = 0; // limited by requestQueueDepth
+    };
+
+    void processCompletion();
+    void sendWriteData();
+    void issueRequest();
+    void receiveRequests();
+    void main();
+
+    std::unique_ptr<ClientState[]> clientStates;
+    std::deque<OutstandingRequest> outstandingRequests; // issued to memory, in order of issue
+    int writingClient = -1;                             // client, whose write burst is being sent to memory
+    size_t writeDwordsSent = 0;
+    size_t cyclesUntilMemoryFree = 0;
+    unsigned int nextClient = 0;
+    uint32_t readsPerformed = 0;
+    uint32_t writesPerformed = 0;
+    uint32_t bytesTransferred = 0;
 };
@@ -1,5 +1,6 @@
 #include "gpu/blocks/output_merger.h"
 #include "gpu/util/conversions.h"
+#include "gpu/util/memory_access.h"
 #include "gpu/util/transfer.h"
 
 void OutputMerger::main() {
@@ -14,49 +15,21 @@ void OutputMerger::main() {
             const MemoryDataType depthAddress = depth.inpAddress.read() + (fragmentY * framebuffer.inpWidth.read() + fragmentX) * depthTypeByteSize;
 
             // Read current depth
-            memory.outEnable = 1;
-            memory.outAddress = depthAddress;
-            memory.outWrite = 0;
-            wait();
-            memory.outEnable = 0;
-            while (!memory.inpCompleted) {
-                wait();
-            }
-            memory.outAddress = 0;
+            const float currentDepth = Conversions::uintBytesToFloat(MemoryAccess::read(memory, depthAddress));
 
             // Actual depth test. Discard fragment if not passed
-            const float currentDepth = Conversions::readFloat(memory.inpData);
             if (fragmentZ >= currentDepth) {
                 continue;
             }
 
             // If depth test passed, update the value
             if (currentDepth != fragmentZ) {
-                memory.outEnable = 1;
-                memory.outWrite = 1;
-                memory.outAddress = depthAddress;
-                memory.outData = Conversions::floatBytesToUint(fragmentZ);
-                wait();
-                memory.outEnable = 0;
-                while (!memory.inpCompleted) {
-                    wait();
-                }
-                memory.outAddress = 0;
-                memory.outData = 0;
+                MemoryAccess::write(memory, depthAddress, Conversions::floatBytesToUint(fragmentZ));
             }
         }
 
         // Write pixel to memory
-        memory.outEnable = 1;
-        memory.outWrite = 1;
-        memory.outAddress = framebuffer.inpAddress.read() + (fragmentY * framebuffer.inpWidth.read() + fragmentX) * fragmentColorTypeByteSize;
-        memory.outData = fragment.color;
-        wait();
-        memory.outEnable = 0;
-        while (!memory.inpCompleted) {
-            wait();
-        }
-        memory.outAddress = 0;
-        memory.outData = 0;
+        const MemoryAddressType colorAddress = framebuffer.inpAddress.read() + (fragmentY * framebuffer.inpWidth.read() + fragmentX) * fragmentColorTypeByteSize;
+        MemoryAccess::write(memory, colorAddress, fragment.color.to_uint());
     }
 }
@@ -25,6 +25,7 @@ SC_MODULE(OutputMerger) {
         sc_out<bool> outEnable;
         sc_out<bool> outWrite;
         sc_out<MemoryAddressType> outAddress;
+        sc_out<MemoryBurstLengthType> outBurstLength;
         sc_out<MemoryDataType> outData;
         sc_in<MemoryDataType> inpData;
         sc_in<bool> inpCompleted;
@@ -1,10 +1,12 @@
 #include "gpu/blocks/primitive_assembler.h"
 #include "gpu/util/conversions.h"
+#include "gpu/util/memory_access.h"
 #include "gpu/util/raii_boolean_setter.h"
 #include "gpu/util/transfer.h"
 
 void PrimitiveAssembler::assemble() {
     const size_t maxInputComponents = verticesInPrimitive * Isa::maxInputOutputRegisters * Isa::registerComponentsCount;
+    static_assert(maxInputComponents <= maxMemoryBurstLength);
     uint32_t readVertices[maxInputComponents];
 
     while (1) {
@@ -25,10 +27,9 @@ void PrimitiveAssembler::assemble() {
                 wait();
             }
 
+            // Vertices of a triangle are stored contiguously, so they are fetched in a single burst
             const uint32_t triangleAddress = vertexBufferAddress + triangleIndex * componentsToTransfer * sizeof(uint32_t);
-            for (size_t componentIndex = 0; componentIndex < componentsToTransfer; componentIndex++) {
-                readVertices[componentIndex] = fetchComponentFromMemory(triangleAddress + componentIndex * sizeof(uint32_t));
-            }
+            MemoryAccess::readBurst(memory, triangleAddress, readVertices, componentsToTransfer);
 
             // Output the triangle to the next block
             Transfer::sendArrayWithParallelPorts(nextBlock.inpReceiving, nextBlock.outSending, nextBlock.outData, readVertices, componentsToTransfer);
@@ -36,17 +37,3 @@ void PrimitiveAssembler::assemble() {
         }
     }
 }
-
-uint32_t PrimitiveAssembler::fetchComponentFromMemory(uint32_t address) {
-    memory.outEnable = 1;
-    memory.outAddress = address;
-    wait(1);
-    memory.outEnable = 0;
-
-    while (!memory.inpCompleted) {
-        wait(1);
-    }
-
-    memory.outAddress = 0;
-    return memory.inpData.read();
-}
@@ -15,6 +15,7 @@ SC_MODULE(PrimitiveAssembler) {
     struct {
         sc_out<bool> outEnable;
         sc_out<MemoryAddressType> outAddress;
+        sc_out<MemoryBurstLengthType> outBurstLength;
         sc_in<MemoryDataType> inpData;
         sc_in<bool> inpCompleted;
     } memory;
@@ -37,5 +38,4 @@ SC_MODULE(PrimitiveAssembler) {
 
 private:
     void assemble();
-    uint32_t fetchComponentFromMemory(uint32_t address);
 };
@@ -12,7 +12,7 @@ struct ShaderFrontendRequest {
         struct {
             uint32_t clientToken : 16;
             NonZeroCount threadCount : Isa::simdExponent;
-            Isa::Command::ProgramType programType : 1;
+            Isa::Command::ProgramType programType : 2;
         };
         uint32_t raw;
     } dword1;
@@ -31,6 +31,7 @@ struct ShaderFrontendRequest {
             NonZeroCount uniformSize0 : 2;
             NonZeroCount uniformSize1 : 2;
             NonZeroCount uniformSize2 : 2;
+            uint32_t hasUniformMatrix : 1;
         };
         uint32_t raw;
     } dword2;
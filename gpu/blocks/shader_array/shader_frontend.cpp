@@ -2,11 +2,30 @@
 #include "gpu/blocks/shader_array/shader_frontend.h"
 #include "gpu/isa/isa.h"
 #include "gpu/util/error.h"
+#include "gpu/util/memory_access.h"
 #include "gpu/util/raii_boolean_setter.h"
 #include "gpu/util/transfer.h"
 
-void ShaderFrontendBase::requestThread() {
-    constexpr bool handshakeOnlyOnce = true;
+#include <algorithm>
+
+ShaderFrontend::ShaderFrontend(sc_module_name name, size_t clientsCount, size_t shaderUnitsCount, size_t threadGroupsPerShaderUnit)
+    : clientsCount(clientsCount),
+      shaderUnitsCount(shaderUnitsCount),
+      threadGroupsPerShaderUnit(threadGroupsPerShaderUnit),
+      clientInterfaces(std::make_unique<ClientInterface[]>(clientsCount)),
+      shaderUnitInterfaces(std::make_unique<ShaderUnitInterface[]>(shaderUnitsCount)),
+      shaderUnitStates(std::make_unique<ShaderUnitState[]>(shaderUnitsCount)) {
+    FATAL_ERROR_IF(clientsCount == 0, "ShaderFrontend must have at least one client");
+    FATAL_ERROR_IF(shaderUnitsCount == 0, "ShaderFrontend must have at least one shader unit");
+    FATAL_ERROR_IF(threadGroupsPerShaderUnit == 0, "ShaderFrontend must have at least one thread group per shader unit");
+
+    SC_CTHREAD(requestThread, inpClock.pos());
+    SC_CTHREAD(responseThread, inpClock.pos());
+    SC_METHOD(busySignalMethod);
+    sensitive << profiling.responseThreadBusy << profiling.requestThreadBusy;
+}
+
+void ShaderFrontend::requestThread() {
     constexpr size_t maxShaderInputsCount = (Isa::registerComponentsCount * Isa::maxInputOutputRegisters) * (1 + Isa::simdSize);
     uint32_t shaderInput[maxShaderInputsCount] = {};
 
@@ -21,9 +40,7 @@ void ShaderFrontendBase::requestThread() {
             continue;
         }
 
-        ShaderUnitInterface *shaderUnitInterface = {};
-        ShaderUnitState *shaderUnitState = {};
-        if (!findFreeShaderUnit(&shaderUnitInterface, &shaderUnitState)) {
+        if (!isAnyShaderUnitFree()) {
             profiling.requestThreadBusy = false;
             continue;
         }
@@ -44,29 +61,44 @@ void ShaderFrontendBase::requestThread() {
             shaderInput[i] = clientInterface->request.inpData.read();
         }
 
+        // Select a shader unit. A unit can hold multiple thread groups, but all of them have to execute the same program. If the
+        // unit has to be reprogrammed, we have to wait until it finishes all its work. We may not find any unit, even though some
+        // were free before we received the request, because we didn't know which program it needs. Wait for one in such case.
+        ShaderUnitInterface *shaderUnitInterface = {};
+        ShaderUnitState *shaderUnitState = {};
+        while (!findShaderUnitForIsa(request.dword0.isaAddress, &shaderUnitInterface, &shaderUnitState)) {
+            wait();
+        }
+
         // Our shader unit is stateful and the ISA to execute may already be loaded in it. If not, we have to read it from memory
         // and store it in the shader unit
         // TODO this stalls any other requests, that may have ISA already loaded. We could parallelize this somehow. There could be
         // a separate block that would be responsible for loading ISA from memory, caching it and sending to the shader units.
         // However, shader frontend would have to wait for it.
+        // The store command tells the unit that another command follows, so the execute command is sent without a handshake.
+        // If the ISA is already loaded, the execute command is the first one and has to perform the handshake.
+        bool handshakeAlreadyDone = false;
         if (request.dword0.isaAddress != shaderUnitState->loadedIsaAddress) {
             IsaCacheEntry &cachedIsa = getIsa(request.dword0.isaAddress);
             validateRequest(request, cachedIsa.getMetadata());
-            storeIsa(*shaderUnitInterface, cachedIsa, handshakeOnlyOnce);
+            storeIsa(*shaderUnitInterface, cachedIsa, true);
+            shaderUnitState->loadedIsaAddress = request.dword0.isaAddress;
+            handshakeAlreadyDone = true;
         }
 
         // At this point shader unit already know what it has to execute. We only have to issue the command and send the inputs to it.
-        executeIsa(*shaderUnitInterface, handshakeOnlyOnce, shaderInput, request.dword1.threadCount, shaderInputsCount);
+        executeIsa(*shaderUnitInterface, handshakeAlreadyDone, shaderInput, request.dword1.threadCount, shaderInputsCount);
 
         // Cache data about this request, so we can use it in responseThread
-        shaderUnitState->request.isActive = true;
-        shaderUnitState->request.clientIndex = clientIndex;
-        shaderUnitState->request.clientToken = request.dword1.clientToken;
-        shaderUnitState->request.outputsCount = calculateShaderOutputsCount(request);
+        ShaderUnitRequest shaderUnitRequest = {};
+        shaderUnitRequest.clientIndex = clientIndex;
+        shaderUnitRequest.clientToken = request.dword1.clientToken;
+        shaderUnitRequest.outputsCount = calculateShaderOutputsCount(request);
+        shaderUnitState->requests.push_back(shaderUnitRequest);
     }
 }
 
-void ShaderFrontendBase::responseThread() {
+void ShaderFrontend::responseThread() {
     constexpr size_t maxShaderOutputsCount = Isa::registerComponentsCount * Isa::maxInputOutputRegisters * Isa::simdSize + sizeof(ShaderFrontendResponse) / sizeof(uint32_t);
     uint32_t shaderOutputs[maxShaderOutputsCount] = {};
 
@@ -81,24 +113,26 @@ void ShaderFrontendBase::responseThread() {
             continue;
         }
         profiling.responseThreadBusy = true;
-        FATAL_ERROR_IF(!shaderUnitState->request.isActive, "Shader unit tried to return results for no reason");
+
+        // Shader units return results in the same order as they received the requests
+        const ShaderUnitRequest shaderUnitRequest = shaderUnitState->requests.front();
 
         // Prepare response header
         uint32_t shaderOutputsCount = 0;
         ShaderFrontendResponse response = {};
-        response.dword0.clientToken = shaderUnitState->request.clientToken;
+        response.dword0.clientToken = shaderUnitRequest.clientToken;
         shaderOutputs[shaderOutputsCount++] = response.dword0.raw;
 
         // Read results from shader unit
         auto &unit = shaderUnitInterface->response;
         shaderOutputs[shaderOutputsCount++] = Transfer::receive(unit.inpSending, unit.inpData, unit.outReceiving);
-        for (int i = 1; i < shaderUnitState->request.outputsCount; i++) {
+        for (int i = 1; i < shaderUnitRequest.outputsCount; i++) {
             wait();
             shaderOutputs[shaderOutputsCount++] = unit.inpData.read();
         }
 
-        // Free the shader unit by marking it as not busy
-        shaderUnitState->request.isActive = false;
+        // Free the thread group in shader unit
+        shaderUnitState->requests.pop_front();
 
         // Send results to client
         auto &client = clientInterface->response;
@@ -111,48 +145,86 @@ void ShaderFrontendBase::responseThread() {
     }
 }
 
-void ShaderFrontendBase::busySignalMethod() {
+bool ShaderFrontend::isAnyShaderUnitFree() {
+    for (size_t shaderUnitIndex = 0; shaderUnitIndex < shaderUnitsCount; shaderUnitIndex++) {
+        if (shaderUnitStates[shaderUnitIndex].requests.size() < threadGroupsPerShaderUnit) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ShaderFrontend::findShaderUnitForIsa(MemoryAddressType isaAddress, ShaderUnitInterface **outUnitInterface, ShaderUnitState **outState) {
+    // Prefer units, which already have the ISA loaded and have a free thread group
+    for (size_t shaderUnitIndex = 0; shaderUnitIndex < shaderUnitsCount; shaderUnitIndex++) {
+        const ShaderUnitState &state = shaderUnitStates[shaderUnitIndex];
+        if (state.loadedIsaAddress == isaAddress && state.requests.size() < threadGroupsPerShaderUnit) {
+            *outUnitInterface = &shaderUnitInterfaces[shaderUnitIndex];
+            *outState = &shaderUnitStates[shaderUnitIndex];
+            return true;
+        }
+    }
+
+    // Otherwise take an idle unit, which can be reprogrammed
+    for (size_t shaderUnitIndex = 0; shaderUnitIndex < shaderUnitsCount; shaderUnitIndex++) {
+        if (shaderUnitStates[shaderUnitIndex].requests.empty()) {
+            *outUnitInterface = &shaderUnitInterfaces[shaderUnitIndex];
+            *outState = &shaderUnitStates[shaderUnitIndex];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ShaderFrontend::findClientMakingRequest(ClientInterface **outClientInterface, size_t *outIndex) {
+    for (size_t clientIndex = 0; clientIndex < clientsCount; clientIndex++) {
+        if (clientInterfaces[clientIndex].request.inpSending.read()) {
+            *outClientInterface = &clientInterfaces[clientIndex];
+            *outIndex = clientIndex;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ShaderFrontend::findShaderUnitSendingResponse(ShaderUnitInterface **outUnitInterface, ShaderUnitState **outState, ClientInterface **outClientInterface) {
+    for (size_t shaderUnitIndex = 0; shaderUnitIndex < shaderUnitsCount; shaderUnitIndex++) {
+        if (shaderUnitInterfaces[shaderUnitIndex].response.inpSending.read()) {
+            *outUnitInterface = &shaderUnitInterfaces[shaderUnitIndex];
+            *outState = &shaderUnitStates[shaderUnitIndex];
+            FATAL_ERROR_IF(shaderUnitStates[shaderUnitIndex].requests.empty(), "Shader unit tried to return results for no reason");
+            *outClientInterface = &clientInterfaces[shaderUnitStates[shaderUnitIndex].requests.front().clientIndex];
+            return true;
+        }
+    }
+    return false;
+}
+
+void ShaderFrontend::busySignalMethod() {
     profiling.outBusy = profiling.requestThreadBusy | profiling.responseThreadBusy;
 }
 
-ShaderFrontendBase::IsaCacheEntry &ShaderFrontendBase::getIsa(uint32_t isaAddress) {
+ShaderFrontend::IsaCacheEntry &ShaderFrontend::getIsa(uint32_t isaAddress) {
     // First look in cache
     if (IsaCacheEntry *isa = isaCache.get(isaAddress); isa != nullptr) {
         return *isa;
     }
 
-    // If did not found in cache, load from memory
+    // If did not found in cache, load from memory. The first dword is the command header, which contains the length
+    // of the program. The program is then loaded in bursts.
     IsaCacheEntry isa = {};
-    size_t dwordsLoaded = 0;
-    size_t dwordsToLoad = 1;
-    while (dwordsToLoad > 0) {
-        FATAL_ERROR_IF(dwordsLoaded >= Isa::maxIsaSize, "Too big ISA to fit in cache");
-
-        // Load from memory
-        memory.outAddress = isaAddress + 4 * dwordsLoaded;
-        memory.outEnable = 1;
-        wait();
-        memory.outEnable = 0;
-        while (!memory.inpCompleted) {
-            wait();
-        }
-        memory.outAddress = 0;
-
-        // Store in cache
-        uint32_t dword = memory.inpData.read().to_int();
-        isa.data[dwordsLoaded] = dword;
-
-        // Update counters
-        dwordsLoaded++;
-        dwordsToLoad--;
-
-        // If this is a first dword we've read, we're looking at the command header with metadata, which we have to process
-        if (dwordsLoaded == 1) {
-            auto command = reinterpret_cast<Isa::Command::CommandStoreIsa &>(dword);
-            FATAL_ERROR_IF(command.commandType != Isa::Command::CommandType::StoreIsa, "Invalid command header");
-            FATAL_ERROR_IF(command.programLength == 0, "Invalid program length");
-            dwordsToLoad = command.programLength + Isa::commandSizeInDwords - 1;
-        }
+    isa.data[0] = MemoryAccess::read(memory, isaAddress);
+    const auto command = reinterpret_cast<Isa::Command::CommandStoreIsa &>(isa.data[0]);
+    FATAL_ERROR_IF(command.commandType != Isa::Command::CommandType::StoreIsa, "Invalid command header");
+    FATAL_ERROR_IF(command.programLength == 0, "Invalid program length");
+    const size_t dwordsToLoad = command.programLength + Isa::commandSizeInDwords;
+    FATAL_ERROR_IF(dwordsToLoad > Isa::maxIsaSize, "Too big ISA to fit in cache");
+
+    size_t dwordsLoaded = 1;
+    while (dwordsLoaded < dwordsToLoad) {
+        const size_t burstLength = std::min(dwordsToLoad - dwordsLoaded, maxMemoryBurstLength);
+        MemoryAccess::readBurst(memory, isaAddress + 4 * dwordsLoaded, isa.data + dwordsLoaded, burstLength);
+        dwordsLoaded += burstLength;
     }
 
     isa.dataSize = dwordsLoaded;
@@ -163,14 +235,14 @@ ShaderFrontendBase::IsaCacheEntry &ShaderFrontendBase::getIsa(uint32_t isaAddres
     return *isaCache.put(isaAddress, std::move(isa));
 }
 
-void ShaderFrontendBase::storeIsa(ShaderUnitInterface &shaderUnitInterface, ShaderFrontendBase::IsaCacheEntry &cache, bool hasNextCommand) {
+void ShaderFrontend::storeIsa(ShaderUnitInterface &shaderUnitInterface, ShaderFrontend::IsaCacheEntry &cache, bool hasNextCommand) {
     cache.getMetadata().hasNextCommand = hasNextCommand;
 
     auto &unit = shaderUnitInterface.request;
     Transfer::sendArray(unit.inpReceiving, unit.outSending, unit.outData, cache.data, cache.dataSize);
 }
 
-void ShaderFrontendBase::executeIsa(ShaderUnitInterface &shaderUnitInterface, bool handshakeAlreadyDone, const uint32_t *shaderInputs, NonZeroCount threadCount, uint32_t shaderInputsCount) {
+void ShaderFrontend::executeIsa(ShaderUnitInterface &shaderUnitInterface, bool handshakeAlreadyDone, const uint32_t *shaderInputs, NonZeroCount threadCount, uint32_t shaderInputsCount) {
     auto &unit = shaderUnitInterface.request;
 
     // Send the command
@@ -187,7 +259,7 @@ void ShaderFrontendBase::executeIsa(ShaderUnitInterface &shaderUnitInterface, bo
     }
 }
 
-size_t ShaderFrontendBase::calculateShaderInputsCount(const ShaderFrontendRequest &request) {
+size_t ShaderFrontend::calculateShaderInputsCount(const ShaderFrontendRequest &request) {
     size_t perThreadInputs = 0;
     size_t perRequestInputs = 0;
 
@@ -206,6 +278,9 @@ size_t ShaderFrontendBase::calculateShaderInputsCount(const ShaderFrontendReques
             perRequestInputs += nonZeroCountToInt(request.dword2.inputSize2);
         }
         perRequestInputs *= 3; // Above inputs will be placed for each vertex in the triangle
+    } else if (request.dword1.programType == Isa::Command::ProgramType::ComputeShader) {
+        // Receive id of the first thread. Shader unit generates ids of the remaining threads.
+        perRequestInputs = 1;
     } else {
         if (attributesCount > 0) {
             perThreadInputs += nonZeroCountToInt(request.dword2.inputSize0);
@@ -229,11 +304,19 @@ size_t ShaderFrontendBase::calculateShaderInputsCount(const ShaderFrontendReques
     if (uniformsCount > 2) {
         perRequestInputs += nonZeroCountToInt(request.dword2.uniformSize2);
     }
+    if (request.dword2.hasUniformMatrix) {
+        perRequestInputs += Isa::matrixDwordsCount;
+    }
 
     return perThreadInputs * nonZeroCountToInt(request.dword1.threadCount) + perRequestInputs;
 }
 
-size_t ShaderFrontendBase::calculateShaderOutputsCount(const ShaderFrontendRequest &request) {
+size_t ShaderFrontend::calculateShaderOutputsCount(const ShaderFrontendRequest &request) {
+    // Compute shaders store results to memory and only return the number of finished threads
+    if (request.dword1.programType == Isa::Command::ProgramType::ComputeShader) {
+        return 1;
+    }
+
     size_t components = 0;
 
     int registersCount = nonZeroCountToInt(request.dword2.outputsCount);
@@ -251,7 +334,8 @@ size_t ShaderFrontendBase::calculateShaderOutputsCount(const ShaderFrontendReque
     return components;
 }
 
-void ShaderFrontendBase::validateRequest(const ShaderFrontendRequest &request, Isa::Command::CommandStoreIsa &isaCommand) {
+void ShaderFrontend::validateRequest(const ShaderFrontendRequest &request, Isa::Command::CommandStoreIsa &isaCommand) {
+    FATAL_ERROR_IF(isaCommand.programType != request.dword1.programType, "Invalid program type");
     FATAL_ERROR_IF(isaCommand.inputsCount != request.dword2.inputsCount, "Invalid inputs count");
     const int inputsCount = nonZeroCountToInt(isaCommand.inputsCount);
     if (request.dword1.programType == Isa::Command::ProgramType::FragmentShader) {
@@ -288,4 +372,5 @@ void ShaderFrontendBase::validateRequest(const ShaderFrontendRequest &request, I
     if (uniformsCount > 2) {
         FATAL_ERROR_IF(isaCommand.uniformSize2 != request.dword2.uniformSize2, "Invalid uniformSize2");
     }
+    FATAL_ERROR_IF(isaCommand.hasUniformMatrix != request.dword2.hasUniformMatrix, "Invalid uniform matrix");
 }
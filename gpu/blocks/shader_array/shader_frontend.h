@@ -5,13 +5,19 @@
 #include "gpu/isa/isa.h"
 #include "gpu/util/entry_cache.h"
 
+#include <deque>
+#include <memory>
 #include <systemc.h>
 
-SC_MODULE(ShaderFrontendBase) {
+SC_MODULE(ShaderFrontend) {
+    SC_HAS_PROCESS(ShaderFrontend);
+    ShaderFrontend(sc_module_name name, size_t clientsCount, size_t shaderUnitsCount, size_t threadGroupsPerShaderUnit = 1);
+
     sc_in_clk inpClock;
     struct {
         sc_out<bool> outEnable;
         sc_out<MemoryAddressType> outAddress;
+        sc_out<MemoryBurstLengthType> outBurstLength;
         sc_in<MemoryDataType> inpData;
         sc_in<bool> inpCompleted;
     } memory;
@@ -22,15 +28,7 @@ SC_MODULE(ShaderFrontendBase) {
         sc_out<sc_uint<32>> outIsaFetches;
     } profiling;
 
-    SC_CTOR(ShaderFrontendBase) {
-        SC_CTHREAD(requestThread, inpClock.pos());
-        SC_CTHREAD(responseThread, inpClock.pos());
-        SC_METHOD(busySignalMethod);
-        sensitive << profiling.responseThreadBusy << profiling.requestThreadBusy;
-    }
-
-protected:
-    // Structures to hold values dependent on clientsCount and shaderUnitsCount, which will be instantiated in templated subclass
+    // Interfaces with clients and shader units. Their counts are selected at construction time.
     struct ClientInterface {
         struct {
             sc_in<bool> inpSending;
@@ -57,22 +55,33 @@ protected:
             sc_in<sc_uint<32>> inpData;
         } response;
     };
+    const size_t clientsCount;
+    const size_t shaderUnitsCount;
+    const size_t threadGroupsPerShaderUnit;
+    std::unique_ptr<ClientInterface[]> clientInterfaces;
+    std::unique_ptr<ShaderUnitInterface[]> shaderUnitInterfaces;
+
+private:
+    struct ShaderUnitRequest {
+        int clientIndex{};
+        int clientToken{};
+        int outputsCount{};
+    };
     struct ShaderUnitState {
         MemoryAddressType loadedIsaAddress = 0xffffffff;
-        struct {
-            bool isActive = false;
-            int clientIndex{};
-            int clientToken{};
-            int outputsCount{};
-        } request;
+        std::deque<ShaderUnitRequest> requests; // one entry per occupied thread group, in order of execution
     };
 
-    // Methods for traversing clients and shader units. Moved to a templated subclass, since this class doesn't know about them.
-    virtual bool findFreeShaderUnit(ShaderUnitInterface * *outUnitInterface, ShaderUnitState * *outState) = 0;
-    virtual bool findClientMakingRequest(ClientInterface * *outClientInterface, size_t * outIndex) = 0;
-    virtual bool findShaderUnitSendingResponse(ShaderUnitInterface * *outUnitInterface, ShaderUnitState * *outState, ClientInterface * *outClientInterface) = 0;
+    // This array holds states that we programmed for shader unit. It is cached, so we don't have to
+    // ask the shader units about their states and transfer too much data.
+    std::unique_ptr<ShaderUnitState[]> shaderUnitStates;
+
+    // Methods for traversing clients and shader units
+    bool isAnyShaderUnitFree();
+    bool findShaderUnitForIsa(MemoryAddressType isaAddress, ShaderUnitInterface * *outUnitInterface, ShaderUnitState * *outState);
+    bool findClientMakingRequest(ClientInterface * *outClientInterface, size_t * outIndex);
+    bool findShaderUnitSendingResponse(ShaderUnitInterface * *outUnitInterface, ShaderUnitState * *outState, ClientInterface * *outClientInterface);
 
-private:
     // Methods implementing SystemC processes
     void requestThread();
     void responseThread();
@@ -107,50 +116,3 @@ private:
     size_t calculateShaderOutputsCount(const ShaderFrontendRequest &request);
     void validateRequest(const ShaderFrontendRequest &request, Isa::Command::CommandStoreIsa &isaCommand);
 };
-
-template <size_t clientsCount, size_t shaderUnitsCount>
-struct ShaderFrontend : ShaderFrontendBase {
-    using ShaderFrontendBase::ShaderFrontendBase;
-    ClientInterface clientInterfaces[clientsCount];
-    ShaderUnitInterface shaderUnitInterfaces[shaderUnitsCount];
-
-protected:
-    bool findFreeShaderUnit(ShaderUnitInterface **outUnitInterface, ShaderUnitState **outState) override {
-        for (size_t shaderUnitIndex = 0; shaderUnitIndex < shaderUnitsCount; shaderUnitIndex++) {
-            if (!shaderUnitStates[shaderUnitIndex].request.isActive) {
-                *outUnitInterface = &shaderUnitInterfaces[shaderUnitIndex];
-                *outState = &shaderUnitStates[shaderUnitIndex];
-                return true;
-            }
-        }
-        return false;
-    }
-
-    bool findClientMakingRequest(ClientInterface **outClientInterface, size_t *outIndex) override {
-        for (size_t clientIndex = 0; clientIndex < clientsCount; clientIndex++) {
-            if (clientInterfaces[clientIndex].request.inpSending.read()) {
-                *outClientInterface = &clientInterfaces[clientIndex];
-                *outIndex = clientIndex;
-                return true;
-            }
-        }
-        return false;
-    }
-
-    bool findShaderUnitSendingResponse(ShaderUnitInterface **outUnitInterface, ShaderUnitState **outState, ClientInterface **outClientInterface) override {
-        for (size_t shaderUnitIndex = 0; shaderUnitIndex < shaderUnitsCount; shaderUnitIndex++) {
-            if (shaderUnitInterfaces[shaderUnitIndex].response.inpSending.read()) {
-                *outUnitInterface = &shaderUnitInterfaces[shaderUnitIndex];
-                *outState = &shaderUnitStates[shaderUnitIndex];
-                *outClientInterface = &clientInterfaces[shaderUnitStates[shaderUnitIndex].request.clientIndex];
-                return true;
-            }
-        }
-        return false;
-    }
-
-private:
-    // This array holds states that we programmed for shader unit. It is cached, so we don't have to
-    // ask the shader units about their states and transfer too much data.
-    ShaderUnitState shaderUnitStates[shaderUnitsCount];
-};
@@ -2,19 +2,138 @@
 #include "gpu/definitions/register_allocator.h"
 #include "gpu/util/conversions.h"
 #include "gpu/util/math.h"
+#include "gpu/util/memory_access.h"
 #include "gpu/util/os_interface.h"
 #include "gpu/util/transfer.h"
 
 #include <algorithm>
+#include <cmath>
+
+namespace {
+namespace Operations {
+float asf(int32_t arg) { return reinterpret_cast<float &>(arg); }
+int32_t asi(float arg) { return reinterpret_cast<int32_t &>(arg); }
+
+int32_t fadd(int32_t src1, int32_t src2) { return asi(asf(src1) + asf(src2)); }
+int32_t fsub(int32_t src1, int32_t src2) { return asi(asf(src1) - asf(src2)); }
+int32_t fmul(int32_t src1, int32_t src2) { return asi(asf(src1) * asf(src2)); }
+int32_t fdiv(int32_t src1, int32_t src2) { return asi(asf(src1) / asf(src2)); }
+int32_t fneg(int32_t src) { return asi(-asf(src)); }
+int32_t fdot(VectorRegister src1, VectorRegister src2) {
+    return asi(asf(src1.x) * asf(src2.x) +
+               asf(src1.y) * asf(src2.y) +
+               asf(src1.z) * asf(src2.z) +
+               asf(src1.w) * asf(src2.w));
+}
+VectorRegister fcross(VectorRegister src1, VectorRegister src2) {
+    return VectorRegister{
+        asi(asf(src1.y) * asf(src2.z) - asf(src1.z) * asf(src2.y)),
+        asi(asf(src1.z) * asf(src2.x) - asf(src1.x) * asf(src2.z)),
+        asi(asf(src1.x) * asf(src2.y) - asf(src1.y) * asf(src2.x)),
+        0,
+    };
+}
+int32_t fcross2(VectorRegister src1, VectorRegister src2) { return asi(asf(src1.x) * asf(src2.y) - asf(src1.y) * asf(src2.x)); }
+int32_t fmad(int32_t src1, int32_t src2, int32_t src3) { return asi(asf(src1) * asf(src2) + asf(src3)); }
+int32_t frcp(int32_t src) { return asi(1 / asf(src)); }
+VectorRegister fnorm(VectorRegister src) {
+    const float x = asf(src.x);
+    const float y = asf(src.y);
+    const float z = asf(src.z);
+    const float w = asf(src.w);
+    const float len = sqrtf(x * x + y * y + z * z + w * w);
+    return VectorRegister{
+        asi(x / len),
+        asi(y / len),
+        asi(z / len),
+        asi(w / len),
+    };
+}
+int32_t fmax(int32_t src1, int32_t src2) { return asi(std::max(asf(src1), asf(src2))); }
+int32_t fmin(int32_t src1, int32_t src2) { return asi(std::min(asf(src1), asf(src2))); }
+int32_t fsqrt(int32_t src) { return asi(sqrtf(asf(src))); }
+int32_t frsq(int32_t src) { return asi(1 / sqrtf(asf(src))); }
+int32_t fexp2(int32_t src) { return asi(exp2f(asf(src))); }
+int32_t flog2(int32_t src) { return asi(log2f(asf(src))); }
+int32_t fsin(int32_t src) { return asi(sinf(asf(src))); }
+int32_t fcos(int32_t src) { return asi(cosf(asf(src))); }
+int32_t fpow(int32_t src1, int32_t src2) { return asi(powf(asf(src1), asf(src2))); }
+int32_t f2unorm8(VectorRegister src) {
+    // Same conversion as done by the FragmentShader block for unpacked colors
+    const auto toUnorm8 = [](int32_t component) { return static_cast<uint32_t>(saturate(asf(component)) * 255); };
+    return toUnorm8(src.x) | toUnorm8(src.y) << 8 | toUnorm8(src.z) << 16 | toUnorm8(src.w) << 24;
+}
+int32_t fcmpeq(int32_t src1, int32_t src2) { return asf(src1) == asf(src2) ? ~0 : 0; }
+int32_t fcmpne(int32_t src1, int32_t src2) { return asf(src1) != asf(src2) ? ~0 : 0; }
+int32_t fcmplt(int32_t src1, int32_t src2) { return asf(src1) < asf(src2) ? ~0 : 0; }
+int32_t fcmple(int32_t src1, int32_t src2) { return asf(src1) <= asf(src2) ? ~0 : 0; }
+
+int32_t iadd(int32_t src1, int32_t src2) { return src1 + src2; }
+int32_t isub(int32_t src1, int32_t src2) { return src1 - src2; }
+int32_t imul(int32_t src1, int32_t src2) { return src1 * src2; }
+int32_t idiv(int32_t src1, int32_t src2) { return src2 != 0 ? src1 / src2 : 0; } // lanes disabled by control flow may divide by zero
+int32_t ineg(int32_t src) { return -src; }
+int32_t imax(int32_t src1, int32_t src2) { return std::max(src1, src2); }
+int32_t imin(int32_t src1, int32_t src2) { return std::min(src1, src2); }
+int32_t icmpeq(int32_t src1, int32_t src2) { return src1 == src2 ? ~0 : 0; }
+int32_t icmpne(int32_t src1, int32_t src2) { return src1 != src2 ? ~0 : 0; }
+int32_t icmplt(int32_t src1, int32_t src2) { return src1 < src2 ? ~0 : 0; }
+int32_t icmple(int32_t src1, int32_t src2) { return src1 <= src2 ? ~0 : 0; }
+int32_t iand(int32_t src1, int32_t src2) { return src1 & src2; }
+int32_t ior(int32_t src1, int32_t src2) { return src1 | src2; }
+int32_t ixor(int32_t src1, int32_t src2) { return src1 ^ src2; }
+int32_t ishl(int32_t src1, int32_t src2) { return static_cast<uint32_t>(src1) << (src2 & 31); }
+int32_t ishr(int32_t src1, int32_t src2) { return static_cast<uint32_t>(src1) >> (src2 & 31); }
+
+int32_t mov(int32_t src) { return src; }
+} // namespace Operations
+
+uint32_t lowLanesMask(uint32_t lanesCount) {
+    return lanesCount >= 32 ? ~0u : (1u << lanesCount) - 1;
+}
+static_assert(Isa::simdSize <= 32, "Lane masks are stored in 32-bit integers");
+} // namespace
+
+ShaderUnit::ShaderUnit(sc_module_name name, ShaderExecutionMode executionMode, const ShaderUnitTiming &timing, size_t threadGroupsCount)
+    : sc_module(name),
+      executionMode(executionMode),
+      timing(timing),
+      threadGroupsCount(threadGroupsCount),
+      threadGroups(std::make_unique<ThreadGroup[]>(threadGroupsCount)) {
+    FATAL_ERROR_IF(timing.lanesPerCycle == 0, "ShaderUnit must process at least one lane per cycle");
+    FATAL_ERROR_IF(threadGroupsCount == 0, "ShaderUnit must have at least one thread group");
+    for (size_t opcodeIndex = 0; opcodeIndex < static_cast<size_t>(Isa::Opcode::COUNT); opcodeIndex++) {
+        FATAL_ERROR_IF(timing.opcodes[opcodeIndex].issueCycles == 0, "ShaderUnit cannot issue opcode ", opcodeIndex, " in 0 cycles");
+    }
 
-void ShaderUnit::main() {
+    for (size_t threadGroupIndex = 0; threadGroupIndex < threadGroupsCount; threadGroupIndex++) {
+        freeThreadGroups.push(&threadGroups[threadGroupIndex]);
+    }
+
+    SC_CTHREAD(requestThread, inpClock.pos());
+    SC_CTHREAD(executeThread, inpClock.pos());
+    SC_CTHREAD(responseThread, inpClock.pos());
+    SC_METHOD(busySignalMethod);
+    sensitive << profiling.requestThreadBusy << profiling.executeThreadBusy << profiling.responseThreadBusy;
+}
+
+void ShaderUnit::requestThread() {
     bool handshakeAlreadyEstablished = false;
 
     while (true) {
+        // Do not accept any commands until there is a free thread group to store the inputs in. ShaderFrontend
+        // tracks our free groups, so it will not send more work than we can hold. It may only start a new request
+        // a bit before the group is returned to the free list.
+        profiling.requestThreadBusy = false;
+        while (freeThreadGroups.empty()) {
+            wait();
+        }
+
         // Read ISA header
         Isa::Command::Command command = {};
-        Transfer::receiveArray(request.inpSending, request.inpData, request.outReceiving, command.dummy.raw, Isa::commandSizeInDwords, &profiling.outBusy, !handshakeAlreadyEstablished);
+        Transfer::receiveArray(request.inpSending, request.inpData, request.outReceiving, command.dummy.raw, Isa::commandSizeInDwords, nullptr, !handshakeAlreadyEstablished);
         handshakeAlreadyEstablished = command.dummy.hasNextCommand;
+        profiling.requestThreadBusy = true;
 
         switch (command.dummy.commandType) {
         case Isa::Command::CommandType::ExecuteIsa:
@@ -29,40 +148,96 @@ void ShaderUnit::main() {
     }
 }
 
+void ShaderUnit::executeThread() {
+    while (true) {
+        wait();
+
+        if (receivedThreadGroups.empty()) {
+            profiling.executeThreadBusy = false;
+            continue;
+        }
+        profiling.executeThreadBusy = true;
+        ThreadGroup &group = *receivedThreadGroups.front();
+        receivedThreadGroups.pop();
+
+        // Load the group's context to the working registers
+        registers = group.registers;
+        std::copy_n(group.uniformDwords, maxUniformDwords, uniformDwords);
+        std::copy_n(group.uniformMatrix, Isa::matrixDwordsCount, uniformMatrix);
+
+        // Execute isa
+        profiling.outThreadsStarted = profiling.outThreadsStarted.read() + group.threadCount;
+        executeInstructions(group.threadCount);
+        profiling.outThreadsFinished = profiling.outThreadsFinished.read() + group.threadCount;
+
+        // Store the results back, so the group can be sent while we execute another one
+        group.registers = registers;
+        executedThreadGroups.push(&group);
+    }
+}
+
+void ShaderUnit::responseThread() {
+    while (true) {
+        wait();
+
+        if (executedThreadGroups.empty()) {
+            profiling.responseThreadBusy = false;
+            continue;
+        }
+        profiling.responseThreadBusy = true;
+        ThreadGroup &group = *executedThreadGroups.front();
+        executedThreadGroups.pop();
+
+        // Stream-out values from output registers
+        uint32_t outputStream[Isa::registerComponentsCount * Isa::maxInputOutputRegisters * Isa::simdSize];
+        uint32_t outputStreamSize = {};
+        appendOutputRegistersValues(group, outputStream, outputStreamSize);
+        Transfer::sendArray(response.inpReceiving, response.outSending, response.outData, outputStream, outputStreamSize);
+
+        freeThreadGroups.push(&group);
+    }
+}
+
+void ShaderUnit::busySignalMethod() {
+    profiling.outBusy = profiling.requestThreadBusy | profiling.executeThreadBusy | profiling.responseThreadBusy;
+}
+
 void ShaderUnit::processStoreIsaCommand(Isa::Command::CommandStoreIsa command) {
+    // Thread groups already received would execute a wrong program
+    FATAL_ERROR_IF(freeThreadGroups.size() != threadGroupsCount, "ISA can only be stored when all thread groups are finished");
+
     const uint32_t isaSize = command.programLength;
     this->isaMetadata = command;
     for (int i = 0; i < isaSize; i++) {
         wait();
         this->isa[i] = request.inpData.read();
     }
+    decodeIsa();
+    if (executionMode != ShaderExecutionMode::Interpreter) {
+        compileIsa();
+    }
 }
 
 void ShaderUnit::processExecuteIsaCommand(Isa::Command::CommandExecuteIsa command) {
+    ThreadGroup &group = *freeThreadGroups.front();
+    freeThreadGroups.pop();
+
     // Clear all registers to 0
     static_assert(std::is_pod_v<Registers>);
-    memset(&registers, 0, sizeof(registers));
-
-    // Stream-in values for input registers
-    const auto threadCount = nonZeroCountToInt(command.threadCount);
-    initializeInputRegisters(threadCount);
+    memset(&group.registers, 0, sizeof(group.registers));
 
-    // Execute isa
-    profiling.outThreadsStarted = profiling.outThreadsStarted.read() + threadCount;
-    executeInstructions(isaMetadata.programLength, threadCount);
-    profiling.outThreadsFinished = profiling.outThreadsFinished.read() + threadCount;
-
-    // Stream-out values from output registers
-    uint32_t outputStream[Isa::registerComponentsCount * Isa::maxInputOutputRegisters * Isa::simdSize];
-    uint32_t outputStreamSize = {};
-    appendOutputRegistersValues(threadCount, outputStream, outputStreamSize);
-
-    Transfer::sendArray(response.inpReceiving, response.outSending, response.outData, outputStream, outputStreamSize);
+    // Stream-in values for input registers and queue the group for execution
+    group.threadCount = nonZeroCountToInt(command.threadCount);
+    initializeInputRegisters(group);
+    receivedThreadGroups.push(&group);
 }
 
-void ShaderUnit::initializeInputRegisters(uint32_t threadCount) {
+void ShaderUnit::initializeInputRegisters(ThreadGroup &group) {
+    const uint32_t threadCount = group.threadCount;
+
     // Get info about input components
     const bool isFs = isaMetadata.programType == Isa::Command::ProgramType::FragmentShader;
+    const bool isCs = isaMetadata.programType == Isa::Command::ProgramType::ComputeShader;
     const uint32_t inputsCount = nonZeroCountToInt(isaMetadata.inputsCount);
     Isa::RegisterIndex inputRegisterIndices[4] = {};
     uint32_t inputComponentsCounts[4] = {};
@@ -87,20 +262,28 @@ void ShaderUnit::initializeInputRegisters(uint32_t threadCount) {
     // Receive per thread inputs from SF. In normal shaders all input attributes will be passed and stored in registers.
     // In FS only xy position is passed and we store it in the first input register. They will be interpolated later by
     // code generated by the compiler and results will be stored to actual input registers defined in isaMetadata.
+    // In CS only id of the first thread is passed. Remaining threads of the group have subsequent ids.
     constexpr size_t maxPerThreadDwords = Isa::simdSize * Isa::maxInputOutputRegisters * Isa::registerComponentsCount;
     uint32_t perThreadDwords[maxPerThreadDwords];
+    uint32_t firstThreadId = 0;
     if (isFs) {
         const auto dwordsCout = threadCount * 2;
         Transfer::receiveArray(request.inpSending, request.inpData, request.outReceiving, perThreadDwords, dwordsCout, nullptr, false);
+    } else if (isCs) {
+        Transfer::receiveArray(request.inpSending, request.inpData, request.outReceiving, &firstThreadId, 1, nullptr, false);
     } else {
         const auto dwordsCount = threadCount * inputTotalComponentCount;
         Transfer::receiveArray(request.inpSending, request.inpData, request.outReceiving, perThreadDwords, dwordsCount, nullptr, false);
     }
 
     // Receive per-request uniform values.
-    std::fill_n(uniformDwords, maxUniformDwords, 0);
+    std::fill_n(group.uniformDwords, maxUniformDwords, 0);
     if (uniformsTotalComponentCount != 0) {
-        Transfer::receiveArray(request.inpSending, request.inpData, request.outReceiving, uniformDwords, uniformsTotalComponentCount, nullptr, false);
+        Transfer::receiveArray(request.inpSending, request.inpData, request.outReceiving, group.uniformDwords, uniformsTotalComponentCount, nullptr, false);
+    }
+    std::fill_n(group.uniformMatrix, Isa::matrixDwordsCount, 0);
+    if (isaMetadata.hasUniformMatrix) {
+        Transfer::receiveArray(request.inpSending, request.inpData, request.outReceiving, reinterpret_cast<uint32_t *>(group.uniformMatrix), Isa::matrixDwordsCount, nullptr, false);
     }
 
     // Receive per-request vertex attributes for FS.
@@ -114,8 +297,12 @@ void ShaderUnit::initializeInputRegisters(uint32_t threadCount) {
     // Store per-thread inputs in registers
     if (isFs) {
         for (int threadIndex = 0; threadIndex < threadCount; threadIndex++) {
-            registers.gpr[threadIndex][inputRegisterIndices[0]].x = perThreadDwords[threadIndex * 2 + 0];
-            registers.gpr[threadIndex][inputRegisterIndices[0]].y = perThreadDwords[threadIndex * 2 + 1];
+            group.registers.gpr[inputRegisterIndices[0]][0][threadIndex] = perThreadDwords[threadIndex * 2 + 0];
+            group.registers.gpr[inputRegisterIndices[0]][1][threadIndex] = perThreadDwords[threadIndex * 2 + 1];
+        }
+    } else if (isCs) {
+        for (int threadIndex = 0; threadIndex < threadCount; threadIndex++) {
+            group.registers.gpr[inputRegisterIndices[0]][0][threadIndex] = firstThreadId + threadIndex;
         }
     } else {
         uint32_t stored = 0;
@@ -124,9 +311,9 @@ void ShaderUnit::initializeInputRegisters(uint32_t threadCount) {
                 const auto componentsCount = inputComponentsCounts[inputIndex];
                 const auto registerIndex = inputRegisterIndices[inputIndex];
 
-                VectorRegister &reg = registers.gpr[threadIndex][registerIndex];
-                std::memcpy(&reg.x, perThreadDwords + stored, sizeof(int32_t) * componentsCount);
-                stored += componentsCount;
+                for (int component = 0; component < componentsCount; component++) {
+                    group.registers.gpr[registerIndex][component][threadIndex] = perThreadDwords[stored++];
+                }
             }
         }
     }
@@ -149,17 +336,25 @@ void ShaderUnit::initializeInputRegisters(uint32_t threadCount) {
                 stored += componentsCount;
 
                 // Store the value for each thread
-                for (int threadIndex = 0; threadIndex < threadCount; threadIndex++) {
-                    registers.gpr[threadIndex][registerIndex] = regValue;
+                for (int component = 0; component < Isa::registerComponentsCount; component++) {
+                    std::fill_n(group.registers.gpr[registerIndex][component], threadCount, regValue[component]);
                 }
             }
         }
     }
 }
 
-void ShaderUnit::appendOutputRegistersValues(uint32_t threadCount, uint32_t *outputStream, uint32_t &outputStreamSize) {
+void ShaderUnit::appendOutputRegistersValues(const ThreadGroup &group, uint32_t *outputStream, uint32_t &outputStreamSize) {
+    const uint32_t threadCount = group.threadCount;
     const uint32_t outputsCount = nonZeroCountToInt(isaMetadata.outputsCount);
 
+    // Compute shaders store their results to memory. Only the number of finished threads is returned, so
+    // ShaderFrontend knows the group is done.
+    if (isaMetadata.programType == Isa::Command::ProgramType::ComputeShader) {
+        outputStream[outputStreamSize++] = threadCount;
+        return;
+    }
+
     // Get info about components
     Isa::RegisterIndex registerIndices[4] = {};
     uint32_t componentsCounts[4] = {};
@@ -173,9 +368,8 @@ void ShaderUnit::appendOutputRegistersValues(uint32_t threadCount, uint32_t *out
             const auto registerIndex = registerIndices[outputIndex];
             const auto componentsCount = componentsCounts[outputIndex];
 
-            const VectorRegister &reg = registers.gpr[threadIndex][registerIndex];
             for (int component = 0; component < componentsCount; component++) {
-                outputStream[outputStreamSize++] = reg[component];
+                outputStream[outputStreamSize++] = group.registers.gpr[registerIndex][component][threadIndex];
             }
         }
     }
@@ -195,7 +389,7 @@ void ShaderUnit::loadUniforms(uint32_t threadCount) {
         }
 
         for (int threadIndex = 0; threadIndex < threadCount; threadIndex++) {
-            registers.gpr[threadIndex][registerIndex] = registerValue;
+            writeRegister(registerIndex, threadIndex, registerValue);
         }
     }
 }
@@ -219,8 +413,8 @@ void ShaderUnit::zeroInitializeUnusedRegisters(uint32_t threadCount) {
     // Clear registers which are not used
     for (Isa::RegisterIndex registerIndex = 0; registerIndex < Isa::generalPurposeRegistersCount; registerIndex++) {
         if (!isBitSet(usedRegisterMask, registerIndex)) {
-            for (size_t threadIndex = 0; threadIndex < threadCount; threadIndex++) {
-                registers.gpr[threadIndex][registerIndex] = {};
+            for (size_t component = 0; component < Isa::registerComponentsCount; component++) {
+                std::fill_n(registers.gpr[registerIndex][component], threadCount, 0);
             }
         }
     }
@@ -278,295 +472,1132 @@ Isa::RegisterIndex ShaderUnit::getUniformRegisterIndex(uint32_t index) const {
     }
 }
 
-void ShaderUnit::executeInstructions(uint32_t isaSize, uint32_t threadCount) {
-    while (registers.pc < isaSize) {
-        const Isa::Instruction &instruction = *reinterpret_cast<const Isa::Instruction *>(isa + registers.pc);
-
-        const static auto asf = [](int32_t arg) { return reinterpret_cast<float &>(arg); };
-        const static auto asi = [](float arg) { return reinterpret_cast<int32_t &>(arg); };
-
-        switch (instruction.header.opcode) {
-        case Isa::Opcode::fadd:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMath, [](int32_t src1, int32_t src2) { return asi(asf(src1) + asf(src2)); });
-            break;
-        case Isa::Opcode::fadd_imm:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMathImm, [](int32_t src1, int32_t src2) { return asi(asf(src1) + asf(src2)); });
-            break;
-        case Isa::Opcode::fsub:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMath, [](int32_t src1, int32_t src2) { return asi(asf(src1) - asf(src2)); });
-            break;
-        case Isa::Opcode::fsub_imm:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMathImm, [](int32_t src1, int32_t src2) { return asi(asf(src1) - asf(src2)); });
-            break;
-        case Isa::Opcode::fmul:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMath, [](int32_t src1, int32_t src2) { return asi(asf(src1) * asf(src2)); });
-            break;
-        case Isa::Opcode::fmul_imm:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMathImm, [](int32_t src1, int32_t src2) { return asi(asf(src1) * asf(src2)); });
-            break;
-        case Isa::Opcode::fdiv:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMath, [](int32_t src1, int32_t src2) { return asi(asf(src1) / asf(src2)); });
-            break;
-        case Isa::Opcode::fdiv_imm:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMathImm, [](int32_t src1, int32_t src2) { return asi(asf(src1) / asf(src2)); });
-            break;
-        case Isa::Opcode::fneg:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.unaryMath, [](int32_t src) { return asi(-asf(src)); });
-            break;
-        case Isa::Opcode::fdot:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMath, [](VectorRegister src1, VectorRegister src2) {
-                return asi(asf(src1.x) * asf(src2.x) +
-                           asf(src1.y) * asf(src2.y) +
-                           asf(src1.z) * asf(src2.z) +
-                           asf(src1.w) * asf(src2.w));
-            });
-            break;
-        case Isa::Opcode::fcross:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMath, [](VectorRegister src1, VectorRegister src2) {
-                return VectorRegister{
-                    asi(asf(src1.y) * asf(src2.z) - asf(src1.z) * asf(src2.y)),
-                    asi(asf(src1.z) * asf(src2.x) - asf(src1.x) * asf(src2.z)),
-                    asi(asf(src1.x) * asf(src2.y) - asf(src1.y) * asf(src2.x)),
-                    0,
-                };
-            });
-            break;
-        case Isa::Opcode::fcross2:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMath, [](VectorRegister src1, VectorRegister src2) {
-                return asi(asf(src1.x) * asf(src2.y) - asf(src1.y) * asf(src2.x));
-            });
-            break;
-        case Isa::Opcode::fmad:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.ternaryMath, [](int32_t src1, int32_t src2, int32_t src3) {
-                return asi(asf(src1) * asf(src2) + asf(src3));
-            });
-            break;
-        case Isa::Opcode::frcp:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.unaryMath, [](int32_t src) { return asi(1 / asf(src)); });
-            break;
-        case Isa::Opcode::fnorm:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.unaryMath, [](VectorRegister src) {
-                const float x = asf(src.x);
-                const float y = asf(src.y);
-                const float z = asf(src.z);
-                const float w = asf(src.w);
-                const float len = sqrtf(x * x + y * y + z * z + w * w);
-                return VectorRegister{
-                    asi(x / len),
-                    asi(y / len),
-                    asi(z / len),
-                    asi(w / len),
-                };
-            });
-            break;
-        case Isa::Opcode::fmax:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMath, [](int32_t src1, int32_t src2) { return asi(std::max(asf(src1), asf(src2))); });
-            break;
-        case Isa::Opcode::fmin:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMath, [](int32_t src1, int32_t src2) { return asi(std::min(asf(src1), asf(src2))); });
-            break;
+void ShaderUnit::decodeIsa() {
+    uint32_t dwordIndex = 0;
+    decodedIsaSize = 0;
+    while (dwordIndex < isaMetadata.programLength) {
+        const Isa::Instruction &instruction = *reinterpret_cast<const Isa::Instruction *>(isa + dwordIndex);
+        dwordIndex += decodeInstruction(instruction, decodedIsa[decodedIsaSize++]);
+    }
+    resolveJumpTargets();
+}
 
-        case Isa::Opcode::iadd:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMath, [](int32_t src1, int32_t src2) { return src1 + src2; });
-            break;
-        case Isa::Opcode::iadd_imm:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMathImm, [](int32_t src1, int32_t src2) { return src1 + src2; });
-            break;
-        case Isa::Opcode::isub:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMath, [](int32_t src1, int32_t src2) { return src1 - src2; });
-            break;
-        case Isa::Opcode::isub_imm:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMathImm, [](int32_t src1, int32_t src2) { return src1 - src2; });
+void ShaderUnit::resolveJumpTargets() {
+    // The assembler validates the control flow, so any mismatch means the program is corrupted. Breaks are first
+    // pointed at their loop, because index of the endloop is not known yet.
+    uint32_t stack[Isa::maxControlFlowDepth] = {};
+    uint32_t depth = 0;
+    const auto isTopOfStack = [&](std::initializer_list<Isa::Opcode> opcodes) {
+        return depth > 0 && std::find(opcodes.begin(), opcodes.end(), decodedIsa[stack[depth - 1]].opcode) != opcodes.end();
+    };
+
+    for (uint32_t instructionIndex = 0; instructionIndex < decodedIsaSize; instructionIndex++) {
+        DecodedInstruction &instruction = decodedIsa[instructionIndex];
+        switch (instruction.opcode) {
+        case Isa::Opcode::if_:
+        case Isa::Opcode::loop:
+            FATAL_ERROR_IF(depth == Isa::maxControlFlowDepth, "Too deeply nested control flow");
+            stack[depth++] = instructionIndex;
             break;
-        case Isa::Opcode::imul:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMath, [](int32_t src1, int32_t src2) { return src1 * src2; });
+        case Isa::Opcode::else_:
+            FATAL_ERROR_IF(!isTopOfStack({Isa::Opcode::if_}), "else without matching if");
+            decodedIsa[stack[depth - 1]].jumpTarget = instructionIndex;
+            stack[depth - 1] = instructionIndex;
             break;
-        case Isa::Opcode::imul_imm:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMathImm, [](int32_t src1, int32_t src2) { return src1 * src2; });
+        case Isa::Opcode::endif:
+            FATAL_ERROR_IF(!isTopOfStack({Isa::Opcode::if_, Isa::Opcode::else_}), "endif without matching if");
+            decodedIsa[stack[--depth]].jumpTarget = instructionIndex;
             break;
-        case Isa::Opcode::idiv:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMath, [](int32_t src1, int32_t src2) { return src1 / src2; });
+        case Isa::Opcode::endloop:
+            FATAL_ERROR_IF(!isTopOfStack({Isa::Opcode::loop}), "endloop without matching loop");
+            instruction.jumpTarget = stack[depth - 1] + 1;
+            decodedIsa[stack[--depth]].jumpTarget = instructionIndex;
             break;
-        case Isa::Opcode::idiv_imm:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMathImm, [](int32_t src1, int32_t src2) { return src1 / src2; });
-            break;
-        case Isa::Opcode::ineg:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.unaryMath, [](int32_t src) { return -src; });
-            break;
-        case Isa::Opcode::imax:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMath, [](int32_t src1, int32_t src2) { return std::max(src1, src2); });
-            break;
-        case Isa::Opcode::imin:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.binaryMath, [](int32_t src1, int32_t src2) { return std::min(src1, src2); });
-            break;
-
-        case Isa::Opcode::init:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.unaryMathImm, [](int32_t src) { return src; });
-            break;
-        case Isa::Opcode::mov:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.unaryMath, [](int32_t src) { return src; });
-            break;
-        case Isa::Opcode::swizzle:
-            registers.pc += executeInstructionForLanes(threadCount, instruction.swizzle);
-            break;
-        case Isa::Opcode::trap:
-            if (OsInterface::isDebuggerAttached()) {
-                OsInterface::breakpoint();
+        case Isa::Opcode::break_: {
+            uint32_t loopDepth = depth;
+            while (loopDepth > 0 && decodedIsa[stack[loopDepth - 1]].opcode != Isa::Opcode::loop) {
+                loopDepth--;
             }
-            registers.pc += sizeof(instruction.nullary) / sizeof(uint32_t);
+            FATAL_ERROR_IF(loopDepth == 0, "break outside of a loop");
+            instruction.jumpTarget = stack[loopDepth - 1];
             break;
-
-        case Isa::Opcode::lduni:
-            loadUniforms(threadCount);
-            registers.pc += sizeof(instruction.nullary) / sizeof(uint32_t);
-            break;
-        case Isa::Opcode::initregs:
-            zeroInitializeUnusedRegisters(threadCount);
-            registers.pc += sizeof(instruction.nullary) / sizeof(uint32_t);
+        }
+        default:
             break;
+        }
+    }
+    FATAL_ERROR_IF(depth != 0, "Unterminated control flow");
 
-        default:
-            FATAL_ERROR("Unknown opcode: ", (uint32_t)instruction.header.opcode);
+    for (uint32_t instructionIndex = 0; instructionIndex < decodedIsaSize; instructionIndex++) {
+        DecodedInstruction &instruction = decodedIsa[instructionIndex];
+        if (instruction.opcode == Isa::Opcode::break_) {
+            instruction.jumpTarget = decodedIsa[instruction.jumpTarget].jumpTarget;
         }
+    }
+}
 
-        wait();
+uint32_t ShaderUnit::decodeInstruction(const Isa::Instruction &instruction, DecodedInstruction &decoded) {
+    using namespace Operations;
+
+    decoded = {};
+    decoded.opcode = instruction.header.opcode;
+    decoded.uniform = instruction.header.uniform;
+    switch (instruction.header.opcode) {
+    case Isa::Opcode::fadd:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<fadd>());
+    case Isa::Opcode::fadd_imm:
+        return decodeInstruction(instruction.binaryMathImm, decoded, binaryMathImm<fadd>());
+    case Isa::Opcode::fsub:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<fsub>());
+    case Isa::Opcode::fsub_imm:
+        return decodeInstruction(instruction.binaryMathImm, decoded, binaryMathImm<fsub>());
+    case Isa::Opcode::fmul:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<fmul>());
+    case Isa::Opcode::fmul_imm:
+        return decodeInstruction(instruction.binaryMathImm, decoded, binaryMathImm<fmul>());
+    case Isa::Opcode::fdiv:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<fdiv>());
+    case Isa::Opcode::fdiv_imm:
+        return decodeInstruction(instruction.binaryMathImm, decoded, binaryMathImm<fdiv>());
+    case Isa::Opcode::fneg:
+        return decodeInstruction(instruction.unaryMath, decoded, unaryMath<fneg>());
+    case Isa::Opcode::fdot:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMathVectorScalar<fdot>());
+    case Isa::Opcode::fcross:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMathVectorVector<fcross>());
+    case Isa::Opcode::fcross2:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMathVectorScalar<fcross2>());
+    case Isa::Opcode::fmad:
+        return decodeInstruction(instruction.ternaryMath, decoded, ternaryMath<fmad>());
+    case Isa::Opcode::frcp:
+        return decodeInstruction(instruction.unaryMath, decoded, unaryMath<frcp>());
+    case Isa::Opcode::fnorm:
+        return decodeInstruction(instruction.unaryMath, decoded, unaryMathVectorVector<fnorm>());
+    case Isa::Opcode::fmax:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<fmax>());
+    case Isa::Opcode::fmin:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<fmin>());
+    case Isa::Opcode::fcmpeq:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<fcmpeq>());
+    case Isa::Opcode::fcmpne:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<fcmpne>());
+    case Isa::Opcode::fcmplt:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<fcmplt>());
+    case Isa::Opcode::fcmple:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<fcmple>());
+    case Isa::Opcode::fmatmul: {
+        // Matrix is stored in src1 and three subsequent registers
+        const Isa::RegisterIndex matrixRegister = instruction.binaryMath.src1;
+        FATAL_ERROR_IF(matrixRegister + Isa::matrixRowsCount > Isa::generalPurposeRegistersCount, "Matrix registers out of range");
+        const uint32_t size = decodeInstruction(instruction.binaryMath, decoded, interpretedOnly(&ShaderUnit::executeMatrixMultiply));
+        decoded.readRegistersMask |= 0b1111 << matrixRegister;
+        return size;
+    }
+    case Isa::Opcode::fmatmul_uni:
+        return decodeInstruction(instruction.unaryMath, decoded, interpretedOnly(&ShaderUnit::executeUniformMatrixMultiply));
+    case Isa::Opcode::fsqrt:
+        return decodeInstruction(instruction.unaryMath, decoded, unaryMath<fsqrt>());
+    case Isa::Opcode::frsq:
+        return decodeInstruction(instruction.unaryMath, decoded, unaryMath<frsq>());
+    case Isa::Opcode::fexp2:
+        return decodeInstruction(instruction.unaryMath, decoded, unaryMath<fexp2>());
+    case Isa::Opcode::flog2:
+        return decodeInstruction(instruction.unaryMath, decoded, unaryMath<flog2>());
+    case Isa::Opcode::fsin:
+        return decodeInstruction(instruction.unaryMath, decoded, unaryMath<fsin>());
+    case Isa::Opcode::fcos:
+        return decodeInstruction(instruction.unaryMath, decoded, unaryMath<fcos>());
+    case Isa::Opcode::fpow:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<fpow>());
+    case Isa::Opcode::f2unorm8:
+        return decodeInstruction(instruction.unaryMath, decoded, unaryMathVectorScalar<f2unorm8>());
+
+    case Isa::Opcode::iadd:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<iadd>());
+    case Isa::Opcode::iadd_imm:
+        return decodeInstruction(instruction.binaryMathImm, decoded, binaryMathImm<iadd>());
+    case Isa::Opcode::isub:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<isub>());
+    case Isa::Opcode::isub_imm:
+        return decodeInstruction(instruction.binaryMathImm, decoded, binaryMathImm<isub>());
+    case Isa::Opcode::imul:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<imul>());
+    case Isa::Opcode::imul_imm:
+        return decodeInstruction(instruction.binaryMathImm, decoded, binaryMathImm<imul>());
+    case Isa::Opcode::idiv:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<idiv>());
+    case Isa::Opcode::idiv_imm:
+        return decodeInstruction(instruction.binaryMathImm, decoded, binaryMathImm<idiv>());
+    case Isa::Opcode::ineg:
+        return decodeInstruction(instruction.unaryMath, decoded, unaryMath<ineg>());
+    case Isa::Opcode::imax:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<imax>());
+    case Isa::Opcode::imin:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<imin>());
+    case Isa::Opcode::icmpeq:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<icmpeq>());
+    case Isa::Opcode::icmpne:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<icmpne>());
+    case Isa::Opcode::icmplt:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<icmplt>());
+    case Isa::Opcode::icmple:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<icmple>());
+    case Isa::Opcode::iand:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<iand>());
+    case Isa::Opcode::ior:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<ior>());
+    case Isa::Opcode::ixor:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<ixor>());
+    case Isa::Opcode::ishl:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<ishl>());
+    case Isa::Opcode::ishr:
+        return decodeInstruction(instruction.binaryMath, decoded, binaryMath<ishr>());
+
+    case Isa::Opcode::sample:
+        return decodeInstruction(instruction.unaryMath, decoded, interpretedOnly(&ShaderUnit::executeSample));
+
+    case Isa::Opcode::ld:
+        return decodeInstruction(instruction.unaryMath, decoded, interpretedOnly(&ShaderUnit::executeLoad));
+    case Isa::Opcode::st: {
+        // Store does not write any register. Destination mask selects components of src2 to store.
+        const uint32_t size = decodeInstruction(instruction.binaryMath, decoded, interpretedOnly(&ShaderUnit::executeStore));
+        decoded.uniform = false;
+        decoded.writtenComponentsMask = 0;
+        decoded.writtenRegistersMask = 0;
+        return size;
+    }
+
+    case Isa::Opcode::if_:
+        return decodeInstruction(instruction.condition, decoded, interpretedOnly(&ShaderUnit::executeIf));
+    case Isa::Opcode::else_:
+        return decodeInstruction(instruction.nullary, decoded, interpretedOnly(&ShaderUnit::executeElse));
+    case Isa::Opcode::endif:
+        return decodeInstruction(instruction.nullary, decoded, interpretedOnly(&ShaderUnit::executeEndif));
+    case Isa::Opcode::loop:
+        return decodeInstruction(instruction.nullary, decoded, interpretedOnly(&ShaderUnit::executeLoop));
+    case Isa::Opcode::endloop:
+        return decodeInstruction(instruction.nullary, decoded, interpretedOnly(&ShaderUnit::executeEndloop));
+    case Isa::Opcode::break_:
+        return decodeInstruction(instruction.condition, decoded, interpretedOnly(&ShaderUnit::executeBreak));
+
+    case Isa::Opcode::init:
+        return decodeInstruction(instruction.unaryMathImm, decoded, unaryMathImm<mov>());
+    case Isa::Opcode::mov:
+        return decodeInstruction(instruction.unaryMath, decoded, unaryMath<mov>());
+    case Isa::Opcode::swizzle:
+        return decodeInstruction(instruction.swizzle, decoded, {&ShaderUnit::executeSwizzle, &ShaderUnit::compileSwizzle});
+    case Isa::Opcode::trap:
+        return decodeInstruction(instruction.nullary, decoded, interpretedOnly(&ShaderUnit::executeTrap));
+
+    case Isa::Opcode::lduni:
+        return decodeInstruction(instruction.nullary, decoded, interpretedOnly(&ShaderUnit::executeLoadUniforms));
+    case Isa::Opcode::initregs:
+        return decodeInstruction(instruction.nullary, decoded, interpretedOnly(&ShaderUnit::executeInitRegs));
+
+    default:
+        FATAL_ERROR("Unknown opcode: ", (uint32_t)instruction.header.opcode);
     }
 }
 
-int32_t ShaderUnit::executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::UnaryMath &inst, UnaryFunction function) {
-    VectorRegister &src = registers.gpr[lane][inst.src];
-    VectorRegister &dest = registers.gpr[lane][inst.dest];
+uint32_t ShaderUnit::decodeInstruction(const Isa::InstructionLayouts::UnaryMath &inst, DecodedInstruction &decoded, InstructionImplementation implementation) {
+    decoded.handler = implementation.handler;
+    decoded.compiler = implementation.compiler;
+    decoded.dest = inst.dest;
+    decoded.src1 = inst.src;
+    decoded.destMask = inst.destMask;
+    decoded.writtenComponentsMask = implementation.ignoresDestMask ? 0b1111 : inst.destMask;
+    setBit(decoded.readRegistersMask, inst.src);
+    setBit(decoded.writtenRegistersMask, inst.dest);
+    return sizeof(inst) / sizeof(uint32_t);
+}
+
+uint32_t ShaderUnit::decodeInstruction(const Isa::InstructionLayouts::BinaryMath &inst, DecodedInstruction &decoded, InstructionImplementation implementation) {
+    decoded.handler = implementation.handler;
+    decoded.compiler = implementation.compiler;
+    decoded.dest = inst.dest;
+    decoded.src1 = inst.src1;
+    decoded.src2 = inst.src2;
+    decoded.destMask = inst.destMask;
+    decoded.writtenComponentsMask = implementation.ignoresDestMask ? 0b1111 : inst.destMask;
+    setBit(decoded.readRegistersMask, inst.src1);
+    setBit(decoded.readRegistersMask, inst.src2);
+    setBit(decoded.writtenRegistersMask, inst.dest);
+    return sizeof(inst) / sizeof(uint32_t);
+}
+
+uint32_t ShaderUnit::decodeInstruction(const Isa::InstructionLayouts::TernaryMath &inst, DecodedInstruction &decoded, InstructionImplementation implementation) {
+    decoded.handler = implementation.handler;
+    decoded.compiler = implementation.compiler;
+    decoded.dest = inst.dest;
+    decoded.src1 = inst.src1;
+    decoded.src2 = inst.src2;
+    decoded.src3 = inst.src3;
+    decoded.destMask = inst.destMask;
+    decoded.writtenComponentsMask = inst.destMask;
+    setBit(decoded.readRegistersMask, inst.src1);
+    setBit(decoded.readRegistersMask, inst.src2);
+    setBit(decoded.readRegistersMask, inst.src3);
+    setBit(decoded.writtenRegistersMask, inst.dest);
+    return sizeof(inst) / sizeof(uint32_t);
+}
+
+uint32_t ShaderUnit::decodeInstruction(const Isa::InstructionLayouts::UnaryMathImm &inst, DecodedInstruction &decoded, InstructionImplementation implementation) {
+    const size_t immCount = nonZeroCountToInt(inst.immediateValuesCount);
+
+    decoded.handler = implementation.handler;
+    decoded.compiler = implementation.compiler;
+    decoded.dest = inst.dest;
+    decoded.destMask = inst.destMask;
+    decoded.writtenComponentsMask = inst.destMask;
+    setBit(decoded.writtenRegistersMask, inst.dest);
+
+    // Immediate values are assigned to subsequent components from the mask. If there are fewer immediates
+    // than components, the last one is repeated.
+    size_t immediateValueIndex = 0;
     for (int i = 0; i < 4; i++) {
         if (isBitSet(inst.destMask, 3 - i)) {
-            dest[i] = function(src[i]);
+            decoded.immediates[i] = reinterpret_cast<const int32_t &>(inst.immediateValues[immediateValueIndex]);
+            if (immediateValueIndex + 1 < immCount) {
+                immediateValueIndex++;
+            }
         }
     }
-    return sizeof(inst) / sizeof(uint32_t);
+    return 1 + immCount;
 }
 
-int32_t ShaderUnit::executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::UnaryMath &inst, UnaryVectorScalarFunction function) {
-    VectorRegister &src1 = registers.gpr[lane][inst.src];
-    VectorRegister &dest = registers.gpr[lane][inst.dest];
+uint32_t ShaderUnit::decodeInstruction(const Isa::InstructionLayouts::BinaryMathImm &inst, DecodedInstruction &decoded, InstructionImplementation implementation) {
+    const size_t immCount = nonZeroCountToInt(inst.immediateValuesCount);
+
+    decoded.handler = implementation.handler;
+    decoded.compiler = implementation.compiler;
+    decoded.dest = inst.dest;
+    decoded.src1 = inst.src;
+    decoded.destMask = inst.destMask;
+    decoded.writtenComponentsMask = inst.destMask;
+    setBit(decoded.readRegistersMask, inst.src);
+    setBit(decoded.writtenRegistersMask, inst.dest);
 
-    const uint32_t result = function(src1);
+    // Immediate values are assigned the same way as in UnaryMathImm
+    size_t immediateValueIndex = 0;
     for (int i = 0; i < 4; i++) {
         if (isBitSet(inst.destMask, 3 - i)) {
-            dest[i] = result; // store the same result in each component from mask
+            decoded.immediates[i] = reinterpret_cast<const int32_t &>(inst.immediateValues[immediateValueIndex]);
+            if (immediateValueIndex + 1 < immCount) {
+                immediateValueIndex++;
+            }
         }
     }
+    return 1 + immCount;
+}
 
+uint32_t ShaderUnit::decodeInstruction(const Isa::InstructionLayouts::Swizzle &inst, DecodedInstruction &decoded, InstructionImplementation implementation) {
+    decoded.handler = implementation.handler;
+    decoded.compiler = implementation.compiler;
+    decoded.dest = inst.dest;
+    decoded.src1 = inst.src;
+    decoded.swizzle[0] = static_cast<uint32_t>(inst.patternX);
+    decoded.swizzle[1] = static_cast<uint32_t>(inst.patternY);
+    decoded.swizzle[2] = static_cast<uint32_t>(inst.patternZ);
+    decoded.swizzle[3] = static_cast<uint32_t>(inst.patternW);
+    decoded.writtenComponentsMask = 0b1111;
+    setBit(decoded.readRegistersMask, inst.src);
+    setBit(decoded.writtenRegistersMask, inst.dest);
     return sizeof(inst) / sizeof(uint32_t);
 }
 
-int32_t ShaderUnit::executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::UnaryMath &inst, UnaryVectorVectorFunction function) {
-    VectorRegister &src = registers.gpr[lane][inst.src];
-    VectorRegister &dest = registers.gpr[lane][inst.dest];
-
-    const VectorRegister result = function(src);
-    for (int i = 0; i < 4; i++) {
-        dest = result; // ignore destination mask
+uint32_t ShaderUnit::decodeInstruction(const Isa::InstructionLayouts::Nullary &inst, DecodedInstruction &decoded, InstructionImplementation implementation) {
+    decoded.handler = implementation.handler;
+    decoded.compiler = implementation.compiler;
+    decoded.uniform = false; // internal instructions must always operate on all threads
+
+    // Internal instructions can access any register, so they serialize execution. Control flow instructions
+    // only change the execution mask.
+    switch (decoded.opcode) {
+    case Isa::Opcode::else_:
+    case Isa::Opcode::endif:
+    case Isa::Opcode::loop:
+    case Isa::Opcode::endloop:
+        break;
+    default:
+        decoded.readRegistersMask = 0xffff;
+        decoded.writtenRegistersMask = 0xffff;
+        break;
     }
+    return sizeof(inst) / sizeof(uint32_t);
+}
 
+uint32_t ShaderUnit::decodeInstruction(const Isa::InstructionLayouts::Condition &inst, DecodedInstruction &decoded, InstructionImplementation implementation) {
+    decoded.handler = implementation.handler;
+    decoded.compiler = implementation.compiler;
+    decoded.uniform = false; // control flow has to evaluate the condition in all lanes
+    decoded.src1 = inst.src;
+    decoded.conditionComponent = static_cast<uint32_t>(inst.component);
+    setBit(decoded.readRegistersMask, inst.src);
     return sizeof(inst) / sizeof(uint32_t);
 }
 
-int32_t ShaderUnit::executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::BinaryMath &inst, BinaryFunction function) {
-    VectorRegister &src1 = registers.gpr[lane][inst.src1];
-    VectorRegister &src2 = registers.gpr[lane][inst.src2];
-    VectorRegister &dest = registers.gpr[lane][inst.dest];
-    for (int i = 0; i < 4; i++) {
-        if (isBitSet(inst.destMask, 3 - i)) {
-            dest[i] = function(src1[i], src2[i]);
+void ShaderUnit::executeInstructions(uint32_t threadCount) {
+    timingState = {};
+
+    switch (executionMode) {
+    case ShaderExecutionMode::Interpreter:
+        interpretInstructions(threadCount, true);
+        break;
+    case ShaderExecutionMode::Compiled:
+        executeCompiledInstructions(threadCount);
+        break;
+    case ShaderExecutionMode::Differential: {
+        // Compiled program is executed with timing, interpreter is run afterwards as a reference without
+        // consuming any more simulation time, apart from texture requests, which have to be sent again.
+        // Memory accesses are replayed from a log. Registers from the interpreter are the ones being output.
+        const Registers initialRegisters = registers;
+        memoryAccessLog.mode = MemoryAccessLog::Mode::Recording;
+        memoryAccessLog.accesses.clear();
+        executeCompiledInstructions(threadCount);
+        const Registers compiledRegisters = registers;
+        registers = initialRegisters;
+        memoryAccessLog.mode = MemoryAccessLog::Mode::Replaying;
+        memoryAccessLog.replayedAccessesCount = 0;
+        interpretInstructions(threadCount, false);
+        memoryAccessLog.mode = MemoryAccessLog::Mode::Disabled;
+        FATAL_ERROR_IF(memoryAccessLog.replayedAccessesCount != memoryAccessLog.accesses.size(), "Interpreter made fewer memory accesses than the compiled program");
+        verifyCompiledExecution(compiledRegisters, threadCount);
+        break;
+    }
+    default:
+        UNREACHABLE_CODE;
+    }
+
+    waitForPipelineDrain();
+}
+
+void ShaderUnit::interpretInstructions(uint32_t threadCount, bool waitAfterEachInstruction) {
+    registers.pc = 0;
+    resetControlFlow(threadCount);
+    while (registers.pc < decodedIsaSize) {
+        const DecodedInstruction &instruction = decodedIsa[registers.pc++];
+        executeInstruction(instruction, threadCount, [this, &instruction](uint32_t lanesCount) {
+            (this->*instruction.handler)(instruction, lanesCount);
+        });
+        if (waitAfterEachInstruction) {
+            retireInstruction(instruction, threadCount);
         }
     }
-    return sizeof(inst) / sizeof(uint32_t);
 }
 
-int32_t ShaderUnit::executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::TernaryMath &inst, TernaryFunction function) {
-    VectorRegister &src1 = registers.gpr[lane][inst.src1];
-    VectorRegister &src2 = registers.gpr[lane][inst.src2];
-    VectorRegister &src3 = registers.gpr[lane][inst.src3];
-    VectorRegister &dest = registers.gpr[lane][inst.dest];
-    for (int i = 0; i < 4; i++) {
-        if (isBitSet(inst.destMask, 3 - i)) {
-            dest[i] = function(src1[i], src2[i], src3[i]);
+template <typename Execute>
+void ShaderUnit::executeInstruction(const DecodedInstruction &inst, uint32_t threadCount, Execute &&execute) {
+    // Save values of the destination, so we can restore them in disabled lanes
+    const uint32_t disabledLanes = controlFlow.allLanesMask & ~controlFlow.executionMask;
+    const bool predicated = disabledLanes != 0 && inst.writtenComponentsMask != 0;
+    int32_t savedDest[Isa::registerComponentsCount][Isa::simdSize];
+    if (predicated) {
+        std::copy_n(&registers.gpr[inst.dest][0][0], Isa::registerComponentsCount * Isa::simdSize, &savedDest[0][0]);
+    }
+
+    if (inst.uniform) {
+        execute(1);
+        broadcastUniformResult(inst.dest, inst.writtenComponentsMask, threadCount);
+    } else {
+        execute(threadCount);
+    }
+
+    if (predicated) {
+        for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+            if (isBitSet(inst.writtenComponentsMask, 3 - component)) {
+                int32_t *dest = registers.gpr[inst.dest][component];
+                for (uint32_t lane = 0; lane < threadCount; lane++) {
+                    dest[lane] = ((disabledLanes >> lane) & 1) ? savedDest[component][lane] : dest[lane];
+                }
+            }
         }
     }
-    return sizeof(inst) / sizeof(uint32_t);
 }
 
-int32_t ShaderUnit::executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::BinaryMath &inst, BinaryVectorScalarFunction function) {
-    VectorRegister &src1 = registers.gpr[lane][inst.src1];
-    VectorRegister &src2 = registers.gpr[lane][inst.src2];
-    VectorRegister &dest = registers.gpr[lane][inst.dest];
+void ShaderUnit::retireInstruction(const DecodedInstruction &inst, uint32_t threadCount) {
+    // All lanes may be disabled after a break, until an else or endif enables the remaining ones
+    const uint32_t activeLanesCount = countBits(controlFlow.executionMask);
+    if (inst.uniform && activeLanesCount > 0) {
+        profiling.outLaneInstructionsSaved = profiling.outLaneInstructionsSaved.read() + activeLanesCount - 1;
+    }
 
-    const uint32_t result = function(src1, src2);
-    for (int i = 0; i < 4; i++) {
-        if (isBitSet(inst.destMask, 3 - i)) {
-            dest[i] = result; // store the same result in each component from mask
+    if (timing.functionalOnly) {
+        wait();
+        return;
+    }
+
+    // Instructions are executed functionally at issue time. Only the time is advanced here, so it doesn't
+    // matter that results are visible earlier than they would be in hardware.
+    const uint16_t accessedRegistersMask = inst.readRegistersMask | inst.writtenRegistersMask;
+    uint32_t issueCycle = timingState.issueCycle;
+    for (Isa::RegisterIndex registerIndex = 0; registerIndex < Isa::generalPurposeRegistersCount; registerIndex++) {
+        if (isBitSet(accessedRegistersMask, registerIndex)) {
+            issueCycle = std::max(issueCycle, timingState.registerReadyCycles[registerIndex]);
         }
     }
 
-    return sizeof(inst) / sizeof(uint32_t);
+    // Passes without any enabled lanes are skipped
+    uint32_t passesCount = 0;
+    for (uint32_t firstLane = 0; firstLane < threadCount; firstLane += timing.lanesPerCycle) {
+        const uint32_t passLanes = lowLanesMask(std::min(timing.lanesPerCycle, threadCount - firstLane)) << firstLane;
+        passesCount += (controlFlow.executionMask & passLanes) != 0;
+    }
+    passesCount = inst.uniform ? 1 : std::max(passesCount, 1u);
+
+    const ShaderUnitTiming::OpcodeTiming &opcodeTiming = timing[inst.opcode];
+    const uint32_t nextIssueCycle = issueCycle + passesCount * opcodeTiming.issueCycles;
+    const uint32_t resultReadyCycle = nextIssueCycle - opcodeTiming.issueCycles + opcodeTiming.latency;
+    for (Isa::RegisterIndex registerIndex = 0; registerIndex < Isa::generalPurposeRegistersCount; registerIndex++) {
+        if (isBitSet(inst.writtenRegistersMask, registerIndex)) {
+            timingState.registerReadyCycles[registerIndex] = resultReadyCycle;
+        }
+    }
+
+    wait(nextIssueCycle - timingState.issueCycle);
+    timingState.issueCycle = nextIssueCycle;
 }
 
-int32_t ShaderUnit::executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::BinaryMath &inst, BinaryVectorVectorFunction function) {
-    VectorRegister &src1 = registers.gpr[lane][inst.src1];
-    VectorRegister &src2 = registers.gpr[lane][inst.src2];
-    VectorRegister &dest = registers.gpr[lane][inst.dest];
+void ShaderUnit::waitForPipelineDrain() {
+    if (timing.functionalOnly) {
+        return;
+    }
 
-    const VectorRegister result = function(src1, src2);
-    for (int i = 0; i < 4; i++) {
-        dest = result; // ignore destination mask
+    const uint32_t *registerReadyCycles = timingState.registerReadyCycles;
+    const uint32_t lastReadyCycle = *std::max_element(registerReadyCycles, registerReadyCycles + Isa::generalPurposeRegistersCount);
+    if (lastReadyCycle > timingState.issueCycle) {
+        wait(lastReadyCycle - timingState.issueCycle);
+        timingState.issueCycle = lastReadyCycle;
     }
+}
 
-    return sizeof(inst) / sizeof(uint32_t);
+// Handlers below iterate over components first and then over lanes. Every component of a destination depends
+// only on the same component of the sources, so the result is the same as if each lane was executed separately.
+// Operations reading whole vectors compute all results before storing them, because destination can be one of
+// the sources.
+
+template <ShaderUnit::UnaryFunction function>
+void ShaderUnit::executeUnaryMath(const DecodedInstruction &inst, uint32_t threadCount) {
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        if (isBitSet(inst.destMask, 3 - component)) {
+            const int32_t *src = registers.gpr[inst.src1][component];
+            int32_t *dest = registers.gpr[inst.dest][component];
+            for (uint32_t lane = 0; lane < threadCount; lane++) {
+                dest[lane] = function(src[lane]);
+            }
+        }
+    }
 }
 
-int32_t ShaderUnit::executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::UnaryMathImm &inst, UnaryFunction function) {
-    const size_t immCount = nonZeroCountToInt(inst.immediateValuesCount);
+template <ShaderUnit::UnaryVectorScalarFunction function>
+void ShaderUnit::executeUnaryMathVectorScalar(const DecodedInstruction &inst, uint32_t threadCount) {
+    int32_t results[Isa::simdSize];
+    for (uint32_t lane = 0; lane < threadCount; lane++) {
+        results[lane] = function(readRegister(inst.src1, lane));
+    }
 
-    VectorRegister &dest = registers.gpr[lane][inst.dest];
-    size_t immediateValueIndex = 0;
-    for (int i = 0; i < 4; i++) {
-        if (isBitSet(inst.destMask, 3 - i)) {
-            int32_t src2 = reinterpret_cast<const int32_t &>(inst.immediateValues[immediateValueIndex]);
-            dest[i] = function(src2);
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        if (isBitSet(inst.destMask, 3 - component)) {
+            std::copy_n(results, threadCount, registers.gpr[inst.dest][component]); // store the same result in each component from mask
+        }
+    }
+}
 
-            if (immediateValueIndex + 1 < immCount) {
-                immediateValueIndex++;
+template <ShaderUnit::UnaryVectorVectorFunction function>
+void ShaderUnit::executeUnaryMathVectorVector(const DecodedInstruction &inst, uint32_t threadCount) {
+    VectorRegister results[Isa::simdSize];
+    for (uint32_t lane = 0; lane < threadCount; lane++) {
+        results[lane] = function(readRegister(inst.src1, lane));
+    }
+    for (uint32_t lane = 0; lane < threadCount; lane++) {
+        writeRegister(inst.dest, lane, results[lane]); // ignore destination mask
+    }
+}
+
+template <ShaderUnit::BinaryFunction function>
+void ShaderUnit::executeBinaryMath(const DecodedInstruction &inst, uint32_t threadCount) {
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        if (isBitSet(inst.destMask, 3 - component)) {
+            const int32_t *src1 = registers.gpr[inst.src1][component];
+            const int32_t *src2 = registers.gpr[inst.src2][component];
+            int32_t *dest = registers.gpr[inst.dest][component];
+            for (uint32_t lane = 0; lane < threadCount; lane++) {
+                dest[lane] = function(src1[lane], src2[lane]);
             }
         }
     }
-    return 1 + immCount;
 }
 
-int32_t ShaderUnit::executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::BinaryMathImm &inst, BinaryFunction function) {
-    const size_t immCount = nonZeroCountToInt(inst.immediateValuesCount);
+template <ShaderUnit::TernaryFunction function>
+void ShaderUnit::executeTernaryMath(const DecodedInstruction &inst, uint32_t threadCount) {
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        if (isBitSet(inst.destMask, 3 - component)) {
+            const int32_t *src1 = registers.gpr[inst.src1][component];
+            const int32_t *src2 = registers.gpr[inst.src2][component];
+            const int32_t *src3 = registers.gpr[inst.src3][component];
+            int32_t *dest = registers.gpr[inst.dest][component];
+            for (uint32_t lane = 0; lane < threadCount; lane++) {
+                dest[lane] = function(src1[lane], src2[lane], src3[lane]);
+            }
+        }
+    }
+}
 
-    VectorRegister &src1 = registers.gpr[lane][inst.src];
-    VectorRegister &dest = registers.gpr[lane][inst.dest];
-    size_t immediateValueIndex = 0;
-    for (int i = 0; i < 4; i++) {
-        if (isBitSet(inst.destMask, 3 - i)) {
-            int32_t src2 = reinterpret_cast<const int32_t &>(inst.immediateValues[immediateValueIndex]);
-            dest[i] = function(src1[i], src2);
+template <ShaderUnit::BinaryVectorScalarFunction function>
+void ShaderUnit::executeBinaryMathVectorScalar(const DecodedInstruction &inst, uint32_t threadCount) {
+    int32_t results[Isa::simdSize];
+    for (uint32_t lane = 0; lane < threadCount; lane++) {
+        results[lane] = function(readRegister(inst.src1, lane), readRegister(inst.src2, lane));
+    }
 
-            if (immediateValueIndex + 1 < immCount) {
-                immediateValueIndex++;
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        if (isBitSet(inst.destMask, 3 - component)) {
+            std::copy_n(results, threadCount, registers.gpr[inst.dest][component]); // store the same result in each component from mask
+        }
+    }
+}
+
+template <ShaderUnit::BinaryVectorVectorFunction function>
+void ShaderUnit::executeBinaryMathVectorVector(const DecodedInstruction &inst, uint32_t threadCount) {
+    VectorRegister results[Isa::simdSize];
+    for (uint32_t lane = 0; lane < threadCount; lane++) {
+        results[lane] = function(readRegister(inst.src1, lane), readRegister(inst.src2, lane));
+    }
+    for (uint32_t lane = 0; lane < threadCount; lane++) {
+        writeRegister(inst.dest, lane, results[lane]); // ignore destination mask
+    }
+}
+
+template <ShaderUnit::UnaryFunction function>
+void ShaderUnit::executeUnaryMathImm(const DecodedInstruction &inst, uint32_t threadCount) {
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        if (isBitSet(inst.destMask, 3 - component)) {
+            const int32_t result = function(inst.immediates[component]);
+            std::fill_n(registers.gpr[inst.dest][component], threadCount, result);
+        }
+    }
+}
+
+template <ShaderUnit::BinaryFunction function>
+void ShaderUnit::executeBinaryMathImm(const DecodedInstruction &inst, uint32_t threadCount) {
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        if (isBitSet(inst.destMask, 3 - component)) {
+            const int32_t *src1 = registers.gpr[inst.src1][component];
+            const int32_t src2 = inst.immediates[component];
+            int32_t *dest = registers.gpr[inst.dest][component];
+            for (uint32_t lane = 0; lane < threadCount; lane++) {
+                dest[lane] = function(src1[lane], src2);
             }
         }
     }
-    return 1 + immCount;
 }
 
-int32_t ShaderUnit::executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::Swizzle &inst) {
-    VectorRegister &src = registers.gpr[lane][inst.src];
-    VectorRegister &dest = registers.gpr[lane][inst.dest];
+void ShaderUnit::broadcastUniformResult(Isa::RegisterIndex dest, uint32_t componentsMask, uint32_t threadCount) {
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        if (isBitSet(componentsMask, 3 - component)) {
+            int32_t *row = registers.gpr[dest][component];
+            std::fill_n(row + 1, threadCount - 1, row[0]);
+        }
+    }
+}
 
-    dest.x = src[static_cast<size_t>(inst.patternX)];
-    dest.y = src[static_cast<size_t>(inst.patternY)];
-    dest.z = src[static_cast<size_t>(inst.patternZ)];
-    dest.w = src[static_cast<size_t>(inst.patternW)];
-    return sizeof(inst) / sizeof(uint32_t);
+void ShaderUnit::resetControlFlow(uint32_t threadCount) {
+    controlFlow.allLanesMask = lowLanesMask(threadCount);
+    controlFlow.executionMask = controlFlow.allLanesMask;
+    controlFlow.depth = 0;
+}
+
+uint32_t ShaderUnit::getConditionLanes(const DecodedInstruction &inst, uint32_t threadCount) const {
+    const int32_t *condition = registers.gpr[inst.src1][inst.conditionComponent];
+    uint32_t lanes = 0;
+    for (uint32_t lane = 0; lane < threadCount; lane++) {
+        lanes |= uint32_t(condition[lane] != 0) << lane;
+    }
+    return lanes;
+}
+
+void ShaderUnit::executeIf(const DecodedInstruction &inst, uint32_t threadCount) {
+    const uint32_t conditionLanes = getConditionLanes(inst, threadCount);
+    const uint32_t executionMask = controlFlow.executionMask;
+    controlFlow.stack[controlFlow.depth++] = {false, executionMask, executionMask & ~conditionLanes};
+    controlFlow.executionMask = executionMask & conditionLanes;
+    if (controlFlow.executionMask == 0) {
+        registers.pc = inst.jumpTarget; // skip to else or endif
+    }
+}
+
+void ShaderUnit::executeElse(const DecodedInstruction &inst, uint32_t threadCount) {
+    controlFlow.executionMask = controlFlow.stack[controlFlow.depth - 1].elseMask;
+    if (controlFlow.executionMask == 0) {
+        registers.pc = inst.jumpTarget; // skip to endif
+    }
+}
+
+void ShaderUnit::executeEndif(const DecodedInstruction &inst, uint32_t threadCount) {
+    controlFlow.executionMask = controlFlow.stack[--controlFlow.depth].savedMask;
+}
+
+void ShaderUnit::executeLoop(const DecodedInstruction &inst, uint32_t threadCount) {
+    controlFlow.stack[controlFlow.depth++] = {true, controlFlow.executionMask, 0};
+}
+
+void ShaderUnit::executeEndloop(const DecodedInstruction &inst, uint32_t threadCount) {
+    if (controlFlow.executionMask != 0) {
+        registers.pc = inst.jumpTarget; // next iteration for lanes, which did not break
+    } else {
+        controlFlow.executionMask = controlFlow.stack[--controlFlow.depth].savedMask;
+    }
+}
+
+void ShaderUnit::executeBreak(const DecodedInstruction &inst, uint32_t threadCount) {
+    const uint32_t breakingLanes = controlFlow.executionMask & getConditionLanes(inst, threadCount);
+    controlFlow.executionMask &= ~breakingLanes;
+
+    // Disable breaking lanes in all constructs inside the loop, so they are not enabled by endif or else
+    uint32_t pendingLanes = 0;
+    uint32_t entryIndex = controlFlow.depth - 1;
+    for (; !controlFlow.stack[entryIndex].isLoop; entryIndex--) {
+        controlFlow.stack[entryIndex].savedMask &= ~breakingLanes;
+        controlFlow.stack[entryIndex].elseMask &= ~breakingLanes;
+        pendingLanes |= controlFlow.stack[entryIndex].savedMask | controlFlow.stack[entryIndex].elseMask;
+    }
+
+    // Lanes waiting for an else or endif inside the loop have to continue the iteration. Otherwise, the loop can
+    // be left immediately.
+    if (controlFlow.executionMask == 0 && pendingLanes == 0) {
+        controlFlow.depth = entryIndex + 1;
+        registers.pc = inst.jumpTarget; // skip to endloop
+    }
+}
+
+// Each component of the destination is a dot product of a matrix row and the vector, summed in the same order
+// as in fdot. Rows are computed before storing, because destination can be the vector or one of the matrix rows.
+void ShaderUnit::executeMatrixMultiply(const DecodedInstruction &inst, uint32_t threadCount) {
+    using Operations::asf;
+    using Operations::asi;
+
+    int32_t results[Isa::matrixRowsCount][Isa::simdSize];
+    for (uint32_t row = 0; row < Isa::matrixRowsCount; row++) {
+        if (isBitSet(inst.destMask, 3 - row)) {
+            const auto &matrixRow = registers.gpr[inst.src1 + row];
+            const auto &vector = registers.gpr[inst.src2];
+            for (uint32_t lane = 0; lane < threadCount; lane++) {
+                results[row][lane] = asi(asf(matrixRow[0][lane]) * asf(vector[0][lane]) +
+                                         asf(matrixRow[1][lane]) * asf(vector[1][lane]) +
+                                         asf(matrixRow[2][lane]) * asf(vector[2][lane]) +
+                                         asf(matrixRow[3][lane]) * asf(vector[3][lane]));
+            }
+        }
+    }
+
+    for (uint32_t row = 0; row < Isa::matrixRowsCount; row++) {
+        if (isBitSet(inst.destMask, 3 - row)) {
+            std::copy_n(results[row], threadCount, registers.gpr[inst.dest][row]);
+        }
+    }
+}
+
+void ShaderUnit::executeUniformMatrixMultiply(const DecodedInstruction &inst, uint32_t threadCount) {
+    using Operations::asf;
+    using Operations::asi;
+
+    int32_t results[Isa::matrixRowsCount][Isa::simdSize];
+    for (uint32_t row = 0; row < Isa::matrixRowsCount; row++) {
+        if (isBitSet(inst.destMask, 3 - row)) {
+            const int32_t *matrixRow = uniformMatrix + row * Isa::registerComponentsCount;
+            const auto &vector = registers.gpr[inst.src1];
+            for (uint32_t lane = 0; lane < threadCount; lane++) {
+                results[row][lane] = asi(asf(matrixRow[0]) * asf(vector[0][lane]) +
+                                         asf(matrixRow[1]) * asf(vector[1][lane]) +
+                                         asf(matrixRow[2]) * asf(vector[2][lane]) +
+                                         asf(matrixRow[3]) * asf(vector[3][lane]));
+            }
+        }
+    }
+
+    for (uint32_t row = 0; row < Isa::matrixRowsCount; row++) {
+        if (isBitSet(inst.destMask, 3 - row)) {
+            std::copy_n(results[row], threadCount, registers.gpr[inst.dest][row]);
+        }
+    }
+}
+
+void ShaderUnit::executeSample(const DecodedInstruction &inst, uint32_t threadCount) {
+    // Only coordinates of enabled lanes are sent to the TextureUnit. Destination in disabled lanes is restored
+    // by executeInstruction() anyway. Uniform instructions are executed for the first lane, even if it's disabled.
+    uint32_t request[1 + 2 * Isa::simdSize];
+    uint32_t lanes[Isa::simdSize];
+    uint32_t lanesCount = 0;
+    for (uint32_t lane = 0; lane < threadCount; lane++) {
+        if (inst.uniform || isBitSet(controlFlow.executionMask, lane)) {
+            request[1 + 2 * lanesCount + 0] = registers.gpr[inst.src1][0][lane];
+            request[1 + 2 * lanesCount + 1] = registers.gpr[inst.src1][1][lane];
+            lanes[lanesCount++] = lane;
+        }
+    }
+    if (lanesCount == 0) {
+        return;
+    }
+    request[0] = lanesCount;
+
+    uint32_t colors[4 * Isa::simdSize];
+    Transfer::sendArray(texture.request.inpReceiving, texture.request.outSending, texture.request.outData, request, 1 + 2 * lanesCount);
+    Transfer::receiveArray(texture.response.inpSending, texture.response.inpData, texture.response.outReceiving, colors, 4 * lanesCount);
+
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        if (isBitSet(inst.destMask, 3 - component)) {
+            for (uint32_t laneIndex = 0; laneIndex < lanesCount; laneIndex++) {
+                registers.gpr[inst.dest][component][lanes[laneIndex]] = colors[4 * laneIndex + component];
+            }
+        }
+    }
+}
+
+void ShaderUnit::executeLoad(const DecodedInstruction &inst, uint32_t threadCount) {
+    // Only enabled lanes access memory. Components of a lane are contiguous, so they are read in a single burst from the
+    // first to the last enabled component. Uniform instructions are executed for the first lane, even if it's disabled.
+    // Address is read before any component is loaded, because destination can be the same register.
+    uint32_t firstComponent = Isa::registerComponentsCount;
+    uint32_t lastComponent = 0;
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        if (isBitSet(inst.destMask, 3 - component)) {
+            firstComponent = std::min(firstComponent, component);
+            lastComponent = component;
+        }
+    }
+    if (firstComponent > lastComponent) {
+        return;
+    }
+    const uint32_t componentsCount = lastComponent - firstComponent + 1;
+    for (uint32_t lane = 0; lane < threadCount; lane++) {
+        if (inst.uniform || isBitSet(controlFlow.executionMask, lane)) {
+            const uint32_t address = registers.gpr[inst.src1][0][lane];
+            uint32_t values[Isa::registerComponentsCount] = {};
+            readMemory(address + firstComponent * memoryDataTypeByteSize, values, componentsCount);
+            for (uint32_t component = firstComponent; component <= lastComponent; component++) {
+                if (isBitSet(inst.destMask, 3 - component)) {
+                    registers.gpr[inst.dest][component][lane] = values[component - firstComponent];
+                }
+            }
+        }
+    }
+}
+
+void ShaderUnit::executeStore(const DecodedInstruction &inst, uint32_t threadCount) {
+    // Lanes store one after another, so if multiple lanes write the same address, the last one wins. Disabled
+    // components must not be overwritten, so each run of consecutive enabled components is a separate burst.
+    for (uint32_t lane = 0; lane < threadCount; lane++) {
+        if (isBitSet(controlFlow.executionMask, lane)) {
+            const uint32_t address = registers.gpr[inst.src1][0][lane];
+            uint32_t component = 0;
+            while (component < Isa::registerComponentsCount) {
+                if (!isBitSet(inst.destMask, 3 - component)) {
+                    component++;
+                    continue;
+                }
+                const uint32_t firstComponent = component;
+                uint32_t values[Isa::registerComponentsCount] = {};
+                while (component < Isa::registerComponentsCount && isBitSet(inst.destMask, 3 - component)) {
+                    values[component - firstComponent] = registers.gpr[inst.src2][component][lane];
+                    component++;
+                }
+                writeMemory(address + firstComponent * memoryDataTypeByteSize, values, component - firstComponent);
+            }
+        }
+    }
+}
+
+void ShaderUnit::executeSwizzle(const DecodedInstruction &inst, uint32_t threadCount) {
+    // Components are written in order and a later component can read the one written earlier, if src and dest
+    // are the same register. This is consistent with executing lanes one by one.
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        const int32_t *src = registers.gpr[inst.src1][inst.swizzle[component]];
+        int32_t *dest = registers.gpr[inst.dest][component];
+        for (uint32_t lane = 0; lane < threadCount; lane++) {
+            dest[lane] = src[lane];
+        }
+    }
+}
+
+void ShaderUnit::executeTrap(const DecodedInstruction &inst, uint32_t threadCount) {
+    if (OsInterface::isDebuggerAttached()) {
+        OsInterface::breakpoint();
+    }
+}
+
+void ShaderUnit::executeLoadUniforms(const DecodedInstruction &inst, uint32_t threadCount) {
+    loadUniforms(threadCount);
+}
+
+void ShaderUnit::executeInitRegs(const DecodedInstruction &inst, uint32_t threadCount) {
+    zeroInitializeUnusedRegisters(threadCount);
+}
+
+VectorRegister ShaderUnit::readRegister(Isa::RegisterIndex registerIndex, uint32_t lane) const {
+    return VectorRegister{
+        registers.gpr[registerIndex][0][lane],
+        registers.gpr[registerIndex][1][lane],
+        registers.gpr[registerIndex][2][lane],
+        registers.gpr[registerIndex][3][lane],
+    };
+}
+
+void ShaderUnit::writeRegister(Isa::RegisterIndex registerIndex, uint32_t lane, const VectorRegister &value) {
+    registers.gpr[registerIndex][0][lane] = value.x;
+    registers.gpr[registerIndex][1][lane] = value.y;
+    registers.gpr[registerIndex][2][lane] = value.z;
+    registers.gpr[registerIndex][3][lane] = value.w;
+}
+
+void ShaderUnit::readMemory(uint32_t address, uint32_t *data, uint32_t sizeInDwords) {
+    if (memoryAccessLog.mode == MemoryAccessLog::Mode::Replaying) {
+        FATAL_ERROR_IF(memoryAccessLog.replayedAccessesCount == memoryAccessLog.accesses.size(), "Interpreter made more memory accesses than the compiled program");
+        const MemoryAccessLog::Access &access = memoryAccessLog.accesses[memoryAccessLog.replayedAccessesCount++];
+        FATAL_ERROR_IF(access.write || access.address != address || access.sizeInDwords != sizeInDwords, "Interpreter loaded ", sizeInDwords, " dwords from 0x", std::hex, address,
+                       " instead of the access made by the compiled program");
+        std::copy_n(access.values, sizeInDwords, data);
+        return;
+    }
+
+    MemoryAccess::readBurst(memory, address, data, sizeInDwords);
+
+    if (memoryAccessLog.mode == MemoryAccessLog::Mode::Recording) {
+        MemoryAccessLog::Access access = {address, sizeInDwords, {}, false};
+        std::copy_n(data, sizeInDwords, access.values);
+        memoryAccessLog.accesses.push_back(access);
+    }
+}
+
+void ShaderUnit::writeMemory(uint32_t address, const uint32_t *data, uint32_t sizeInDwords) {
+    if (memoryAccessLog.mode == MemoryAccessLog::Mode::Replaying) {
+        FATAL_ERROR_IF(memoryAccessLog.replayedAccessesCount == memoryAccessLog.accesses.size(), "Interpreter made more memory accesses than the compiled program");
+        const MemoryAccessLog::Access &access = memoryAccessLog.accesses[memoryAccessLog.replayedAccessesCount++];
+        FATAL_ERROR_IF(!access.write || access.address != address || access.sizeInDwords != sizeInDwords || !std::equal(data, data + sizeInDwords, access.values),
+                       "Interpreter stored ", sizeInDwords, " dwords to 0x", std::hex, address, " instead of the access made by the compiled program");
+        return;
+    }
+
+    MemoryAccess::writeBurst(memory, address, data, sizeInDwords);
+
+    if (memoryAccessLog.mode == MemoryAccessLog::Mode::Recording) {
+        MemoryAccessLog::Access access = {address, sizeInDwords, {}, true};
+        std::copy_n(data, sizeInDwords, access.values);
+        memoryAccessLog.accesses.push_back(access);
+    }
+}
+
+// Compiled programs resolve everything that depends only on the program when it is stored: destination masks are
+// turned into lists of components and register indices into pointers to rows of the register file. A closure
+// for an element-wise instruction only loops over rows it writes. Instructions operating on whole vectors and
+// internal instructions fall back to calling their interpreter handler.
+
+uint64_t ShaderUnit::hashIsa() const {
+    // FNV-1a over the program metadata and its code
+    uint64_t hash = 14695981039346656037ull;
+    const auto hashDwords = [&hash](const uint32_t *dwords, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            hash = (hash ^ dwords[i]) * 1099511628211ull;
+        }
+    };
+    hashDwords(reinterpret_cast<const uint32_t *>(&isaMetadata), Isa::commandSizeInDwords);
+    hashDwords(isa, isaMetadata.programLength);
+    return hash;
+}
+
+std::vector<uint32_t> ShaderUnit::getProgramDwords() const {
+    const uint32_t *metadataDwords = reinterpret_cast<const uint32_t *>(&isaMetadata);
+    std::vector<uint32_t> dwords(metadataDwords, metadataDwords + Isa::commandSizeInDwords);
+    dwords.insert(dwords.end(), isa, isa + isaMetadata.programLength);
+    return dwords;
+}
+
+void ShaderUnit::compileIsa() {
+    const uint64_t hash = hashIsa();
+    FATAL_ERROR_IF(hash == invalidProgramHash, "Program hash collides with invalid cache key");
+    std::vector<uint32_t> programDwords = getProgramDwords();
+
+    compiledProgram = compiledProgramsCache.get(hash);
+    if (compiledProgram != nullptr && compiledProgram->programDwords == programDwords) {
+        return;
+    }
+
+    // On a collision the new program is put as the most recently used entry, so it is found before the old one
+    CompiledProgram program = {};
+    program.programDwords = std::move(programDwords);
+    program.instructions.reserve(decodedIsaSize);
+    for (uint32_t instructionIndex = 0; instructionIndex < decodedIsaSize; instructionIndex++) {
+        const DecodedInstruction &instruction = decodedIsa[instructionIndex];
+        program.instructions.push_back((this->*instruction.compiler)(instruction));
+    }
+    compiledProgram = compiledProgramsCache.put(hash, std::move(program));
+}
+
+void ShaderUnit::executeCompiledInstructions(uint32_t threadCount) {
+    registers.pc = 0;
+    resetControlFlow(threadCount);
+    while (registers.pc < compiledProgram->instructions.size()) {
+        const uint32_t instructionIndex = registers.pc++;
+        const DecodedInstruction &instruction = decodedIsa[instructionIndex];
+        executeInstruction(instruction, threadCount, compiledProgram->instructions[instructionIndex]);
+        retireInstruction(instruction, threadCount);
+    }
+}
+
+void ShaderUnit::verifyCompiledExecution(const Registers &compiledRegisters, uint32_t threadCount) const {
+    const auto isNan = [](int32_t value) {
+        return (value & 0x7f800000) == 0x7f800000 && (value & 0x007fffff) != 0;
+    };
+
+    for (Isa::RegisterIndex registerIndex = 0; registerIndex < Isa::generalPurposeRegistersCount; registerIndex++) {
+        for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+            for (uint32_t lane = 0; lane < threadCount; lane++) {
+                const int32_t expected = registers.gpr[registerIndex][component][lane];
+                const int32_t actual = compiledRegisters.gpr[registerIndex][component][lane];
+
+                // Sign and payload of NaNs are not specified by C++ and can depend on how an expression was compiled
+                const bool matches = expected == actual || (isNan(expected) && isNan(actual));
+                FATAL_ERROR_IF(!matches, "Compiled program mismatch in r", (uint32_t)registerIndex, "[", component, "] lane ", lane,
+                               ": interpreter=", expected, " compiled=", actual);
+            }
+        }
+    }
+}
+
+template <ShaderUnit::UnaryFunction function>
+ShaderUnit::CompiledInstruction ShaderUnit::compileUnaryMath(const DecodedInstruction &inst) {
+    struct Row {
+        int32_t *dest;
+        const int32_t *src;
+    };
+    std::vector<Row> rows = {};
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        if (isBitSet(inst.destMask, 3 - component)) {
+            rows.push_back({registers.gpr[inst.dest][component], registers.gpr[inst.src1][component]});
+        }
+    }
+
+    return [rows](uint32_t threadCount) {
+        for (const Row &row : rows) {
+            for (uint32_t lane = 0; lane < threadCount; lane++) {
+                row.dest[lane] = function(row.src[lane]);
+            }
+        }
+    };
+}
+
+template <ShaderUnit::BinaryFunction function>
+ShaderUnit::CompiledInstruction ShaderUnit::compileBinaryMath(const DecodedInstruction &inst) {
+    struct Row {
+        int32_t *dest;
+        const int32_t *src1;
+        const int32_t *src2;
+    };
+    std::vector<Row> rows = {};
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        if (isBitSet(inst.destMask, 3 - component)) {
+            rows.push_back({registers.gpr[inst.dest][component], registers.gpr[inst.src1][component], registers.gpr[inst.src2][component]});
+        }
+    }
+
+    return [rows](uint32_t threadCount) {
+        for (const Row &row : rows) {
+            for (uint32_t lane = 0; lane < threadCount; lane++) {
+                row.dest[lane] = function(row.src1[lane], row.src2[lane]);
+            }
+        }
+    };
+}
+
+template <ShaderUnit::TernaryFunction function>
+ShaderUnit::CompiledInstruction ShaderUnit::compileTernaryMath(const DecodedInstruction &inst) {
+    struct Row {
+        int32_t *dest;
+        const int32_t *src1;
+        const int32_t *src2;
+        const int32_t *src3;
+    };
+    std::vector<Row> rows = {};
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        if (isBitSet(inst.destMask, 3 - component)) {
+            rows.push_back({registers.gpr[inst.dest][component], registers.gpr[inst.src1][component],
+                            registers.gpr[inst.src2][component], registers.gpr[inst.src3][component]});
+        }
+    }
+
+    return [rows](uint32_t threadCount) {
+        for (const Row &row : rows) {
+            for (uint32_t lane = 0; lane < threadCount; lane++) {
+                row.dest[lane] = function(row.src1[lane], row.src2[lane], row.src3[lane]);
+            }
+        }
+    };
+}
+
+template <ShaderUnit::UnaryFunction function>
+ShaderUnit::CompiledInstruction ShaderUnit::compileUnaryMathImm(const DecodedInstruction &inst) {
+    // Result does not depend on any register, so it can be computed during compilation
+    struct Row {
+        int32_t *dest;
+        int32_t value;
+    };
+    std::vector<Row> rows = {};
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        if (isBitSet(inst.destMask, 3 - component)) {
+            rows.push_back({registers.gpr[inst.dest][component], function(inst.immediates[component])});
+        }
+    }
+
+    return [rows](uint32_t threadCount) {
+        for (const Row &row : rows) {
+            std::fill_n(row.dest, threadCount, row.value);
+        }
+    };
+}
+
+template <ShaderUnit::BinaryFunction function>
+ShaderUnit::CompiledInstruction ShaderUnit::compileBinaryMathImm(const DecodedInstruction &inst) {
+    struct Row {
+        int32_t *dest;
+        const int32_t *src1;
+        int32_t src2;
+    };
+    std::vector<Row> rows = {};
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        if (isBitSet(inst.destMask, 3 - component)) {
+            rows.push_back({registers.gpr[inst.dest][component], registers.gpr[inst.src1][component], inst.immediates[component]});
+        }
+    }
+
+    return [rows](uint32_t threadCount) {
+        for (const Row &row : rows) {
+            for (uint32_t lane = 0; lane < threadCount; lane++) {
+                row.dest[lane] = function(row.src1[lane], row.src2);
+            }
+        }
+    };
+}
+
+ShaderUnit::CompiledInstruction ShaderUnit::compileSwizzle(const DecodedInstruction &inst) {
+    struct Row {
+        int32_t *dest;
+        const int32_t *src;
+    };
+    Row rows[Isa::registerComponentsCount] = {};
+    for (uint32_t component = 0; component < Isa::registerComponentsCount; component++) {
+        rows[component] = {registers.gpr[inst.dest][component], registers.gpr[inst.src1][inst.swizzle[component]]};
+    }
+
+    // Rows have to be copied in order, like in the interpreter
+    return [rows](uint32_t threadCount) {
+        for (const Row &row : rows) {
+            for (uint32_t lane = 0; lane < threadCount; lane++) {
+                row.dest[lane] = row.src[lane];
+            }
+        }
+    };
+}
+
+ShaderUnit::CompiledInstruction ShaderUnit::compileInterpreted(const DecodedInstruction &inst) {
+    return [this, inst](uint32_t threadCount) {
+        (this->*inst.handler)(inst, threadCount);
+    };
 }
@@ -1,17 +1,29 @@
 #pragma once
 
+#include "gpu/blocks/shader_array/shader_unit_timing.h"
 #include "gpu/definitions/types.h"
 #include "gpu/isa/isa.h"
 #include "gpu/isa/vector_register.h"
+#include "gpu/util/entry_cache.h"
 #include "gpu/util/non_zero_count.h"
 
+#include <functional>
+#include <memory>
+#include <queue>
 #include <systemc.h>
+#include <vector>
 
 enum class ShaderUnitOperation {
     StoreIsa = 0,
     Execute = 1,
 };
 
+enum class ShaderExecutionMode {
+    Interpreter,  // execute decoded instructions one by one
+    Compiled,     // compile the program to a chain of closures when it is stored and execute them
+    Differential, // execute both ways and verify the compiled program against the interpreter
+};
+
 SC_MODULE(ShaderUnit) {
     sc_in_clk inpClock;
 
@@ -27,24 +39,65 @@ SC_MODULE(ShaderUnit) {
         sc_out<sc_uint<32>> outData;
     } response;
 
+    // Interface with the TextureUnit used by sample instructions
+    struct {
+        struct {
+            sc_out<bool> outSending;
+            sc_out<sc_uint<32>> outData;
+            sc_in<bool> inpReceiving;
+        } request;
+
+        struct {
+            sc_out<bool> outReceiving;
+            sc_in<bool> inpSending;
+            sc_in<sc_uint<32>> inpData;
+        } response;
+    } texture;
+
+    // Interface with memory used by ld and st instructions
     struct {
+        sc_out<bool> outEnable;
+        sc_out<bool> outWrite;
+        sc_out<MemoryAddressType> outAddress;
+        sc_out<MemoryBurstLengthType> outBurstLength;
+        sc_out<MemoryDataType> outData;
+        sc_in<MemoryDataType> inpData;
+        sc_in<bool> inpCompleted;
+    } memory;
+
+    struct {
+        sc_signal<bool> requestThreadBusy;
+        sc_signal<bool> executeThreadBusy;
+        sc_signal<bool> responseThreadBusy;
         sc_out<bool> outBusy;
         sc_out<sc_uint<32>> outThreadsStarted;
         sc_out<sc_uint<32>> outThreadsFinished;
+        sc_out<sc_uint<32>> outLaneInstructionsSaved; // lanes, which did not have to execute uniform instructions
     } profiling;
 
-    SC_CTOR(ShaderUnit) {
-        SC_CTHREAD(main, inpClock.pos());
-    }
+    SC_HAS_PROCESS(ShaderUnit);
+    ShaderUnit(sc_module_name name, ShaderExecutionMode executionMode = ShaderExecutionMode::Interpreter, const ShaderUnitTiming &timing = {},
+               size_t threadGroupsCount = 1);
 
-    void main();
+    const ShaderExecutionMode executionMode;
+    const ShaderUnitTiming timing;
+    const size_t threadGroupsCount;
 
 private:
+    struct ThreadGroup;
+
+    // Methods implementing SystemC processes. Receiving inputs, executing and sending outputs are done by separate
+    // processes, so they can work on different thread groups at the same time.
+    void requestThread();
+    void executeThread();
+    void responseThread();
+    void busySignalMethod();
+
     void processStoreIsaCommand(Isa::Command::CommandStoreIsa command);
     void processExecuteIsaCommand(Isa::Command::CommandExecuteIsa command);
 
-    void initializeInputRegisters(uint32_t threadCount);
-    void appendOutputRegistersValues(uint32_t threadCount, uint32_t * outputStream, uint32_t & outputStreamSize);
+    void initializeInputRegisters(ThreadGroup & group);
+    void appendOutputRegistersValues(const ThreadGroup &group, uint32_t * outputStream, uint32_t & outputStreamSize);
 
     void loadUniforms(uint32_t threadCount);
     void zeroInitializeUnusedRegisters(uint32_t threadCount);
@@ -61,35 +114,226 @@ private:
     using TernaryFunction = int32_t (*)(int32_t, int32_t, int32_t);
     using BinaryVectorScalarFunction = int32_t (*)(VectorRegister, VectorRegister);
     using BinaryVectorVectorFunction = VectorRegister (*)(VectorRegister, VectorRegister);
-    void executeInstructions(uint32_t isaSize, uint32_t threadCount);
-    int32_t executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::UnaryMath &inst, UnaryFunction function);
-    int32_t executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::UnaryMath &inst, UnaryVectorScalarFunction function);
-    int32_t executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::UnaryMath &inst, UnaryVectorVectorFunction function);
-    int32_t executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::BinaryMath &inst, BinaryFunction function);
-    int32_t executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::TernaryMath &inst, TernaryFunction function);
-    int32_t executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::BinaryMath &inst, BinaryVectorScalarFunction function);
-    int32_t executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::BinaryMath &inst, BinaryVectorVectorFunction function);
-    int32_t executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::UnaryMathImm &inst, UnaryFunction function);
-    int32_t executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::BinaryMathImm &inst, BinaryFunction function);
-    int32_t executeInstructionLane(uint32_t lane, const Isa::InstructionLayouts::Swizzle &inst);
-
-    template <typename... Args>
-    int32_t executeInstructionForLanes(uint32_t threadCount, Args && ...args) {
-        int32_t pcIncrement = 0;
-        for (uint32_t lane = 0; lane < threadCount; lane++) {
-            pcIncrement = executeInstructionLane(lane, std::forward<Args>(args)...);
-        }
-        return pcIncrement;
-    }
+
+    // The program is decoded once, when it is stored in the shader unit. Each instruction is translated to
+    // a handler method with all of its operands already extracted from the bitfields, so executing it is
+    // just an indirect call. Handlers are instantiated for each operation, so the operation can be inlined
+    // into the loop over lanes.
+    //
+    // Each instruction also gets a compiler method, which can translate it into a closure with addresses of
+    // all accessed register rows already resolved. See compileIsa().
+    //
+    // Instructions tagged as uniform by the assembler compute the same values in all threads. They are executed
+    // only for the first lane and the result is broadcast to the remaining ones.
+    //
+    // Handlers always compute results for all lanes. If some lanes are disabled by control flow, values of the
+    // destination in these lanes are restored afterwards. See executeInstruction().
+    struct DecodedInstruction;
+    using InstructionHandler = void (ShaderUnit::*)(const DecodedInstruction &, uint32_t);
+    using CompiledInstruction = std::function<void(uint32_t threadCount)>;
+    using InstructionCompiler = CompiledInstruction (ShaderUnit::*)(const DecodedInstruction &);
+    struct InstructionImplementation {
+        InstructionHandler handler;
+        InstructionCompiler compiler;
+        bool ignoresDestMask = false; // operation always writes all components of the destination
+    };
+    struct DecodedInstruction {
+        InstructionHandler handler;
+        InstructionCompiler compiler;
+        Isa::Opcode opcode;
+        Isa::RegisterIndex dest;
+        Isa::RegisterIndex src1;
+        Isa::RegisterIndex src2;
+        Isa::RegisterIndex src3;
+        uint32_t destMask;
+        uint32_t writtenComponentsMask; // destMask or all components, if the operation ignores it
+        bool uniform;
+        int32_t immediates[Isa::registerComponentsCount]; // immediate value for each destination component
+        uint32_t swizzle[Isa::registerComponentsCount];
+        uint32_t conditionComponent;
+        uint32_t jumpTarget; // index of the instruction, where control flow continues, when the jump is taken
+        uint16_t readRegistersMask;    // used by the timing model to find dependencies between instructions
+        uint16_t writtenRegistersMask;
+    };
+
+    void decodeIsa();
+    void resolveJumpTargets();
+    uint32_t decodeInstruction(const Isa::Instruction &instruction, DecodedInstruction &decoded);
+    uint32_t decodeInstruction(const Isa::InstructionLayouts::UnaryMath &inst, DecodedInstruction &decoded, InstructionImplementation implementation);
+    uint32_t decodeInstruction(const Isa::InstructionLayouts::BinaryMath &inst, DecodedInstruction &decoded, InstructionImplementation implementation);
+    uint32_t decodeInstruction(const Isa::InstructionLayouts::TernaryMath &inst, DecodedInstruction &decoded, InstructionImplementation implementation);
+    uint32_t decodeInstruction(const Isa::InstructionLayouts::UnaryMathImm &inst, DecodedInstruction &decoded, InstructionImplementation implementation);
+    uint32_t decodeInstruction(const Isa::InstructionLayouts::BinaryMathImm &inst, DecodedInstruction &decoded, InstructionImplementation implementation);
+    uint32_t decodeInstruction(const Isa::InstructionLayouts::Swizzle &inst, DecodedInstruction &decoded, InstructionImplementation implementation);
+    uint32_t decodeInstruction(const Isa::InstructionLayouts::Nullary &inst, DecodedInstruction &decoded, InstructionImplementation implementation);
+    uint32_t decodeInstruction(const Isa::InstructionLayouts::Condition &inst, DecodedInstruction &decoded, InstructionImplementation implementation);
+
+    template <UnaryFunction function>
+    constexpr static InstructionImplementation unaryMath() { return {&ShaderUnit::executeUnaryMath<function>, &ShaderUnit::compileUnaryMath<function>}; }
+    template <UnaryVectorScalarFunction function>
+    constexpr static InstructionImplementation unaryMathVectorScalar() { return {&ShaderUnit::executeUnaryMathVectorScalar<function>, &ShaderUnit::compileInterpreted}; }
+    template <UnaryVectorVectorFunction function>
+    constexpr static InstructionImplementation unaryMathVectorVector() { return {&ShaderUnit::executeUnaryMathVectorVector<function>, &ShaderUnit::compileInterpreted, true}; }
+    template <BinaryFunction function>
+    constexpr static InstructionImplementation binaryMath() { return {&ShaderUnit::executeBinaryMath<function>, &ShaderUnit::compileBinaryMath<function>}; }
+    template <TernaryFunction function>
+    constexpr static InstructionImplementation ternaryMath() { return {&ShaderUnit::executeTernaryMath<function>, &ShaderUnit::compileTernaryMath<function>}; }
+    template <BinaryVectorScalarFunction function>
+    constexpr static InstructionImplementation binaryMathVectorScalar() { return {&ShaderUnit::executeBinaryMathVectorScalar<function>, &ShaderUnit::compileInterpreted}; }
+    template <BinaryVectorVectorFunction function>
+    constexpr static InstructionImplementation binaryMathVectorVector() { return {&ShaderUnit::executeBinaryMathVectorVector<function>, &ShaderUnit::compileInterpreted, true}; }
+    template <UnaryFunction function>
+    constexpr static InstructionImplementation unaryMathImm() { return {&ShaderUnit::executeUnaryMathImm<function>, &ShaderUnit::compileUnaryMathImm<function>}; }
+    template <BinaryFunction function>
+    constexpr static InstructionImplementation binaryMathImm() { return {&ShaderUnit::executeBinaryMathImm<function>, &ShaderUnit::compileBinaryMathImm<function>}; }
+    constexpr static InstructionImplementation interpretedOnly(InstructionHandler handler) { return {handler, &ShaderUnit::compileInterpreted}; }
+
+    void executeInstructions(uint32_t threadCount);
+    void interpretInstructions(uint32_t threadCount, bool waitAfterEachInstruction);
+    template <typename Execute>
+    void executeInstruction(const DecodedInstruction &inst, uint32_t threadCount, Execute &&execute);
+    void retireInstruction(const DecodedInstruction &inst, uint32_t threadCount);
+    void waitForPipelineDrain();
+    template <UnaryFunction function>
+    void executeUnaryMath(const DecodedInstruction &inst, uint32_t threadCount);
+    template <UnaryVectorScalarFunction function>
+    void executeUnaryMathVectorScalar(const DecodedInstruction &inst, uint32_t threadCount);
+    template <UnaryVectorVectorFunction function>
+    void executeUnaryMathVectorVector(const DecodedInstruction &inst, uint32_t threadCount);
+    template <BinaryFunction function>
+    void executeBinaryMath(const DecodedInstruction &inst, uint32_t threadCount);
+    template <TernaryFunction function>
+    void executeTernaryMath(const DecodedInstruction &inst, uint32_t threadCount);
+    template <BinaryVectorScalarFunction function>
+    void executeBinaryMathVectorScalar(const DecodedInstruction &inst, uint32_t threadCount);
+    template <BinaryVectorVectorFunction function>
+    void executeBinaryMathVectorVector(const DecodedInstruction &inst, uint32_t threadCount);
+    template <UnaryFunction function>
+    void executeUnaryMathImm(const DecodedInstruction &inst, uint32_t threadCount);
+    template <BinaryFunction function>
+    void executeBinaryMathImm(const DecodedInstruction &inst, uint32_t threadCount);
+    void broadcastUniformResult(Isa::RegisterIndex dest, uint32_t componentsMask, uint32_t threadCount);
+    void executeMatrixMultiply(const DecodedInstruction &inst, uint32_t threadCount);
+    void executeUniformMatrixMultiply(const DecodedInstruction &inst, uint32_t threadCount);
+    void executeSample(const DecodedInstruction &inst, uint32_t threadCount);
+    void executeLoad(const DecodedInstruction &inst, uint32_t threadCount);
+    void executeStore(const DecodedInstruction &inst, uint32_t threadCount);
+    void executeSwizzle(const DecodedInstruction &inst, uint32_t threadCount);
+    void executeTrap(const DecodedInstruction &inst, uint32_t threadCount);
+    void executeLoadUniforms(const DecodedInstruction &inst, uint32_t threadCount);
+    void executeInitRegs(const DecodedInstruction &inst, uint32_t threadCount);
+    void executeIf(const DecodedInstruction &inst, uint32_t threadCount);
+    void executeElse(const DecodedInstruction &inst, uint32_t threadCount);
+    void executeEndif(const DecodedInstruction &inst, uint32_t threadCount);
+    void executeLoop(const DecodedInstruction &inst, uint32_t threadCount);
+    void executeEndloop(const DecodedInstruction &inst, uint32_t threadCount);
+    void executeBreak(const DecodedInstruction &inst, uint32_t threadCount);
+    uint32_t getConditionLanes(const DecodedInstruction &inst, uint32_t threadCount) const;
+
+    VectorRegister readRegister(Isa::RegisterIndex registerIndex, uint32_t lane) const;
+    void writeRegister(Isa::RegisterIndex registerIndex, uint32_t lane, const VectorRegister &value);
+
+    void readMemory(uint32_t address, uint32_t *data, uint32_t sizeInDwords);
+    void writeMemory(uint32_t address, const uint32_t *data, uint32_t sizeInDwords);
+
+    // In differential mode the program is executed twice. Memory accesses made by the first execution are recorded
+    // and the second one replays them, so stores are not repeated and loads return the same values.
+    struct MemoryAccessLog {
+        enum class Mode {
+            Disabled,
+            Recording,
+            Replaying,
+        };
+        struct Access {
+            uint32_t address;
+            uint32_t sizeInDwords; // a single burst never exceeds one register
+            uint32_t values[Isa::registerComponentsCount];
+            bool write;
+        };
+        Mode mode = Mode::Disabled;
+        std::vector<Access> accesses;
+        size_t replayedAccessesCount = 0;
+    } memoryAccessLog;
 
     Isa::Command::CommandStoreIsa isaMetadata = {};
     uint32_t isa[Isa::maxIsaSize] = {};
+    DecodedInstruction decodedIsa[Isa::maxIsaSize] = {};
+    uint32_t decodedIsaSize = 0;
 
+    // Registers are stored in a structure of arrays layout. Values of one component of a register are contiguous
+    // for all lanes, so an instruction can be executed as a simple loop over lanes, which the compiler can vectorize.
     struct Registers {
-        VectorRegister gpr[Isa::simdSize][Isa::generalPurposeRegistersCount];
-        uint32_t pc;
+        int32_t gpr[Isa::generalPurposeRegistersCount][Isa::registerComponentsCount][Isa::simdSize];
+        uint32_t pc; // index of the next instruction in decodedIsa
     } registers;
 
+    // Lanes disabled by control flow do not modify any registers. Each if and loop pushes an entry to the stack,
+    // which is popped by the matching endif or endloop. Lanes leaving a loop through a break are removed from all
+    // entries above the loop, so they stay disabled until the loop ends.
+    struct ControlFlowState {
+        struct Entry {
+            bool isLoop;
+            uint32_t savedMask; // lanes to enable when the construct ends
+            uint32_t elseMask;  // lanes to enable in the else branch
+        };
+        uint32_t allLanesMask;
+        uint32_t executionMask;
+        uint32_t depth;
+        Entry stack[Isa::maxControlFlowDepth];
+    } controlFlow;
+    void resetControlFlow(uint32_t threadCount);
+
+    // Cycles are counted from the beginning of the program. Only used when timing is not functionalOnly.
+    struct TimingState {
+        uint32_t issueCycle; // cycle, at which next instruction can be issued
+        uint32_t registerReadyCycles[Isa::generalPurposeRegistersCount];
+    } timingState;
+
+    // Compiled programs are chains of closures, one per instruction. They are cached by a hash of the program,
+    // so shader units alternating between a few programs don't have to compile them each time. The program itself
+    // is kept as well and compared on a hit, so a hash collision is treated as a miss.
+    struct CompiledProgram {
+        std::vector<uint32_t> programDwords; // metadata followed by the code
+        std::vector<CompiledInstruction> instructions;
+    };
+    void compileIsa();
+    uint64_t hashIsa() const;
+    std::vector<uint32_t> getProgramDwords() const;
+    void executeCompiledInstructions(uint32_t threadCount);
+    void verifyCompiledExecution(const Registers &compiledRegisters, uint32_t threadCount) const;
+    template <UnaryFunction function>
+    CompiledInstruction compileUnaryMath(const DecodedInstruction &inst);
+    template <BinaryFunction function>
+    CompiledInstruction compileBinaryMath(const DecodedInstruction &inst);
+    template <TernaryFunction function>
+    CompiledInstruction compileTernaryMath(const DecodedInstruction &inst);
+    template <UnaryFunction function>
+    CompiledInstruction compileUnaryMathImm(const DecodedInstruction &inst);
+    template <BinaryFunction function>
+    CompiledInstruction compileBinaryMathImm(const DecodedInstruction &inst);
+    CompiledInstruction compileSwizzle(const DecodedInstruction &inst);
+    CompiledInstruction compileInterpreted(const DecodedInstruction &inst);
+
+    constexpr static size_t compiledProgramsCacheSize = 4;
+    constexpr static uint64_t invalidProgramHash = 0;
+    EntryCache<uint64_t, CompiledProgram, compiledProgramsCacheSize, invalidProgramHash> compiledProgramsCache;
+    CompiledProgram *compiledProgram = nullptr;
+
     constexpr static size_t maxUniformDwords = Isa::maxInputOutputRegisters * Isa::registerComponentsCount;
     uint32_t uniformDwords[maxUniformDwords];
+    int32_t uniformMatrix[Isa::matrixDwordsCount]; // row-major, only received if isaMetadata.hasUniformMatrix is set
+
+    // Each thread group holds inputs of one ExecuteIsa command. Groups are executed and their results are sent
+    // in the order they were received, so ShaderFrontend can match responses to its requests. Instructions operate
+    // on registers, uniformDwords and uniformMatrix declared above, which are loaded from the group before it is executed.
+    struct ThreadGroup {
+        Registers registers;
+        uint32_t uniformDwords[maxUniformDwords];
+        int32_t uniformMatrix[Isa::matrixDwordsCount];
+        uint32_t threadCount;
+    };
+    std::unique_ptr<ThreadGroup[]> threadGroups;
+    std::queue<ThreadGroup *> freeThreadGroups;
+    std::queue<ThreadGroup *> receivedThreadGroups;
+    std::queue<ThreadGroup *> executedThreadGroups;
 };
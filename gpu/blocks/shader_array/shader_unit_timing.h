@@ -0,0 +1,58 @@
+#pragma once
+
+#include "gpu/isa/isa.h"
+
+#include <cstdint>
+#include <initializer_list>
+
+// Describes how many cycles the ShaderUnit spends on executing instructions. Instructions are issued in order.
+// Threads are split into passes of lanesPerCycle lanes and each pass occupies the issue port for issueCycles.
+// Results are available to subsequent instructions latency cycles after the last pass was issued. An instruction
+// reading or writing a register, which is not yet available, stalls until it is.
+struct ShaderUnitTiming {
+    struct OpcodeTiming {
+        uint32_t latency = 1;
+        uint32_t issueCycles = 1;
+    };
+
+    bool functionalOnly = true; // every instruction takes exactly one cycle, regardless of the fields below
+    uint32_t lanesPerCycle = Isa::simdSize;
+    OpcodeTiming opcodes[static_cast<size_t>(Isa::Opcode::COUNT)] = {};
+
+    OpcodeTiming &operator[](Isa::Opcode opcode) { return opcodes[static_cast<size_t>(opcode)]; }
+    const OpcodeTiming &operator[](Isa::Opcode opcode) const { return opcodes[static_cast<size_t>(opcode)]; }
+
+    // Example configuration resembling a simple in-order GPU core.
+    static ShaderUnitTiming createTypical() {
+        using Isa::Opcode;
+
+        ShaderUnitTiming timing = {};
+        timing.functionalOnly = false;
+        timing.lanesPerCycle = 8;
+        for (Opcode opcode : {Opcode::fadd, Opcode::fadd_imm, Opcode::fsub, Opcode::fsub_imm, Opcode::fmul, Opcode::fmul_imm,
+                              Opcode::fmad, Opcode::fmax, Opcode::fmin, Opcode::imul, Opcode::imul_imm}) {
+            timing[opcode] = {4, 1};
+        }
+        for (Opcode opcode : {Opcode::fdot, Opcode::fcross, Opcode::fcross2}) {
+            timing[opcode] = {6, 1};
+        }
+        timing[Opcode::fmatmul] = {8, 2};
+        timing[Opcode::fmatmul_uni] = {8, 2};
+        timing[Opcode::fdiv] = {16, 4};
+        timing[Opcode::fdiv_imm] = {16, 4};
+        timing[Opcode::frcp] = {12, 2};
+        timing[Opcode::fnorm] = {20, 4};
+        timing[Opcode::fsqrt] = {16, 4};
+        timing[Opcode::frsq] = {12, 2};
+        timing[Opcode::fexp2] = {12, 2};
+        timing[Opcode::flog2] = {12, 2};
+        timing[Opcode::fsin] = {16, 4};
+        timing[Opcode::fcos] = {16, 4};
+        timing[Opcode::fpow] = {28, 4}; // implemented as log, multiply and exp
+        timing[Opcode::f2unorm8] = {4, 1};
+        // sample, ld and st are not listed, because they wait for the TextureUnit or memory during execution
+        timing[Opcode::idiv] = {24, 8};
+        timing[Opcode::idiv_imm] = {24, 8};
+        return timing;
+    }
+};
@@ -0,0 +1,200 @@
+#include "gpu/blocks/texture_unit.h"
+#include "gpu/util/conversions.h"
+#include "gpu/util/error.h"
+#include "gpu/util/math.h"
+#include "gpu/util/memory_access.h"
+#include "gpu/util/transfer.h"
+
+#include <algorithm>
+#include <cmath>
+
+TextureUnit::TextureUnit(sc_module_name name, size_t clientsCount, size_t cacheSetsCount, size_t cacheWaysCount)
+    : clientsCount(clientsCount),
+      clientInterfaces(std::make_unique<ClientInterface[]>(clientsCount)),
+      cache(cacheSetsCount, cacheWaysCount) {
+    FATAL_ERROR_IF(clientsCount == 0, "TextureUnit must have at least one client");
+    FATAL_ERROR_IF(cacheSetsCount == 0 || cacheWaysCount == 0, "TextureUnit cache must have at least one line");
+    SC_CTHREAD(main, inpClock.pos());
+}
+
+uint32_t TextureUnit::calculateTexelIndex(uint32_t x, uint32_t y, uint32_t width, uint32_t height, bool mortonLayout) {
+    if (!mortonLayout) {
+        return y * width + x;
+    }
+
+    // Bits of x and y are interleaved as long as both dimensions have them. Remaining bits of the
+    // larger dimension are placed above them, so the texture is a row or a column of Morton squares.
+    FATAL_ERROR_IF(countBits(width) != 1 || countBits(height) != 1, "Morton layout requires power of two texture dimensions");
+    const uint32_t interleavedBits = findBit(std::min(width, height), true);
+    uint32_t index = 0;
+    for (uint32_t bit = 0; bit < interleavedBits; bit++) {
+        index |= ((x >> bit) & 1) << (2 * bit);
+        index |= ((y >> bit) & 1) << (2 * bit + 1);
+    }
+    const uint32_t remainingBits = width > height ? x >> interleavedBits : y >> interleavedBits;
+    return index | (remainingBits << (2 * interleavedBits));
+}
+
+void TextureUnit::main() {
+    uint32_t coordinates[2 * maxCoordinatesPerRequest];
+    float colors[4 * maxCoordinatesPerRequest];
+    TextureState lastState = {};
+
+    while (true) {
+        wait();
+
+        ClientInterface *clientInterface = {};
+        if (!findClientMakingRequest(&clientInterface)) {
+            profiling.outBusy = false;
+            continue;
+        }
+        profiling.outBusy = true;
+
+        // Receive coordinates
+        const uint32_t coordinatesCount = Transfer::receive(clientInterface->request.inpSending, clientInterface->request.inpData, clientInterface->request.outReceiving).to_uint();
+        FATAL_ERROR_IF(coordinatesCount == 0 || coordinatesCount > maxCoordinatesPerRequest, "Invalid number of texture coordinates");
+        Transfer::receiveArray(clientInterface->request.inpSending, clientInterface->request.inpData, clientInterface->request.outReceiving,
+                               coordinates, 2 * coordinatesCount, nullptr, false);
+
+        // Get current texture state
+        TextureState state = {};
+        state.address = texture.inpAddress.read().to_uint();
+        state.width = texture.inpWidth.read().to_uint();
+        state.height = texture.inpHeight.read().to_uint();
+        state.mortonLayout = texture.inpMortonLayout.read();
+        state.bilinearFilter = texture.inpBilinearFilter.read();
+        FATAL_ERROR_IF(state.width == 0 || state.height == 0, "Texture cannot be empty");
+        if (!state.hasSameTexels(lastState)) {
+            cache.invalidate();
+            lastState = state;
+        }
+
+        // Sample one coordinate per clock, unless we have to wait for memory
+        for (uint32_t coordinateIndex = 0; coordinateIndex < coordinatesCount; coordinateIndex++) {
+            const float u = Conversions::uintBytesToFloat(coordinates[2 * coordinateIndex + 0]);
+            const float v = Conversions::uintBytesToFloat(coordinates[2 * coordinateIndex + 1]);
+            sample(state, u, v, colors + 4 * coordinateIndex);
+            wait();
+        }
+
+        // Return results
+        Transfer::sendArray(clientInterface->response.inpReceiving, clientInterface->response.outSending, clientInterface->response.outData,
+                            reinterpret_cast<uint32_t *>(colors), 4 * coordinatesCount);
+    }
+}
+
+bool TextureUnit::findClientMakingRequest(ClientInterface **outClientInterface) {
+    for (size_t clientIndex = 0; clientIndex < clientsCount; clientIndex++) {
+        if (clientInterfaces[clientIndex].request.inpSending.read()) {
+            *outClientInterface = &clientInterfaces[clientIndex];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TextureUnit::TextureState::hasSameTexels(const TextureState &other) const {
+    return address == other.address &&
+           width == other.width &&
+           height == other.height &&
+           mortonLayout == other.mortonLayout;
+}
+
+void TextureUnit::sample(const TextureState &state, float u, float v, float *outRgba) {
+    const auto unpack = [](uint32_t texel, float *rgba) {
+        for (int channel = 0; channel < 4; channel++) {
+            rgba[channel] = ((texel >> (8 * channel)) & 0xff) / 255.f;
+        }
+    };
+
+    // Texel centers are at half-integer coordinates
+    const float x = u * state.width;
+    const float y = v * state.height;
+    if (!state.bilinearFilter) {
+        unpack(fetchTexel(state, static_cast<int32_t>(std::floor(x)), static_cast<int32_t>(std::floor(y))), outRgba);
+        return;
+    }
+
+    const float x0 = std::floor(x - 0.5f);
+    const float y0 = std::floor(y - 0.5f);
+    const float weightX = x - 0.5f - x0;
+    const float weightY = y - 0.5f - y0;
+    float texels[4][4];
+    unpack(fetchTexel(state, static_cast<int32_t>(x0) + 0, static_cast<int32_t>(y0) + 0), texels[0]);
+    unpack(fetchTexel(state, static_cast<int32_t>(x0) + 1, static_cast<int32_t>(y0) + 0), texels[1]);
+    unpack(fetchTexel(state, static_cast<int32_t>(x0) + 0, static_cast<int32_t>(y0) + 1), texels[2]);
+    unpack(fetchTexel(state, static_cast<int32_t>(x0) + 1, static_cast<int32_t>(y0) + 1), texels[3]);
+    for (int channel = 0; channel < 4; channel++) {
+        const float top = texels[0][channel] + weightX * (texels[1][channel] - texels[0][channel]);
+        const float bottom = texels[2][channel] + weightX * (texels[3][channel] - texels[2][channel]);
+        outRgba[channel] = top + weightY * (bottom - top);
+    }
+}
+
+uint32_t TextureUnit::fetchTexel(const TextureState &state, int32_t x, int32_t y) {
+    x = std::clamp<int32_t>(x, 0, state.width - 1);
+    y = std::clamp<int32_t>(y, 0, state.height - 1);
+    const uint32_t texelIndex = calculateTexelIndex(x, y, state.width, state.height, state.mortonLayout);
+    const uint32_t firstTexelInLine = texelIndex - texelIndex % texelsPerCacheLine;
+    const uint32_t lineAddress = state.address + firstTexelInLine * memoryDataTypeByteSize;
+
+    TexelCache::Line *line = cache.find(lineAddress);
+    if (line) {
+        profiling.outCacheHits = ++cacheHits;
+    } else {
+        profiling.outCacheMisses = ++cacheMisses;
+
+        // The line is filled with a single burst. Texels past the end of the texture are not read, because they could
+        // be outside of memory.
+        line = &cache.allocate(lineAddress);
+        const uint32_t texelsCount = state.width * state.height;
+        const uint32_t texelsToRead = std::min<uint32_t>(texelsPerCacheLine, texelsCount - firstTexelInLine);
+        MemoryAccess::readBurst(memory, lineAddress, line->texels, texelsToRead);
+        std::fill(line->texels + texelsToRead, line->texels + texelsPerCacheLine, 0);
+    }
+    return line->texels[texelIndex % texelsPerCacheLine];
+}
+
+TextureUnit::TexelCache::TexelCache(size_t setsCount, size_t waysCount)
+    : setsCount(setsCount),
+      waysCount(waysCount),
+      lines(std::make_unique<Line[]>(setsCount * waysCount)) {
+    invalidate();
+}
+
+TextureUnit::TexelCache::Line *TextureUnit::TexelCache::find(uint32_t address) {
+    const size_t set = (address / (texelsPerCacheLine * memoryDataTypeByteSize)) % setsCount;
+    Line *ways = lines.get() + set * waysCount;
+    for (size_t way = 0; way < waysCount; way++) {
+        if (ways[way].valid && ways[way].address == address) {
+            ways[way].lastUse = ++useCounter;
+            return &ways[way];
+        }
+    }
+    return nullptr;
+}
+
+TextureUnit::TexelCache::Line &TextureUnit::TexelCache::allocate(uint32_t address) {
+    // Replace an invalid line or the least recently used one
+    const size_t set = (address / (texelsPerCacheLine * memoryDataTypeByteSize)) % setsCount;
+    Line *ways = lines.get() + set * waysCount;
+    Line *victim = &ways[0];
+    for (size_t way = 0; way < waysCount; way++) {
+        if (!ways[way].valid) {
+            victim = &ways[way];
+            break;
+        }
+        if (ways[way].lastUse < victim->lastUse) {
+            victim = &ways[way];
+        }
+    }
+
+    victim->valid = true;
+    victim->address = address;
+    victim->lastUse = ++useCounter;
+    return *victim;
+}
+
+void TextureUnit::TexelCache::invalidate() {
+    std::fill_n(lines.get(), setsCount * waysCount, Line{});
+}
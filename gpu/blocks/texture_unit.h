@@ -0,0 +1,105 @@
+#pragma once
+
+#include "gpu/definitions/types.h"
+#include "gpu/isa/isa.h"
+
+#include <memory>
+#include <systemc.h>
+
+// Samples a single texture on behalf of shader units. Each shader unit is a separate client, which sends
+// texture coordinates of its threads and receives filtered RGBA colors. Texels are fetched from memory
+// through a set-associative cache.
+//
+// Texels are stored as RGBA8 colors, the same as in the framebuffer. Coordinates are normalized to [0,1]
+// and clamped to the edges of the texture. Texture can be stored row by row or in Morton order, which keeps
+// texels close in both directions close in memory. Morton order requires power of two dimensions.
+SC_MODULE(TextureUnit) {
+    SC_HAS_PROCESS(TextureUnit);
+    TextureUnit(sc_module_name name, size_t clientsCount, size_t cacheSetsCount, size_t cacheWaysCount);
+
+    sc_in_clk inpClock;
+
+    struct {
+        sc_in<MemoryAddressType> inpAddress;
+        sc_in<sc_uint<16>> inpWidth;
+        sc_in<sc_uint<16>> inpHeight;
+        sc_in<bool> inpMortonLayout;
+        sc_in<bool> inpBilinearFilter;
+    } texture;
+
+    struct {
+        sc_out<bool> outEnable;
+        sc_out<MemoryAddressType> outAddress;
+        sc_out<MemoryBurstLengthType> outBurstLength;
+        sc_in<MemoryDataType> inpData;
+        sc_in<bool> inpCompleted;
+    } memory;
+
+    struct {
+        sc_out<bool> outBusy;
+        sc_out<sc_uint<32>> outCacheHits;
+        sc_out<sc_uint<32>> outCacheMisses;
+    } profiling;
+
+    // Request starts with the number of coordinates followed by u,v pairs. Response contains r,g,b,a floats
+    // for each coordinate.
+    struct ClientInterface {
+        struct {
+            sc_in<bool> inpSending;
+            sc_in<sc_uint<32>> inpData;
+            sc_out<bool> outReceiving;
+        } request;
+
+        struct {
+            sc_out<bool> outSending;
+            sc_out<sc_uint<32>> outData;
+            sc_in<bool> inpReceiving;
+        } response;
+    };
+    const size_t clientsCount;
+    std::unique_ptr<ClientInterface[]> clientInterfaces;
+
+    constexpr static inline uint32_t maxCoordinatesPerRequest = Isa::simdSize;
+    constexpr static inline uint32_t texelsPerCacheLine = 4; // 2x2 texels in Morton layout
+
+    // Index of a texel in the texture's memory. Can be used by the host to lay out the texture.
+    static uint32_t calculateTexelIndex(uint32_t x, uint32_t y, uint32_t width, uint32_t height, bool mortonLayout);
+
+private:
+    void main();
+    bool findClientMakingRequest(ClientInterface * *outClientInterface);
+
+    struct TextureState {
+        uint32_t address;
+        uint32_t width;
+        uint32_t height;
+        bool mortonLayout;
+        bool bilinearFilter;
+        bool hasSameTexels(const TextureState &other) const;
+    };
+    void sample(const TextureState &state, float u, float v, float *outRgba);
+    uint32_t fetchTexel(const TextureState &state, int32_t x, int32_t y);
+
+    // Lines are tagged with their memory address. Writes to memory are not snooped, so the cache is invalidated
+    // whenever address, size or layout of the texture changes, in case the texture was reuploaded in the meantime.
+    struct TexelCache {
+        struct Line {
+            bool valid;
+            uint32_t address; // address of the first texel
+            uint32_t lastUse;
+            uint32_t texels[texelsPerCacheLine];
+        };
+
+        TexelCache(size_t setsCount, size_t waysCount);
+        Line *find(uint32_t address);
+        Line &allocate(uint32_t address);
+        void invalidate();
+
+        const size_t setsCount;
+        const size_t waysCount;
+        std::unique_ptr<Line[]> lines; // ways of each set are contiguous
+        uint32_t useCounter = 0;
+    } cache;
+    uint32_t cacheHits = 0;
+    uint32_t cacheMisses = 0;
+};
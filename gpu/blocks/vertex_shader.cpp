@@ -4,9 +4,10 @@
 
 void VertexShader::main() {
     const auto maxDwordsPerInputPrimitive = verticesInPrimitive * Isa::registerComponentsCount * Isa::maxInputOutputRegisters;
+    const auto maxUniformDwords = Isa::registerComponentsCount * Isa::maxInputOutputRegisters + Isa::matrixDwordsCount;
     struct {
         ShaderFrontendRequest header = {};
-        uint32_t data[maxDwordsPerInputPrimitive];
+        uint32_t data[maxDwordsPerInputPrimitive + maxUniformDwords];
     } request;
 
     const auto maxDwordsPerOutputPrimitive = verticesInPrimitive * Isa::registerComponentsCount * Isa::maxInputOutputRegisters;
@@ -18,6 +19,13 @@ void VertexShader::main() {
     while (true) {
         wait();
 
+        // Input components are configured only for draws. Don't read them before any vertices are sent, because
+        // compute dispatches leave them unset.
+        if (!previousBlock.inpSending.read()) {
+            profiling.outBusy = false;
+            continue;
+        }
+
         // Prepare some info about our input
         CustomShaderComponents inputComponentsInfo{this->inpCustomInputComponents.read().to_uint()};
         const size_t totalInputComponents = verticesInPrimitive * inputComponentsInfo.getTotalCustomComponents();
@@ -38,6 +46,12 @@ void VertexShader::main() {
                 request.data[dataDwords++] = value;
             }
         }
+        const bool hasUniformMatrix = inpHasUniformMatrix.read();
+        if (hasUniformMatrix) {
+            for (size_t dwordIndex = 0u; dwordIndex < Isa::matrixDwordsCount; dwordIndex++) {
+                request.data[dataDwords++] = inpUniformMatrixData[dwordIndex].read().to_int();
+            }
+        }
 
         // Prepare some info about the request
         CustomShaderComponents customOutputComponents{this->inpCustomOutputComponents.read().to_uint()};
@@ -60,6 +74,7 @@ void VertexShader::main() {
         request.header.dword2.uniformSize0 = uniformsInfo.comp0;
         request.header.dword2.uniformSize1 = uniformsInfo.comp1;
         request.header.dword2.uniformSize2 = uniformsInfo.comp2;
+        request.header.dword2.hasUniformMatrix = hasUniformMatrix;
 
         // Perform the request
         const size_t dwordsToSend = sizeof(ShaderFrontendRequest) / sizeof(uint32_t) + dataDwords;
@@ -12,6 +12,8 @@ SC_MODULE(VertexShader) {
     sc_in<CustomShaderComponentsType> inpCustomOutputComponents;
     sc_in<CustomShaderComponentsType> inpUniforms;
     sc_in<VertexPositionFloatType> inpUniformsData[Isa::maxInputOutputRegisters][Isa::registerComponentsCount];
+    sc_in<bool> inpHasUniformMatrix;
+    sc_in<VertexPositionFloatType> inpUniformMatrixData[Isa::matrixDwordsCount];
 
     struct PreviousBlock {
         sc_in<bool> inpSending;
@@ -5,8 +5,11 @@
 #include <systemc.h>
 
 constexpr inline size_t memoryDataTypeByteSize = 4;
-using MemoryAddressType = sc_uint<32>;
+constexpr inline size_t memoryAddressBits = 32; // byte addresses, so up to 4 GiB of memory can be addressed
+using MemoryAddressType = sc_uint<memoryAddressBits>;
 using MemoryDataType = sc_uint<memoryDataTypeByteSize * 8>;
+constexpr inline size_t maxMemoryBurstLength = 256; // in dwords
+using MemoryBurstLengthType = sc_uint<16>;
 
 using VertexPositionFloatType = sc_uint<32>;   // 32-bit float saved as uint
 using VertexPositionIntegerType = sc_uint<16>; // actual uint
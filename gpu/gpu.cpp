@@ -1,36 +1,45 @@
 #include "gpu/gpu.h"
 #include "gpu/util/vcd_trace.h"
 
-#include <array>
+#include <string>
+#include <vector>
 
-std::array<sc_out<bool> *, 10> getBlocksBusySignals(Gpu *gpu) {
-    return {
+std::vector<sc_out<bool> *> getBlocksBusySignals(Gpu *gpu) {
+    std::vector<sc_out<bool> *> result = {
         &gpu->blitter.profiling.outBusy,
         &gpu->memoryController.profiling.outBusy,
         &gpu->shaderFrontend.profiling.outBusy,
         &gpu->shaderFrontend.profiling.outBusy,
-        &gpu->shaderUnit0.profiling.outBusy,
-        &gpu->shaderUnit1.profiling.outBusy,
         &gpu->primitiveAssembler.profiling.outBusy,
         &gpu->vertexShader.profiling.outBusy,
         &gpu->rasterizer.profiling.outBusy,
         &gpu->outputMerger.profiling.outBusy,
+        &gpu->textureUnit.profiling.outBusy,
     };
+    for (auto &shaderUnit : gpu->shaderUnits) {
+        result.push_back(&shaderUnit->profiling.outBusy);
+    }
+    return result;
 }
 
-Gpu::Gpu(sc_module_name name, sc_clock &clock)
-    : commandStreamer("CommandStreamer", clock.period()),
+Gpu::Gpu(sc_module_name name, sc_clock &clock, const GpuConfig &gpuConfig)
+    : gpuConfig(gpuConfig),
+      commandStreamer("CommandStreamer", clock.period()),
       blitter("Blitter"),
-      memoryController("MemoryController"),
-      memory("Memory"),
-      shaderFrontend("ShaderFrontend"),
-      shaderUnit0("ShaderUnit0"),
-      shaderUnit1("ShaderUnit1"),
+      memoryController("MemoryController", static_cast<size_t>(MemoryClient::COUNT) + gpuConfig.shaderUnitsCount),
+      memory("Memory", gpuConfig.memorySize, gpuConfig.memoryBackend),
+      shaderFrontend("ShaderFrontend", static_cast<size_t>(ShaderFrontendClient::COUNT), gpuConfig.shaderUnitsCount, gpuConfig.threadGroupsPerShaderUnit),
       primitiveAssembler("PrimitiveAssembler"),
       vertexShader("VertexShader"),
       rasterizer("Rasterizer"),
       fragmentShader("FragmentShader"),
-      outputMerger("OutputMerger") {
+      outputMerger("OutputMerger"),
+      textureUnit("TextureUnit", gpuConfig.shaderUnitsCount, gpuConfig.textureCacheSetsCount, gpuConfig.textureCacheWaysCount) {
+    for (size_t shaderUnitIndex = 0; shaderUnitIndex < gpuConfig.shaderUnitsCount; shaderUnitIndex++) {
+        const std::string shaderUnitName = "ShaderUnit" + std::to_string(shaderUnitIndex);
+        shaderUnits.push_back(std::make_unique<ShaderUnit>(shaderUnitName.c_str(), gpuConfig.shaderExecutionMode, gpuConfig.shaderUnitTiming,
+                                                          gpuConfig.threadGroupsPerShaderUnit));
+    }
 
     connectClocks(clock);
     connectInternalPorts();
@@ -46,13 +55,15 @@ void Gpu::connectClocks(sc_clock &clock) {
     memoryController.inpClock(clock);
     memory.inpClock(clock);
     shaderFrontend.inpClock(clock);
-    shaderUnit0.inpClock(clock);
-    shaderUnit1.inpClock(clock);
+    for (auto &shaderUnit : shaderUnits) {
+        shaderUnit->inpClock(clock);
+    }
     primitiveAssembler.inpClock(clock);
     vertexShader.inpClock(clock);
     rasterizer.inpClock(clock);
     fragmentShader.inpClock(clock);
     outputMerger.inpClock(clock);
+    textureUnit.inpClock(clock);
 }
 
 void Gpu::connectInternalPorts() {
@@ -69,27 +80,48 @@ void Gpu::connectInternalPorts() {
     ports.connectMemoryToClient(memoryController.memory, memory, "MEM_MEMCTL");
 
     // MEMCTL <-> clients
-    sc_in<MemoryDataType> *portsForRead[] = {&blitter.memory.inpData,
-                                             &primitiveAssembler.memory.inpData,
-                                             &outputMerger.memory.inpData,
-                                             &shaderFrontend.memory.inpData};
-    ports.connectPortsMultiple(portsForRead, memoryController.outData, "MEMCTL_dataForRead");
-    ports.connectMemoryToClient<MemoryClientType::ReadOnly, MemoryServerType::SeparateOutData>(primitiveAssembler.memory, memoryController.clients[0], "MEMCTL_PA");
-    ports.connectMemoryToClient<MemoryClientType::ReadWrite, MemoryServerType::SeparateOutData>(blitter.memory, memoryController.clients[1], "MEMCTL_BLT");
-    ports.connectMemoryToClient<MemoryClientType::ReadWrite, MemoryServerType::SeparateOutData>(outputMerger.memory, memoryController.clients[2], "MEMCTL_OM");
-    ports.connectMemoryToClient<MemoryClientType::ReadOnly, MemoryServerType::SeparateOutData>(shaderFrontend.memory, memoryController.clients[3], "MEMCTL_SF");
+    auto memoryClient = [this](MemoryClient client) -> MemoryController::ClientPorts & {
+        return memoryController.clients[static_cast<size_t>(client)];
+    };
+    ports.connectMemoryToClient<MemoryClientType::ReadOnly>(primitiveAssembler.memory, memoryClient(MemoryClient::PA), "MEMCTL_PA");
+    ports.connectMemoryToClient<MemoryClientType::ReadWrite>(blitter.memory, memoryClient(MemoryClient::BLT), "MEMCTL_BLT");
+    ports.connectMemoryToClient<MemoryClientType::ReadWrite>(outputMerger.memory, memoryClient(MemoryClient::OM), "MEMCTL_OM");
+    ports.connectMemoryToClient<MemoryClientType::ReadOnly>(shaderFrontend.memory, memoryClient(MemoryClient::SF), "MEMCTL_SF");
+    ports.connectMemoryToClient<MemoryClientType::ReadOnly>(textureUnit.memory, memoryClient(MemoryClient::TU), "MEMCTL_TU");
+    for (size_t shaderUnitIndex = 0; shaderUnitIndex < shaderUnits.size(); shaderUnitIndex++) {
+        auto &clientPorts = memoryController.clients[static_cast<size_t>(MemoryClient::COUNT) + shaderUnitIndex];
+        const std::string prefix = "MEMCTL_SU" + std::to_string(shaderUnitIndex);
+        ports.connectMemoryToClient<MemoryClientType::ReadWrite>(shaderUnits[shaderUnitIndex]->memory, clientPorts, prefix);
+    }
 
     // SF -> SU
-    ports.connectHandshake(shaderFrontend.shaderUnitInterfaces[0].request, shaderUnit0.request, "SF_SU0_req");
-    ports.connectHandshake(shaderFrontend.shaderUnitInterfaces[1].request, shaderUnit1.request, "SF_SU1_req");
-    ports.connectHandshake(shaderUnit0.response, shaderFrontend.shaderUnitInterfaces[0].response, "SF_SU0_resp");
-    ports.connectHandshake(shaderUnit1.response, shaderFrontend.shaderUnitInterfaces[1].response, "SF_SU1_resp");
+    for (size_t shaderUnitIndex = 0; shaderUnitIndex < shaderUnits.size(); shaderUnitIndex++) {
+        ShaderUnit &shaderUnit = *shaderUnits[shaderUnitIndex];
+        auto &shaderUnitInterface = shaderFrontend.shaderUnitInterfaces[shaderUnitIndex];
+        const std::string prefix = "SF_SU" + std::to_string(shaderUnitIndex);
+        ports.connectHandshake(shaderUnitInterface.request, shaderUnit.request, prefix + "_req");
+        ports.connectHandshake(shaderUnit.response, shaderUnitInterface.response, prefix + "_resp");
+    }
+
+    // SU -> TU
+    for (size_t shaderUnitIndex = 0; shaderUnitIndex < shaderUnits.size(); shaderUnitIndex++) {
+        ShaderUnit &shaderUnit = *shaderUnits[shaderUnitIndex];
+        auto &clientInterface = textureUnit.clientInterfaces[shaderUnitIndex];
+        const std::string prefix = "SU" + std::to_string(shaderUnitIndex) + "_TU";
+        ports.connectHandshake(shaderUnit.texture.request, clientInterface.request, prefix + "_req");
+        ports.connectHandshake(clientInterface.response, shaderUnit.texture.response, prefix + "_resp");
+    }
 
     // SF -> clients
-    ports.connectHandshake(vertexShader.shaderFrontend.request, shaderFrontend.clientInterfaces[0].request, "SF_VS_req");
-    ports.connectHandshake(shaderFrontend.clientInterfaces[0].response, vertexShader.shaderFrontend.response, "SF_VS_resp");
-    ports.connectHandshake(fragmentShader.shaderFrontend.request, shaderFrontend.clientInterfaces[1].request, "SF_FS_req");
-    ports.connectHandshake(shaderFrontend.clientInterfaces[1].response, fragmentShader.shaderFrontend.response, "SF_FS_resp");
+    auto &vsInterface = shaderFrontend.clientInterfaces[static_cast<size_t>(ShaderFrontendClient::VS)];
+    auto &fsInterface = shaderFrontend.clientInterfaces[static_cast<size_t>(ShaderFrontendClient::FS)];
+    ports.connectHandshake(vertexShader.shaderFrontend.request, vsInterface.request, "SF_VS_req");
+    ports.connectHandshake(vsInterface.response, vertexShader.shaderFrontend.response, "SF_VS_resp");
+    ports.connectHandshake(fragmentShader.shaderFrontend.request, fsInterface.request, "SF_FS_req");
+    ports.connectHandshake(fsInterface.response, fragmentShader.shaderFrontend.response, "SF_FS_resp");
+    auto &csInterface = shaderFrontend.clientInterfaces[static_cast<size_t>(ShaderFrontendClient::CS)];
+    ports.connectHandshake(commandStreamer.shaderFrontend.request, csInterface.request, "SF_CS_req");
+    ports.connectHandshake(csInterface.response, commandStreamer.shaderFrontend.response, "SF_CS_resp");
 
     // PA <-> VS
     ports.connectHandshakeWithParallelPorts(primitiveAssembler.nextBlock, vertexShader.previousBlock, "PA_VS");
@@ -121,6 +153,10 @@ void Gpu::connectPublicPorts() {
             input(signal);
         }
     }
+    vertexShader.inpHasUniformMatrix(config.VS.hasUniformMatrix);
+    for (uint32_t dwordIndex = 0u; dwordIndex < Isa::matrixDwordsCount; dwordIndex++) {
+        vertexShader.inpUniformMatrixData[dwordIndex](config.VS.uniformMatrixData[dwordIndex]);
+    }
 
     rasterizer.inpCustomVsPsComponents(config.GLOBAL.vsPsCustomComponents);
     rasterizer.framebuffer.inpWidth(config.GLOBAL.framebufferWidth);
@@ -136,6 +172,27 @@ void Gpu::connectPublicPorts() {
             input(signal);
         }
     }
+    fragmentShader.inpHasUniformMatrix(config.FS.hasUniformMatrix);
+    fragmentShader.inpPackedColorOutput(config.FS.packedColorOutput);
+    for (uint32_t dwordIndex = 0u; dwordIndex < Isa::matrixDwordsCount; dwordIndex++) {
+        fragmentShader.inpUniformMatrixData[dwordIndex](config.FS.uniformMatrixData[dwordIndex]);
+    }
+
+    commandStreamer.computeShader.inpShaderAddress(config.CS.shaderAddress);
+    commandStreamer.computeShader.inpUniforms(config.CS.uniforms);
+    for (uint32_t uniformIndex = 0u; uniformIndex < Isa::maxInputOutputRegisters; uniformIndex++) {
+        for (uint32_t componentIndex = 0u; componentIndex < Isa::registerComponentsCount; componentIndex++) {
+            auto &input = commandStreamer.computeShader.inpUniformsData[uniformIndex][componentIndex];
+            auto &signal = config.CS.uniformsData[uniformIndex][componentIndex];
+            input(signal);
+        }
+    }
+
+    textureUnit.texture.inpAddress(config.TU.textureAddress);
+    textureUnit.texture.inpWidth(config.TU.textureWidth);
+    textureUnit.texture.inpHeight(config.TU.textureHeight);
+    textureUnit.texture.inpMortonLayout(config.TU.mortonLayout);
+    textureUnit.texture.inpBilinearFilter(config.TU.bilinearFilter);
 
     outputMerger.framebuffer.inpAddress(config.OM.framebufferAddress);
     outputMerger.depth.inpEnable(config.OM.depthEnable);
@@ -152,16 +209,19 @@ void Gpu::connectProfilingPorts() {
     profilingPorts.connectPort(memoryController.profiling.outBusy, "MEMCTL_busy");
     profilingPorts.connectPort(memoryController.profiling.outReadsPerformed, "MEMCTL_reads");
     profilingPorts.connectPort(memoryController.profiling.outWritesPerformed, "MEMCTL_writes");
+    profilingPorts.connectPort(memoryController.profiling.outBytesTransferred, "MEMCTL_bytesTransferred");
 
     profilingPorts.connectPort(shaderFrontend.profiling.outBusy, "SF_busy");
     profilingPorts.connectPort(shaderFrontend.profiling.outIsaFetches, "SF_isaFetches");
 
-    profilingPorts.connectPort(shaderUnit0.profiling.outBusy, "SU0_busy");
-    profilingPorts.connectPort(shaderUnit0.profiling.outThreadsStarted, "SU0_threadsStarted");
-    profilingPorts.connectPort(shaderUnit0.profiling.outThreadsFinished, "SU0_threadsFinished");
-    profilingPorts.connectPort(shaderUnit1.profiling.outBusy, "SU1_busy");
-    profilingPorts.connectPort(shaderUnit1.profiling.outThreadsStarted, "SU1_threadsStarted");
-    profilingPorts.connectPort(shaderUnit1.profiling.outThreadsFinished, "SU1_threadsFinished");
+    for (size_t shaderUnitIndex = 0; shaderUnitIndex < shaderUnits.size(); shaderUnitIndex++) {
+        ShaderUnit &shaderUnit = *shaderUnits[shaderUnitIndex];
+        const std::string prefix = "SU" + std::to_string(shaderUnitIndex);
+        profilingPorts.connectPort(shaderUnit.profiling.outBusy, prefix + "_busy");
+        profilingPorts.connectPort(shaderUnit.profiling.outThreadsStarted, prefix + "_threadsStarted");
+        profilingPorts.connectPort(shaderUnit.profiling.outThreadsFinished, prefix + "_threadsFinished");
+        profilingPorts.connectPort(shaderUnit.profiling.outLaneInstructionsSaved, prefix + "_laneInstructionsSaved");
+    }
 
     profilingPorts.connectPort(primitiveAssembler.profiling.outBusy, "PA_busy");
     profilingPorts.connectPort(primitiveAssembler.profiling.outPrimitivesProduced, "PA_primitivesProduced");
@@ -174,6 +234,10 @@ void Gpu::connectProfilingPorts() {
     profilingPorts.connectPort(fragmentShader.profiling.outBusy, "FS_busy");
 
     profilingPorts.connectPort(outputMerger.profiling.outBusy, "OM_busy");
+
+    profilingPorts.connectPort(textureUnit.profiling.outBusy, "TU_busy");
+    profilingPorts.connectPort(textureUnit.profiling.outCacheHits, "TU_cacheHits");
+    profilingPorts.connectPort(textureUnit.profiling.outCacheMisses, "TU_cacheMisses");
 }
 
 void Gpu::addSignalsToVcdTrace(VcdTrace &trace, bool publicPorts, bool internalPorts) {
@@ -189,9 +253,21 @@ void Gpu::addSignalsToVcdTrace(VcdTrace &trace, bool publicPorts, bool internalP
 
         trace.trace(config.VS.shaderAddress);
         trace.trace(config.VS.uniforms);
+        trace.trace(config.VS.hasUniformMatrix);
 
         trace.trace(config.FS.shaderAddress);
         trace.trace(config.FS.uniforms);
+        trace.trace(config.FS.hasUniformMatrix);
+        trace.trace(config.FS.packedColorOutput);
+
+        trace.trace(config.CS.shaderAddress);
+        trace.trace(config.CS.uniforms);
+
+        trace.trace(config.TU.textureAddress);
+        trace.trace(config.TU.textureWidth);
+        trace.trace(config.TU.textureHeight);
+        trace.trace(config.TU.mortonLayout);
+        trace.trace(config.TU.bilinearFilter);
 
         trace.trace(config.OM.framebufferAddress);
         trace.trace(config.OM.depthEnable);
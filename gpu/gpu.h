@@ -10,31 +10,37 @@
 #include "gpu/blocks/rasterizer.h"
 #include "gpu/blocks/shader_array/shader_frontend.h"
 #include "gpu/blocks/shader_array/shader_unit.h"
+#include "gpu/blocks/texture_unit.h"
 #include "gpu/blocks/vertex_shader.h"
+#include "gpu/gpu_config.h"
 #include "gpu/util/port_connector.h"
 
+#include <memory>
 #include <systemc.h>
+#include <vector>
 
 class VcdTrace;
 
 SC_MODULE(Gpu) {
-    constexpr static inline size_t memorySize = 21000;
     SC_HAS_PROCESS(Gpu);
-    Gpu(sc_module_name name, sc_clock &clock);
+    Gpu(sc_module_name name, sc_clock &clock, const GpuConfig &gpuConfig = {});
+
+    // Structural parameters the GPU was created with
+    const GpuConfig gpuConfig;
 
     // Blocks of the GPU
-    CommandStreamer commandStreamer;       // abbreviation: CS
-    Blitter blitter;                       // abbreviation: BLT
-    MemoryController<4> memoryController;  // abbreviation: MEMCTL
-    Memory<memorySize> memory;             // abbreviation: MEM
-    ShaderFrontend<2, 2> shaderFrontend;   // abbreviation: SF
-    ShaderUnit shaderUnit0;                // abbreviation SU0
-    ShaderUnit shaderUnit1;                // abbreviation SU1
-    PrimitiveAssembler primitiveAssembler; // abbreviation: PA
-    VertexShader vertexShader;             // abbreviation: VS
-    Rasterizer rasterizer;                 // abbreviation: RS
-    FragmentShader fragmentShader;         // abbreviation: FS
-    OutputMerger outputMerger;             // abbreviation: OM
+    CommandStreamer commandStreamer;                      // abbreviation: CS
+    Blitter blitter;                                      // abbreviation: BLT
+    MemoryController memoryController;                    // abbreviation: MEMCTL
+    Memory memory;                                        // abbreviation: MEM
+    ShaderFrontend shaderFrontend;                        // abbreviation: SF
+    std::vector<std::unique_ptr<ShaderUnit>> shaderUnits; // abbreviation: SU0, SU1, ...
+    PrimitiveAssembler primitiveAssembler;                // abbreviation: PA
+    VertexShader vertexShader;                            // abbreviation: VS
+    Rasterizer rasterizer;                                // abbreviation: RS
+    FragmentShader fragmentShader;                        // abbreviation: FS
+    OutputMerger outputMerger;                            // abbreviation: OM
+    TextureUnit textureUnit;                              // abbreviation: TU
 
     // This structure represents wirings of individual blocks visible to the
     // user. Ideally user should set all of the fields to desired values.
@@ -55,14 +61,33 @@ SC_MODULE(Gpu) {
             sc_signal<MemoryAddressType> shaderAddress{"VS_shaderAddress"};
             sc_signal<CustomShaderComponentsType> uniforms{"VS_uniforms"};
             sc_signal<VertexPositionFloatType> uniformsData[Isa::maxInputOutputRegisters][Isa::registerComponentsCount];
+            sc_signal<bool> hasUniformMatrix{"VS_hasUniformMatrix"};
+            sc_signal<VertexPositionFloatType> uniformMatrixData[Isa::matrixDwordsCount]; // row-major
         } VS;
 
         struct {
             sc_signal<MemoryAddressType> shaderAddress{"FS_shaderAddress"};
             sc_signal<CustomShaderComponentsType> uniforms{"FS_uniforms"};
             sc_signal<VertexPositionFloatType> uniformsData[Isa::maxInputOutputRegisters][Isa::registerComponentsCount];
+            sc_signal<bool> hasUniformMatrix{"FS_hasUniformMatrix"};
+            sc_signal<VertexPositionFloatType> uniformMatrixData[Isa::matrixDwordsCount]; // row-major
+            sc_signal<bool> packedColorOutput{"FS_packedColorOutput"};
         } FS;
 
+        struct {
+            sc_signal<MemoryAddressType> textureAddress{"TU_textureAddress"};
+            sc_signal<sc_uint<16>> textureWidth{"TU_textureWidth"};
+            sc_signal<sc_uint<16>> textureHeight{"TU_textureHeight"};
+            sc_signal<bool> mortonLayout{"TU_mortonLayout"};
+            sc_signal<bool> bilinearFilter{"TU_bilinearFilter"};
+        } TU;
+
+        struct {
+            sc_signal<MemoryAddressType> shaderAddress{"CS_shaderAddress"};
+            sc_signal<CustomShaderComponentsType> uniforms{"CS_uniforms"};
+            sc_signal<VertexPositionFloatType> uniformsData[Isa::maxInputOutputRegisters][Isa::registerComponentsCount];
+        } CS;
+
         struct {
             sc_signal<MemoryAddressType> framebufferAddress{"OM_framebufferAddress"};
             sc_signal<bool> depthEnable{"OM_depthEnable"};
@@ -81,6 +106,24 @@ SC_MODULE(Gpu) {
     void addProfilingSignalsToVcdTrace(VcdTrace & trace);
 
 private:
+    // Blocks connected to the MemoryController. Their order is the order of MEMCTL client interfaces.
+    // Shader units are connected after them, one interface per unit.
+    enum class MemoryClient {
+        PA,
+        BLT,
+        OM,
+        SF,
+        TU,
+        COUNT,
+    };
+    // Blocks connected to the ShaderFrontend. Their order is the order of SF client interfaces.
+    enum class ShaderFrontendClient {
+        VS,
+        FS,
+        CS,
+        COUNT,
+    };
+
     void connectClocks(sc_clock &clock);
     void connectInternalPorts();
     void connectPublicPorts();
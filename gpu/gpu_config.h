@@ -0,0 +1,19 @@
+#pragma once
+
+#include "gpu/blocks/memory.h"
+#include "gpu/blocks/shader_array/shader_unit.h"
+
+#include <cstddef>
+
+// Structural parameters of the Gpu. Contrary to the configuration pins (see Gpu::config), they decide which
+// blocks are instantiated and how they are wired together, so they have to be known at elaboration time.
+struct GpuConfig {
+    size_t shaderUnitsCount = 2;
+    size_t threadGroupsPerShaderUnit = 1; // more groups allow a shader unit to stream data of one group while executing another
+    size_t memorySize = 21000; // in dwords
+    MemoryBackend memoryBackend = MemoryBackend::Signals; // use Native or Sparse for large memories
+    ShaderExecutionMode shaderExecutionMode = ShaderExecutionMode::Interpreter;
+    ShaderUnitTiming shaderUnitTiming = {};
+    size_t textureCacheSetsCount = 16;
+    size_t textureCacheWaysCount = 2; // each line holds TextureUnit::texelsPerCacheLine texels
+};
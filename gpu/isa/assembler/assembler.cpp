@@ -0,0 +1,58 @@
+#include "gpu/isa/assembler/assembler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+namespace Isa {
+
+std::vector<int> assemblyBatch(const std::vector<const char *> &codes, std::vector<PicoGpuBinary> &outBinaries, size_t threadsCount) {
+    outBinaries.clear();
+    outBinaries.resize(codes.size());
+    std::vector<int> results(codes.size(), 0);
+
+    if (threadsCount == 0) {
+        threadsCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    threadsCount = std::min(threadsCount, codes.size());
+
+    // Each thread takes the next source when it's done with the previous one, so a few long shaders don't leave other
+    // threads idle. Errors in the sources are reported through the binaries. Failed internal checks throw exceptions,
+    // which must be passed back to the calling thread, because only it may stop the simulation.
+    std::atomic<size_t> nextIndex = 0;
+    std::vector<std::exception_ptr> exceptions(codes.size());
+    const auto assembleSources = [&]() {
+        for (size_t index = nextIndex++; index < codes.size(); index = nextIndex++) {
+            try {
+                results[index] = assembly(codes[index], &outBinaries[index]);
+            } catch (...) {
+                exceptions[index] = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads = {};
+    for (size_t threadIndex = 1; threadIndex < threadsCount; threadIndex++) {
+        threads.emplace_back([&]() {
+            stopSimulationOnFatalError = false;
+            assembleSources();
+        });
+    }
+    assembleSources();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    for (const std::exception_ptr &exception : exceptions) {
+        if (exception) {
+            if (stopSimulationOnFatalError) {
+                sc_stop();
+            }
+            std::rethrow_exception(exception);
+        }
+    }
+    return results;
+}
+
+} // namespace Isa
@@ -2,6 +2,13 @@
 
 #include "gpu/isa/assembler/pico_gpu_binary.h"
 
+#include <vector>
+
 namespace Isa {
+    // The scanner and the parser keep no global state, so multiple threads can assemble shaders at the same time
     int assembly(const char *code, PicoGpuBinary *outBinary);
+
+    // Assembles each source into the binary at the same index on up to threadsCount threads, including the calling one.
+    // A threadsCount of 0 selects one thread per hardware thread. Returns results of assembly() for all sources.
+    std::vector<int> assemblyBatch(const std::vector<const char *> &codes, std::vector<PicoGpuBinary> &outBinaries, size_t threadsCount = 0);
 }
@@ -0,0 +1,145 @@
+#include "gpu/isa/assembler/assembler.h"
+#include "gpu/isa/assembler/binary_cache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+
+namespace Isa {
+
+namespace {
+constexpr uint32_t entryMagic = 0x43424750; // "PGBC"
+
+uint64_t hashSource(const char *code) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    const auto hashBytes = [&hash](const void *bytes, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            hash = (hash ^ static_cast<const uint8_t *>(bytes)[i]) * 1099511628211ull;
+        }
+    };
+    hashBytes(&BinaryCache::assemblerVersion, sizeof(BinaryCache::assemblerVersion));
+    hashBytes(code, std::strlen(code));
+    return hash;
+}
+} // namespace
+
+BinaryCache::BinaryCache(const std::string &directory) : directory(directory) {
+    std::error_code errorCode = {};
+    std::filesystem::create_directories(directory, errorCode); // if it fails, every lookup is simply a miss
+}
+
+int BinaryCache::assembly(const char *code, PicoGpuBinary *outBinary) {
+    const std::string path = getEntryPath(code);
+    if (load(path, code, outBinary)) {
+        hitsCount++;
+        return 0;
+    }
+
+    missesCount++;
+    const int result = Isa::assembly(code, outBinary);
+    if (result == 0 && !outBinary->hasError()) {
+        store(path, code, *outBinary);
+    }
+    return result;
+}
+
+std::string BinaryCache::getEntryPath(const char *code) const {
+    char name[32] = {};
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(hashSource(code)));
+    return (std::filesystem::path(directory) / name).string();
+}
+
+bool BinaryCache::load(const std::string &path, const char *code, PicoGpuBinary *outBinary) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t sourceLength = 0;
+    file.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char *>(&version), sizeof(version));
+    file.read(reinterpret_cast<char *>(&sourceLength), sizeof(sourceLength));
+    if (!file || magic != entryMagic || version != assemblerVersion || sourceLength != std::strlen(code)) {
+        return false;
+    }
+
+    std::string source(sourceLength, '\0');
+    if (!file.read(source.data(), sourceLength) || source != code) {
+        return false;
+    }
+    return outBinary->deserialize(file);
+}
+
+void BinaryCache::store(const std::string &path, const char *code, const PicoGpuBinary &binary) {
+    // Other processes may be reading or writing the same entry, so it only appears under its final name once complete
+    const std::string temporaryPath = path + "." + std::to_string(std::random_device{}()) + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        const uint64_t sourceLength = std::strlen(code);
+        file.write(reinterpret_cast<const char *>(&entryMagic), sizeof(entryMagic));
+        file.write(reinterpret_cast<const char *>(&assemblerVersion), sizeof(assemblerVersion));
+        file.write(reinterpret_cast<const char *>(&sourceLength), sizeof(sourceLength));
+        file.write(code, sourceLength);
+        if (!binary.serialize(file) || !file.flush()) {
+            file.close();
+            std::error_code errorCode = {};
+            std::filesystem::remove(temporaryPath, errorCode);
+            return;
+        }
+    }
+
+    std::error_code errorCode = {};
+    std::filesystem::rename(temporaryPath, path, errorCode);
+    if (errorCode) {
+        std::filesystem::remove(temporaryPath, errorCode);
+    }
+}
+
+const PicoGpuBinary &SpecializationCache::get(const PicoGpuBinary &binary, const PicoGpuBinary::UniformValues &uniformValues) {
+    // Uniform registers and their sizes are stored in the command header, which is a part of the key
+    const std::vector<uint32_t> &data = binary.getData();
+    const Command::CommandStoreIsa &command = reinterpret_cast<const Command::CommandStoreIsa &>(data[0]);
+    const NonZeroCount uniformSizes[] = {command.uniformSize0, command.uniformSize1, command.uniformSize2};
+    std::vector<uint32_t> key = data;
+    for (uint32_t uniformIndex = 0; uniformIndex < command.uniformsCount; uniformIndex++) {
+        const uint32_t componentsCount = nonZeroCountToInt(uniformSizes[uniformIndex]);
+        for (uint32_t component = 0; component < componentsCount; component++) {
+            key.push_back(static_cast<uint32_t>(uniformValues[uniformIndex][component]));
+        }
+    }
+
+    std::lock_guard<std::mutex> lock{mutex};
+    std::unique_ptr<PicoGpuBinary> &entry = entries[std::move(key)];
+    if (entry != nullptr) {
+        hitsCount++;
+        return *entry;
+    }
+    missesCount++;
+    entry = std::make_unique<PicoGpuBinary>();
+    binary.specialize(uniformValues, *entry);
+    return *entry;
+}
+
+int assemblyCached(const char *code, PicoGpuBinary *outBinary) {
+    static const std::unique_ptr<BinaryCache> cache = []() -> std::unique_ptr<BinaryCache> {
+        const char *directory = std::getenv("PICOGPU_SHADER_CACHE");
+        if (directory == nullptr || directory[0] == '\0') {
+            return nullptr;
+        }
+        return std::make_unique<BinaryCache>(directory);
+    }();
+
+    if (cache == nullptr) {
+        return assembly(code, outBinary);
+    }
+    return cache->assembly(code, outBinary);
+}
+
+} // namespace Isa
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "gpu/isa/assembler/pico_gpu_binary.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Isa {
+
+// Keeps assembled binaries in a directory, so processes assembling the same shader source run the assembler only
+// once. Entries are named after a hash of the source and assemblerVersion. Each entry contains the source as well,
+// which is compared on load, so hash collisions are treated as misses. Entries are written to a temporary file and
+// then renamed, so multiple processes and threads can share the directory. Sources, which fail to assemble, are
+// never cached.
+class BinaryCache {
+public:
+    // Must be incremented whenever the encoding or the state saved by PicoGpuBinary::serialize() changes
+    constexpr static uint32_t assemblerVersion = 3;
+
+    explicit BinaryCache(const std::string &directory);
+
+    int assembly(const char *code, PicoGpuBinary *outBinary);
+    uint32_t getHitsCount() const { return hitsCount; }
+    uint32_t getMissesCount() const { return missesCount; }
+
+private:
+    std::string getEntryPath(const char *code) const;
+    bool load(const std::string &path, const char *code, PicoGpuBinary *outBinary);
+    void store(const std::string &path, const char *code, const PicoGpuBinary &binary);
+
+    const std::string directory;
+    std::atomic<uint32_t> hitsCount = 0;
+    std::atomic<uint32_t> missesCount = 0;
+};
+
+// Keeps variants of binaries created by PicoGpuBinary::specialize() in memory, so draws with the same uniform values
+// reuse them. Entries are keyed by the encoded program and the values of components used by its uniform directives.
+// Returned binaries stay valid as long as the cache exists. Can be used by multiple threads.
+class SpecializationCache {
+public:
+    const PicoGpuBinary &get(const PicoGpuBinary &binary, const PicoGpuBinary::UniformValues &uniformValues);
+    uint32_t getHitsCount() const { return hitsCount; }
+    uint32_t getMissesCount() const { return missesCount; }
+
+private:
+    std::mutex mutex = {};
+    std::map<std::vector<uint32_t>, std::unique_ptr<PicoGpuBinary>> entries = {};
+    std::atomic<uint32_t> hitsCount = 0;
+    std::atomic<uint32_t> missesCount = 0;
+};
+
+// Uses a cache in the directory pointed to by the PICOGPU_SHADER_CACHE environment variable. Falls back to assembly()
+// if the variable is not set.
+int assemblyCached(const char *code, PicoGpuBinary *outBinary);
+
+} // namespace Isa
@@ -0,0 +1,375 @@
+#include "gpu/isa/assembler/disassembler.h"
+#include "gpu/isa/assembler/pico_gpu_binary.h"
+#include "gpu/util/conversions.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+namespace Isa {
+
+namespace {
+std::string formatMask(uint32_t mask, bool omitFull) {
+    if (omitFull && mask == 0b1111) {
+        return "";
+    }
+    std::string result = ".";
+    for (uint32_t component = 0; component < registerComponentsCount; component++) {
+        if (mask & (1 << (3 - component))) {
+            result += "xyzw"[component];
+        }
+    }
+    return result;
+}
+
+std::string formatComponent(SwizzlePatternComponent component) {
+    return std::string(1, "xyzw"[static_cast<uint32_t>(component)]);
+}
+
+std::string formatRegister(RegisterIndex reg) {
+    return "r" + std::to_string(reg);
+}
+
+// The scanner accepts only plain decimal notation with a dot, so exponents are never used
+std::string formatFloat(uint32_t bits) {
+    const float value = Conversions::uintBytesToFloat(bits);
+    if (!std::isfinite(value)) {
+        return std::isnan(value) ? "nan" : (value < 0 ? "-inf" : "inf");
+    }
+
+    char buffer[256] = {};
+    for (int precision = 1; precision < 160; precision++) {
+        std::snprintf(buffer, sizeof(buffer), "%.*f", precision, value);
+        if (Conversions::floatBytesToUint(std::strtof(buffer, nullptr)) == bits) {
+            break;
+        }
+    }
+    return buffer;
+}
+
+// Immediates of init can be either floats or integers. Normal floats are far more likely to be written as finit,
+// while small integers have bit patterns of denormals.
+bool looksLikeFloats(const uint32_t *values, uint32_t count) {
+    for (uint32_t valueIndex = 0; valueIndex < count; valueIndex++) {
+        const float value = Conversions::uintBytesToFloat(values[valueIndex]);
+        if (value != 0 && !std::isnormal(value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isFloatOpcode(Opcode opcode) {
+    switch (opcode) {
+    case Opcode::fadd_imm:
+    case Opcode::fsub_imm:
+    case Opcode::fmul_imm:
+    case Opcode::fdiv_imm:
+        return true;
+    default:
+        return false;
+    }
+}
+
+std::string formatImmediates(const uint32_t *values, uint32_t count, bool asFloats) {
+    std::string result = {};
+    for (uint32_t valueIndex = 0; valueIndex < count; valueIndex++) {
+        result += " ";
+        result += asFloats ? formatFloat(values[valueIndex]) : std::to_string(static_cast<int32_t>(values[valueIndex]));
+    }
+    return result;
+}
+
+std::string getMnemonic(Opcode opcode) {
+    std::string name = getOpcodeName(opcode);
+    for (const char *suffix : {"_imm", "_uni"}) {
+        const size_t suffixPosition = name.rfind(suffix);
+        if (suffixPosition != std::string::npos && suffixPosition + std::strlen(suffix) == name.size()) {
+            name.resize(suffixPosition);
+        }
+    }
+    return name;
+}
+
+void disassembleDirectives(const Command::CommandStoreIsa &command, std::ostream &out) {
+    switch (command.programType) {
+    case Command::ProgramType::VertexShader:
+        out << "#vertexShader\n";
+        break;
+    case Command::ProgramType::FragmentShader:
+        out << "#fragmentShader\n";
+        break;
+    case Command::ProgramType::ComputeShader:
+        out << "#computeShader\n";
+        break;
+    default:
+        out << "// unknown program type " << static_cast<uint32_t>(command.programType) << "\n";
+        break;
+    }
+
+    const auto printIo = [&out](const char *label, uint32_t count, const RegisterIndex *registers, const NonZeroCount *sizes) {
+        for (uint32_t ioIndex = 0; ioIndex < count; ioIndex++) {
+            const uint32_t mask = (0b1111 << (4 - nonZeroCountToInt(sizes[ioIndex]))) & 0b1111;
+            out << label << " " << formatRegister(registers[ioIndex]) << formatMask(mask, false) << "\n";
+        }
+    };
+    const RegisterIndex inputRegisters[] = {command.inputRegister0, command.inputRegister1, command.inputRegister2};
+    const NonZeroCount inputSizes[] = {command.inputSize0, command.inputSize1, command.inputSize2};
+    const RegisterIndex outputRegisters[] = {command.outputRegister0, command.outputRegister1, command.outputRegister2};
+    const NonZeroCount outputSizes[] = {command.outputSize0, command.outputSize1, command.outputSize2};
+    const RegisterIndex uniformRegisters[] = {command.uniformRegister0, command.uniformRegister1, command.uniformRegister2};
+    const NonZeroCount uniformSizes[] = {command.uniformSize0, command.uniformSize1, command.uniformSize2};
+    const bool isCs = command.programType == Command::ProgramType::ComputeShader; // has no outputs, fields are zeroed
+    printIo("#input", nonZeroCountToInt(command.inputsCount), inputRegisters, inputSizes);
+    printIo("#output", isCs ? 0 : nonZeroCountToInt(command.outputsCount), outputRegisters, outputSizes);
+    printIo("#uniform", command.uniformsCount, uniformRegisters, uniformSizes);
+    if (command.hasUniformMatrix) {
+        out << "#uniformMatrix\n";
+    }
+}
+
+std::string disassembleInstruction(const Instruction &inst, const uint32_t *immediates, uint32_t immediatesCount) {
+    const Opcode opcode = inst.header.opcode;
+    std::string result = getMnemonic(opcode);
+    switch (opcode) {
+    case Opcode::init: {
+        const bool asFloats = looksLikeFloats(immediates, immediatesCount);
+        result = asFloats ? "finit" : "iinit";
+        result += " " + formatRegister(inst.unaryMathImm.dest) + formatMask(inst.unaryMathImm.destMask, true);
+        result += formatImmediates(immediates, immediatesCount, asFloats);
+        break;
+    }
+    case Opcode::fadd_imm:
+    case Opcode::fsub_imm:
+    case Opcode::fmul_imm:
+    case Opcode::fdiv_imm:
+    case Opcode::iadd_imm:
+    case Opcode::isub_imm:
+    case Opcode::imul_imm:
+    case Opcode::idiv_imm:
+        result += " " + formatRegister(inst.binaryMathImm.dest) + formatMask(inst.binaryMathImm.destMask, true);
+        result += " " + formatRegister(inst.binaryMathImm.src);
+        result += formatImmediates(immediates, immediatesCount, isFloatOpcode(opcode));
+        break;
+    case Opcode::fcross:
+        result += " " + formatRegister(inst.binaryMath.dest) + " " + formatRegister(inst.binaryMath.src1) + " " + formatRegister(inst.binaryMath.src2);
+        break;
+    case Opcode::fmatmul_uni:
+        result += " " + formatRegister(inst.unaryMath.dest) + formatMask(inst.unaryMath.destMask, true) + " umat " + formatRegister(inst.unaryMath.src);
+        break;
+    case Opcode::st:
+        result += " " + formatRegister(inst.binaryMath.src1) + " " + formatRegister(inst.binaryMath.src2) + formatMask(inst.binaryMath.destMask, true);
+        break;
+    case Opcode::swizzle:
+        result += " " + formatRegister(inst.swizzle.dest) + " " + formatRegister(inst.swizzle.src) + "." +
+                  formatComponent(inst.swizzle.patternX) + formatComponent(inst.swizzle.patternY) +
+                  formatComponent(inst.swizzle.patternZ) + formatComponent(inst.swizzle.patternW);
+        break;
+    case Opcode::if_:
+    case Opcode::break_:
+        result += " " + formatRegister(inst.condition.src) + "." + formatComponent(inst.condition.component);
+        break;
+    default: {
+        // Remaining instructions take a masked destination followed by source registers
+        const PicoGpuBinary::InstructionOperands operands = PicoGpuBinary::getInstructionOperands(inst);
+        if (operands.writtenComponents != 0) {
+            const uint32_t destMask = (opcode == Opcode::fnorm) ? inst.unaryMath.destMask : operands.writtenComponents;
+            result += " " + formatRegister(operands.dest) + formatMask(destMask, true);
+        }
+        const uint32_t printedSources = opcode == Opcode::fmatmul ? 1 : operands.sourcesCount; // matrix is given by its first row
+        for (uint32_t sourceIndex = 0; sourceIndex < printedSources; sourceIndex++) {
+            result += " " + formatRegister(operands.sources[sourceIndex]);
+        }
+        if (opcode == Opcode::fmatmul) {
+            result += " " + formatRegister(operands.sources[matrixRowsCount]);
+        }
+        break;
+    }
+    }
+    return result;
+}
+} // namespace
+
+const char *getOpcodeName(Opcode opcode) {
+    switch (opcode) {
+    case Opcode::fadd:
+        return "fadd";
+    case Opcode::fadd_imm:
+        return "fadd_imm";
+    case Opcode::fsub:
+        return "fsub";
+    case Opcode::fsub_imm:
+        return "fsub_imm";
+    case Opcode::fmul:
+        return "fmul";
+    case Opcode::fmul_imm:
+        return "fmul_imm";
+    case Opcode::fdiv:
+        return "fdiv";
+    case Opcode::fdiv_imm:
+        return "fdiv_imm";
+    case Opcode::fneg:
+        return "fneg";
+    case Opcode::fdot:
+        return "fdot";
+    case Opcode::fcross:
+        return "fcross";
+    case Opcode::fcross2:
+        return "fcross2";
+    case Opcode::fmad:
+        return "fmad";
+    case Opcode::frcp:
+        return "frcp";
+    case Opcode::fnorm:
+        return "fnorm";
+    case Opcode::fmax:
+        return "fmax";
+    case Opcode::fmin:
+        return "fmin";
+    case Opcode::fcmpeq:
+        return "fcmpeq";
+    case Opcode::fcmpne:
+        return "fcmpne";
+    case Opcode::fcmplt:
+        return "fcmplt";
+    case Opcode::fcmple:
+        return "fcmple";
+    case Opcode::fmatmul:
+        return "fmatmul";
+    case Opcode::fmatmul_uni:
+        return "fmatmul_uni";
+    case Opcode::fsqrt:
+        return "fsqrt";
+    case Opcode::frsq:
+        return "frsq";
+    case Opcode::fexp2:
+        return "fexp2";
+    case Opcode::flog2:
+        return "flog2";
+    case Opcode::fsin:
+        return "fsin";
+    case Opcode::fcos:
+        return "fcos";
+    case Opcode::fpow:
+        return "fpow";
+    case Opcode::f2unorm8:
+        return "f2unorm8";
+    case Opcode::iadd:
+        return "iadd";
+    case Opcode::iadd_imm:
+        return "iadd_imm";
+    case Opcode::isub:
+        return "isub";
+    case Opcode::isub_imm:
+        return "isub_imm";
+    case Opcode::imul:
+        return "imul";
+    case Opcode::imul_imm:
+        return "imul_imm";
+    case Opcode::idiv:
+        return "idiv";
+    case Opcode::idiv_imm:
+        return "idiv_imm";
+    case Opcode::ineg:
+        return "ineg";
+    case Opcode::imax:
+        return "imax";
+    case Opcode::imin:
+        return "imin";
+    case Opcode::icmpeq:
+        return "icmpeq";
+    case Opcode::icmpne:
+        return "icmpne";
+    case Opcode::icmplt:
+        return "icmplt";
+    case Opcode::icmple:
+        return "icmple";
+    case Opcode::iand:
+        return "iand";
+    case Opcode::ior:
+        return "ior";
+    case Opcode::ixor:
+        return "ixor";
+    case Opcode::ishl:
+        return "ishl";
+    case Opcode::ishr:
+        return "ishr";
+    case Opcode::sample:
+        return "sample";
+    case Opcode::ld:
+        return "ld";
+    case Opcode::st:
+        return "st";
+    case Opcode::if_:
+        return "if";
+    case Opcode::else_:
+        return "else";
+    case Opcode::endif:
+        return "endif";
+    case Opcode::loop:
+        return "loop";
+    case Opcode::endloop:
+        return "endloop";
+    case Opcode::break_:
+        return "break";
+    case Opcode::init:
+        return "init";
+    case Opcode::swizzle:
+        return "swizzle";
+    case Opcode::mov:
+        return "mov";
+    case Opcode::trap:
+        return "trap";
+    case Opcode::lduni:
+        return "lduni";
+    case Opcode::initregs:
+        return "initregs";
+    default:
+        return "unknown";
+    }
+}
+
+std::string disassembly(const uint32_t *data, size_t sizeInDwords) {
+    std::ostringstream out = {};
+    const size_t headerSize = sizeof(Command::CommandStoreIsa) / sizeof(uint32_t);
+    if (sizeInDwords < headerSize) {
+        out << "// missing command header\n";
+        return out.str();
+    }
+    disassembleDirectives(*reinterpret_cast<const Command::CommandStoreIsa *>(data), out);
+
+    uint32_t depth = 0;
+    for (size_t dwordIndex = headerSize; dwordIndex < sizeInDwords;) {
+        const Instruction &inst = *reinterpret_cast<const Instruction *>(data + dwordIndex);
+        if (static_cast<uint32_t>(inst.header.opcode) >= static_cast<uint32_t>(Opcode::COUNT)) {
+            out << "// unknown opcode " << static_cast<uint32_t>(inst.header.opcode) << "\n";
+            break;
+        }
+        const PicoGpuBinary::InstructionOperands operands = PicoGpuBinary::getInstructionOperands(inst);
+        if (dwordIndex + operands.sizeInDwords > sizeInDwords) {
+            out << "// truncated instruction\n";
+            break;
+        }
+
+        const Opcode opcode = inst.header.opcode;
+        if (depth > 0 && (opcode == Opcode::else_ || opcode == Opcode::endif || opcode == Opcode::endloop)) {
+            depth--;
+        }
+        const std::string text = std::string(depth * 4, ' ') + disassembleInstruction(inst, data + dwordIndex + 1, operands.sizeInDwords - 1);
+        out << text;
+        if (inst.header.uniform) {
+            out << std::string(text.size() < 40 ? 40 - text.size() : 1, ' ') << "// uniform";
+        }
+        out << "\n";
+        if (opcode == Opcode::if_ || opcode == Opcode::else_ || opcode == Opcode::loop) {
+            depth++;
+        }
+
+        dwordIndex += operands.sizeInDwords;
+    }
+    return out.str();
+}
+
+} // namespace Isa
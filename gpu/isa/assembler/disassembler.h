@@ -0,0 +1,17 @@
+#pragma once
+
+#include "gpu/isa/isa.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Isa {
+const char *getOpcodeName(Opcode opcode);
+
+// Converts a binary produced by PicoGpuBinary back to assembly. Data must start with the CommandStoreIsa header, from
+// which the shader type and the input, output and uniform directives are recreated. Instructions inserted by the
+// assembler, such as the fragment shader prologue, lduni and initregs, are printed as well, so the output shows exactly
+// what shader units execute. Uniform instructions are marked with a comment.
+std::string disassembly(const uint32_t *data, size_t sizeInDwords);
+} // namespace Isa
@@ -0,0 +1,753 @@
+#include "gpu/isa/assembler/optimizer.h"
+#include "gpu/isa/assembler/pico_gpu_binary.h"
+#include "gpu/util/conversions.h"
+#include "gpu/util/math.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace Isa {
+
+namespace {
+using InstructionOperands = PicoGpuBinary::InstructionOperands;
+
+uint32_t componentBit(uint32_t component) { return 1u << (3 - component); }
+
+bool isControlFlow(Opcode opcode) {
+    switch (opcode) {
+    case Opcode::if_:
+    case Opcode::else_:
+    case Opcode::endif:
+    case Opcode::loop:
+    case Opcode::endloop:
+    case Opcode::break_:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Components read from each source. Operations on whole vectors are assumed to read all components.
+uint32_t getReadComponents(const Instruction &inst, const InstructionOperands &operands) {
+    if (PicoGpuBinary::isComponentWise(inst.header.opcode)) {
+        return operands.writtenComponents;
+    }
+
+    switch (inst.header.opcode) {
+    case Opcode::swizzle:
+        return componentBit(static_cast<uint32_t>(inst.swizzle.patternX)) |
+               componentBit(static_cast<uint32_t>(inst.swizzle.patternY)) |
+               componentBit(static_cast<uint32_t>(inst.swizzle.patternZ)) |
+               componentBit(static_cast<uint32_t>(inst.swizzle.patternW));
+    case Opcode::if_:
+    case Opcode::break_:
+        return componentBit(static_cast<uint32_t>(inst.condition.component));
+    default:
+        return 0b1111;
+    }
+}
+
+// Register forms of operations, which have an immediate form taking the second operand as immediate values
+bool getImmediateOpcode(Opcode opcode, Opcode *outImmediateOpcode) {
+    switch (opcode) {
+    case Opcode::fadd:
+        *outImmediateOpcode = Opcode::fadd_imm;
+        return true;
+    case Opcode::fsub:
+        *outImmediateOpcode = Opcode::fsub_imm;
+        return true;
+    case Opcode::fmul:
+        *outImmediateOpcode = Opcode::fmul_imm;
+        return true;
+    case Opcode::fdiv:
+        *outImmediateOpcode = Opcode::fdiv_imm;
+        return true;
+    case Opcode::iadd:
+        *outImmediateOpcode = Opcode::iadd_imm;
+        return true;
+    case Opcode::isub:
+        *outImmediateOpcode = Opcode::isub_imm;
+        return true;
+    case Opcode::imul:
+        *outImmediateOpcode = Opcode::imul_imm;
+        return true;
+    case Opcode::idiv:
+        *outImmediateOpcode = Opcode::idiv_imm;
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool isCommutative(Opcode opcode) {
+    return opcode == Opcode::fadd || opcode == Opcode::fmul || opcode == Opcode::iadd || opcode == Opcode::imul;
+}
+
+// Immediate values are assigned to subsequent components from the mask and the last one is repeated, the same
+// as in the ShaderUnit.
+int32_t getImmediateValue(const uint32_t *immediateValues, NonZeroCount immediateValuesCount, uint32_t destMask, uint32_t component) {
+    const uint32_t precedingComponentsMask = ~((componentBit(component) << 1) - 1) & 0b1111;
+    const uint32_t index = std::min<uint32_t>(countBits(destMask & precedingComponentsMask), nonZeroCountToInt(immediateValuesCount) - 1);
+    return static_cast<int32_t>(immediateValues[index]);
+}
+
+// Computes a single component of a result the same way as the ShaderUnit. Returns false for operations, which are
+// not evaluated during assembly.
+bool evaluate(Opcode opcode, int32_t src1, int32_t src2, int32_t *outResult) {
+    const float f1 = Conversions::intBytesToFloat(src1);
+    const float f2 = Conversions::intBytesToFloat(src2);
+    const uint32_t u1 = static_cast<uint32_t>(src1);
+    const uint32_t u2 = static_cast<uint32_t>(src2);
+    const auto fromFloat = [](float value) { return Conversions::floatBytesToInt(value); };
+    const auto fromBool = [](bool value) { return value ? ~0 : 0; };
+
+    switch (opcode) {
+    case Opcode::fadd:
+    case Opcode::fadd_imm:
+        *outResult = fromFloat(f1 + f2);
+        return true;
+    case Opcode::fsub:
+    case Opcode::fsub_imm:
+        *outResult = fromFloat(f1 - f2);
+        return true;
+    case Opcode::fmul:
+    case Opcode::fmul_imm:
+        *outResult = fromFloat(f1 * f2);
+        return true;
+    case Opcode::fdiv:
+    case Opcode::fdiv_imm:
+        *outResult = fromFloat(f1 / f2);
+        return true;
+    case Opcode::fneg:
+        *outResult = fromFloat(-f1);
+        return true;
+    case Opcode::fmax:
+        *outResult = fromFloat(std::max(f1, f2));
+        return true;
+    case Opcode::fmin:
+        *outResult = fromFloat(std::min(f1, f2));
+        return true;
+    case Opcode::fcmpeq:
+        *outResult = fromBool(f1 == f2);
+        return true;
+    case Opcode::fcmpne:
+        *outResult = fromBool(f1 != f2);
+        return true;
+    case Opcode::fcmplt:
+        *outResult = fromBool(f1 < f2);
+        return true;
+    case Opcode::fcmple:
+        *outResult = fromBool(f1 <= f2);
+        return true;
+    case Opcode::iadd:
+    case Opcode::iadd_imm:
+        *outResult = static_cast<int32_t>(u1 + u2);
+        return true;
+    case Opcode::isub:
+    case Opcode::isub_imm:
+        *outResult = static_cast<int32_t>(u1 - u2);
+        return true;
+    case Opcode::imul:
+    case Opcode::imul_imm:
+        *outResult = static_cast<int32_t>(u1 * u2);
+        return true;
+    case Opcode::idiv:
+    case Opcode::idiv_imm:
+        if (src1 == std::numeric_limits<int32_t>::min() && src2 == -1) {
+            return false; // overflows, so leave it to the hardware
+        }
+        *outResult = src2 != 0 ? src1 / src2 : 0;
+        return true;
+    case Opcode::ineg:
+        *outResult = static_cast<int32_t>(0u - u1);
+        return true;
+    case Opcode::imax:
+        *outResult = std::max(src1, src2);
+        return true;
+    case Opcode::imin:
+        *outResult = std::min(src1, src2);
+        return true;
+    case Opcode::icmpeq:
+        *outResult = fromBool(src1 == src2);
+        return true;
+    case Opcode::icmpne:
+        *outResult = fromBool(src1 != src2);
+        return true;
+    case Opcode::icmplt:
+        *outResult = fromBool(src1 < src2);
+        return true;
+    case Opcode::icmple:
+        *outResult = fromBool(src1 <= src2);
+        return true;
+    case Opcode::iand:
+        *outResult = src1 & src2;
+        return true;
+    case Opcode::ior:
+        *outResult = src1 | src2;
+        return true;
+    case Opcode::ixor:
+        *outResult = src1 ^ src2;
+        return true;
+    case Opcode::ishl:
+        *outResult = static_cast<int32_t>(u1 << (u2 & 31));
+        return true;
+    case Opcode::ishr:
+        *outResult = static_cast<int32_t>(u1 >> (u2 & 31));
+        return true;
+    case Opcode::mov:
+        *outResult = src1;
+        return true;
+    default:
+        // Transcendental functions are left to the hardware, because their precision is implementation defined
+        // and fmad is not folded, because the compiler could contract it differently than in the ShaderUnit.
+        return false;
+    }
+}
+} // namespace
+
+Optimizer::Optimizer(const uint32_t *program, size_t sizeInDwords, const ProgramInterface &programInterface)
+    : programInterface(programInterface) {
+    for (size_t dwordIndex = 0; dwordIndex < sizeInDwords;) {
+        const InstructionOperands operands = PicoGpuBinary::getInstructionOperands(reinterpret_cast<const Instruction &>(program[dwordIndex]));
+        FATAL_ERROR_IF(dwordIndex + operands.sizeInDwords > sizeInDwords, "Truncated instruction");
+
+        ProgramInstruction instruction = {};
+        std::copy_n(program + dwordIndex, operands.sizeInDwords, instruction.dwords);
+        instructions.push_back(instruction);
+        dwordIndex += operands.sizeInDwords;
+    }
+}
+
+void Optimizer::optimize() {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        changed |= propagateCopies();
+        changed |= foldConstants();
+        changed |= fuseMultiplyAdd();
+        changed |= eliminateDeadCode();
+    }
+}
+
+std::vector<uint32_t> Optimizer::getProgram() {
+    std::vector<uint32_t> program = {};
+    for (ProgramInstruction &instruction : instructions) {
+        const InstructionOperands operands = PicoGpuBinary::getInstructionOperands(instruction.get());
+        program.insert(program.end(), instruction.dwords, instruction.dwords + operands.sizeInDwords);
+    }
+    return program;
+}
+
+bool Optimizer::propagateCopies() {
+    // For each component of each register we remember, which component of another register holds the same value.
+    // Any write to either of them ends the relation.
+    struct CopySource {
+        bool valid;
+        RegisterIndex reg;
+        uint32_t component;
+    };
+    CopySource copies[generalPurposeRegistersCount][registerComponentsCount] = {};
+    const auto forgetAll = [&copies]() { std::fill_n(&copies[0][0], generalPurposeRegistersCount * registerComponentsCount, CopySource{}); };
+
+    // Returns a register holding copies of all given components in the same positions
+    const auto findCopiedRegister = [&copies](RegisterIndex reg, uint32_t components, RegisterIndex *outCopiedReg) {
+        bool found = false;
+        for (uint32_t component = 0; component < registerComponentsCount; component++) {
+            if (!(components & componentBit(component))) {
+                continue;
+            }
+            const CopySource &copy = copies[reg][component];
+            if (!copy.valid || copy.component != component || (found && copy.reg != *outCopiedReg)) {
+                return false;
+            }
+            *outCopiedReg = copy.reg;
+            found = true;
+        }
+        return found;
+    };
+
+    bool changed = false;
+    for (ProgramInstruction &instruction : instructions) {
+        Instruction &inst = instruction.get();
+        InstructionOperands operands = PicoGpuBinary::getInstructionOperands(inst);
+
+        // Read the original values instead of the copies
+        switch (inst.header.opcode) {
+        case Opcode::swizzle: {
+            const uint32_t pattern[registerComponentsCount] = {
+                static_cast<uint32_t>(inst.swizzle.patternX),
+                static_cast<uint32_t>(inst.swizzle.patternY),
+                static_cast<uint32_t>(inst.swizzle.patternZ),
+                static_cast<uint32_t>(inst.swizzle.patternW),
+            };
+            // Components of the destination are written one by one and can be read by the following ones, so
+            // we don't change swizzles, which read their destination
+            const CopySource(&sourceCopies)[registerComponentsCount] = copies[inst.swizzle.src];
+            const RegisterIndex copiedReg = sourceCopies[pattern[0]].reg;
+            bool canReadOriginal = inst.swizzle.src != inst.swizzle.dest && copiedReg != inst.swizzle.dest;
+            for (uint32_t component = 0; component < registerComponentsCount; component++) {
+                canReadOriginal &= sourceCopies[pattern[component]].valid && sourceCopies[pattern[component]].reg == copiedReg;
+            }
+            if (canReadOriginal) {
+                inst.swizzle.patternX = static_cast<SwizzlePatternComponent>(sourceCopies[pattern[0]].component);
+                inst.swizzle.patternY = static_cast<SwizzlePatternComponent>(sourceCopies[pattern[1]].component);
+                inst.swizzle.patternZ = static_cast<SwizzlePatternComponent>(sourceCopies[pattern[2]].component);
+                inst.swizzle.patternW = static_cast<SwizzlePatternComponent>(sourceCopies[pattern[3]].component);
+                inst.swizzle.src = copiedReg;
+                changed = true;
+            }
+            break;
+        }
+        case Opcode::if_:
+        case Opcode::break_: {
+            const CopySource &copy = copies[inst.condition.src][static_cast<uint32_t>(inst.condition.component)];
+            if (copy.valid) {
+                inst.condition.src = copy.reg;
+                inst.condition.component = static_cast<SwizzlePatternComponent>(copy.component);
+                changed = true;
+            }
+            break;
+        }
+        case Opcode::fmatmul:
+            break;
+        default: {
+            const uint32_t readComponents = getReadComponents(inst, operands);
+            for (uint32_t sourceIndex = 0; sourceIndex < operands.sourcesCount; sourceIndex++) {
+                RegisterIndex copiedReg = {};
+                if (findCopiedRegister(operands.sources[sourceIndex], readComponents, &copiedReg)) {
+                    operands.sources[sourceIndex] = copiedReg;
+                    PicoGpuBinary::setInstructionRegisters(inst, operands);
+                    changed = true;
+                }
+            }
+            break;
+        }
+        }
+        operands = PicoGpuBinary::getInstructionOperands(inst);
+
+        // Registers written outside of regular instructions are not tracked
+        if (isControlFlow(inst.header.opcode) || inst.header.opcode == Opcode::lduni || inst.header.opcode == Opcode::initregs) {
+            forgetAll();
+            continue;
+        }
+        if (operands.writtenComponents == 0) {
+            continue;
+        }
+
+        // Remember which components the destination is a copy of
+        CopySource newCopies[registerComponentsCount] = {};
+        bool copiesItself = false;
+        if (inst.header.opcode == Opcode::mov) {
+            for (uint32_t component = 0; component < registerComponentsCount; component++) {
+                newCopies[component] = {true, inst.unaryMath.src, component};
+            }
+            copiesItself = inst.unaryMath.src == inst.unaryMath.dest;
+        }
+        if (inst.header.opcode == Opcode::swizzle) {
+            newCopies[0] = {true, inst.swizzle.src, static_cast<uint32_t>(inst.swizzle.patternX)};
+            newCopies[1] = {true, inst.swizzle.src, static_cast<uint32_t>(inst.swizzle.patternY)};
+            newCopies[2] = {true, inst.swizzle.src, static_cast<uint32_t>(inst.swizzle.patternZ)};
+            newCopies[3] = {true, inst.swizzle.src, static_cast<uint32_t>(inst.swizzle.patternW)};
+            copiesItself = inst.swizzle.src == inst.swizzle.dest;
+        }
+
+        // Remove copies, which would not change the destination
+        bool isRedundant = newCopies[0].valid;
+        for (uint32_t component = 0; component < registerComponentsCount; component++) {
+            if (operands.writtenComponents & componentBit(component)) {
+                const CopySource &oldCopy = copies[operands.dest][component];
+                const CopySource &newCopy = newCopies[component];
+                const bool sameComponent = copiesItself && newCopy.component == component;
+                const bool alreadyCopied = oldCopy.valid && oldCopy.reg == newCopy.reg && oldCopy.component == newCopy.component;
+                isRedundant &= sameComponent || alreadyCopied;
+            }
+        }
+        if (isRedundant) {
+            instruction.removed = true;
+            changed = true;
+            continue;
+        }
+        if (copiesItself) {
+            std::fill_n(newCopies, registerComponentsCount, CopySource{});
+        }
+
+        // Update the copies
+        for (RegisterIndex reg = 0; reg < generalPurposeRegistersCount; reg++) {
+            for (uint32_t component = 0; component < registerComponentsCount; component++) {
+                CopySource &copy = copies[reg][component];
+                if (copy.valid && copy.reg == operands.dest && (operands.writtenComponents & componentBit(copy.component))) {
+                    copy = {};
+                }
+            }
+        }
+        for (uint32_t component = 0; component < registerComponentsCount; component++) {
+            if (operands.writtenComponents & componentBit(component)) {
+                copies[operands.dest][component] = newCopies[component];
+            }
+        }
+    }
+
+    return removeMarkedInstructions() || changed;
+}
+
+bool Optimizer::foldConstants() {
+    struct KnownValue {
+        bool valid;
+        int32_t value;
+    };
+    KnownValue constants[generalPurposeRegistersCount][registerComponentsCount] = {};
+
+    // A value written outside of control flow by the last instruction writing the component stays there until the
+    // program ends, so it is still known after control flow instructions
+    KnownValue invariants[generalPurposeRegistersCount][registerComponentsCount] = {};
+    size_t lastWriteIndices[generalPurposeRegistersCount][registerComponentsCount] = {};
+    for (size_t instructionIndex = 0; instructionIndex < instructions.size(); instructionIndex++) {
+        Instruction &inst = instructions[instructionIndex].get();
+        const InstructionOperands operands = PicoGpuBinary::getInstructionOperands(inst);
+        for (RegisterIndex reg = 0; reg < generalPurposeRegistersCount; reg++) {
+            uint32_t writtenComponents = reg == operands.dest ? operands.writtenComponents : 0;
+            if ((inst.header.opcode == Opcode::lduni && isBitSet(programInterface.uniformRegsMask, reg)) ||
+                (inst.header.opcode == Opcode::initregs && isBitSet(programInterface.zeroedRegsMask, reg))) {
+                writtenComponents = 0b1111;
+            }
+            for (uint32_t component = 0; component < registerComponentsCount; component++) {
+                if (writtenComponents & componentBit(component)) {
+                    lastWriteIndices[reg][component] = instructionIndex;
+                }
+            }
+        }
+    }
+    uint32_t controlFlowDepth = 0;
+    const auto setKnownValue = [&](size_t instructionIndex, RegisterIndex reg, uint32_t component, KnownValue value) {
+        constants[reg][component] = value;
+        if (controlFlowDepth == 0 && lastWriteIndices[reg][component] == instructionIndex) {
+            invariants[reg][component] = value;
+        }
+    };
+    const auto setRegister = [&](size_t instructionIndex, RegisterIndex reg, KnownValue value) {
+        for (uint32_t component = 0; component < registerComponentsCount; component++) {
+            setKnownValue(instructionIndex, reg, component, value);
+        }
+    };
+
+    bool changed = false;
+    for (size_t instructionIndex = 0; instructionIndex < instructions.size(); instructionIndex++) {
+        ProgramInstruction &instruction = instructions[instructionIndex];
+        if (instruction.removed) {
+            continue; // part of a branch, which is never taken
+        }
+        Instruction &inst = instruction.get();
+        const InstructionOperands operands = PicoGpuBinary::getInstructionOperands(inst);
+
+        switch (inst.header.opcode) {
+        case Opcode::lduni:
+            for (RegisterIndex reg = 0; reg < generalPurposeRegistersCount; reg++) {
+                if (isBitSet(programInterface.uniformRegsMask, reg)) {
+                    setRegister(instructionIndex, reg, {});
+                }
+            }
+            continue;
+        case Opcode::initregs:
+            for (RegisterIndex reg = 0; reg < generalPurposeRegistersCount; reg++) {
+                if (isBitSet(programInterface.zeroedRegsMask, reg)) {
+                    setRegister(instructionIndex, reg, {true, 0});
+                }
+            }
+            continue;
+        case Opcode::if_:
+        case Opcode::break_: {
+            // Threads take the branch if the component is not zero. A break, which is never taken, can be removed,
+            // but a break always taken still has to end the loop.
+            const KnownValue &condition = constants[inst.condition.src][static_cast<uint32_t>(inst.condition.component)];
+            if (condition.valid && inst.header.opcode == Opcode::if_) {
+                removeUntakenBranch(instructionIndex, condition.value != 0);
+                changed = true;
+                continue;
+            }
+            if (condition.valid && condition.value == 0) {
+                instruction.removed = true;
+                changed = true;
+                continue;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        if (isControlFlow(inst.header.opcode)) {
+            controlFlowDepth += inst.header.opcode == Opcode::if_ || inst.header.opcode == Opcode::loop;
+            controlFlowDepth -= inst.header.opcode == Opcode::endif || inst.header.opcode == Opcode::endloop;
+            std::copy_n(&invariants[0][0], generalPurposeRegistersCount * registerComponentsCount, &constants[0][0]);
+            continue;
+        }
+        if (operands.writtenComponents == 0) {
+            continue;
+        }
+
+        // Compute the result if all read components are known
+        int32_t results[registerComponentsCount] = {};
+        bool resultsKnown = false;
+        if (inst.header.opcode == Opcode::init) {
+            for (uint32_t component = 0; component < registerComponentsCount; component++) {
+                results[component] = getImmediateValue(inst.unaryMathImm.immediateValues, inst.unaryMathImm.immediateValuesCount, inst.unaryMathImm.destMask, component);
+            }
+            resultsKnown = true;
+        } else if (PicoGpuBinary::isComponentWise(inst.header.opcode) && operands.sourcesCount <= 2) {
+            resultsKnown = true;
+            for (uint32_t component = 0; component < registerComponentsCount && resultsKnown; component++) {
+                if (!(operands.writtenComponents & componentBit(component))) {
+                    continue;
+                }
+
+                int32_t arguments[2] = {};
+                for (uint32_t sourceIndex = 0; sourceIndex < operands.sourcesCount && resultsKnown; sourceIndex++) {
+                    const KnownValue &value = constants[operands.sources[sourceIndex]][component];
+                    resultsKnown = value.valid;
+                    arguments[sourceIndex] = value.value;
+                }
+                if (operands.sizeInDwords > 1) {
+                    arguments[1] = getImmediateValue(inst.binaryMathImm.immediateValues, inst.binaryMathImm.immediateValuesCount, inst.binaryMathImm.destMask, component);
+                }
+                resultsKnown = resultsKnown && evaluate(inst.header.opcode, arguments[0], arguments[1], &results[component]);
+            }
+
+            // Replace the operation with its result
+            if (resultsKnown) {
+                std::vector<int32_t> immediateValues = {};
+                for (uint32_t component = 0; component < registerComponentsCount; component++) {
+                    if (operands.writtenComponents & componentBit(component)) {
+                        immediateValues.push_back(results[component]);
+                    }
+                }
+                const uint32_t immediateValuesCount = PicoGpuBinary::getUsedImmediateValuesCount(operands.writtenComponents, immediateValues);
+
+                instruction = {};
+                InstructionLayouts::UnaryMathImm &initInst = instruction.get().unaryMathImm;
+                initInst.opcode = Opcode::init;
+                initInst.dest = operands.dest;
+                initInst.destMask = operands.writtenComponents;
+                initInst.immediateValuesCount = intToNonZeroCount(immediateValuesCount);
+                for (uint32_t i = 0; i < immediateValuesCount; i++) {
+                    initInst.immediateValues[i] = static_cast<uint32_t>(immediateValues[i]);
+                }
+                changed = true;
+            }
+        }
+
+        // Pass a known operand as immediate values, so its register doesn't have to be initialized
+        Opcode immediateOpcode = {};
+        if (!resultsKnown && getImmediateOpcode(inst.header.opcode, &immediateOpcode)) {
+            const InstructionLayouts::BinaryMath math = inst.binaryMath;
+            const uint32_t candidatesCount = isCommutative(math.opcode) ? 2 : 1;
+            for (uint32_t candidateIndex = 0; candidateIndex < candidatesCount; candidateIndex++) {
+                const RegisterIndex knownReg = candidateIndex == 0 ? math.src2 : math.src1;
+                const RegisterIndex otherReg = candidateIndex == 0 ? math.src1 : math.src2;
+                std::vector<int32_t> immediateValues = {};
+                for (uint32_t component = 0; component < registerComponentsCount; component++) {
+                    if ((math.destMask & componentBit(component)) && constants[knownReg][component].valid) {
+                        immediateValues.push_back(constants[knownReg][component].value);
+                    }
+                }
+                if (immediateValues.size() != countBits(math.destMask)) {
+                    continue;
+                }
+                const uint32_t immediateValuesCount = PicoGpuBinary::getUsedImmediateValuesCount(math.destMask, immediateValues);
+
+                instruction = {};
+                InstructionLayouts::BinaryMathImm &immInst = instruction.get().binaryMathImm;
+                immInst.opcode = immediateOpcode;
+                immInst.dest = math.dest;
+                immInst.src = otherReg;
+                immInst.destMask = math.destMask;
+                immInst.immediateValuesCount = intToNonZeroCount(immediateValuesCount);
+                for (uint32_t i = 0; i < immediateValuesCount; i++) {
+                    immInst.immediateValues[i] = static_cast<uint32_t>(immediateValues[i]);
+                }
+                changed = true;
+                break;
+            }
+        }
+
+        for (uint32_t component = 0; component < registerComponentsCount; component++) {
+            if (operands.writtenComponents & componentBit(component)) {
+                setKnownValue(instructionIndex, operands.dest, component, {resultsKnown, results[component]});
+            }
+        }
+    }
+    return removeMarkedInstructions() || changed;
+}
+
+void Optimizer::removeUntakenBranch(size_t ifIndex, bool conditionValue) {
+    // Find else and endif of this if
+    size_t elseIndex = 0;
+    size_t endifIndex = 0;
+    for (size_t instructionIndex = ifIndex + 1, nesting = 1; endifIndex == 0; instructionIndex++) {
+        FATAL_ERROR_IF(instructionIndex == instructions.size(), "if without matching endif");
+        const Opcode opcode = instructions[instructionIndex].get().header.opcode;
+        nesting += opcode == Opcode::if_ || opcode == Opcode::loop;
+        nesting -= opcode == Opcode::endif || opcode == Opcode::endloop;
+        if (nesting == 1 && opcode == Opcode::else_) {
+            elseIndex = instructionIndex;
+        }
+        if (nesting == 0) {
+            endifIndex = instructionIndex;
+        }
+    }
+
+    // Keep the body of the taken branch without the surrounding control flow instructions
+    const size_t secondBranchIndex = elseIndex != 0 ? elseIndex : endifIndex;
+    const size_t removedBegin = conditionValue ? secondBranchIndex : ifIndex;
+    const size_t removedEnd = conditionValue ? endifIndex : secondBranchIndex;
+    for (size_t instructionIndex = removedBegin; instructionIndex <= removedEnd; instructionIndex++) {
+        instructions[instructionIndex].removed = true;
+    }
+    instructions[ifIndex].removed = true;
+    instructions[endifIndex].removed = true;
+}
+
+bool Optimizer::fuseMultiplyAdd() {
+    // For each register we remember the components holding a product of two other registers. Writes to any
+    // of these registers end the relation.
+    struct Product {
+        uint32_t components;
+        RegisterIndex src1;
+        RegisterIndex src2;
+    };
+    Product products[generalPurposeRegistersCount] = {};
+
+    bool changed = false;
+    for (ProgramInstruction &instruction : instructions) {
+        Instruction &inst = instruction.get();
+        if (isControlFlow(inst.header.opcode) || inst.header.opcode == Opcode::lduni || inst.header.opcode == Opcode::initregs) {
+            std::fill_n(products, generalPurposeRegistersCount, Product{});
+            continue;
+        }
+
+        // The product is rounded before the addition in fmad, so the result does not change
+        if (inst.header.opcode == Opcode::fadd) {
+            const InstructionLayouts::BinaryMath add = inst.binaryMath;
+            for (uint32_t productIndex = 0; productIndex < 2; productIndex++) {
+                const RegisterIndex productReg = productIndex == 0 ? add.src1 : add.src2;
+                const RegisterIndex addendReg = productIndex == 0 ? add.src2 : add.src1;
+                const Product &product = products[productReg];
+                if (productReg == addendReg || (add.destMask & ~product.components) != 0) {
+                    continue;
+                }
+
+                instruction = {};
+                InstructionLayouts::TernaryMath &madInst = instruction.get().ternaryMath;
+                madInst.opcode = Opcode::fmad;
+                madInst.dest = add.dest;
+                madInst.src1 = product.src1;
+                madInst.src2 = product.src2;
+                madInst.src3 = addendReg;
+                madInst.destMask = add.destMask;
+                changed = true;
+                break;
+            }
+        }
+
+        const InstructionOperands operands = PicoGpuBinary::getInstructionOperands(inst);
+        if (operands.writtenComponents == 0) {
+            continue;
+        }
+        for (Product &product : products) {
+            if (product.src1 == operands.dest || product.src2 == operands.dest) {
+                product = {};
+            }
+        }
+        products[operands.dest].components &= ~operands.writtenComponents;
+        if (inst.header.opcode == Opcode::fmul && inst.binaryMath.dest != inst.binaryMath.src1 && inst.binaryMath.dest != inst.binaryMath.src2) {
+            products[operands.dest] = {inst.binaryMath.destMask, inst.binaryMath.src1, inst.binaryMath.src2};
+        }
+    }
+    return changed;
+}
+
+bool Optimizer::eliminateDeadCode() {
+    // Walk backwards and track, which components will be read before being overwritten
+    RegisterComponents live = programInterface.outputComponents;
+    uint32_t controlFlowDepth = 0;
+
+    for (size_t instructionIndex = instructions.size(); instructionIndex-- > 0;) {
+        ProgramInstruction &instruction = instructions[instructionIndex];
+        Instruction &inst = instruction.get();
+        const InstructionOperands operands = PicoGpuBinary::getInstructionOperands(inst);
+
+        switch (inst.header.opcode) {
+        case Opcode::endloop:
+            addLoopReads(instructionIndex, live); // values read in the next iteration are live in the whole loop
+            controlFlowDepth++;
+            break;
+        case Opcode::endif:
+            controlFlowDepth++;
+            break;
+        case Opcode::if_:
+        case Opcode::loop:
+            controlFlowDepth--;
+            break;
+        case Opcode::lduni:
+        case Opcode::initregs: {
+            const uint16_t writtenRegsMask = inst.header.opcode == Opcode::lduni ? programInterface.uniformRegsMask : programInterface.zeroedRegsMask;
+            bool anyLive = false;
+            for (RegisterIndex reg = 0; reg < generalPurposeRegistersCount; reg++) {
+                if (isBitSet(writtenRegsMask, reg)) {
+                    anyLive |= live[reg] != 0;
+                    live[reg] = 0;
+                }
+            }
+            instruction.removed = !anyLive;
+            continue;
+        }
+        default:
+            break;
+        }
+
+        // Instructions not writing any register have side effects or control the flow
+        if (operands.writtenComponents != 0) {
+            if ((live[operands.dest] & operands.writtenComponents) == 0) {
+                instruction.removed = true;
+                continue;
+            }
+            if (controlFlowDepth == 0) {
+                live[operands.dest] &= ~operands.writtenComponents;
+            }
+        }
+
+        const uint32_t readComponents = getReadComponents(inst, operands);
+        for (uint32_t sourceIndex = 0; sourceIndex < operands.sourcesCount; sourceIndex++) {
+            live[operands.sources[sourceIndex]] |= readComponents;
+        }
+    }
+
+    return removeMarkedInstructions();
+}
+
+void Optimizer::addLoopReads(size_t endloopIndex, RegisterComponents &live) {
+    uint32_t nesting = 1;
+    for (size_t instructionIndex = endloopIndex; instructionIndex-- > 0;) {
+        Instruction &inst = instructions[instructionIndex].get();
+        nesting += inst.header.opcode == Opcode::endloop;
+        nesting -= inst.header.opcode == Opcode::loop;
+        if (nesting == 0) {
+            return;
+        }
+
+        const InstructionOperands operands = PicoGpuBinary::getInstructionOperands(inst);
+        const uint32_t readComponents = getReadComponents(inst, operands);
+        for (uint32_t sourceIndex = 0; sourceIndex < operands.sourcesCount; sourceIndex++) {
+            live[operands.sources[sourceIndex]] |= readComponents;
+        }
+    }
+    FATAL_ERROR("endloop without matching loop");
+}
+
+bool Optimizer::removeMarkedInstructions() {
+    const auto isRemoved = [](const ProgramInstruction &instruction) { return instruction.removed; };
+    const auto newEnd = std::remove_if(instructions.begin(), instructions.end(), isRemoved);
+    const bool removedAny = newEnd != instructions.end();
+    instructions.erase(newEnd, instructions.end());
+    return removedAny;
+}
+
+} // namespace Isa
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "gpu/isa/isa.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Isa {
+
+// Rewrites an encoded program into an equivalent one, which executes fewer instructions. Passes are repeated as long
+// as any of them changes the program, because each of them can expose more work for the others:
+//  - copy propagation makes instructions read the original register instead of its copy made by mov or swizzle and
+//    removes copies, which don't change the destination,
+//  - constant folding replaces operations on values known during assembly with init, passes known operands of
+//    arithmetic as immediates and removes branches, whose condition is known,
+//  - fmul followed by fadd of the product is fused into fmad,
+//  - dead code elimination removes instructions, whose results are not read before the program ends, including
+//    lduni and initregs, if none of the registers they write is read before being overwritten.
+//
+// Registers are analyzed per component. Forward passes forget everything they know at control flow instructions, so
+// they don't have to follow branches and loops. The only exception are constants written outside of control flow, which
+// are never overwritten later in the program. Dead code elimination never treats writes inside control flow as
+// overwriting the register, because some threads may skip them.
+class Optimizer {
+public:
+    using RegisterComponents = std::array<uint8_t, generalPurposeRegistersCount>; // mask of components for each register
+
+    // Registers written or read outside of the instruction stream
+    struct ProgramInterface {
+        RegisterComponents outputComponents; // read by the shader unit after the program ends
+        uint16_t uniformRegsMask;            // written by lduni
+        uint16_t zeroedRegsMask;             // written by initregs
+    };
+
+    Optimizer(const uint32_t *program, size_t sizeInDwords, const ProgramInterface &programInterface);
+
+    void optimize();
+    std::vector<uint32_t> getProgram();
+    auto getInstructionsCount() const { return instructions.size(); }
+
+private:
+    // Has space for the longest encoding, so the instruction can be accessed through any layout
+    struct ProgramInstruction {
+        uint32_t dwords[1 + registerComponentsCount] = {};
+        bool removed = false;
+
+        Instruction &get() { return reinterpret_cast<Instruction &>(dwords[0]); }
+    };
+
+    bool propagateCopies();
+    bool foldConstants();
+    void removeUntakenBranch(size_t ifIndex, bool conditionValue);
+    bool fuseMultiplyAdd();
+    bool eliminateDeadCode();
+    void addLoopReads(size_t endloopIndex, RegisterComponents &live);
+    bool removeMarkedInstructions();
+
+    const ProgramInterface programInterface;
+    std::vector<ProgramInstruction> instructions = {};
+};
+
+} // namespace Isa
@@ -1,6 +1,12 @@
 %code requires {
     #include "gpu/isa/assembler/pico_gpu_binary.h"
 
+    // Opaque state of the reentrant scanner, defined the same way by flex
+    #ifndef YY_TYPEDEF_YY_SCANNER_T
+    #define YY_TYPEDEF_YY_SCANNER_T
+    typedef void *yyscan_t;
+    #endif
+
     struct DstRegister {
         Isa::RegisterIndex reg;
         uint32_t mask;
@@ -14,6 +20,11 @@
         Isa::SwizzlePatternComponent w;
     };
 
+    struct ConditionRegister {
+        Isa::RegisterIndex reg;
+        Isa::SwizzlePatternComponent component;
+    };
+
     struct ImmediateArgs {
         size_t count;
         int32_t args[4];
@@ -31,6 +42,7 @@
     float f;
     DstRegister dstReg;
     FullySwizzledRegister fullySwizzledReg;
+    ConditionRegister conditionReg;
     Isa::RegisterIndex reg;
     Isa::SwizzlePatternComponent swizzleComponent;
     ImmediateArgs immediateArgs;
@@ -41,14 +53,14 @@
     #include <initializer_list>
 
     // Communication with scanner
-    int gpuasm_lex();
-    void scannerSetParsedString(const char *str);
-    void scannerUnsetParsetString();
-    extern int gpuasm_lineno;
+    int gpuasm_lex(GPUASM_STYPE *lval, yyscan_t scanner);
+    yyscan_t scannerCreate(const char *str);
+    void scannerDestroy(yyscan_t scanner);
+    int scannerGetLineNumber(yyscan_t scanner);
 
     // Error handling
-    int yyerror(void *yylval, const char *s);
-    #define YYABORT_WITH_ERROR(err) { yyerror(nullptr, err); YYABORT; }
+    int yyerror(yyscan_t scanner, Isa::PicoGpuBinary *outputBinary, const char *s);
+    #define YYABORT_WITH_ERROR(err) { yyerror(scanner, outputBinary, err); YYABORT; }
     #define VALIDATE_BINARY()                                         \
         do {                                                          \
             if (outputBinary->hasError()) {                           \
@@ -63,10 +75,14 @@
 %}
 
 // Tokens received from lexer
-%token FINIT FADD FSUB FMUL FDIV FNEG FDOT FCROSS FCROSS2 FMAD FRCP FNORM FMAX FMIN
-%token IINIT IADD ISUB IMUL IDIV INEG IMAX IMIN
+%token FINIT FADD FSUB FMUL FDIV FNEG FDOT FCROSS FCROSS2 FMAD FRCP FNORM FMAX FMIN FCMPEQ FCMPNE FCMPLT FCMPLE FMATMUL
+%token FSQRT FRSQ FEXP2 FLOG2 FSIN FCOS FPOW F2UNORM8
+%token IINIT IADD ISUB IMUL IDIV INEG IMAX IMIN ICMPEQ ICMPNE ICMPLT ICMPLE IAND IOR IXOR ISHL ISHR
+%token SAMPLE
+%token LD ST
+%token IF ELSE ENDIF LOOP ENDLOOP BREAK
 %token MOV SWIZZLE TRAP
-%token HASH_INPUT HASH_OUTPUT HASH_UNIFORM HASH_VS HASH_FS HASH_UNDEFINED_REGS DOT
+%token HASH_INPUT HASH_OUTPUT HASH_UNIFORM HASH_VS HASH_FS HASH_CS HASH_UNDEFINED_REGS HASH_UNIFORM_MATRIX HASH_OPTIMIZE UNIFORM_MATRIX DOT
 %token <swizzleComponent> VEC_COMPONENT
 %token <reg> REG
 %token <i> NUMBER_INT
@@ -76,11 +92,14 @@
 %type <ui> REG_MASK
 %type <dstReg> DST_REG
 %type <fullySwizzledReg> FULLY_SWIZZLED_REG
+%type <conditionReg> CONDITION_REG
 %type <immediateArgs> IMMEDIATE_INTS IMMEDIATE_FLOATS
 
-%parse-param {Isa::PicoGpuBinary *outputBinary}
+%lex-param {yyscan_t scanner}
+%parse-param {yyscan_t scanner} {Isa::PicoGpuBinary *outputBinary}
 
 %define api.prefix {gpuasm_}
+%define api.pure full
 %define parse.error verbose
 
 
@@ -107,7 +126,10 @@ DIRECTIVE:
     | HASH_UNIFORM REG REG_MASK { outputBinary->encodeDirectiveInputOutput($2, $3, Isa::PicoGpuBinary::IoType::Uniform); VALIDATE_BINARY(); }
     | HASH_VS { outputBinary->encodeDirectiveShaderType(Isa::Command::ProgramType::VertexShader); }
     | HASH_FS { outputBinary->encodeDirectiveShaderType(Isa::Command::ProgramType::FragmentShader); }
+    | HASH_CS { outputBinary->encodeDirectiveShaderType(Isa::Command::ProgramType::ComputeShader); }
     | HASH_UNDEFINED_REGS { outputBinary->encodeDirectiveUndefinedRegs(); VALIDATE_BINARY();}
+    | HASH_UNIFORM_MATRIX { outputBinary->encodeDirectiveUniformMatrix(); VALIDATE_BINARY(); }
+    | HASH_OPTIMIZE { outputBinary->encodeDirectiveOptimize(); VALIDATE_BINARY(); }
 
 // ----------------------------- Instructions
 INSTRUCTION_SECTION : INSTRUCTIONS { outputBinary->finalizeInstructions(); VALIDATE_BINARY(); }
@@ -116,13 +138,13 @@ INSTRUCTIONS:
     | INSTRUCTIONS INSTRUCTION
 INSTRUCTION:
       FADD      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::fadd, $2.reg, $3, $4, $2.mask); }
-    | FADD      DST_REG REG NUMBER_FLOAT  { outputBinary->encodeBinaryMathImm(Isa::Opcode::fadd_imm, $2.reg, $3, $2.mask, {asint($4)}); }
+    | FADD      DST_REG REG IMMEDIATE_FLOATS { outputBinary->encodeBinaryMathImm(Isa::Opcode::fadd_imm, $2.reg, $3, $2.mask, $4.toVector()); }
     | FSUB      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::fsub, $2.reg, $3, $4, $2.mask); }
-    | FSUB      DST_REG REG NUMBER_FLOAT  { outputBinary->encodeBinaryMathImm(Isa::Opcode::fsub_imm, $2.reg, $3, $2.mask, {asint($4)}); }
+    | FSUB      DST_REG REG IMMEDIATE_FLOATS { outputBinary->encodeBinaryMathImm(Isa::Opcode::fsub_imm, $2.reg, $3, $2.mask, $4.toVector()); }
     | FMUL      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::fmul, $2.reg, $3, $4, $2.mask); }
-    | FMUL      DST_REG REG NUMBER_FLOAT  { outputBinary->encodeBinaryMathImm(Isa::Opcode::fmul_imm, $2.reg, $3, $2.mask, {asint($4)}); }
+    | FMUL      DST_REG REG IMMEDIATE_FLOATS { outputBinary->encodeBinaryMathImm(Isa::Opcode::fmul_imm, $2.reg, $3, $2.mask, $4.toVector()); }
     | FDIV      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::fdiv, $2.reg, $3, $4, $2.mask); }
-    | FDIV      DST_REG REG NUMBER_FLOAT  { outputBinary->encodeBinaryMathImm(Isa::Opcode::fdiv_imm, $2.reg, $3, $2.mask, {asint($4)}); }
+    | FDIV      DST_REG REG IMMEDIATE_FLOATS { outputBinary->encodeBinaryMathImm(Isa::Opcode::fdiv_imm, $2.reg, $3, $2.mask, $4.toVector()); }
     | FNEG      DST_REG REG               { outputBinary->encodeUnaryMath(Isa::Opcode::fneg, $2.reg, $3, $2.mask); }
     | FDOT      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::fdot, $2.reg, $3, $4, $2.mask); }
     | FCROSS    REG REG REG               { outputBinary->encodeBinaryMath(Isa::Opcode::fcross, $2, $3, $4, 0b1111); }
@@ -131,18 +153,50 @@ INSTRUCTION:
     | FNORM     DST_REG REG               { outputBinary->encodeUnaryMath(Isa::Opcode::fnorm, $2.reg, $3, $2.mask); }
     | FMAX      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::fmax, $2.reg, $3, $4, $2.mask); }
     | FMIN      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::fmin, $2.reg, $3, $4, $2.mask); }
-    | FMAD      DST_REG REG REG REG       { outputBinary->encodeTernaryMath(Isa::Opcode::fcross2, $2.reg, $3, $4, $5, $2.mask); }
+    | FCMPEQ    DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::fcmpeq, $2.reg, $3, $4, $2.mask); }
+    | FCMPNE    DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::fcmpne, $2.reg, $3, $4, $2.mask); }
+    | FCMPLT    DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::fcmplt, $2.reg, $3, $4, $2.mask); }
+    | FCMPLE    DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::fcmple, $2.reg, $3, $4, $2.mask); }
+    | FMATMUL   DST_REG REG REG           { outputBinary->encodeMatrixMultiply($2.reg, $3, $4, $2.mask); VALIDATE_BINARY(); }
+    | FMATMUL   DST_REG UNIFORM_MATRIX REG { outputBinary->encodeUniformMatrixMultiply($2.reg, $4, $2.mask); VALIDATE_BINARY(); }
+    | FSQRT     DST_REG REG               { outputBinary->encodeUnaryMath(Isa::Opcode::fsqrt, $2.reg, $3, $2.mask); }
+    | FRSQ      DST_REG REG               { outputBinary->encodeUnaryMath(Isa::Opcode::frsq, $2.reg, $3, $2.mask); }
+    | FEXP2     DST_REG REG               { outputBinary->encodeUnaryMath(Isa::Opcode::fexp2, $2.reg, $3, $2.mask); }
+    | FLOG2     DST_REG REG               { outputBinary->encodeUnaryMath(Isa::Opcode::flog2, $2.reg, $3, $2.mask); }
+    | FSIN      DST_REG REG               { outputBinary->encodeUnaryMath(Isa::Opcode::fsin, $2.reg, $3, $2.mask); }
+    | FCOS      DST_REG REG               { outputBinary->encodeUnaryMath(Isa::Opcode::fcos, $2.reg, $3, $2.mask); }
+    | FPOW      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::fpow, $2.reg, $3, $4, $2.mask); }
+    | F2UNORM8  DST_REG REG               { outputBinary->encodeUnaryMath(Isa::Opcode::f2unorm8, $2.reg, $3, $2.mask); }
+    | FMAD      DST_REG REG REG REG       { outputBinary->encodeTernaryMath(Isa::Opcode::fmad, $2.reg, $3, $4, $5, $2.mask); }
     | IADD      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::iadd, $2.reg, $3, $4, $2.mask); }
-    | IADD      DST_REG REG NUMBER_INT    { outputBinary->encodeBinaryMathImm(Isa::Opcode::iadd_imm, $2.reg, $3, $2.mask, {$4}); }
+    | IADD      DST_REG REG IMMEDIATE_INTS { outputBinary->encodeBinaryMathImm(Isa::Opcode::iadd_imm, $2.reg, $3, $2.mask, $4.toVector()); }
     | ISUB      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::isub, $2.reg, $3, $4, $2.mask); }
-    | ISUB      DST_REG REG NUMBER_INT    { outputBinary->encodeBinaryMathImm(Isa::Opcode::isub_imm, $2.reg, $3, $2.mask, {$4}); }
+    | ISUB      DST_REG REG IMMEDIATE_INTS { outputBinary->encodeBinaryMathImm(Isa::Opcode::isub_imm, $2.reg, $3, $2.mask, $4.toVector()); }
     | IMUL      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::imul, $2.reg, $3, $4, $2.mask); }
-    | IMUL      DST_REG REG NUMBER_INT    { outputBinary->encodeBinaryMathImm(Isa::Opcode::imul_imm, $2.reg, $3, $2.mask, {$4}); }
+    | IMUL      DST_REG REG IMMEDIATE_INTS { outputBinary->encodeBinaryMathImm(Isa::Opcode::imul_imm, $2.reg, $3, $2.mask, $4.toVector()); }
     | IDIV      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::idiv, $2.reg, $3, $4, $2.mask); }
-    | IDIV      DST_REG REG NUMBER_INT    { outputBinary->encodeBinaryMathImm(Isa::Opcode::idiv_imm, $2.reg, $3, $2.mask, {$4}); }
+    | IDIV      DST_REG REG IMMEDIATE_INTS { outputBinary->encodeBinaryMathImm(Isa::Opcode::idiv_imm, $2.reg, $3, $2.mask, $4.toVector()); }
     | INEG      DST_REG REG               { outputBinary->encodeUnaryMath(Isa::Opcode::ineg, $2.reg, $3, $2.mask); }
     | IMAX      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::imax, $2.reg, $3, $4, $2.mask); }
     | IMIN      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::imin, $2.reg, $3, $4, $2.mask); }
+    | ICMPEQ    DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::icmpeq, $2.reg, $3, $4, $2.mask); }
+    | ICMPNE    DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::icmpne, $2.reg, $3, $4, $2.mask); }
+    | ICMPLT    DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::icmplt, $2.reg, $3, $4, $2.mask); }
+    | ICMPLE    DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::icmple, $2.reg, $3, $4, $2.mask); }
+    | IAND      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::iand, $2.reg, $3, $4, $2.mask); }
+    | IOR       DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::ior, $2.reg, $3, $4, $2.mask); }
+    | IXOR      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::ixor, $2.reg, $3, $4, $2.mask); }
+    | ISHL      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::ishl, $2.reg, $3, $4, $2.mask); }
+    | ISHR      DST_REG REG REG           { outputBinary->encodeBinaryMath(Isa::Opcode::ishr, $2.reg, $3, $4, $2.mask); }
+    | SAMPLE    DST_REG REG               { outputBinary->encodeUnaryMath(Isa::Opcode::sample, $2.reg, $3, $2.mask); }
+    | LD        DST_REG REG               { outputBinary->encodeUnaryMath(Isa::Opcode::ld, $2.reg, $3, $2.mask); }
+    | ST        REG DST_REG               { outputBinary->encodeStore($2, $3.reg, $3.mask); }
+    | IF        CONDITION_REG             { outputBinary->encodeCondition(Isa::Opcode::if_, $2.reg, $2.component); VALIDATE_BINARY(); }
+    | ELSE                                { outputBinary->encodeNullary(Isa::Opcode::else_); VALIDATE_BINARY(); }
+    | ENDIF                               { outputBinary->encodeNullary(Isa::Opcode::endif); VALIDATE_BINARY(); }
+    | LOOP                                { outputBinary->encodeNullary(Isa::Opcode::loop); VALIDATE_BINARY(); }
+    | ENDLOOP                             { outputBinary->encodeNullary(Isa::Opcode::endloop); VALIDATE_BINARY(); }
+    | BREAK     CONDITION_REG             { outputBinary->encodeCondition(Isa::Opcode::break_, $2.reg, $2.component); VALIDATE_BINARY(); }
     | SWIZZLE   REG FULLY_SWIZZLED_REG    { outputBinary->encodeSwizzle(Isa::Opcode::swizzle, $2, $3.reg, $3.x, $3.y, $3.z, $3.w); }
     | TRAP                                { outputBinary->encodeNullary(Isa::Opcode::trap); }
     | MOV       DST_REG REG               { outputBinary->encodeUnaryMath(Isa::Opcode::mov, $2.reg, $3, $2.mask); }
@@ -163,6 +217,9 @@ REG_MASK:
 FULLY_SWIZZLED_REG:
     REG DOT VEC_COMPONENT VEC_COMPONENT VEC_COMPONENT VEC_COMPONENT { $$ = FullySwizzledRegister{$1, $3, $4, $5, $6}; }
 
+CONDITION_REG:
+    REG DOT VEC_COMPONENT { $$ = ConditionRegister{$1, $3}; }
+
 IMMEDIATE_INTS:
       NUMBER_INT                                   { $$ = ImmediateArgs{ 1, {$1,  0,  0,  0}}; }
     | NUMBER_INT NUMBER_INT                        { $$ = ImmediateArgs{ 2, {$1, $2,  0,  0}}; }
@@ -183,9 +240,9 @@ IMMEDIATE_FLOATS:
 
 
 
-int gpuasm_error(void *yylval, const char *s)
+int gpuasm_error(yyscan_t scanner, Isa::PicoGpuBinary *outputBinary, const char *s)
 {
-    fprintf(stderr, "error: %s (line: %d)\n", s, gpuasm_lineno);
+    fprintf(stderr, "error: %s (line: %d)\n", s, scannerGetLineNumber(scanner));
     return 0;
 }
 
@@ -212,9 +269,9 @@ uint32_t constructMask(std::initializer_list<Isa::SwizzlePatternComponent> value
 
 namespace Isa {
     int assembly(const char *code, PicoGpuBinary *outBinary)  {
-        scannerSetParsedString(code);
-        int result = gpuasm_parse(outBinary);
-        scannerUnsetParsetString();
+        yyscan_t scanner = scannerCreate(code);
+        int result = gpuasm_parse(scanner, outBinary);
+        scannerDestroy(scanner);
         return result;
     }
 }
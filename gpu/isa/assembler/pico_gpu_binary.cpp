@@ -1,9 +1,14 @@
 #include "gpu/definitions/custom_components.h"
 #include "gpu/definitions/register_allocator.h"
+#include "gpu/isa/assembler/optimizer.h"
 #include "gpu/isa/assembler/pico_gpu_binary.h"
+#include "gpu/isa/assembler/virtual_register_allocator.h"
 #include "gpu/util/conversions.h"
 #include "gpu/util/math.h"
 
+#include <algorithm>
+#include <array>
+
 namespace Isa {
 
 PicoGpuBinary::PicoGpuBinary() {
@@ -16,6 +21,13 @@ void PicoGpuBinary::reset() {
     programType = {};
     std::fill(data.begin(), data.end(), 0);
     undefinedRegs = {};
+    uniformMatrix = {};
+    optimize = {};
+    uniformInstructionsCount = {};
+    instructionsCount = {};
+    unoptimizedInstructionsCount = {};
+    controlFlowStack.clear();
+    virtualRegisterInstructions.clear();
 
     std::memset(&inputs, 0, sizeof(inputs));
     std::memset(&outputs, 0, sizeof(outputs));
@@ -25,6 +37,12 @@ void PicoGpuBinary::reset() {
 void PicoGpuBinary::encodeDirectiveInputOutput(RegisterIndex reg, int mask, IoType ioType) {
     InputOutputRegisters &io = getIoRegisters(ioType);
 
+    // Validate register
+    if (isVirtualRegister(reg)) {
+        error << "Virtual registers cannot be used in " << getIoLabel(ioType) << " directives";
+        return;
+    }
+
     // Validate component mask
     FATAL_ERROR_IF(mask == 0, "Mask must be non zero")
     FATAL_ERROR_IF(mask & ~0b1111, "Mask must be a 4-bit value");
@@ -76,6 +94,22 @@ void PicoGpuBinary::encodeDirectiveUndefinedRegs() {
     undefinedRegs = true;
 }
 
+void PicoGpuBinary::encodeDirectiveUniformMatrix() {
+    if (uniformMatrix) {
+        error << "Multiple uniform matrix directives";
+        return;
+    }
+    uniformMatrix = true;
+}
+
+void PicoGpuBinary::encodeDirectiveOptimize() {
+    if (optimize) {
+        error << "Multiple optimize directives";
+        return;
+    }
+    optimize = true;
+}
+
 void PicoGpuBinary::finalizeDirectives() {
     if (!this->programType.has_value()) {
         error << "No program type specification";
@@ -87,6 +121,11 @@ void PicoGpuBinary::finalizeDirectives() {
     finalizeInputOutputDirectives(IoType::Input);
     finalizeInputOutputDirectives(IoType::Output);
     finalizeInputOutputDirectives(IoType::Uniform);
+    getStoreIsaCommand().hasUniformMatrix = uniformMatrix;
+    if (isCs() && uniformMatrix) {
+        error << getShaderTypeName() << " cannot use a uniform matrix";
+        return;
+    }
 
     // Insert preamble code if necessary
     if (this->programType.value() == Isa::Command::ProgramType::FragmentShader) {
@@ -127,6 +166,22 @@ void PicoGpuBinary::finalizeInputOutputDirectives(IoType ioType) {
         io.regs[0].usage = InputOutputRegisterUsage::Fixed;
     }
 
+    // Ensure that compute shader receives its thread id in a single component of its only input. It does not have any outputs,
+    // because it stores results to memory, so output fields of the ISA are left zeroed.
+    if (ioType == IoType::Input && isCs()) {
+        if (io.usedRegsCount != 1 || io.regs[0].componentsCount != 1) {
+            error << getShaderTypeName() << " must use exactly one single-component " << getIoLabel(ioType) << " register for the thread id";
+            return;
+        }
+        io.regs[0].usage = InputOutputRegisterUsage::Fixed;
+    }
+    if (ioType == IoType::Output && isCs()) {
+        if (io.usedRegsCount != 0) {
+            error << getShaderTypeName() << " cannot use " << getIoLabel(ioType) << " registers. Results have to be stored to memory";
+        }
+        return;
+    }
+
     // Ensure that fragment shader only uses one output and mark it as fixed.
     // Add a second output for interpolated z-value and mark it as internal.
     if (ioType == IoType::Output && programType.value() == Isa::Command::ProgramType::FragmentShader) {
@@ -134,8 +189,9 @@ void PicoGpuBinary::finalizeInputOutputDirectives(IoType ioType) {
             error << getShaderTypeName() << " must use exactly one output register";
             return;
         }
-        if (io.regs[0].componentsCount != 4) {
-            error << getShaderTypeName() << " must use a 4-component color vector as its only " << getIoLabel(ioType);
+        if (io.regs[0].componentsCount != 4 && io.regs[0].componentsCount != 1) {
+            error << getShaderTypeName() << " must use a 4-component color vector as its only " << getIoLabel(ioType)
+                  << " or a single component with a packed RGBA8 color";
             return;
         }
         FATAL_ERROR_IF(io.regs[0].usage != InputOutputRegisterUsage::Custom, "Unexpected usage of fixed io register");
@@ -191,6 +247,9 @@ const char *PicoGpuBinary::getShaderTypeName() {
     if (isFs()) {
         return "FragmentShader";
     }
+    if (isCs()) {
+        return "ComputeShader";
+    }
     return "UnknownShader";
 }
 
@@ -288,6 +347,8 @@ CustomShaderComponents PicoGpuBinary::getUniforms() {
 }
 
 void PicoGpuBinary::encodeNullary(Opcode opcode) {
+    updateControlFlowStack(opcode);
+
     auto inst = getSpace<InstructionLayouts::Nullary>();
     inst->opcode = opcode;
 }
@@ -298,6 +359,7 @@ void PicoGpuBinary::encodeUnaryMath(Opcode opcode, RegisterIndex dest, RegisterI
     inst->dest = dest;
     inst->src = src;
     inst->destMask = destMask;
+    recordVirtualRegisters(inst, dest, {src});
 }
 
 void PicoGpuBinary::encodeBinaryMath(Opcode opcode, RegisterIndex dest, RegisterIndex src1, RegisterIndex src2, uint32_t destMask) {
@@ -307,6 +369,7 @@ void PicoGpuBinary::encodeBinaryMath(Opcode opcode, RegisterIndex dest, Register
     inst->src1 = src1;
     inst->src2 = src2;
     inst->destMask = destMask;
+    recordVirtualRegisters(inst, dest, {src1, src2});
 }
 
 void PicoGpuBinary::encodeTernaryMath(Opcode opcode, RegisterIndex dest, RegisterIndex src1, RegisterIndex src2, RegisterIndex src3, uint32_t destMask) {
@@ -317,35 +380,51 @@ void PicoGpuBinary::encodeTernaryMath(Opcode opcode, RegisterIndex dest, Registe
     inst->src2 = src2;
     inst->src3 = src3;
     inst->destMask = destMask;
+    recordVirtualRegisters(inst, dest, {src1, src2, src3});
+}
+
+uint32_t PicoGpuBinary::getUsedImmediateValuesCount(uint32_t destMask, const std::vector<int32_t> &immediateValues) {
+    // Shader units assign immediates to subsequent components from the mask and repeat the last one if there are
+    // too few of them. Hence values past the masked components and trailing repetitions can be dropped, which
+    // shortens the program without changing its behavior.
+    size_t count = std::min<size_t>(immediateValues.size(), std::max<size_t>(countBits(destMask), 1));
+    while (count > 1 && immediateValues[count - 1] == immediateValues[count - 2]) {
+        count--;
+    }
+    return count;
 }
 
 void PicoGpuBinary::encodeUnaryMathImm(Opcode opcode, RegisterIndex dest, uint32_t destMask, const std::vector<int32_t> &immediateValues) {
     FATAL_ERROR_IF(immediateValues.empty(), "UnaryMathImm must have at least one immediate value");
     FATAL_ERROR_IF(immediateValues.size() > 4, "UnaryMathImm can have at most 4 immediate values");
 
-    auto inst = getSpace<InstructionLayouts::UnaryMathImm>(1 + immediateValues.size());
+    const uint32_t immediateValuesCount = getUsedImmediateValuesCount(destMask, immediateValues);
+    auto inst = getSpace<InstructionLayouts::UnaryMathImm>(1 + immediateValuesCount);
     inst->opcode = opcode;
     inst->dest = dest;
     inst->destMask = destMask;
-    inst->immediateValuesCount = intToNonZeroCount(immediateValues.size());
-    for (uint32_t i = 0; i < immediateValues.size(); i++) {
+    inst->immediateValuesCount = intToNonZeroCount(immediateValuesCount);
+    for (uint32_t i = 0; i < immediateValuesCount; i++) {
         inst->immediateValues[i] = reinterpret_cast<const uint32_t &>(immediateValues[i]);
     }
+    recordVirtualRegisters(inst, dest, {});
 }
 
 void PicoGpuBinary::encodeBinaryMathImm(Opcode opcode, RegisterIndex dest, RegisterIndex src, uint32_t destMask, const std::vector<int32_t> &immediateValues) {
     FATAL_ERROR_IF(immediateValues.empty(), "BinaryMathImm must have at least one immediate value");
     FATAL_ERROR_IF(immediateValues.size() > 4, "BinaryMathImm can have at most 4 immediate values");
 
-    auto inst = getSpace<InstructionLayouts::BinaryMathImm>(1 + immediateValues.size());
+    const uint32_t immediateValuesCount = getUsedImmediateValuesCount(destMask, immediateValues);
+    auto inst = getSpace<InstructionLayouts::BinaryMathImm>(1 + immediateValuesCount);
     inst->opcode = opcode;
     inst->dest = dest;
     inst->src = src;
     inst->destMask = destMask;
-    inst->immediateValuesCount = intToNonZeroCount(immediateValues.size());
-    for (uint32_t i = 0; i < immediateValues.size(); i++) {
+    inst->immediateValuesCount = intToNonZeroCount(immediateValuesCount);
+    for (uint32_t i = 0; i < immediateValuesCount; i++) {
         inst->immediateValues[i] = reinterpret_cast<const uint32_t &>(immediateValues[i]);
     }
+    recordVirtualRegisters(inst, dest, {src});
 }
 
 void PicoGpuBinary::encodeSwizzle(Opcode opcode, RegisterIndex dest, RegisterIndex src,
@@ -358,9 +437,54 @@ void PicoGpuBinary::encodeSwizzle(Opcode opcode, RegisterIndex dest, RegisterInd
     inst->patternY = y;
     inst->patternZ = z;
     inst->patternW = w;
+    recordVirtualRegisters(inst, dest, {src});
+}
+
+void PicoGpuBinary::encodeCondition(Opcode opcode, RegisterIndex src, SwizzlePatternComponent component) {
+    updateControlFlowStack(opcode);
+
+    auto inst = getSpace<InstructionLayouts::Condition>();
+    inst->opcode = opcode;
+    inst->src = src;
+    inst->component = component;
+    recordVirtualRegisters(inst, 0, {src});
+}
+
+void PicoGpuBinary::encodeMatrixMultiply(RegisterIndex dest, RegisterIndex matrix, RegisterIndex src, uint32_t destMask) {
+    if (isVirtualRegister(matrix)) {
+        error << "Matrix must be stored in physical registers, because its rows have to be consecutive";
+        return;
+    }
+    const RegisterIndex lastMatrixRegister = matrix + Isa::matrixRowsCount - 1;
+    if (lastMatrixRegister >= Isa::generalPurposeRegistersCount) {
+        error << "Matrix in r" << matrix << " would use registers up to r" << lastMatrixRegister << ". Max is r" << Isa::generalPurposeRegistersCount - 1;
+        return;
+    }
+    encodeBinaryMath(Opcode::fmatmul, dest, matrix, src, destMask);
+}
+
+void PicoGpuBinary::encodeUniformMatrixMultiply(RegisterIndex dest, RegisterIndex src, uint32_t destMask) {
+    if (!uniformMatrix) {
+        error << "Uniform matrix used without a uniform matrix directive";
+        return;
+    }
+    encodeUnaryMath(Opcode::fmatmul_uni, dest, src, destMask);
+}
+
+void PicoGpuBinary::encodeStore(RegisterIndex address, RegisterIndex src, uint32_t srcMask) {
+    // Store does not write any register, so the destination field is left unused
+    encodeBinaryMath(Opcode::st, 0, address, src, srcMask);
 }
 
 void PicoGpuBinary::finalizeInstructions() {
+    if (hasError()) {
+        return;
+    }
+    if (!controlFlowStack.empty()) {
+        error << (controlFlowStack.back() == Opcode::loop ? "loop without matching endloop" : "if without matching endif");
+        return;
+    }
+
     if (programType.value() == Isa::Command::ProgramType::FragmentShader) {
         // Put Z coordinate as a first component, so it can be exported
         encodeSwizzle(Isa::Opcode::swizzle, inputs.regs[0].index, inputs.regs[0].index,
@@ -370,9 +494,100 @@ void PicoGpuBinary::finalizeInstructions() {
                       Isa::SwizzlePatternComponent::SwizzleZ);
     }
 
+    allocateVirtualRegisters();
+    if (hasError()) {
+        return;
+    }
+    optimizeInstructions();
+    if (hasError()) {
+        return;
+    }
+    tagUniformInstructions();
     getStoreIsaCommand().programLength = data.size() - sizeof(Command::CommandStoreIsa) / sizeof(uint32_t);
 }
 
+void PicoGpuBinary::recordVirtualRegisters(const void *instruction, RegisterIndex dest, std::initializer_list<RegisterIndex> sources) {
+    if (!isVirtualRegister(dest) && std::none_of(sources.begin(), sources.end(), isVirtualRegister)) {
+        return;
+    }
+
+    // Sources are passed in the order of encoded fields. Rows of the fmatmul matrix are decoded as multiple sources,
+    // but they are always physical registers, so only the vector has to be replaced.
+    const uint32_t *dwords = static_cast<const uint32_t *>(instruction);
+    const Instruction &inst = reinterpret_cast<const Instruction &>(*dwords);
+    InstructionOperands operands = getInstructionOperands(inst);
+    operands.dest = dest;
+    if (inst.header.opcode == Opcode::fmatmul) {
+        operands.sources[Isa::matrixRowsCount] = sources.begin()[1];
+    } else {
+        std::copy(sources.begin(), sources.end(), operands.sources);
+    }
+    virtualRegisterInstructions.push_back({static_cast<size_t>(dwords - data.data()), operands});
+}
+
+void PicoGpuBinary::allocateVirtualRegisters() {
+    if (virtualRegisterInstructions.empty()) {
+        return;
+    }
+
+    // Feed the whole program to the allocator, including the prologue, which uses physical registers
+    VirtualRegisterAllocator allocator{static_cast<uint16_t>(inputs.usedRegsMask | uniforms.usedRegsMask), outputs.usedRegsMask};
+    const size_t headerSize = sizeof(Command::CommandStoreIsa) / sizeof(uint32_t);
+    auto recorded = virtualRegisterInstructions.begin();
+    for (size_t dwordIndex = headerSize; dwordIndex < data.size();) {
+        const Instruction &inst = reinterpret_cast<const Instruction &>(data[dwordIndex]);
+        InstructionOperands operands = getInstructionOperands(inst);
+        if (recorded != virtualRegisterInstructions.end() && recorded->dwordIndex == dwordIndex) {
+            operands = recorded->operands;
+            recorded++;
+        }
+        allocator.addInstruction(inst.header.opcode, operands);
+        dwordIndex += operands.sizeInDwords;
+    }
+    if (!allocator.allocate(error)) {
+        return;
+    }
+
+    for (VirtualRegisterInstruction &instruction : virtualRegisterInstructions) {
+        InstructionOperands &operands = instruction.operands;
+        operands.dest = allocator.getPhysicalRegister(operands.dest);
+        for (uint32_t sourceIndex = 0; sourceIndex < operands.sourcesCount; sourceIndex++) {
+            operands.sources[sourceIndex] = allocator.getPhysicalRegister(operands.sources[sourceIndex]);
+        }
+        setInstructionRegisters(reinterpret_cast<Instruction &>(data[instruction.dwordIndex]), operands);
+    }
+    virtualRegisterInstructions.clear();
+}
+
+void PicoGpuBinary::optimizeInstructions() {
+    const size_t headerSize = sizeof(Command::CommandStoreIsa) / sizeof(uint32_t);
+    Optimizer::ProgramInterface programInterface = {};
+    for (uint32_t outputIndex = 0; outputIndex < outputs.usedRegsCount; outputIndex++) {
+        programInterface.outputComponents[outputs.regs[outputIndex].index] |= outputs.regs[outputIndex].mask;
+    }
+    programInterface.uniformRegsMask = uniforms.usedRegsMask;
+    programInterface.zeroedRegsMask = ~(inputs.usedRegsMask | uniforms.usedRegsMask);
+
+    // Count instructions even if we don't optimize, so the counts can always be compared
+    Optimizer optimizer{data.data() + headerSize, data.size() - headerSize, programInterface};
+    unoptimizedInstructionsCount = optimizer.getInstructionsCount();
+    instructionsCount = unoptimizedInstructionsCount;
+    if (!optimize) {
+        return;
+    }
+    optimizer.optimize();
+    instructionsCount = optimizer.getInstructionsCount();
+
+    // Folded constants take more space than the operations they replace, so the program may not fit anymore
+    const std::vector<uint32_t> program = optimizer.getProgram();
+    if (program.size() >= Isa::maxIsaSize) {
+        error << "Optimized program is too long";
+        return;
+    }
+    data.resize(headerSize);
+    data.insert(data.end(), program.begin(), program.end());
+}
+
 void PicoGpuBinary::encodeAttributeInterpolationForFragmentShader() {
     constexpr static size_t perspectiveAware = true;
 
@@ -479,6 +694,510 @@ void PicoGpuBinary::encodeAttributeInterpolationForFragmentShader() {
     }
 }
 
+PicoGpuBinary::InstructionOperands PicoGpuBinary::getInstructionOperands(const Instruction &inst) {
+    InstructionOperands operands = {};
+    operands.sizeInDwords = 1;
+
+    switch (inst.header.opcode) {
+    case Opcode::fneg:
+    case Opcode::frcp:
+    case Opcode::fnorm:
+    case Opcode::ineg:
+    case Opcode::mov:
+    case Opcode::fsqrt:
+    case Opcode::frsq:
+    case Opcode::fexp2:
+    case Opcode::flog2:
+    case Opcode::fsin:
+    case Opcode::fcos:
+    case Opcode::f2unorm8:
+    case Opcode::sample: // texture is the same for all threads, so only coordinates decide the result
+    case Opcode::ld: // all threads see the same memory, so only the address decides the result
+    case Opcode::fmatmul_uni: // uniform matrix is the same for all threads, so it is not tracked
+        operands.sources[operands.sourcesCount++] = inst.unaryMath.src;
+        operands.dest = inst.unaryMath.dest;
+        operands.writtenComponents = inst.header.opcode == Opcode::fnorm ? 0b1111 : inst.unaryMath.destMask; // fnorm ignores the mask
+        break;
+    case Opcode::fadd:
+    case Opcode::fsub:
+    case Opcode::fmul:
+    case Opcode::fdiv:
+    case Opcode::fdot:
+    case Opcode::fcross:
+    case Opcode::fcross2:
+    case Opcode::fmax:
+    case Opcode::fmin:
+    case Opcode::fcmpeq:
+    case Opcode::fcmpne:
+    case Opcode::fcmplt:
+    case Opcode::fcmple:
+    case Opcode::fpow:
+    case Opcode::iadd:
+    case Opcode::isub:
+    case Opcode::imul:
+    case Opcode::idiv:
+    case Opcode::imax:
+    case Opcode::imin:
+    case Opcode::icmpeq:
+    case Opcode::icmpne:
+    case Opcode::icmplt:
+    case Opcode::icmple:
+    case Opcode::iand:
+    case Opcode::ior:
+    case Opcode::ixor:
+    case Opcode::ishl:
+    case Opcode::ishr:
+        operands.sources[operands.sourcesCount++] = inst.binaryMath.src1;
+        operands.sources[operands.sourcesCount++] = inst.binaryMath.src2;
+        operands.dest = inst.binaryMath.dest;
+        operands.writtenComponents = inst.header.opcode == Opcode::fcross ? 0b1111 : inst.binaryMath.destMask; // fcross ignores the mask
+        break;
+    case Opcode::st:
+        operands.sources[operands.sourcesCount++] = inst.binaryMath.src1;
+        operands.sources[operands.sourcesCount++] = inst.binaryMath.src2;
+        break;
+    case Opcode::fmatmul:
+        for (uint32_t row = 0; row < Isa::matrixRowsCount; row++) {
+            operands.sources[operands.sourcesCount++] = inst.binaryMath.src1 + row;
+        }
+        operands.sources[operands.sourcesCount++] = inst.binaryMath.src2;
+        operands.dest = inst.binaryMath.dest;
+        operands.writtenComponents = inst.binaryMath.destMask;
+        break;
+    case Opcode::fmad:
+        operands.sources[operands.sourcesCount++] = inst.ternaryMath.src1;
+        operands.sources[operands.sourcesCount++] = inst.ternaryMath.src2;
+        operands.sources[operands.sourcesCount++] = inst.ternaryMath.src3;
+        operands.dest = inst.ternaryMath.dest;
+        operands.writtenComponents = inst.ternaryMath.destMask;
+        break;
+    case Opcode::init:
+        operands.dest = inst.unaryMathImm.dest;
+        operands.writtenComponents = inst.unaryMathImm.destMask;
+        operands.sizeInDwords += nonZeroCountToInt(inst.unaryMathImm.immediateValuesCount);
+        break;
+    case Opcode::fadd_imm:
+    case Opcode::fsub_imm:
+    case Opcode::fmul_imm:
+    case Opcode::fdiv_imm:
+    case Opcode::iadd_imm:
+    case Opcode::isub_imm:
+    case Opcode::imul_imm:
+    case Opcode::idiv_imm:
+        operands.sources[operands.sourcesCount++] = inst.binaryMathImm.src;
+        operands.dest = inst.binaryMathImm.dest;
+        operands.writtenComponents = inst.binaryMathImm.destMask;
+        operands.sizeInDwords += nonZeroCountToInt(inst.binaryMathImm.immediateValuesCount);
+        break;
+    case Opcode::swizzle:
+        operands.sources[operands.sourcesCount++] = inst.swizzle.src;
+        operands.dest = inst.swizzle.dest;
+        operands.writtenComponents = 0b1111;
+        break;
+    case Opcode::if_:
+    case Opcode::break_:
+        operands.sources[operands.sourcesCount++] = inst.condition.src;
+        break;
+    case Opcode::else_:
+    case Opcode::endif:
+    case Opcode::loop:
+    case Opcode::endloop:
+    case Opcode::trap:
+    case Opcode::lduni:
+    case Opcode::initregs:
+        break;
+    default:
+        FATAL_ERROR("Unknown opcode: ", (uint32_t)inst.header.opcode);
+    }
+    return operands;
+}
+
+bool PicoGpuBinary::isComponentWise(Opcode opcode) {
+    switch (opcode) {
+    case Opcode::fadd:
+    case Opcode::fadd_imm:
+    case Opcode::fsub:
+    case Opcode::fsub_imm:
+    case Opcode::fmul:
+    case Opcode::fmul_imm:
+    case Opcode::fdiv:
+    case Opcode::fdiv_imm:
+    case Opcode::fneg:
+    case Opcode::fmad:
+    case Opcode::frcp:
+    case Opcode::fmax:
+    case Opcode::fmin:
+    case Opcode::fcmpeq:
+    case Opcode::fcmpne:
+    case Opcode::fcmplt:
+    case Opcode::fcmple:
+    case Opcode::fsqrt:
+    case Opcode::frsq:
+    case Opcode::fexp2:
+    case Opcode::flog2:
+    case Opcode::fsin:
+    case Opcode::fcos:
+    case Opcode::fpow:
+    case Opcode::iadd:
+    case Opcode::iadd_imm:
+    case Opcode::isub:
+    case Opcode::isub_imm:
+    case Opcode::imul:
+    case Opcode::imul_imm:
+    case Opcode::idiv:
+    case Opcode::idiv_imm:
+    case Opcode::ineg:
+    case Opcode::imax:
+    case Opcode::imin:
+    case Opcode::icmpeq:
+    case Opcode::icmpne:
+    case Opcode::icmplt:
+    case Opcode::icmple:
+    case Opcode::iand:
+    case Opcode::ior:
+    case Opcode::ixor:
+    case Opcode::ishl:
+    case Opcode::ishr:
+    case Opcode::mov:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void PicoGpuBinary::setInstructionRegisters(Instruction &inst, const InstructionOperands &operands) {
+    // Counterpart of getInstructionOperands. Matrix rows of fmatmul are consecutive registers, so only the first one
+    // is encoded.
+    switch (inst.header.opcode) {
+    case Opcode::init:
+        inst.unaryMathImm.dest = operands.dest;
+        break;
+    case Opcode::fadd_imm:
+    case Opcode::fsub_imm:
+    case Opcode::fmul_imm:
+    case Opcode::fdiv_imm:
+    case Opcode::iadd_imm:
+    case Opcode::isub_imm:
+    case Opcode::imul_imm:
+    case Opcode::idiv_imm:
+        inst.binaryMathImm.dest = operands.dest;
+        inst.binaryMathImm.src = operands.sources[0];
+        break;
+    case Opcode::swizzle:
+        inst.swizzle.dest = operands.dest;
+        inst.swizzle.src = operands.sources[0];
+        break;
+    case Opcode::if_:
+    case Opcode::break_:
+        inst.condition.src = operands.sources[0];
+        break;
+    case Opcode::fmatmul:
+        inst.binaryMath.dest = operands.dest;
+        inst.binaryMath.src1 = operands.sources[0];
+        inst.binaryMath.src2 = operands.sources[Isa::matrixRowsCount];
+        break;
+    case Opcode::fmad:
+        inst.ternaryMath.dest = operands.dest;
+        inst.ternaryMath.src1 = operands.sources[0];
+        inst.ternaryMath.src2 = operands.sources[1];
+        inst.ternaryMath.src3 = operands.sources[2];
+        break;
+    default:
+        // Remaining register-only instructions are distinguished by the number of sources
+        switch (operands.sourcesCount) {
+        case 0:
+            break;
+        case 1:
+            inst.unaryMath.dest = operands.dest;
+            inst.unaryMath.src = operands.sources[0];
+            break;
+        case 2:
+            inst.binaryMath.dest = operands.dest;
+            inst.binaryMath.src1 = operands.sources[0];
+            inst.binaryMath.src2 = operands.sources[1];
+            break;
+        default:
+            FATAL_ERROR("Unexpected number of sources: ", operands.sourcesCount);
+        }
+    }
+}
+
+void PicoGpuBinary::tagUniformInstructions() {
+    // Find instructions, which compute the same values for all threads. We track which components of each register
+    // may differ between threads. All registers start as varying, because inputs are per-thread and the remaining
+    // registers may contain leftovers from previous executions. Sources are treated as whole registers, so we don't
+    // have to know which components each operation reads. Destinations are tracked per component, because partial
+    // writes are common when building vectors from scalars.
+    //
+    // Writes inside divergent control flow only reach some of the threads, so they always make the destination
+    // varying, even if the written value is uniform. Loops are always treated as divergent and everything written
+    // inside them is varying from the start of the loop, so we don't have to iterate over the back edge.
+    using VaryingComponents = std::array<uint8_t, Isa::generalPurposeRegistersCount>;
+    struct ControlFlowFrame {
+        Opcode opcode;
+        bool divergent;
+        VaryingComponents entryState;
+        VaryingComponents thenState;
+    };
+
+    VaryingComponents varyingComponents = {};
+    varyingComponents.fill(0b1111);
+    const auto isVarying = [&varyingComponents](RegisterIndex reg) { return varyingComponents[reg] != 0; };
+    std::vector<ControlFlowFrame> controlFlowFrames = {};
+    uint32_t divergentDepth = 0;
+    uniformInstructionsCount = 0;
+
+    const size_t headerSize = sizeof(Command::CommandStoreIsa) / sizeof(uint32_t);
+    for (size_t dwordIndex = headerSize; dwordIndex < data.size();) {
+        Instruction &inst = reinterpret_cast<Instruction &>(data[dwordIndex]);
+        const InstructionOperands operands = getInstructionOperands(inst);
+        dwordIndex += operands.sizeInDwords;
+
+        bool sourcesVarying = false;
+        for (uint32_t sourceIndex = 0; sourceIndex < operands.sourcesCount; sourceIndex++) {
+            sourcesVarying |= isVarying(operands.sources[sourceIndex]);
+        }
+
+        switch (inst.header.opcode) {
+        case Opcode::lduni:
+            // Uniform registers are set to the same values in all threads
+            for (uint32_t uniformIndex = 0; uniformIndex < uniforms.usedRegsCount; uniformIndex++) {
+                varyingComponents[uniforms.regs[uniformIndex].index] = 0;
+            }
+            break;
+        case Opcode::initregs:
+            // Registers, which are neither inputs nor uniforms, are zeroed
+            for (RegisterIndex reg = 0; reg < Isa::generalPurposeRegistersCount; reg++) {
+                if (!isBitSet(inputs.usedRegsMask | uniforms.usedRegsMask, reg)) {
+                    varyingComponents[reg] = 0;
+                }
+            }
+            break;
+        case Opcode::if_:
+            controlFlowFrames.push_back({Opcode::if_, sourcesVarying, varyingComponents, {}});
+            divergentDepth += sourcesVarying;
+            break;
+        case Opcode::else_: {
+            // Only one of the branches is taken, if the condition is uniform, so the state is merged at endif. With
+            // a divergent condition some threads have already executed the first branch, so its writes are varying
+            // in the second one as well. Uniform instructions are executed by the first thread, which may be one of
+            // them.
+            ControlFlowFrame &frame = controlFlowFrames.back();
+            frame.opcode = Opcode::else_;
+            frame.thenState = varyingComponents;
+            varyingComponents = frame.entryState;
+            if (frame.divergent) {
+                for (RegisterIndex reg = 0; reg < Isa::generalPurposeRegistersCount; reg++) {
+                    varyingComponents[reg] |= frame.thenState[reg];
+                }
+            }
+            break;
+        }
+        case Opcode::endif: {
+            const ControlFlowFrame &frame = controlFlowFrames.back();
+            const VaryingComponents &otherBranchState = frame.opcode == Opcode::else_ ? frame.thenState : frame.entryState;
+            for (RegisterIndex reg = 0; reg < Isa::generalPurposeRegistersCount; reg++) {
+                varyingComponents[reg] |= otherBranchState[reg];
+            }
+            divergentDepth -= frame.divergent;
+            controlFlowFrames.pop_back();
+            break;
+        }
+        case Opcode::loop: {
+            for (size_t bodyDwordIndex = dwordIndex, nesting = 1;; ) {
+                const Instruction &bodyInst = reinterpret_cast<const Instruction &>(data[bodyDwordIndex]);
+                const InstructionOperands bodyOperands = getInstructionOperands(bodyInst);
+                bodyDwordIndex += bodyOperands.sizeInDwords;
+                nesting += bodyInst.header.opcode == Opcode::loop;
+                nesting -= bodyInst.header.opcode == Opcode::endloop;
+                if (nesting == 0) {
+                    break;
+                }
+                varyingComponents[bodyOperands.dest] |= bodyOperands.writtenComponents;
+            }
+            controlFlowFrames.push_back({Opcode::loop, true, varyingComponents, {}});
+            divergentDepth++;
+            break;
+        }
+        case Opcode::endloop:
+            divergentDepth--;
+            controlFlowFrames.pop_back();
+            break;
+        default:
+            break;
+        }
+
+        // Only instructions writing registers can be tagged. Control flow and internal instructions always
+        // operate on all threads.
+        if (operands.writtenComponents == 0) {
+            continue;
+        }
+        inst.header.uniform = !sourcesVarying;
+        if (sourcesVarying || divergentDepth > 0) {
+            varyingComponents[operands.dest] |= operands.writtenComponents;
+        } else {
+            varyingComponents[operands.dest] &= ~operands.writtenComponents;
+        }
+        uniformInstructionsCount += inst.header.uniform;
+    }
+}
+
+void PicoGpuBinary::updateControlFlowStack(Opcode opcode) {
+    const auto isInLoop = [this]() {
+        return std::find(controlFlowStack.begin(), controlFlowStack.end(), Opcode::loop) != controlFlowStack.end();
+    };
+
+    switch (opcode) {
+    case Opcode::if_:
+    case Opcode::loop:
+        if (controlFlowStack.size() == Isa::maxControlFlowDepth) {
+            error << "Too deeply nested control flow. Max depth is " << Isa::maxControlFlowDepth;
+            return;
+        }
+        controlFlowStack.push_back(opcode);
+        break;
+    case Opcode::else_:
+        if (controlFlowStack.empty() || controlFlowStack.back() != Opcode::if_) {
+            error << "else without matching if";
+            return;
+        }
+        controlFlowStack.back() = Opcode::else_;
+        break;
+    case Opcode::endif:
+        if (controlFlowStack.empty() || (controlFlowStack.back() != Opcode::if_ && controlFlowStack.back() != Opcode::else_)) {
+            error << "endif without matching if";
+            return;
+        }
+        controlFlowStack.pop_back();
+        break;
+    case Opcode::endloop:
+        if (controlFlowStack.empty() || controlFlowStack.back() != Opcode::loop) {
+            error << "endloop without matching loop";
+            return;
+        }
+        controlFlowStack.pop_back();
+        break;
+    case Opcode::break_:
+        if (!isInLoop()) {
+            error << "break outside of a loop";
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void PicoGpuBinary::specialize(const UniformValues &uniformValues, PicoGpuBinary &outBinary) const {
+    outBinary.reset();
+    if (hasError() || !programType.has_value()) {
+        outBinary.error << "Cannot specialize a binary with errors";
+        return;
+    }
+    outBinary.programType = programType;
+    outBinary.undefinedRegs = undefinedRegs;
+    outBinary.uniformMatrix = uniformMatrix;
+    outBinary.optimize = true;
+    outBinary.inputs = inputs;
+    outBinary.outputs = outputs;
+
+    // Uniforms are not loaded anymore, so initregs zeroes their registers as well. Hence the values have to be set
+    // after it. Components missing in uniform directives are zeroed, the same as by lduni.
+    const size_t headerSize = sizeof(Command::CommandStoreIsa) / sizeof(uint32_t);
+    outBinary.data.assign(data.begin(), data.begin() + headerSize);
+    outBinary.finalizeInputOutputDirectives(IoType::Uniform);
+    const auto encodeUniformValues = [&]() {
+        for (uint32_t uniformIndex = 0; uniformIndex < uniforms.usedRegsCount; uniformIndex++) {
+            const InputOutputRegister &uniform = uniforms.regs[uniformIndex];
+            std::vector<int32_t> values(registerComponentsCount, 0);
+            std::copy_n(uniformValues[uniformIndex].begin(), uniform.componentsCount, values.begin());
+            outBinary.encodeUnaryMathImm(Opcode::init, uniform.index, 0b1111, values);
+        }
+    };
+    bool uniformValuesPending = false;
+    for (size_t dwordIndex = headerSize; dwordIndex < data.size();) {
+        const Instruction &inst = reinterpret_cast<const Instruction &>(data[dwordIndex]);
+        const uint32_t sizeInDwords = getInstructionOperands(inst).sizeInDwords;
+        if (uniformValuesPending && inst.header.opcode != Opcode::initregs) {
+            encodeUniformValues();
+            uniformValuesPending = false;
+        }
+        if (inst.header.opcode == Opcode::lduni) {
+            uniformValuesPending = true;
+        } else {
+            outBinary.data.insert(outBinary.data.end(), data.begin() + dwordIndex, data.begin() + dwordIndex + sizeInDwords);
+        }
+        dwordIndex += sizeInDwords;
+    }
+    if (uniformValuesPending) {
+        encodeUniformValues();
+    }
+
+    outBinary.optimizeInstructions();
+    if (outBinary.hasError()) {
+        return;
+    }
+    outBinary.tagUniformInstructions();
+    outBinary.getStoreIsaCommand().programLength = outBinary.data.size() - headerSize;
+}
+
+bool PicoGpuBinary::serialize(std::ostream &out) const {
+    if (hasError() || !programType.has_value()) {
+        return false;
+    }
+
+    const auto write = [&out](const auto &value) { out.write(reinterpret_cast<const char *>(&value), sizeof(value)); };
+    const uint32_t sizeInDwords = static_cast<uint32_t>(data.size());
+    write(programType.value());
+    write(undefinedRegs);
+    write(uniformMatrix);
+    write(optimize);
+    write(uniformInstructionsCount);
+    write(instructionsCount);
+    write(unoptimizedInstructionsCount);
+    write(inputs);
+    write(outputs);
+    write(uniforms);
+    write(sizeInDwords);
+    out.write(reinterpret_cast<const char *>(data.data()), data.size() * sizeof(uint32_t));
+    return out.good();
+}
+
+bool PicoGpuBinary::deserialize(std::istream &in) {
+    const size_t headerSize = sizeof(Command::CommandStoreIsa) / sizeof(uint32_t);
+    const auto fail = [this, headerSize]() {
+        reset();
+        data.resize(headerSize);
+        return false;
+    };
+    reset();
+
+    const auto read = [&in](auto &value) { return bool(in.read(reinterpret_cast<char *>(&value), sizeof(value))); };
+    Command::ProgramType loadedProgramType = {};
+    uint32_t sizeInDwords = 0;
+    const bool headerRead = read(loadedProgramType) &&
+                            read(undefinedRegs) &&
+                            read(uniformMatrix) &&
+                            read(optimize) &&
+                            read(uniformInstructionsCount) &&
+                            read(instructionsCount) &&
+                            read(unoptimizedInstructionsCount) &&
+                            read(inputs) &&
+                            read(outputs) &&
+                            read(uniforms) &&
+                            read(sizeInDwords);
+    if (!headerRead || sizeInDwords < headerSize || sizeInDwords > headerSize + maxIsaSize) {
+        return fail();
+    }
+
+    data.resize(sizeInDwords);
+    if (!in.read(reinterpret_cast<char *>(data.data()), sizeInDwords * sizeof(uint32_t))) {
+        return fail();
+    }
+    programType = loadedProgramType;
+    return true;
+}
+
 void PicoGpuBinary::setHasNextCommand() {
     getStoreIsaCommand().hasNextCommand = 1;
 }
@@ -4,7 +4,10 @@
 #include "gpu/isa/isa.h"
 #include "gpu/util/error.h"
 
+#include <array>
 #include <cstddef>
+#include <initializer_list>
+#include <istream>
 #include <optional>
 #include <sstream>
 #include <vector>
@@ -20,12 +23,18 @@ public:
         Uniform,
     };
 
+    // Registers from this index upwards are virtual. They are mapped to physical registers in finalizeInstructions().
+    constexpr static RegisterIndex firstVirtualRegister = generalPurposeRegistersCount;
+    static bool isVirtualRegister(RegisterIndex reg) { return reg >= firstVirtualRegister; }
+
     PicoGpuBinary();
     void reset();
 
     void encodeDirectiveInputOutput(RegisterIndex reg, int mask, IoType ioType);
     void encodeDirectiveShaderType(Isa::Command::ProgramType programType);
     void encodeDirectiveUndefinedRegs();
+    void encodeDirectiveUniformMatrix();
+    void encodeDirectiveOptimize();
     void finalizeDirectives();
 
     void encodeNullary(Opcode opcode);
@@ -35,29 +44,81 @@ public:
     void encodeUnaryMathImm(Opcode opcode, RegisterIndex dest, uint32_t destMask, const std::vector<int32_t> &immediateValue);
     void encodeBinaryMathImm(Opcode opcode, RegisterIndex dest, RegisterIndex src, uint32_t destMask, const std::vector<int32_t> &immediateValue);
     void encodeSwizzle(Opcode opcode, RegisterIndex dest, RegisterIndex src, SwizzlePatternComponent x, SwizzlePatternComponent y, SwizzlePatternComponent z, SwizzlePatternComponent w);
+    void encodeCondition(Opcode opcode, RegisterIndex src, SwizzlePatternComponent component);
+    void encodeMatrixMultiply(RegisterIndex dest, RegisterIndex matrix, RegisterIndex src, uint32_t destMask);
+    void encodeUniformMatrixMultiply(RegisterIndex dest, RegisterIndex src, uint32_t destMask);
+    void encodeStore(RegisterIndex address, RegisterIndex src, uint32_t srcMask);
     void finalizeInstructions();
 
     void setHasNextCommand();
 
     auto &getData() { return data; }
+    const auto &getData() const { return data; }
     auto getSizeInBytes() const { return data.size() * sizeof(uint32_t); }
     auto getSizeInDwords() const { return data.size(); }
     auto hasError() const { return !error.str().empty(); }
     auto getError() const { return error.str(); }
     auto isVs() const { return programType.value() == Isa::Command::ProgramType::VertexShader; }
     auto isFs() const { return programType.value() == Isa::Command::ProgramType::FragmentShader; }
+    auto isCs() const { return programType.value() == Isa::Command::ProgramType::ComputeShader; }
+    auto getUniformInstructionsCount() const { return uniformInstructionsCount; }
+    auto getInstructionsCount() const { return instructionsCount; }
+    auto getUnoptimizedInstructionsCount() const { return unoptimizedInstructionsCount; } // same as above, unless #optimize was used
+    auto hasUniformMatrix() const { return uniformMatrix; }
+    auto hasPackedColorOutput() const { return isFs() && outputs.regs[0].componentsCount == 1; } // see f2unorm8 instruction
 
     static bool areShadersCompatible(const PicoGpuBinary &vs, const PicoGpuBinary &fs);
     CustomShaderComponents getVsCustomInputComponents();
     CustomShaderComponents getVsPsCustomComponents();
     CustomShaderComponents getUniforms();
 
+    // Values of uniform registers in the order of uniform directives, the same as in uniformsData of the GPU config
+    using UniformValues = std::array<std::array<int32_t, registerComponentsCount>, maxInputOutputRegisters>;
+
+    // Creates a variant of the program for the given uniform values. The values are set with init instructions instead
+    // of lduni and the program is optimized as if #optimize was used, which passes them to arithmetic as immediates
+    // and removes branches depending only on them. The variant has no uniform directives, so the GPU must be
+    // configured with its getUniforms(). The uniform matrix is still passed per request.
+    void specialize(const UniformValues &uniformValues, PicoGpuBinary &outBinary) const;
+
+    // Stores the whole assembled state, so it can be restored without running the assembler again. Fails for binaries
+    // with errors and for truncated or malformed input.
+    bool serialize(std::ostream &out) const;
+    bool deserialize(std::istream &in);
+
+    // Registers accessed by an instruction. Used by passes analyzing the encoded program.
+    struct InstructionOperands {
+        uint32_t sizeInDwords;
+        RegisterIndex dest;
+        uint32_t writtenComponents; // zero for instructions not writing any register
+        RegisterIndex sources[matrixRowsCount + 1]; // fmatmul reads all rows of the matrix and the vector
+        uint32_t sourcesCount;
+    };
+    static InstructionOperands getInstructionOperands(const Instruction &inst);
+    static void setInstructionRegisters(Instruction &inst, const InstructionOperands &operands);
+    static bool isComponentWise(Opcode opcode); // each component of the result depends only on the same components of sources
+    static uint32_t getUsedImmediateValuesCount(uint32_t destMask, const std::vector<int32_t> &immediateValues);
+
 private:
     // Basic data of the shader binary
     std::ostringstream error = {};
     std::optional<Isa::Command::ProgramType> programType = {};
     bool undefinedRegs = {};
+    bool uniformMatrix = {};
+    bool optimize = {};
     std::vector<uint32_t> data = {};
+    uint32_t uniformInstructionsCount = {}; // instructions computing the same values for all threads
+    uint32_t instructionsCount = {};
+    uint32_t unoptimizedInstructionsCount = {};
+    std::vector<Opcode> controlFlowStack = {}; // currently open if, else and loop instructions
+
+    // Instructions using virtual registers. Encoded instructions can only hold physical registers, so the original
+    // operands are kept until the registers are allocated.
+    struct VirtualRegisterInstruction {
+        size_t dwordIndex;
+        InstructionOperands operands;
+    };
+    std::vector<VirtualRegisterInstruction> virtualRegisterInstructions = {};
 
     // Description of used input and output registers. Per thread inputs/outpus may be hardcoded in GPU,
     // some may be implicitly inserted and some may be defined by the shader code. Uniform values are all
@@ -86,6 +147,12 @@ private:
     // Helper private methods
     Command::CommandStoreIsa &getStoreIsaCommand() { return reinterpret_cast<Command::CommandStoreIsa &>(data[0]); }
     void encodeAttributeInterpolationForFragmentShader();
+    void updateControlFlowStack(Opcode opcode);
+    void recordVirtualRegisters(const void *instruction, RegisterIndex dest, std::initializer_list<RegisterIndex> sources);
+    void allocateVirtualRegisters();
+    void optimizeInstructions();
+    void tagUniformInstructions();
+
     void finalizeInputOutputDirectives(IoType ioType);
     const char *getShaderTypeName();
     static const char *getIoLabel(IoType ioType);
@@ -99,7 +166,11 @@ private:
     }
     template <typename InstructionLayout>
     InstructionLayout *getSpace(uint32_t length) {
-        FATAL_ERROR_IF(data.size() + length - sizeof(Command::CommandStoreIsa) / sizeof(uint32_t) >= Isa::maxIsaSize, "Too long program"); // TODO make this more graceful
+        // The space is allocated even for a too long program, so the instruction can still be encoded. The error is
+        // reported after parsing.
+        if (data.size() + length - sizeof(Command::CommandStoreIsa) / sizeof(uint32_t) >= Isa::maxIsaSize && !hasError()) {
+            error << "Too long program";
+        }
         data.resize(data.size() + length);
         InstructionLayout *space = reinterpret_cast<InstructionLayout *>(data.data() + data.size() - length);
         return space;
@@ -0,0 +1,148 @@
+#include "gpu/isa/assembler/disassembler.h"
+#include "gpu/isa/assembler/pico_gpu_binary.h"
+#include "gpu/isa/assembler/shader_analyzer.h"
+#include "gpu/util/math.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace Isa {
+
+namespace {
+// Registers, which the ShaderUnit waits for before issuing the instruction
+uint16_t getAccessedRegistersMask(const Instruction &inst, const PicoGpuBinary::InstructionOperands &operands) {
+    switch (inst.header.opcode) {
+    case Opcode::else_:
+    case Opcode::endif:
+    case Opcode::loop:
+    case Opcode::endloop:
+        return 0;
+    case Opcode::trap:
+    case Opcode::lduni:
+    case Opcode::initregs:
+        return 0xffff; // internal instructions serialize execution
+    default:
+        break;
+    }
+
+    uint16_t mask = 0;
+    for (uint32_t sourceIndex = 0; sourceIndex < operands.sourcesCount; sourceIndex++) {
+        setBit(mask, operands.sources[sourceIndex]);
+    }
+    if (operands.writtenComponents != 0) {
+        setBit(mask, operands.dest);
+    }
+    return mask;
+}
+
+void analyzeInputsOutputs(const Command::CommandStoreIsa &command, ShaderStatistics &statistics) {
+    const auto addIo = [&statistics](uint32_t count, const RegisterIndex *registers, const NonZeroCount *sizes, uint32_t &outDwords) {
+        for (uint32_t ioIndex = 0; ioIndex < count; ioIndex++) {
+            setBit(statistics.usedRegistersMask, registers[ioIndex]);
+            outDwords += nonZeroCountToInt(sizes[ioIndex]);
+        }
+    };
+    const RegisterIndex inputRegisters[] = {command.inputRegister0, command.inputRegister1, command.inputRegister2};
+    const NonZeroCount inputSizes[] = {command.inputSize0, command.inputSize1, command.inputSize2};
+    const RegisterIndex outputRegisters[] = {command.outputRegister0, command.outputRegister1, command.outputRegister2};
+    const NonZeroCount outputSizes[] = {command.outputSize0, command.outputSize1, command.outputSize2};
+    const RegisterIndex uniformRegisters[] = {command.uniformRegister0, command.uniformRegister1, command.uniformRegister2};
+    const NonZeroCount uniformSizes[] = {command.uniformSize0, command.uniformSize1, command.uniformSize2};
+    const bool isCs = command.programType == Command::ProgramType::ComputeShader; // has no outputs, fields are zeroed
+    addIo(nonZeroCountToInt(command.inputsCount), inputRegisters, inputSizes, statistics.inputDwordsPerThread);
+    addIo(isCs ? 0 : nonZeroCountToInt(command.outputsCount), outputRegisters, outputSizes, statistics.outputDwordsPerThread);
+    addIo(command.uniformsCount, uniformRegisters, uniformSizes, statistics.uniformDwordsPerRequest);
+    if (command.hasUniformMatrix) {
+        statistics.uniformDwordsPerRequest += matrixDwordsCount;
+    }
+}
+} // namespace
+
+ShaderStatistics analyzeShader(const uint32_t *data, size_t sizeInDwords, const ShaderUnitTiming &timing) {
+    ShaderStatistics statistics = {};
+    const size_t headerSize = sizeof(Command::CommandStoreIsa) / sizeof(uint32_t);
+    if (sizeInDwords < headerSize) {
+        return statistics;
+    }
+    analyzeInputsOutputs(*reinterpret_cast<const Command::CommandStoreIsa *>(data), statistics);
+    statistics.sizeInDwords = static_cast<uint32_t>(sizeInDwords - headerSize);
+
+    // Same model as in ShaderUnit::retireInstruction() with all lanes enabled
+    const uint32_t passesCount = (simdSize + timing.lanesPerCycle - 1) / timing.lanesPerCycle;
+    uint32_t issueCycle = 0;
+    uint32_t registerReadyCycles[generalPurposeRegistersCount] = {};
+
+    for (size_t dwordIndex = headerSize; dwordIndex < sizeInDwords;) {
+        const Instruction &inst = *reinterpret_cast<const Instruction *>(data + dwordIndex);
+        const Opcode opcode = inst.header.opcode;
+        if (static_cast<uint32_t>(opcode) >= static_cast<uint32_t>(Opcode::COUNT)) {
+            break;
+        }
+        const PicoGpuBinary::InstructionOperands operands = PicoGpuBinary::getInstructionOperands(inst);
+        dwordIndex += operands.sizeInDwords;
+
+        const bool isUniform = inst.header.uniform && operands.writtenComponents != 0;
+        statistics.instructionsCount++;
+        statistics.uniformInstructionsCount += isUniform;
+        statistics.opcodeCounts[static_cast<size_t>(opcode)]++;
+        statistics.loopsCount += opcode == Opcode::loop;
+
+        const uint16_t accessedRegistersMask = getAccessedRegistersMask(inst, operands);
+        if (opcode != Opcode::trap && opcode != Opcode::lduni && opcode != Opcode::initregs) {
+            statistics.usedRegistersMask |= accessedRegistersMask;
+        }
+
+        if (timing.functionalOnly) {
+            issueCycle++;
+            continue;
+        }
+        for (RegisterIndex registerIndex = 0; registerIndex < generalPurposeRegistersCount; registerIndex++) {
+            if (isBitSet(accessedRegistersMask, registerIndex)) {
+                issueCycle = std::max(issueCycle, registerReadyCycles[registerIndex]);
+            }
+        }
+        const ShaderUnitTiming::OpcodeTiming &opcodeTiming = timing[opcode];
+        const uint32_t nextIssueCycle = issueCycle + (isUniform ? 1 : passesCount) * opcodeTiming.issueCycles;
+        const uint32_t resultReadyCycle = nextIssueCycle - opcodeTiming.issueCycles + opcodeTiming.latency;
+        if (operands.writtenComponents != 0) {
+            registerReadyCycles[operands.dest] = resultReadyCycle;
+        } else if (accessedRegistersMask == 0xffff) {
+            std::fill_n(registerReadyCycles, generalPurposeRegistersCount, resultReadyCycle);
+        }
+        issueCycle = nextIssueCycle;
+    }
+
+    // Results have to be written before outputs are sent, see ShaderUnit::waitForPipelineDrain()
+    statistics.estimatedCycles = std::max(issueCycle, *std::max_element(registerReadyCycles, registerReadyCycles + generalPurposeRegistersCount));
+    return statistics;
+}
+
+void printShaderStatistics(const ShaderStatistics &statistics, std::ostream &out) {
+    out << "Size:                 " << statistics.sizeInDwords << " dwords\n";
+    out << "Instructions:         " << statistics.instructionsCount << " (" << statistics.uniformInstructionsCount << " uniform)\n";
+    out << "Registers used:       " << countBits(statistics.usedRegistersMask) << " (";
+    const char *separator = "";
+    for (RegisterIndex registerIndex = 0; registerIndex < generalPurposeRegistersCount; registerIndex++) {
+        if (isBitSet(statistics.usedRegistersMask, registerIndex)) {
+            out << separator << "r" << registerIndex;
+            separator = " ";
+        }
+    }
+    out << ")\n";
+    out << "Estimated cycles:     " << statistics.estimatedCycles << " per " << simdSize << " threads";
+    if (statistics.loopsCount > 0) {
+        out << " (" << statistics.loopsCount << " loops counted as a single iteration)";
+    }
+    out << "\n";
+    out << "Inputs per thread:    " << statistics.inputDwordsPerThread << " dwords\n";
+    out << "Outputs per thread:   " << statistics.outputDwordsPerThread << " dwords\n";
+    out << "Uniforms per request: " << statistics.uniformDwordsPerRequest << " dwords\n";
+    out << "Instruction mix:\n";
+    for (size_t opcodeIndex = 0; opcodeIndex < static_cast<size_t>(Opcode::COUNT); opcodeIndex++) {
+        if (statistics.opcodeCounts[opcodeIndex] > 0) {
+            out << "  " << std::left << std::setw(12) << getOpcodeName(static_cast<Opcode>(opcodeIndex)) << std::right << statistics.opcodeCounts[opcodeIndex] << "\n";
+        }
+    }
+}
+
+} // namespace Isa
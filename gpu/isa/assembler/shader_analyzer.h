@@ -0,0 +1,36 @@
+#pragma once
+
+#include "gpu/blocks/shader_array/shader_unit_timing.h"
+#include "gpu/isa/isa.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace Isa {
+
+// Cost of a program estimated without simulating it. Data must start with the CommandStoreIsa header, like in
+// PicoGpuBinary::getData(), and includes instructions inserted by the assembler.
+struct ShaderStatistics {
+    uint32_t sizeInDwords = 0; // instructions only, without the command header
+    uint32_t instructionsCount = 0;
+    uint32_t uniformInstructionsCount = 0;
+    uint32_t opcodeCounts[static_cast<size_t>(Opcode::COUNT)] = {}; // instruction mix
+    uint16_t usedRegistersMask = 0;                                  // registers accessed by instructions or directives
+    uint32_t loopsCount = 0;
+
+    // Cycles a ShaderUnit spends on a request of simdSize threads, which all execute every instruction once. Loop
+    // bodies are counted as a single iteration and both paths of each if are taken. Waiting for the TextureUnit
+    // and memory is not included.
+    uint32_t estimatedCycles = 0;
+
+    // Data transferred between the ShaderFrontend and a ShaderUnit
+    uint32_t inputDwordsPerThread = 0;
+    uint32_t outputDwordsPerThread = 0;
+    uint32_t uniformDwordsPerRequest = 0; // including the uniform matrix
+};
+
+ShaderStatistics analyzeShader(const uint32_t *data, size_t sizeInDwords, const ShaderUnitTiming &timing);
+void printShaderStatistics(const ShaderStatistics &statistics, std::ostream &out);
+
+} // namespace Isa
@@ -0,0 +1,195 @@
+#include "gpu/isa/assembler/virtual_register_allocator.h"
+#include "gpu/util/math.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace Isa {
+
+VirtualRegisterAllocator::VirtualRegisterAllocator(uint16_t liveAtStartRegsMask, uint16_t liveAtEndRegsMask)
+    : liveAtStartRegsMask(liveAtStartRegsMask),
+      liveAtEndRegsMask(liveAtEndRegsMask) {}
+
+void VirtualRegisterAllocator::addInstruction(Opcode opcode, const PicoGpuBinary::InstructionOperands &operands) {
+    const uint32_t position = instructionsCount++;
+
+    if (opcode == Opcode::endif || opcode == Opcode::endloop) {
+        controlFlowDepth--;
+    }
+    if (opcode == Opcode::endloop) {
+        loops.push_back({openLoops.back(), position, controlFlowDepth + 1});
+        openLoops.pop_back();
+    }
+
+    bool destIsRead = false;
+    for (uint32_t sourceIndex = 0; sourceIndex < operands.sourcesCount; sourceIndex++) {
+        addOccurrence(operands.sources[sourceIndex], position, false, false, false);
+        destIsRead |= operands.sources[sourceIndex] == operands.dest;
+    }
+    if (operands.writtenComponents != 0) {
+        const bool isFullOverwrite = operands.writtenComponents == 0b1111 && !destIsRead;
+        addOccurrence(operands.dest, position, true, isFullOverwrite, PicoGpuBinary::isComponentWise(opcode) && !destIsRead);
+    }
+
+    if (opcode == Opcode::loop) {
+        openLoops.push_back(position);
+    }
+    if (opcode == Opcode::if_ || opcode == Opcode::loop) {
+        controlFlowDepth++;
+    }
+}
+
+void VirtualRegisterAllocator::addOccurrence(RegisterIndex reg, uint32_t position, bool isWrite, bool isFullOverwrite, bool isComponentWise) {
+    Interval *interval = nullptr;
+    bool isFirst = false;
+    if (PicoGpuBinary::isVirtualRegister(reg)) {
+        const auto [it, inserted] = virtualIntervals.try_emplace(reg);
+        interval = &it->second;
+        isFirst = inserted;
+    } else {
+        interval = &physicalIntervals[reg];
+        isFirst = !physicalUsed[reg];
+        physicalUsed[reg] = true;
+    }
+
+    if (isFirst) {
+        interval->start = position;
+        interval->overwrittenFirst = isFullOverwrite;
+        interval->componentWiseFirst = isWrite && isComponentWise;
+        interval->firstControlFlowDepth = controlFlowDepth;
+    }
+    interval->end = position;
+    interval->written |= isWrite;
+}
+
+bool VirtualRegisterAllocator::overlaps(const Interval &a, const Interval &b) {
+    const auto meetsAtComponentWiseWrite = [](const Interval &first, const Interval &second) {
+        return first.end == second.start && second.componentWiseFirst;
+    };
+    return a.start <= b.end && b.start <= a.end && !meetsAtComponentWiseWrite(a, b) && !meetsAtComponentWiseWrite(b, a);
+}
+
+void VirtualRegisterAllocator::extendIntervalsOverLoops() {
+    const auto extend = [](Interval &interval, const Loop &loop) {
+        if (!overlaps(interval, Interval{loop.start, loop.end})) {
+            return;
+        }
+        const bool isInsideBody = loop.start < interval.start && interval.end < loop.end;
+        if (isInsideBody && interval.overwrittenFirst && interval.firstControlFlowDepth == loop.bodyControlFlowDepth) {
+            return; // every iteration writes a new value before reading it
+        }
+        if (loop.start < interval.start) {
+            interval.start = loop.start;
+            interval.overwrittenFirst = false;
+            interval.componentWiseFirst = false;
+        }
+        interval.end = std::max(interval.end, loop.end);
+    };
+
+    for (const Loop &loop : loops) {
+        for (RegisterIndex reg = 0; reg < generalPurposeRegistersCount; reg++) {
+            if (physicalUsed[reg]) {
+                extend(physicalIntervals[reg], loop);
+            }
+        }
+        for (auto &[reg, interval] : virtualIntervals) {
+            extend(interval, loop);
+        }
+    }
+}
+
+bool VirtualRegisterAllocator::allocate(std::ostream &error) {
+    for (const auto &[reg, interval] : virtualIntervals) {
+        if (!interval.written) {
+            error << "Virtual register v" << reg - PicoGpuBinary::firstVirtualRegister << " is read, but never written";
+            return false;
+        }
+    }
+
+    // Registers set outside of the instruction stream. Physical registers, which may be read before being entirely
+    // overwritten by all threads, including outputs, depend on values set by lduni or initregs, so they are live from
+    // the start as well.
+    for (RegisterIndex reg = 0; reg < generalPurposeRegistersCount; reg++) {
+        Interval &interval = physicalIntervals[reg];
+        const bool isLiveAtStart = isBitSet(liveAtStartRegsMask, reg);
+        const bool isLiveAtEnd = isBitSet(liveAtEndRegsMask, reg);
+        if (!physicalUsed[reg] && !isLiveAtStart && !isLiveAtEnd) {
+            continue;
+        }
+
+        const bool isOverwrittenFirst = physicalUsed[reg] && interval.overwrittenFirst && interval.firstControlFlowDepth == 0;
+        if (isLiveAtStart || !isOverwrittenFirst) {
+            interval.start = 0;
+            interval.overwrittenFirst = false;
+            interval.componentWiseFirst = false;
+        }
+        if (!physicalUsed[reg]) {
+            interval.end = 0;
+        }
+        if (isLiveAtEnd) {
+            interval.end = instructionsCount;
+        }
+        physicalUsed[reg] = true;
+    }
+    extendIntervalsOverLoops();
+
+    std::vector<Interval> occupiedIntervals[generalPurposeRegistersCount] = {};
+    for (RegisterIndex reg = 0; reg < generalPurposeRegistersCount; reg++) {
+        if (physicalUsed[reg]) {
+            occupiedIntervals[reg].push_back(physicalIntervals[reg]);
+        }
+    }
+
+    std::vector<std::pair<RegisterIndex, Interval>> sortedIntervals{virtualIntervals.begin(), virtualIntervals.end()};
+    std::stable_sort(sortedIntervals.begin(), sortedIntervals.end(), [](const auto &a, const auto &b) { return a.second.start < b.second.start; });
+    for (const auto &[virtualReg, interval] : sortedIntervals) {
+        // Registers needed again soon are preferred, so the ones free for longer remain available for longer intervals.
+        // Among equally good registers the one released earliest is chosen.
+        bool found = false;
+        RegisterIndex bestReg = 0;
+        std::pair<int64_t, int64_t> bestKey = {};
+        for (RegisterIndex reg = 0; reg < generalPurposeRegistersCount; reg++) {
+            const std::vector<Interval> &occupied = occupiedIntervals[reg];
+            const auto overlapsInterval = [&interval](const Interval &other) { return overlaps(interval, other); };
+            if (std::any_of(occupied.begin(), occupied.end(), overlapsInterval)) {
+                continue;
+            }
+
+            int64_t nextUsePosition = std::numeric_limits<int64_t>::max();
+            int64_t releasePosition = -1; // never used
+            for (const Interval &other : occupied) {
+                if (other.start >= interval.end) {
+                    nextUsePosition = std::min<int64_t>(nextUsePosition, other.start);
+                }
+                if (other.end <= interval.start) {
+                    releasePosition = std::max<int64_t>(releasePosition, other.end);
+                }
+            }
+            const std::pair<int64_t, int64_t> key = {nextUsePosition, releasePosition};
+            if (!found || key < bestKey) {
+                found = true;
+                bestReg = reg;
+                bestKey = key;
+            }
+        }
+
+        if (!found) {
+            error << "Too many registers in use to allocate v" << virtualReg - PicoGpuBinary::firstVirtualRegister
+                  << ", which is live between instructions " << interval.start << " and " << interval.end
+                  << ". All " << generalPurposeRegistersCount << " registers are occupied in this range";
+            return false;
+        }
+        occupiedIntervals[bestReg].push_back(interval);
+        assignments[virtualReg] = bestReg;
+    }
+    return true;
+}
+
+RegisterIndex VirtualRegisterAllocator::getPhysicalRegister(RegisterIndex reg) const {
+    if (!PicoGpuBinary::isVirtualRegister(reg)) {
+        return reg;
+    }
+    return assignments.at(reg);
+}
+
+} // namespace Isa
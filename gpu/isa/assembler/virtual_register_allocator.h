@@ -0,0 +1,63 @@
+#pragma once
+
+#include "gpu/isa/assembler/pico_gpu_binary.h"
+
+#include <map>
+#include <ostream>
+#include <vector>
+
+namespace Isa {
+
+// Assigns physical registers to virtual registers with linear scan over live intervals. Instructions are numbered in
+// program order and each register lives from its first to its last occurrence. Registers used inside a loop are kept
+// alive for the whole loop, because the next iteration may read them, unless the loop body overwrites them entirely
+// before any use. Branches need no special treatment, since threads skipping a branch never read values written in it.
+//
+// Physical registers referenced directly by the program, including the fragment shader prologue, occupy their own
+// intervals. Inputs and uniforms are alive from the start and outputs until the end of the program. Two intervals
+// may share a register if one ends before the other starts. They may also meet at a single instruction, if it
+// computes each component separately, the same way as "fadd r0 r0 r1" is allowed to overwrite its source.
+//
+// When multiple registers are free, the one released earliest is chosen. Consecutive values then rarely land in the
+// same register, so the ShaderUnit doesn't stall on writes to a register still used by a pending instruction.
+class VirtualRegisterAllocator {
+public:
+    VirtualRegisterAllocator(uint16_t liveAtStartRegsMask, uint16_t liveAtEndRegsMask);
+
+    void addInstruction(Opcode opcode, const PicoGpuBinary::InstructionOperands &operands);
+    bool allocate(std::ostream &error);
+    RegisterIndex getPhysicalRegister(RegisterIndex reg) const;
+
+private:
+    struct Interval {
+        uint32_t start = 0;
+        uint32_t end = 0;
+        bool written = false;
+        bool overwrittenFirst = false;    // first occurrence writes all components without reading them
+        bool componentWiseFirst = false; // first occurrence is a write by a component-wise instruction
+        uint32_t firstControlFlowDepth = 0;
+    };
+    struct Loop {
+        uint32_t start;
+        uint32_t end;
+        uint32_t bodyControlFlowDepth;
+    };
+
+    void addOccurrence(RegisterIndex reg, uint32_t position, bool isWrite, bool isFullOverwrite, bool isComponentWise);
+    void extendIntervalsOverLoops();
+    static bool overlaps(const Interval &a, const Interval &b);
+
+    const uint16_t liveAtStartRegsMask;
+    const uint16_t liveAtEndRegsMask;
+    uint32_t instructionsCount = 0;
+    uint32_t controlFlowDepth = 0;
+    std::vector<uint32_t> openLoops = {};
+    std::vector<Loop> loops = {}; // ordered by end, so inner loops come before outer ones
+
+    Interval physicalIntervals[generalPurposeRegistersCount] = {};
+    bool physicalUsed[generalPurposeRegistersCount] = {};
+    std::map<RegisterIndex, Interval> virtualIntervals = {};
+    std::map<RegisterIndex, RegisterIndex> assignments = {};
+};
+
+} // namespace Isa
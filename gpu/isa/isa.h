@@ -9,7 +9,7 @@ namespace Isa {
 
 // Define general constants used during further definition of the ISA as well as by
 // components using it.
-constexpr inline size_t opcodeBitsize = 6;
+constexpr inline size_t opcodeBitsize = 7;
 constexpr inline size_t simdExponent = 5;
 constexpr inline size_t simdSize = 1 << simdExponent;
 constexpr inline size_t maxIsaSizeExponent = 9;
@@ -21,6 +21,9 @@ constexpr inline size_t maxInputOutputRegisters = 3;
 constexpr inline size_t registerComponentsCountExponent = 2;
 constexpr inline size_t registerComponentsCount = 1 << 2;
 constexpr inline size_t commandSizeInDwords = 3;
+constexpr inline size_t maxControlFlowDepth = 16;
+constexpr inline size_t matrixRowsCount = registerComponentsCount;
+constexpr inline size_t matrixDwordsCount = matrixRowsCount * registerComponentsCount;
 
 using RegisterIndex = uint32_t;
 
@@ -35,6 +38,7 @@ namespace Command {
     enum class ProgramType : uint32_t {
         VertexShader = 0,
         FragmentShader = 1,
+        ComputeShader = 2,
     };
 
     union CommandDummy {
@@ -50,7 +54,7 @@ namespace Command {
             CommandType commandType : 1; // must be CommandType::StoreIsa
             uint32_t hasNextCommand : 1;
             uint32_t programLength : maxIsaSizeExponent;
-            ProgramType programType : 1;
+            ProgramType programType : 2;
 
             NonZeroCount inputsCount : maxInputOutputRegistersExponent;              // the number valid input registers from 1 to 4.
             NonZeroCount inputSize0 : registerComponentsCountExponent;               // the number of components of first input register that will have a meaningful value.
@@ -75,6 +79,8 @@ namespace Command {
             RegisterIndex uniformRegister1 : generalPurposeRegistersCountExponent;
             NonZeroCount uniformSize2 : registerComponentsCountExponent;
             RegisterIndex uniformRegister2 : generalPurposeRegistersCountExponent;
+
+            uint32_t hasUniformMatrix : 1; // a 4x4 matrix is passed per request after the uniforms. It is not stored in registers.
         };
         uint32_t raw[commandSizeInDwords];
     };
@@ -116,6 +122,20 @@ enum class Opcode : uint32_t {
     fnorm,
     fmax,
     fmin,
+    fcmpeq,
+    fcmpne,
+    fcmplt,
+    fcmple,
+    fmatmul,
+    fmatmul_uni,
+    fsqrt,
+    frsq,
+    fexp2,
+    flog2,
+    fsin,
+    fcos,
+    fpow,
+    f2unorm8,
 
     // Integer math
     iadd,
@@ -129,6 +149,30 @@ enum class Opcode : uint32_t {
     ineg,
     imax,
     imin,
+    icmpeq,
+    icmpne,
+    icmplt,
+    icmple,
+    iand,
+    ior,
+    ixor,
+    ishl,
+    ishr,
+
+    // Texture
+    sample,
+
+    // Memory
+    ld, // load components from subsequent dwords starting at address in src.x
+    st, // store components of src2 to subsequent dwords starting at address in src1.x. Dest is unused.
+
+    // Control flow
+    if_,
+    else_,
+    endif,
+    loop,
+    endloop,
+    break_,
 
     // Misc
     init,
@@ -155,13 +199,17 @@ enum class SwizzlePatternComponent : uint32_t {
 namespace InstructionLayouts {
     // This is not an actual instruction layout, but just some type that can be used to extract
     // the opcode.
+    // The uniform bit is common to all layouts. It is set by the assembler for instructions, whose
+    // results are the same for all threads, so the ShaderUnit may compute them only once and broadcast.
     struct Header {
         Opcode opcode : opcodeBitsize;
+        uint32_t uniform : 1;
     };
 
     // An operation without any arguments
     struct Nullary {
         Opcode opcode : opcodeBitsize;
+        uint32_t uniform : 1;
     };
 
     // Any operation, that can take a register, compute something and output to a register
@@ -169,6 +217,7 @@ namespace InstructionLayouts {
     // will be affected (1 bit per channel)
     struct UnaryMath {
         Opcode opcode : opcodeBitsize;
+        uint32_t uniform : 1;
         RegisterIndex dest : generalPurposeRegistersCountExponent;
         RegisterIndex src : generalPurposeRegistersCountExponent;
         uint32_t destMask : 4;
@@ -179,6 +228,7 @@ namespace InstructionLayouts {
     // will be affected (1 bit per channel)
     struct BinaryMath {
         Opcode opcode : opcodeBitsize;
+        uint32_t uniform : 1;
         RegisterIndex dest : generalPurposeRegistersCountExponent;
         RegisterIndex src1 : generalPurposeRegistersCountExponent;
         RegisterIndex src2 : generalPurposeRegistersCountExponent;
@@ -190,6 +240,7 @@ namespace InstructionLayouts {
     // will be affected (1 bit per channel)
     struct TernaryMath {
         Opcode opcode : opcodeBitsize;
+        uint32_t uniform : 1;
         RegisterIndex dest : generalPurposeRegistersCountExponent;
         RegisterIndex src1 : generalPurposeRegistersCountExponent;
         RegisterIndex src2 : generalPurposeRegistersCountExponent;
@@ -203,10 +254,11 @@ namespace InstructionLayouts {
     // can actually take more bytes if immediateValuesCount is greater than 1.
     struct UnaryMathImm {
         Opcode opcode : opcodeBitsize;
+        uint32_t uniform : 1;
         RegisterIndex dest : generalPurposeRegistersCountExponent;
         uint32_t destMask : 4;
         NonZeroCount immediateValuesCount : 2;
-        uint32_t reserved : 16;
+        uint32_t reserved : 14;
         uint32_t immediateValues[1];
     };
 
@@ -216,11 +268,12 @@ namespace InstructionLayouts {
     // can actually take more bytes if immediateValuesCount is greater than 1.
     struct BinaryMathImm {
         Opcode opcode : opcodeBitsize;
+        uint32_t uniform : 1;
         RegisterIndex dest : generalPurposeRegistersCountExponent;
         RegisterIndex src : generalPurposeRegistersCountExponent;
         uint32_t destMask : 4;
         NonZeroCount immediateValuesCount : 2;
-        uint32_t reserved : 12;
+        uint32_t reserved : 10;
         uint32_t immediateValues[1];
     };
 
@@ -228,6 +281,7 @@ namespace InstructionLayouts {
     // The swizzle pattern is 8 bit, 2 bits per component to select either x,y,z or w from src.
     struct Swizzle {
         Opcode opcode : opcodeBitsize;
+        uint32_t uniform : 1;
         RegisterIndex dest : generalPurposeRegistersCountExponent;
         RegisterIndex src : generalPurposeRegistersCountExponent;
         SwizzlePatternComponent patternX : 2;
@@ -235,6 +289,16 @@ namespace InstructionLayouts {
         SwizzlePatternComponent patternZ : 2;
         SwizzlePatternComponent patternW : 2;
     };
+
+    // Control flow operation taking a single component of a register as a condition. Lanes, in which
+    // it is non-zero, are considered true. Jump targets are not encoded. Shader units find matching
+    // instructions of the structured control flow themselves.
+    struct Condition {
+        Opcode opcode : opcodeBitsize;
+        uint32_t uniform : 1;
+        RegisterIndex src : generalPurposeRegistersCountExponent;
+        SwizzlePatternComponent component : 2;
+    };
 } // namespace InstructionLayouts
 
 union Instruction {
@@ -246,8 +310,20 @@ union Instruction {
     InstructionLayouts::UnaryMathImm unaryMathImm;
     InstructionLayouts::BinaryMathImm binaryMathImm;
     InstructionLayouts::Swizzle swizzle;
+    InstructionLayouts::Condition condition;
     uint32_t raw;
 };
+
+// Instructions are variable-length. Register-only layouts take a single dword and layouts with immediates take one
+// dword followed by one dword per immediate value. The union itself is larger only because of the first immediate.
+static_assert(sizeof(InstructionLayouts::Nullary) == sizeof(uint32_t));
+static_assert(sizeof(InstructionLayouts::UnaryMath) == sizeof(uint32_t));
+static_assert(sizeof(InstructionLayouts::BinaryMath) == sizeof(uint32_t));
+static_assert(sizeof(InstructionLayouts::TernaryMath) == sizeof(uint32_t));
+static_assert(sizeof(InstructionLayouts::Swizzle) == sizeof(uint32_t));
+static_assert(sizeof(InstructionLayouts::Condition) == sizeof(uint32_t));
+static_assert(sizeof(InstructionLayouts::UnaryMathImm) == 2 * sizeof(uint32_t));
+static_assert(sizeof(InstructionLayouts::BinaryMathImm) == 2 * sizeof(uint32_t));
 static_assert(sizeof(Instruction) == 8);
 
 }; // namespace Isa
@@ -3,8 +3,14 @@
 #include <iostream>
 #include <systemc.h>
 
+// SystemC may only be used by the thread running the simulation. Other threads, e.g. assembling shaders in parallel,
+// clear this flag, so their fatal errors are only thrown and rethrown by the thread waiting for them.
+inline thread_local bool stopSimulationOnFatalError = true;
+
 [[noreturn]] inline void performAbort() {
-    sc_stop();
+    if (stopSimulationOnFatalError) {
+        sc_stop();
+    }
     throw std::exception{};
 }
 
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "gpu/definitions/types.h"
+#include "gpu/util/error.h"
+
+#include <systemc.h>
+
+// Client side of the memory protocol, shared by all blocks accessing Memory or MemoryController. The ports are passed
+// as the block's memory interface struct. ReadOnly clients do not have outWrite and outData ports, so only reads
+// can be performed on them. Must be called from a process, which waits for the clock.
+//
+// A request is made by asserting outEnable for one cycle along with the address, the number of dwords in the burst
+// and, for writes, the first dword. Remaining dwords of a write are sent one per cycle in the following cycles and
+// inpCompleted is asserted once, when all of them are written. Dwords of a read are returned one per cycle after the
+// initial latency, each of them marked with inpCompleted.
+struct MemoryAccess {
+    template <typename MemoryPorts>
+    static void readBurst(MemoryPorts &memory, MemoryAddressType address, uint32_t *data, size_t sizeInDwords) {
+        FATAL_ERROR_IF(sizeInDwords == 0 || sizeInDwords > maxMemoryBurstLength, "Invalid memory burst length");
+
+        memory.outEnable = 1;
+        memory.outAddress = address;
+        memory.outBurstLength = sizeInDwords;
+        wait();
+        memory.outEnable = 0;
+        memory.outAddress = 0;
+        memory.outBurstLength = 0;
+
+        for (size_t dwordIndex = 0; dwordIndex < sizeInDwords; dwordIndex++) {
+            if (dwordIndex > 0) {
+                wait(); // previous dword was valid only in the last cycle
+            }
+            while (!memory.inpCompleted) {
+                wait();
+            }
+            data[dwordIndex] = memory.inpData.read().to_uint();
+        }
+    }
+
+    template <typename MemoryPorts>
+    static void writeBurst(MemoryPorts &memory, MemoryAddressType address, const uint32_t *data, size_t sizeInDwords, bool repeatFirstDword = false) {
+        FATAL_ERROR_IF(sizeInDwords == 0 || sizeInDwords > maxMemoryBurstLength, "Invalid memory burst length");
+
+        memory.outEnable = 1;
+        memory.outWrite = 1;
+        memory.outAddress = address;
+        memory.outBurstLength = sizeInDwords;
+        memory.outData = data[0];
+        wait();
+        memory.outEnable = 0;
+        memory.outWrite = 0;
+        memory.outAddress = 0;
+        memory.outBurstLength = 0;
+
+        for (size_t dwordIndex = 1; dwordIndex < sizeInDwords; dwordIndex++) {
+            memory.outData = data[repeatFirstDword ? 0 : dwordIndex];
+            wait();
+        }
+        memory.outData = 0;
+
+        while (!memory.inpCompleted) {
+            wait();
+        }
+    }
+
+    template <typename MemoryPorts>
+    static uint32_t read(MemoryPorts &memory, MemoryAddressType address) {
+        uint32_t value = 0;
+        readBurst(memory, address, &value, 1);
+        return value;
+    }
+
+    template <typename MemoryPorts>
+    static void write(MemoryPorts &memory, MemoryAddressType address, uint32_t value) {
+        writeBurst(memory, address, &value, 1);
+    }
+};
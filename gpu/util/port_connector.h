@@ -69,10 +69,6 @@ enum class MemoryClientType {
     ReadOnly,
     WriteOnly,
 };
-enum class MemoryServerType {
-    Normal,
-    SeparateOutData,
-};
 
 struct PortConnector {
     template <typename DataType>
@@ -81,6 +77,12 @@ struct PortConnector {
         out(signal);
     }
 
+    template <typename DataType>
+    void connectPort(sc_in<DataType> &inp, const std::string &name) {
+        auto &signal = signals<DataType>().get(name);
+        inp(signal);
+    }
+
     template <typename DataType>
     void connectPorts(sc_in<DataType> &inp, sc_out<DataType> &out, const std::string &name) {
         auto &signal = signals<DataType>().get(name);
@@ -97,6 +99,15 @@ struct PortConnector {
         out(signal);
     }
 
+    template <typename DataType>
+    void connectPortsMultiple(const std::vector<sc_in<DataType> *> &inp, sc_out<DataType> &out, const std::string &name) {
+        auto &signal = signals<DataType>().get(name);
+        for (sc_in<DataType> *port : inp) {
+            (*port)(signal);
+        }
+        out(signal);
+    }
+
     template <typename SenderType, typename ReceiverType>
     void connectHandshake(SenderType &sender, ReceiverType &receiver, const std::string &signalNamePrefix) {
         using DataType = typename decltype(SenderType::outData)::data_type;
@@ -137,7 +148,7 @@ struct PortConnector {
         }
     }
 
-    template <MemoryClientType clientType = MemoryClientType::ReadWrite, MemoryServerType serverType = MemoryServerType::Normal, typename MemoryClient, typename MemoryServer>
+    template <MemoryClientType clientType = MemoryClientType::ReadWrite, typename MemoryClient, typename MemoryServer>
     void connectMemoryToClient(MemoryClient &client, MemoryServer &memory, const std::string &signalNamePrefix) {
         auto &enable = boolSignals.get(signalNamePrefix + "_enable");
         memory.inpEnable(enable);
@@ -155,18 +166,20 @@ struct PortConnector {
         memory.inpAddress(address);
         client.outAddress(address);
 
+        auto &burstLength = wordSignals.get(signalNamePrefix + "_burstLength");
+        memory.inpBurstLength(burstLength);
+        client.outBurstLength(burstLength);
+
         auto &dataForWrite = dwordSignals.get(signalNamePrefix + "_dataForWrite");
         memory.inpData(dataForWrite);
         if constexpr (clientType != MemoryClientType::ReadOnly) {
             client.outData(dataForWrite);
         }
 
-        if constexpr (serverType == MemoryServerType::Normal) {
-            auto &dataForRead = dwordSignals.get(signalNamePrefix + "_dataForRead");
-            memory.outData(dataForRead);
-            if constexpr (clientType != MemoryClientType::WriteOnly) {
-                client.inpData(dataForRead);
-            }
+        auto &dataForRead = dwordSignals.get(signalNamePrefix + "_dataForRead");
+        memory.outData(dataForRead);
+        if constexpr (clientType != MemoryClientType::WriteOnly) {
+            client.inpData(dataForRead);
         }
 
         auto &completed = boolSignals.get(signalNamePrefix + "_completed");
@@ -176,6 +189,7 @@ struct PortConnector {
 
     void addSignalsToTrace(VcdTrace &trace) {
         dwordSignals.addSignalsToTrace(trace);
+        wordSignals.addSignalsToTrace(trace);
         boolSignals.addSignalsToTrace(trace);
         shadedFragmentSignals.addSignalsToTrace(trace);
     }
@@ -1,6 +1,13 @@
 #include "gpu/isa/assembler/assembler.h"
+#include "gpu/isa/assembler/binary_cache.h"
+#include "gpu/isa/assembler/disassembler.h"
+#include "gpu/isa/assembler/shader_analyzer.h"
+#include "gpu/util/conversions.h"
 #include "gpu/util/log.h"
 
+#include <filesystem>
+#include <sstream>
+#include <string>
 #include <systemc.h>
 
 void expectPass(bool &outSuccess, const char *shaderName, const char *shaderSource) {
@@ -29,6 +36,189 @@ void expectFail(bool &outSuccess, const char *shaderName, const char *expectedEr
     }
 }
 
+void expectUniformInstructions(bool &outSuccess, const char *shaderName, uint32_t expectedCount, const char *shaderSource) {
+    Isa::PicoGpuBinary binary = {};
+    int result = Isa::assembly(shaderSource, &binary);
+    if (result != 0) {
+        Log() << shaderName << " FAILED TO COMPILE\n";
+        outSuccess = false;
+    } else if (binary.getUniformInstructionsCount() != expectedCount) {
+        Log() << shaderName << " HAS " << binary.getUniformInstructionsCount() << " UNIFORM INSTRUCTIONS, EXPECTED " << expectedCount << "\n";
+        outSuccess = false;
+    } else {
+        Log() << shaderName << " OK\n";
+    }
+}
+
+void expectSameSize(bool &outSuccess, const char *shaderName, const char *shaderSource, const char *referenceShaderSource) {
+    Isa::PicoGpuBinary binary = {};
+    Isa::PicoGpuBinary referenceBinary = {};
+    if (Isa::assembly(shaderSource, &binary) != 0 || Isa::assembly(referenceShaderSource, &referenceBinary) != 0) {
+        Log() << shaderName << " FAILED TO COMPILE\n";
+        outSuccess = false;
+    } else if (binary.getSizeInDwords() != referenceBinary.getSizeInDwords()) {
+        Log() << shaderName << " HAS " << binary.getSizeInDwords() << " DWORDS, EXPECTED " << referenceBinary.getSizeInDwords() << "\n";
+        outSuccess = false;
+    } else {
+        Log() << shaderName << " OK\n";
+    }
+}
+
+void expectInstructionsCount(bool &outSuccess, const char *shaderName, uint32_t expectedCount, uint32_t expectedUnoptimizedCount, const char *shaderSource) {
+    Isa::PicoGpuBinary binary = {};
+    int result = Isa::assembly(shaderSource, &binary);
+    if (result != 0) {
+        Log() << shaderName << " FAILED TO COMPILE\n";
+        outSuccess = false;
+    } else if (binary.getInstructionsCount() != expectedCount || binary.getUnoptimizedInstructionsCount() != expectedUnoptimizedCount) {
+        Log() << shaderName << " HAS " << binary.getInstructionsCount() << " INSTRUCTIONS (" << binary.getUnoptimizedInstructionsCount()
+              << " UNOPTIMIZED), EXPECTED " << expectedCount << " (" << expectedUnoptimizedCount << " UNOPTIMIZED)\n";
+        outSuccess = false;
+    } else {
+        Log() << shaderName << " OK\n";
+    }
+}
+
+void expectCachedBinary(bool &outSuccess, const char *shaderName, const char *shaderSource) {
+    const std::filesystem::path cacheDirectory = std::filesystem::temp_directory_path() / TEST_NAME;
+    std::filesystem::remove_all(cacheDirectory);
+    Isa::BinaryCache cache{cacheDirectory.string()};
+
+    Isa::PicoGpuBinary referenceBinary = {};
+    Isa::PicoGpuBinary storedBinary = {};
+    Isa::PicoGpuBinary loadedBinary = {};
+    if (Isa::assembly(shaderSource, &referenceBinary) != 0 || cache.assembly(shaderSource, &storedBinary) != 0 || cache.assembly(shaderSource, &loadedBinary) != 0) {
+        Log() << shaderName << " FAILED TO COMPILE\n";
+        outSuccess = false;
+    } else if (cache.getMissesCount() != 1 || cache.getHitsCount() != 1) {
+        Log() << shaderName << " HAD " << cache.getMissesCount() << " CACHE MISSES AND " << cache.getHitsCount() << " HITS, EXPECTED 1 AND 1\n";
+        outSuccess = false;
+    } else if (loadedBinary.getData() != referenceBinary.getData() ||
+               loadedBinary.getInstructionsCount() != referenceBinary.getInstructionsCount() ||
+               loadedBinary.getUniformInstructionsCount() != referenceBinary.getUniformInstructionsCount() ||
+               loadedBinary.getUnoptimizedInstructionsCount() != referenceBinary.getUnoptimizedInstructionsCount()) {
+        Log() << shaderName << " LOADED FROM CACHE DIFFERS FROM THE ASSEMBLED ONE\n";
+        outSuccess = false;
+    } else {
+        Log() << shaderName << " OK\n";
+    }
+    std::filesystem::remove_all(cacheDirectory);
+}
+
+void expectBatchSameAsSequential(bool &outSuccess, const char *shaderName, size_t threadsCount, const std::vector<const char *> &shaderSources) {
+    std::vector<Isa::PicoGpuBinary> binaries = {};
+    const std::vector<int> results = Isa::assemblyBatch(shaderSources, binaries, threadsCount);
+    for (size_t shaderIndex = 0; shaderIndex < shaderSources.size(); shaderIndex++) {
+        Isa::PicoGpuBinary referenceBinary = {};
+        const int referenceResult = Isa::assembly(shaderSources[shaderIndex], &referenceBinary);
+        if (results[shaderIndex] != referenceResult || binaries[shaderIndex].getData() != referenceBinary.getData()) {
+            Log() << shaderName << " DIFFERS FROM SEQUENTIAL ASSEMBLY FOR SHADER " << shaderIndex << "\n";
+            outSuccess = false;
+            return;
+        }
+    }
+    Log() << shaderName << " OK\n";
+}
+
+// Errors in shaders assembled on other threads are reported through their binaries, the same as by assembly()
+void expectBatchFail(bool &outSuccess, const char *shaderName, size_t threadsCount, size_t failingShaderIndex, const char *expectedErrorSubstring,
+                     const std::vector<const char *> &shaderSources) {
+    std::vector<Isa::PicoGpuBinary> binaries = {};
+    const std::vector<int> results = Isa::assemblyBatch(shaderSources, binaries, threadsCount);
+    for (size_t shaderIndex = 0; shaderIndex < shaderSources.size(); shaderIndex++) {
+        const bool expectedFail = shaderIndex == failingShaderIndex;
+        if ((results[shaderIndex] != 0) != expectedFail) {
+            Log() << shaderName << (expectedFail ? " COMPILED BUT EXPECTED TO FAIL" : " FAILED TO COMPILE") << " FOR SHADER " << shaderIndex << "\n";
+            outSuccess = false;
+            return;
+        }
+    }
+    if (binaries[failingShaderIndex].getError().find(expectedErrorSubstring) == std::string::npos) {
+        Log() << shaderName << " DID NOT CONTAIN EXPECTED ERROR LOG";
+        Log() << "Error log was: " << binaries[failingShaderIndex].getError() << "\n";
+        outSuccess = false;
+        return;
+    }
+    Log() << shaderName << " OK\n";
+}
+
+// Disassembly of a vertex shader can be assembled again after removing instructions inserted by the assembler
+void expectDisassemblyRoundTrip(bool &outSuccess, const char *shaderName, const char *shaderSource) {
+    Isa::PicoGpuBinary binary = {};
+    if (Isa::assembly(shaderSource, &binary) != 0) {
+        Log() << shaderName << " FAILED TO COMPILE\n";
+        outSuccess = false;
+        return;
+    }
+
+    std::istringstream disassembly{Isa::disassembly(binary.getData().data(), binary.getSizeInDwords())};
+    std::string reassembledSource = {};
+    for (std::string line = {}; std::getline(disassembly, line);) {
+        if (line != "lduni" && line != "initregs") {
+            reassembledSource += line + "\n";
+        }
+    }
+
+    Isa::PicoGpuBinary reassembledBinary = {};
+    if (Isa::assembly(reassembledSource.c_str(), &reassembledBinary) != 0) {
+        Log() << shaderName << " DISASSEMBLY FAILED TO COMPILE\n";
+        Log() << "Disassembly was:\n" << reassembledSource;
+        outSuccess = false;
+    } else if (reassembledBinary.getData() != binary.getData()) {
+        Log() << shaderName << " DISASSEMBLY COMPILED TO A DIFFERENT BINARY\n";
+        Log() << "Disassembly was:\n" << reassembledSource;
+        outSuccess = false;
+    } else {
+        Log() << shaderName << " OK\n";
+    }
+}
+
+void expectEstimatedCycles(bool &outSuccess, const char *shaderName, uint32_t expectedCycles, const char *shaderSource) {
+    Isa::PicoGpuBinary binary = {};
+    if (Isa::assembly(shaderSource, &binary) != 0) {
+        Log() << shaderName << " FAILED TO COMPILE\n";
+        outSuccess = false;
+        return;
+    }
+
+    const Isa::ShaderStatistics statistics = Isa::analyzeShader(binary.getData().data(), binary.getSizeInDwords(), ShaderUnitTiming::createTypical());
+    if (statistics.estimatedCycles != expectedCycles) {
+        Log() << shaderName << " IS ESTIMATED TO TAKE " << statistics.estimatedCycles << " CYCLES, EXPECTED " << expectedCycles << "\n";
+        outSuccess = false;
+    } else {
+        Log() << shaderName << " OK\n";
+    }
+}
+
+// Specialized shader must be encoded the same as the reference shader, in which uniforms are written by hand
+void expectSpecialization(bool &outSuccess, const char *shaderName, const Isa::PicoGpuBinary::UniformValues &uniformValues,
+                          const char *shaderSource, const char *referenceShaderSource) {
+    Isa::PicoGpuBinary binary = {};
+    Isa::PicoGpuBinary referenceBinary = {};
+    if (Isa::assembly(shaderSource, &binary) != 0 || Isa::assembly(referenceShaderSource, &referenceBinary) != 0) {
+        Log() << shaderName << " FAILED TO COMPILE\n";
+        outSuccess = false;
+        return;
+    }
+
+    Isa::SpecializationCache cache = {};
+    const Isa::PicoGpuBinary &specializedBinary = cache.get(binary, uniformValues);
+    const Isa::PicoGpuBinary &cachedBinary = cache.get(binary, uniformValues);
+    if (specializedBinary.hasError()) {
+        Log() << shaderName << " FAILED TO SPECIALIZE: " << specializedBinary.getError() << "\n";
+        outSuccess = false;
+    } else if (specializedBinary.getData() != referenceBinary.getData()) {
+        Log() << shaderName << " SPECIALIZED TO A DIFFERENT BINARY\n";
+        Log() << "Disassembly was:\n" << Isa::disassembly(specializedBinary.getData().data(), specializedBinary.getSizeInDwords());
+        outSuccess = false;
+    } else if (&cachedBinary != &specializedBinary || cache.getHitsCount() != 1 || cache.getMissesCount() != 1) {
+        Log() << shaderName << " WAS NOT CACHED\n";
+        outSuccess = false;
+    } else {
+        Log() << shaderName << " OK\n";
+    }
+}
+
 int sc_main(int argc, char *argv[]) {
     bool success = true;
     int count = 0;
@@ -68,6 +258,11 @@ int sc_main(int argc, char *argv[]) {
                "fadd r2 r2 r2\n"
                "mov r12 r2\n"
                "swizzle r12 r12.wzyx\n");
+    expectPass(success, "Packed color output FS",
+               "#fragmentShader\n"
+               "#input r0.xyzw\n"
+               "#output r12.x\n"
+               "f2unorm8 r12.x r0\n");
     expectPass(success, "Arg auto passthrough FS",
                "#vertexShader\n"
                "#input r0.xyzw\n"
@@ -80,6 +275,30 @@ int sc_main(int argc, char *argv[]) {
                "#undefinedRegs\n"
                "mov r0 r0");
 
+    expectPass(success, "Control flow",
+               "#vertexShader\n"
+               "#input r0.xyzw\n"
+               "#output r12.xyzw\n"
+               "fcmplt r1.x r0 r0\n"
+               "if r1.x\n"
+               "    loop\n"
+               "        break r1.x\n"
+               "        if r0.y\n"
+               "            break r0.z\n"
+               "        endif\n"
+               "    endloop\n"
+               "else\n"
+               "    mov r12 r0\n"
+               "endif\n");
+    expectPass(success, "Compute shader",
+               "#computeShader\n"
+               "#input r0.x\n"
+               "#uniform r1.x\n"
+               "imul r2.x r0 4\n"
+               "iadd r2.x r2 r1\n"
+               "ld r3.xy r2\n"
+               "st r2 r3.y\n");
+
     expectFail(success, "No instructions",
                "", // TODO error is printed to stdout, so we cannot check for it (same for all cases that have this empty)
                "#vertexShader\n"
@@ -229,5 +448,470 @@ int sc_main(int argc, char *argv[]) {
                "#undefinedRegs\n"
                "mov r0 r0\n");
 
+    expectFail(success, "Outputs CS",
+               "ComputeShader cannot use output registers. Results have to be stored to memory",
+               "#computeShader\n"
+               "#input r0.x\n"
+               "#output r12.xyzw\n"
+               "mov r12 r0\n");
+
+    expectFail(success, "Wrong input components CS",
+               "ComputeShader must use exactly one single-component input register for the thread id",
+               "#computeShader\n"
+               "#input r0.xy\n"
+               "st r0 r0\n");
+
+    expectUniformInstructions(success, "Uniform instructions", 2,
+                              "#vertexShader\n"
+                              "#input r0.xyzw\n"
+                              "#output r12.xyzw\n"
+                              "#uniform r1.xyzw\n"
+                              "fmul r2 r1 r1\n"
+                              "fadd r3 r2 r1\n"
+                              "fmul r4 r0 r3\n"
+                              "mov r12 r4\n");
+
+    expectUniformInstructions(success, "Uniform instructions partial writes", 2,
+                              "#vertexShader\n"
+                              "#input r0.xyzw\n"
+                              "#output r12.xyzw\n"
+                              "mov r2.x r0\n"
+                              "finit r2.y 1.0\n"
+                              "fadd r3 r2 r2\n"
+                              "finit r2.x 2.0\n"
+                              "fadd r12 r0 r3\n");
+
+    expectSameSize(success, "Repeated immediates",
+                   "#vertexShader\n"
+                   "#input r0.xyzw\n"
+                   "#output r12.xyzw\n"
+                   "finit r1 1.0 2.0 2.0 2.0\n"
+                   "iinit r2.xy 3 4 5 6\n"
+                   "fadd r12 r1 r2\n",
+                   "#vertexShader\n"
+                   "#input r0.xyzw\n"
+                   "#output r12.xyzw\n"
+                   "finit r1 1.0 2.0\n"
+                   "iinit r2.xy 3 4\n"
+                   "fadd r12 r1 r2\n");
+
+    expectUniformInstructions(success, "Uniform load", 1,
+                              "#computeShader\n"
+                              "#input r0.x\n"
+                              "#uniform r1.x\n"
+                              "ld r2 r1\n"
+                              "st r0 r2\n");
+
+    expectFail(success, "Else without if",
+               "else without matching if",
+               "#vertexShader\n"
+               "#input r0.xyzw\n"
+               "#output r12.xyzw\n"
+               "else\n"
+               "endif\n");
+
+    expectFail(success, "Endloop closing if",
+               "endloop without matching loop",
+               "#vertexShader\n"
+               "#input r0.xyzw\n"
+               "#output r12.xyzw\n"
+               "if r0.x\n"
+               "endloop\n");
+
+    expectFail(success, "Break outside of loop",
+               "break outside of a loop",
+               "#vertexShader\n"
+               "#input r0.xyzw\n"
+               "#output r12.xyzw\n"
+               "if r0.x\n"
+               "    break r0.y\n"
+               "endif\n");
+
+    expectFail(success, "Unterminated loop",
+               "loop without matching endloop",
+               "#vertexShader\n"
+               "#input r0.xyzw\n"
+               "#output r12.xyzw\n"
+               "loop\n"
+               "    break r0.x\n");
+
+    expectUniformInstructions(success, "Uniform instructions undefined regs", 2,
+                              "#vertexShader\n"
+                              "#input r0.xyzw\n"
+                              "#output r12.xyzw\n"
+                              "#undefinedRegs\n"
+                              "fadd r2 r3 r3\n"
+                              "finit r3 1.0\n"
+                              "fadd r2 r3 r3\n"
+                              "fadd r12 r0 r2\n");
+
+    expectUniformInstructions(success, "Uniform instructions control flow", 3,
+                              "#vertexShader\n"
+                              "#input r0.xyzw\n"
+                              "#output r12.xyzw\n"
+                              "#uniform r1.xyzw\n"
+                              "if r1.x\n"
+                              "    fadd r2 r1 r1\n" // uniform, condition is uniform
+                              "endif\n"
+                              "if r0.x\n"
+                              "    fadd r3 r1 r1\n" // uniform, but written only in some threads
+                              "endif\n"
+                              "fadd r4 r2 r2\n" // uniform
+                              "fadd r5 r3 r3\n"
+                              "mov r12 r5\n");
+
+    expectPass(success, "Matrix multiply",
+               "#vertexShader\n"
+               "#uniformMatrix\n"
+               "#input r0.xyzw\n"
+               "#output r12.xyzw\n"
+               "fmatmul r1 r12 r0\n"
+               "fmatmul r12.xyz umat r1\n");
+
+    expectFail(success, "Matrix registers out of range",
+               "Matrix in r13 would use registers up to r16",
+               "#vertexShader\n"
+               "#input r0.xyzw\n"
+               "#output r12.xyzw\n"
+               "fmatmul r12 r13 r0\n");
+
+    expectFail(success, "Uniform matrix without directive",
+               "Uniform matrix used without a uniform matrix directive",
+               "#vertexShader\n"
+               "#input r0.xyzw\n"
+               "#output r12.xyzw\n"
+               "fmatmul r12 umat r0\n");
+
+    expectFail(success, "Multiple uniform matrix directives",
+               "Multiple uniform matrix directives",
+               "#vertexShader\n"
+               "#uniformMatrix\n"
+               "#uniformMatrix\n"
+               "#input r0.xyzw\n"
+               "#output r12.xyzw\n"
+               "mov r12 r0\n");
+
+    expectUniformInstructions(success, "Uniform instructions matrix", 2,
+                              "#vertexShader\n"
+                              "#uniformMatrix\n"
+                              "#input r0.xyzw\n"
+                              "#output r12.xyzw\n"
+                              "#uniform r1.xyzw\n"
+                              "fmatmul r2 umat r1\n" // uniform, both the matrix and the vector are uniform
+                              "mov r4 r1\n"          // uniform
+                              "mov r7 r0\n"
+                              "fmatmul r3 r4 r1\n"   // matrix rows include varying r7
+                              "fmatmul r12 umat r0\n");
+
+    expectUniformInstructions(success, "Uniform instructions divergent else", 1,
+                              "#vertexShader\n"
+                              "#input r0.xyzw\n"
+                              "#output r12.xyzw\n"
+                              "#uniform r1.xyzw\n"
+                              "fmul r3 r1 r1\n" // uniform
+                              "if r0.x\n"
+                              "    fadd r1 r0 r0\n"
+                              "else\n"
+                              "    mov r2 r1\n" // r1 was overwritten in threads, which took the first branch
+                              "endif\n"
+                              "fadd r12 r2 r3\n");
+
+    expectInstructionsCount(success, "Unoptimized instructions count", 6, 6,
+                            "#vertexShader\n"
+                            "#input r0.xyzw\n"
+                            "#output r12.xyzw\n"
+                            "fadd r1 r0 r0\n"
+                            "fmul r1 r0 r0\n"
+                            "fmul r2 r0 r0\n"
+                            "mov r12 r1\n");
+
+    expectInstructionsCount(success, "Optimize dead code", 2, 6,
+                            "#vertexShader\n"
+                            "#optimize\n"
+                            "#input r0.xyzw\n"
+                            "#output r12.xyzw\n"
+                            "fadd r1 r0 r0\n" // overwritten
+                            "fmul r1 r0 r0\n"
+                            "fmul r2 r0 r0\n" // never read
+                            "mov r12 r1\n");
+
+    expectInstructionsCount(success, "Optimize multiply-add", 2, 4,
+                            "#vertexShader\n"
+                            "#optimize\n"
+                            "#input r0.xyzw\n"
+                            "#output r12.xyzw\n"
+                            "#uniform r1.xyzw\n"
+                            "fmul r2 r0 r1\n"
+                            "fadd r12 r2 r1\n");
+
+    expectSameSize(success, "Optimize constant folding",
+                   "#vertexShader\n"
+                   "#optimize\n"
+                   "#input r0.xyzw\n"
+                   "#output r12.xyzw\n"
+                   "finit r1 1.0\n"
+                   "fadd r2 r1 r1\n"
+                   "fmul r3 r2 r2\n"
+                   "fadd r12 r0 r3\n",
+                   "#vertexShader\n"
+                   "#optimize\n"
+                   "#input r0.xyzw\n"
+                   "#output r12.xyzw\n"
+                   "finit r3 4.0\n"
+                   "fadd r12 r0 r3\n");
+
+    expectInstructionsCount(success, "Optimize control flow", 6, 7,
+                            "#vertexShader\n"
+                            "#optimize\n"
+                            "#input r0.xyzw\n"
+                            "#output r12.xyzw\n"
+                            "#uniform r1.xyzw\n"
+                            "mov r2 r0\n" // not overwritten, some threads skip the branch
+                            "if r1.x\n"
+                            "    fadd r2 r1 r1\n"
+                            "endif\n"
+                            "mov r12 r2\n");
+
+    expectFail(success, "Multiple optimize directives",
+               "Multiple optimize directives",
+               "#vertexShader\n"
+               "#optimize\n"
+               "#optimize\n"
+               "#input r0.xyzw\n"
+               "#output r12.xyzw\n"
+               "mov r12 r0\n");
+
+    expectSameSize(success, "Virtual registers",
+                   "#vertexShader\n"
+                   "#input r0.xyzw\n"
+                   "#output r12.xyzw\n"
+                   "fmul v0 r0 r0\n"
+                   "fadd v1 v0 r0\n"
+                   "fmul v2 v1 v0\n"
+                   "fadd v3 v2 v2\n"
+                   "fmul v4 v3 v1\n"
+                   "fadd v5 v4 v3\n"
+                   "fmul v6 v5 v5\n"
+                   "fadd v7 v6 v4\n"
+                   "fmul v8 v7 v7\n"
+                   "fadd v9 v8 v6\n"
+                   "fmul v10 v9 v9\n"
+                   "fadd v11 v10 v8\n"
+                   "fmul v12 v11 v11\n"
+                   "fadd v13 v12 v10\n"
+                   "fmul v14 v13 v13\n"
+                   "fadd v15 v14 v12\n"
+                   "fmul v16 v15 v15\n"
+                   "fadd v17 v16 v14\n"
+                   "fadd r12 v17 v16\n",
+                   "#vertexShader\n"
+                   "#input r0.xyzw\n"
+                   "#output r12.xyzw\n"
+                   "fmul r1 r0 r0\n"
+                   "fadd r2 r1 r0\n"
+                   "fmul r3 r2 r1\n"
+                   "fadd r4 r3 r3\n"
+                   "fmul r5 r4 r2\n"
+                   "fadd r6 r5 r4\n"
+                   "fmul r7 r6 r6\n"
+                   "fadd r8 r7 r5\n"
+                   "fmul r9 r8 r8\n"
+                   "fadd r10 r9 r7\n"
+                   "fmul r11 r10 r10\n"
+                   "fadd r13 r11 r9\n"
+                   "fmul r14 r13 r13\n"
+                   "fadd r15 r14 r11\n"
+                   "fmul r1 r15 r15\n"
+                   "fadd r2 r1 r14\n"
+                   "fmul r3 r2 r2\n"
+                   "fadd r4 r3 r1\n"
+                   "fadd r12 r4 r3\n");
+
+    expectPass(success, "Virtual registers in loop",
+               "#vertexShader\n"
+               "#input r0.xyzw\n"
+               "#output r12.xyzw\n"
+               "#uniform r1.x\n"
+               "finit v0 0.0\n"
+               "loop\n"
+               "    fadd v1 v0 r0\n" // v0 is carried between iterations
+               "    fmul v0 v1 v1\n"
+               "    fcmplt v2 v0 r1\n"
+               "    break v2.x\n"
+               "endloop\n"
+               "mov r12 v0\n");
+
+    expectFail(success, "Too many virtual registers",
+               "Too many registers in use",
+               "#vertexShader\n"
+               "#input r0.xyzw\n"
+               "#output r12.xyzw\n"
+               "fmul v0 r0 r0\n"
+               "fmul v1 r0 r0\n"
+               "fmul v2 r0 r0\n"
+               "fmul v3 r0 r0\n"
+               "fmul v4 r0 r0\n"
+               "fmul v5 r0 r0\n"
+               "fmul v6 r0 r0\n"
+               "fmul v7 r0 r0\n"
+               "fmul v8 r0 r0\n"
+               "fmul v9 r0 r0\n"
+               "fmul v10 r0 r0\n"
+               "fmul v11 r0 r0\n"
+               "fmul v12 r0 r0\n"
+               "fmul v13 r0 r0\n"
+               "fmul v14 r0 r0\n"
+               "fmul v15 r0 r0\n"
+               "fadd r12 r12 v0\n"
+               "fadd r12 r12 v1\n"
+               "fadd r12 r12 v2\n"
+               "fadd r12 r12 v3\n"
+               "fadd r12 r12 v4\n"
+               "fadd r12 r12 v5\n"
+               "fadd r12 r12 v6\n"
+               "fadd r12 r12 v7\n"
+               "fadd r12 r12 v8\n"
+               "fadd r12 r12 v9\n"
+               "fadd r12 r12 v10\n"
+               "fadd r12 r12 v11\n"
+               "fadd r12 r12 v12\n"
+               "fadd r12 r12 v13\n"
+               "fadd r12 r12 v14\n"
+               "fadd r12 r12 v15\n");
+
+    expectFail(success, "Virtual register never written",
+               "Virtual register v1 is read, but never written",
+               "#vertexShader\n"
+               "#input r0.xyzw\n"
+               "#output r12.xyzw\n"
+               "fadd r12 r0 v1\n");
+
+    expectFail(success, "Virtual register in directive",
+               "Virtual registers cannot be used in",
+               "#vertexShader\n"
+               "#input v0.xyzw\n"
+               "#output r12.xyzw\n"
+               "mov r12 v0\n");
+
+    expectFail(success, "Virtual register as matrix",
+               "Matrix must be stored in physical registers",
+               "#vertexShader\n"
+               "#input r0.xyzw\n"
+               "#output r12.xyzw\n"
+               "fmatmul r12 v0 r0\n");
+
+    expectCachedBinary(success, "Binary cache",
+                       "#vertexShader\n"
+                       "#optimize\n"
+                       "#input r0.xyzw\n"
+                       "#output r12.xyzw\n"
+                       "#uniform r1.xy\n"
+                       "if r1.x\n"
+                       "    fmul v0 r0 r1\n"
+                       "    fadd r12 v0 r0\n"
+                       "endif\n");
+
+    std::vector<std::string> batchSources = {};
+    for (int shaderIndex = 0; shaderIndex < 64; shaderIndex++) {
+        batchSources.push_back("#vertexShader\n"
+                               "#input r0.xyzw\n"
+                               "#output r12.xyzw\n"
+                               "finit v0 " +
+                               std::to_string(shaderIndex) + ".0\n"
+                               "fmul v1 r0 v0\n" +
+                               std::string(shaderIndex % 8 == 0 ? "fadd r12 v1 r16\n" : "fadd r12 v1 r0\n")); // some fail
+    }
+    std::vector<const char *> batchSourcePointers = {};
+    for (const std::string &source : batchSources) {
+        batchSourcePointers.push_back(source.c_str());
+    }
+    expectBatchSameAsSequential(success, "Batch assembly", 4, batchSourcePointers);
+
+    std::string tooLongSource = "#vertexShader\n"
+                                "#input r0.xyzw\n"
+                                "#output r12.xyzw\n";
+    for (size_t instructionIndex = 0; instructionIndex < Isa::maxIsaSize; instructionIndex++) {
+        tooLongSource += "fadd r12 r0 r0\n";
+    }
+    expectBatchFail(success, "Batch assembly with too long program", 4, 2, "Too long program",
+                    {batchSourcePointers[1], batchSourcePointers[2], tooLongSource.c_str(), batchSourcePointers[3]});
+
+    expectDisassemblyRoundTrip(success, "Disassembly",
+                               "#vertexShader\n"
+                               "#input r0.xyzw\n"
+                               "#input r1.xy\n"
+                               "#output r12.xyzw\n"
+                               "#output r11.xyz\n"
+                               "#uniform r2.xyzw\n"
+                               "#uniformMatrix\n"
+                               "finit r3 1.5 -0.25 0.0001 100.0\n"
+                               "iinit r4.xy 3 -7\n"
+                               "fadd r5.xz r0 0.1\n"
+                               "imul r6 r4 -3\n"
+                               "fmad r7.yw r0 r2 r3\n"
+                               "fcross r8 r0 r3\n"
+                               "fnorm r8.xyz r8\n"
+                               "fmatmul r9 r3 r0\n"
+                               "fmatmul r10.xy umat r0\n"
+                               "swizzle r9 r9.wzyx\n"
+                               "if r2.y\n"
+                               "    mov r11 r9\n"
+                               "else\n"
+                               "    loop\n"
+                               "        fsub r11 r11 r1\n"
+                               "        break r11.z\n"
+                               "    endloop\n"
+                               "endif\n"
+                               "fmul r12 r5 r7\n");
+
+    expectEstimatedCycles(success, "Estimated cycles", 15, // lduni and initregs stall for all registers
+                          "#vertexShader\n"
+                          "#input r0.xyzw\n"
+                          "#output r12.xyzw\n"
+                          "fmul r12 r0 r0\n");
+
+    const auto floatUniform = [](float x, float y, float z, float w) {
+        return std::array<int32_t, Isa::registerComponentsCount>{Conversions::floatBytesToInt(x), Conversions::floatBytesToInt(y),
+                                                                Conversions::floatBytesToInt(z), Conversions::floatBytesToInt(w)};
+    };
+    expectSpecialization(success, "Specialization", {floatUniform(2, 3, 4, 5), floatUniform(0, 1, 1, 1)},
+                         "#vertexShader\n"
+                         "#input r0.xyzw\n"
+                         "#output r12.xyzw\n"
+                         "#uniform r1.xy\n" // z and w are zeroed
+                         "#uniform r2.x\n"
+                         "fmul r3 r0 r1\n"
+                         "if r2.x\n"
+                         "    fadd r12 r3 r0\n"
+                         "else\n"
+                         "    fsub r12 r3 r1\n"
+                         "endif\n",
+                         "#vertexShader\n"
+                         "#optimize\n"
+                         "#input r0.xyzw\n"
+                         "#output r12.xyzw\n"
+                         "fmul r3 r0 2.0 3.0 0.0\n"
+                         "fsub r12 r3 2.0 3.0 0.0\n");
+
+    expectSpecialization(success, "Specialization in loop", {floatUniform(0.5f, 0.5f, 0.5f, 0.5f)},
+                         "#vertexShader\n"
+                         "#input r0.xyzw\n"
+                         "#output r12.xyzw\n"
+                         "#uniform r1.xyzw\n"
+                         "mov r12 r0\n"
+                         "loop\n"
+                         "    fadd r12 r1 r12\n" // uniform is still known after control flow instructions
+                         "    break r12.x\n"
+                         "endloop\n",
+                         "#vertexShader\n"
+                         "#optimize\n"
+                         "#input r0.xyzw\n"
+                         "#output r12.xyzw\n"
+                         "mov r12 r0\n"
+                         "loop\n"
+                         "    fadd r12 r12 0.5\n"
+                         "    break r12.x\n"
+                         "endloop\n");
+
     return success ? 0 : 1;
 }
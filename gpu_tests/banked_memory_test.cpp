@@ -0,0 +1,158 @@
+#include "gpu/blocks/banked_memory.h"
+#include "gpu/blocks/banked_memory_controller.h"
+#include "gpu/util/port_connector.h"
+#include "gpu/util/vcd_trace.h"
+#include "gpu_tests/test_utils.h"
+
+#include <systemc.h>
+#include <vector>
+
+// Two banks with two dwords interleave: 0x0 and 0x4 belong to bank 0, 0x8 and 0xc to bank 1, 0x10 to bank 0 again.
+const MemoryInterleaving interleaving = {2, 2};
+
+struct Request {
+    const char *description;
+    bool write;
+    uint32_t address;
+    std::vector<uint32_t> data;   // burst written or expected to be read
+    std::vector<size_t> latencies; // cycles until each read dword or the whole write is completed
+};
+
+SC_MODULE(Client) {
+    sc_in_clk inpClk;
+    sc_out<bool> outEnable;
+    sc_out<bool> outWrite;
+    sc_out<MemoryAddressType> outAddress;
+    sc_out<MemoryBurstLengthType> outBurstLength;
+    sc_out<MemoryDataType> outData;
+    sc_in<MemoryDataType> inpData;
+    sc_in<bool> inpCompleted;
+
+    // Requests of all clients with the same index are issued in the same cycle
+    constexpr static size_t cyclesPerRequest = 16;
+    const std::vector<Request> requests;
+
+    TESTER(name(), requests.size());
+
+    SC_HAS_PROCESS(Client);
+    Client(sc_module_name name, const std::vector<Request> &requests)
+        : requests(requests) {
+        SC_THREAD(main);
+        sensitive << inpClk.pos();
+    }
+
+    void main() {
+        bool success = true;
+        for (size_t requestIndex = 0; requestIndex < requests.size(); requestIndex++) {
+            const Request &request = requests[requestIndex];
+            const uint64_t currentCycle = static_cast<uint64_t>(sc_time_stamp() / sc_time(1, SC_NS));
+            wait(3 + requestIndex * cyclesPerRequest - currentCycle);
+
+            outEnable = 1;
+            outWrite = request.write;
+            outAddress = request.address;
+            outBurstLength = request.data.size();
+            outData = request.write ? request.data[0] : 0;
+            ASSERT_EQ(false, inpCompleted);
+
+            // Remaining dwords of a write burst are sent in the following cycles
+            size_t completionsCount = 0;
+            for (size_t cycle = 1; cycle <= request.latencies.back(); cycle++) {
+                wait(1);
+                outEnable = 0;
+                outWrite = 0;
+                outData = request.write && cycle < request.data.size() ? request.data[cycle] : 0;
+
+                const bool expectedCompleted = cycle == request.latencies[completionsCount];
+                ASSERT_EQ(expectedCompleted, inpCompleted);
+                if (expectedCompleted && !request.write) {
+                    ASSERT_EQ(request.data[completionsCount], inpData.read());
+                }
+                completionsCount += expectedCompleted;
+            }
+            wait(1);
+            ASSERT_EQ(false, inpCompleted); // ensure this signal was only a pulse
+            ASSERT_EQ(0, inpData.read());
+            SUMMARY_RESULT(request.description);
+        }
+    }
+};
+
+int sc_main(int argc, char *argv[]) {
+    sc_set_time_resolution(100, SC_PS);
+    sc_clock clock("my_clock", 1, SC_NS, 0.5, 0, SC_NS, true);
+
+    PortConnector ports = {};
+
+    // A single request takes 4 cycles: latch + transfer to memory + operation + transfer from memory. Requests to
+    // different banks are served in parallel. A request to a busy bank waits 2 more cycles, until the first one
+    // completes. Client0 wins the round-robin arbitration, because client1 was the last one dispatched before.
+    // Bursts are split at interleave block boundaries. The burst of client0 at 0x24 is served as dword 9 in bank 0,
+    // dwords 10 and 11 in bank 1 and dword 12 in bank 0. Its second part waits until the burst of client1 frees bank 1.
+    // Each part is dispatched when the previous one completes and read dwords are forwarded as soon as they are read.
+    BankedMemory mem("mem", 32, interleaving);
+    BankedMemoryController memController("memController", 2, interleaving);
+    Client client0{"client0", {
+                                  {"Writing 0x11111111 at 0x0 address with client0 in parallel", true, 0x0, {0x11111111}, {4}},
+                                  {"Reading 0x22222222 at 0x8 address with client0 in parallel", false, 0x8, {0x22222222}, {4}},
+                                  {"Writing 0x33333333 at 0x4 address with client0 before client1", true, 0x4, {0x33333333}, {4}},
+                                  {"Reading 0x44444444 at 0x10 address with client0 before client1", false, 0x10, {0x44444444}, {4}},
+                                  {"Writing 4 dwords at 0x24 address across interleave blocks with client0", true, 0x24, {0xa0, 0xa1, 0xa2, 0xa3}, {10}},
+                                  {"Reading 4 dwords at 0x24 address across interleave blocks with client0", false, 0x24, {0xa0, 0xa1, 0xa2, 0xa3}, {4, 7, 8, 10}},
+                              }};
+    Client client1{"client1", {
+                                  {"Writing 0x22222222 at 0x8 address with client1 in parallel", true, 0x8, {0x22222222}, {4}},
+                                  {"Reading 0x11111111 at 0x0 address with client1 in parallel", false, 0x0, {0x11111111}, {4}},
+                                  {"Writing 0x44444444 at 0x10 address with client1 after bank conflict", true, 0x10, {0x44444444}, {6}},
+                                  {"Reading 0x33333333 at 0x4 address with client1 after bank conflict", false, 0x4, {0x33333333}, {6}},
+                                  {"Writing 2 dwords at 0x48 address with client1 in parallel with a burst", true, 0x48, {0xb0, 0xb1}, {5}},
+                                  {"Reading 2 dwords at 0x48 address with client1 in parallel with a burst", false, 0x48, {0xb0, 0xb1}, {4, 5}},
+                              }};
+
+    // Bind memory banks with memController
+    for (size_t bankIndex = 0; bankIndex < interleaving.banksCount; bankIndex++) {
+        ports.connectMemoryToClient(memController.banks[bankIndex], mem.banks[bankIndex], "MEMCTL_MEM_BANK" + std::to_string(bankIndex));
+    }
+
+    // Bind clients with memController. Each of them has its own data bus.
+    ports.connectMemoryToClient(client0, memController.clients[0], "MEMCTL_CLIENT0");
+    ports.connectMemoryToClient(client1, memController.clients[1], "MEMCTL_CLIENT1");
+
+    // Setup trace
+    VcdTrace trace{"banked_memory"};
+    ADD_TRACE(clock);
+    ports.addSignalsToTrace(trace);
+
+    // Bind clock for every component
+    mem.inpClock(clock);
+    memController.inpClock(clock);
+    client0.inpClk(clock);
+    client1.inpClk(clock);
+
+    // Bind profiling ports to dummy signals
+    ports.connectPort(memController.profiling.outBusy, "MEMCTL_busy");
+    ports.connectPort(memController.profiling.outReadsPerformed, "MEMCTL_reads");
+    ports.connectPort(memController.profiling.outWritesPerformed, "MEMCTL_writes");
+    ports.connectPort(memController.profiling.outBytesTransferred, "MEMCTL_bytesTransferred");
+    for (size_t bankIndex = 0; bankIndex < interleaving.banksCount; bankIndex++) {
+        ports.connectPort(memController.profiling.outBankConflicts[bankIndex], "MEMCTL_bankConflicts" + std::to_string(bankIndex));
+    }
+
+    sc_start({100, SC_NS});
+
+    int result = client0.verify() || client1.verify();
+    const uint32_t expectedProfiling[] = {6, 6, 2, 2};
+    const uint32_t actualProfiling[] = {
+        memController.profiling.outReadsPerformed.read().to_uint(),
+        memController.profiling.outWritesPerformed.read().to_uint(),
+        memController.profiling.outBankConflicts[0].read().to_uint(),
+        memController.profiling.outBankConflicts[1].read().to_uint(),
+    };
+    for (size_t i = 0; i < 4; i++) {
+        if (expectedProfiling[i] != actualProfiling[i]) {
+            Log() << "Profiling counter " << i << " is " << actualProfiling[i] << ", expected " << expectedProfiling[i];
+            result = 1;
+        }
+    }
+    return result;
+}
@@ -111,10 +111,10 @@ int sc_main(int argc, char *argv[]) {
     PortConnector ports = {};
 
     sc_clock clock("clock", 1, SC_NS, 0.5, 0, SC_NS, true);
-    Memory<64> mem{"mem"};
-    std::unique_ptr<MemoryController<1>> memController = {};
+    Memory mem{"mem", 64};
+    std::unique_ptr<MemoryController> memController = {};
     if (useMemoryController) {
-        memController = std::make_unique<MemoryController<1>>("memController");
+        memController = std::make_unique<MemoryController>("memController", 1);
     }
     Blitter blitter("blitter");
     Tester tester("tester", blitter);
@@ -122,8 +122,7 @@ int sc_main(int argc, char *argv[]) {
     // Bind mem with memController or blitter
     if (useMemoryController) {
         ports.connectMemoryToClient(memController->memory, mem, "MEMCTL_MEM");
-        ports.connectMemoryToClient<MemoryClientType::ReadWrite, MemoryServerType::SeparateOutData>(blitter.memory, memController->clients[0], "MEMCTL_BLT");
-        ports.connectPorts(blitter.memory.inpData, memController->outData, "MEMCTL_BLT_dataForRead");
+        ports.connectMemoryToClient(blitter.memory, memController->clients[0], "MEMCTL_BLT");
     } else {
         ports.connectMemoryToClient(blitter.memory, mem, "MEM_BLT");
     }
@@ -147,6 +146,7 @@ int sc_main(int argc, char *argv[]) {
         ports.connectPort(memController->profiling.outBusy, "MEMCTL_busy");
         ports.connectPort(memController->profiling.outReadsPerformed, "MEMCTL_reads");
         ports.connectPort(memController->profiling.outWritesPerformed, "MEMCTL_writes");
+        ports.connectPort(memController->profiling.outBytesTransferred, "MEMCTL_bytesTransferred");
     }
     ports.connectPort(blitter.profiling.outBusy, "BLT_busy");
 
@@ -0,0 +1,95 @@
+#include "gpu/gpu.h"
+#include "gpu/isa/assembler/binary_cache.h"
+#include "gpu/util/conversions.h"
+#include "gpu/util/vcd_trace.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+int sc_main(int argc, char *argv[]) {
+    sc_report_handler::set_actions(SC_INFO, SC_DO_NOTHING);
+
+    // Select GPU topology
+    GpuConfig gpuConfig = {};
+    if (argc > 1) {
+        gpuConfig.shaderUnitsCount = std::stoul(argv[1]);
+    }
+    if (argc > 2 && std::string{argv[2]} == "differential") {
+        gpuConfig.shaderExecutionMode = ShaderExecutionMode::Differential;
+    }
+
+    // Compile the shader. Each thread doubles one vector of the input buffer and stores it in the output buffer.
+    Isa::PicoGpuBinary cs = {};
+    const char *csCode = R"code(
+            #computeShader
+            #input r0.x
+            #uniform r1.xy
+
+            // Calculate addresses of the thread's vectors. Input buffer is at r1.x and output buffer is at r1.y.
+            imul r2.x r0 16
+            iadd r3.x r1 r2
+            swizzle r4 r1.yyyy
+            iadd r4.x r4 r2
+
+            ld r5 r3
+            fmul r5 r5 2.0
+            st r4 r5
+        )code";
+    FATAL_ERROR_IF(Isa::assemblyCached(csCode, &cs), "Failed to assemble CS");
+
+    // Prepare memory
+    const uint32_t groupsCount = 3;
+    const uint32_t componentsCount = groupsCount * Isa::simdSize * Isa::registerComponentsCount;
+    const MemoryAddressType inputAddress = 0;
+    const MemoryAddressType outputAddress = inputAddress + componentsCount * 4;
+    const MemoryAddressType csAddress = outputAddress + componentsCount * 4;
+
+    // Prepare profiling storage
+    std::map<const char *, sc_time> profiling;
+
+    // Initialize GPU
+    sc_clock clock("clock", 1, SC_NS, 0.5, 0, SC_NS, true);
+    Gpu gpu{"Gpu", clock, gpuConfig};
+    gpu.config.CS.shaderAddress = csAddress;
+    gpu.config.CS.uniforms = cs.getUniforms().raw;
+    gpu.config.CS.uniformsData[0][0] = inputAddress;
+    gpu.config.CS.uniformsData[0][1] = outputAddress;
+
+    // Create vcd traces
+    VcdTrace trace{TEST_NAME};
+    gpu.addSignalsToVcdTrace(trace, true, true);
+
+    // Upload the shader and input data
+    auto input = std::make_unique<uint32_t[]>(componentsCount);
+    for (uint32_t i = 0; i < componentsCount; i++) {
+        input[i] = Conversions::floatBytesToUint(static_cast<float>(i) - 100.f);
+    }
+    gpu.commandStreamer.blitToMemory(csAddress, cs.getData().data(), cs.getSizeInDwords(), &profiling["Upload CS"]);
+    gpu.commandStreamer.blitToMemory(inputAddress, input.get(), componentsCount, &profiling["Upload input"]);
+
+    // Run the shader and read results
+    gpu.commandStreamer.dispatch(groupsCount, &profiling["Dispatch"]);
+    auto output = std::make_unique<uint32_t[]>(componentsCount);
+    gpu.commandStreamer.blitFromMemory(outputAddress, output.get(), componentsCount, &profiling["Read output"]);
+    gpu.commandStreamer.waitForIdle();
+
+    // Print profiling results
+    printf("Profiling data:\n");
+    for (auto it : profiling) {
+        printf("\t%s: %s\n", it.first, it.second.to_string().c_str());
+    }
+
+    // Verify results
+    uint32_t failedComponentsCount = 0;
+    for (uint32_t i = 0; i < componentsCount; i++) {
+        const float expected = 2.f * (static_cast<float>(i) - 100.f);
+        const float actual = Conversions::uintBytesToFloat(output[i]);
+        if (expected != actual) {
+            printf("Invalid component %u (expected: %f, actual: %f)\n", i, expected, actual);
+            failedComponentsCount++;
+        }
+    }
+    printf("%s: %s\n", TEST_NAME, failedComponentsCount == 0 ? "PASSED" : "FAILED");
+    return failedComponentsCount == 0 ? 0 : 1;
+}
@@ -1,10 +1,11 @@
 #include "gpu/gpu.h"
-#include "gpu/isa/assembler/assembler.h"
+#include "gpu/isa/assembler/binary_cache.h"
 #include "gpu/util/conversions.h"
 #include "gpu/util/vcd_trace.h"
 
 #include <map>
 #include <memory>
+#include <string>
 #include <third_party/stb_image_write.h>
 
 struct AddressAllocator {
@@ -20,6 +21,8 @@ struct AddressAllocator {
         return result;
     }
 
+    size_t getAllocatedSize() const { return currentOffset; }
+
 private:
     size_t currentOffset = 0;
     size_t memorySize;
@@ -28,6 +31,23 @@ private:
 int sc_main(int argc, char *argv[]) {
     sc_report_handler::set_actions(SC_INFO, SC_DO_NOTHING);
 
+    // Select GPU topology
+    GpuConfig gpuConfig = {};
+    if (argc > 1) {
+        gpuConfig.shaderUnitsCount = std::stoul(argv[1]);
+    }
+    if (argc > 2) {
+        gpuConfig.threadGroupsPerShaderUnit = std::stoul(argv[2]);
+    }
+    if (argc > 3 && std::string{argv[3]} == "native") {
+        gpuConfig.memoryBackend = MemoryBackend::Native;
+    }
+    if (argc > 3 && std::string{argv[3]} == "sparse") {
+        gpuConfig.memoryBackend = MemoryBackend::Sparse;
+        gpuConfig.memorySize = 256 * 1024 * 1024 / 4; // only written pages are allocated
+    }
+    const bool packedColorOutput = argc > 4 && std::string{argv[4]} == "packed";
+
     // Compile shaders
     Isa::PicoGpuBinary vs = {};
     const char *vsCode = R"code(
@@ -48,7 +68,7 @@ int sc_main(int argc, char *argv[]) {
             finit r1 100.f
             fsub r10.y r1 r10
         )code";
-    FATAL_ERROR_IF(Isa::assembly(vsCode, &vs), "Failed to assemble VS");
+    FATAL_ERROR_IF(Isa::assemblyCached(vsCode, &vs), "Failed to assemble VS");
     Isa::PicoGpuBinary fs = {};
     const char *fsCode = R"code(
             #fragmentShader
@@ -59,12 +79,26 @@ int sc_main(int argc, char *argv[]) {
             mov r13.xyz r14
             finit r13.w 1.f
         )code";
-    FATAL_ERROR_IF(Isa::assembly(fsCode, &fs), "Failed to assemble FS");
+    const char *packedFsCode = R"code(
+            #fragmentShader
+            #input r15.xyzw
+            #input r14.xyz
+            #output r13.x
+
+            // Pack the color in the shader, so less data is returned from shader units
+            mov r12.xyz r14
+            finit r12.w 1.f
+            f2unorm8 r13.x r12
+        )code";
+    if (packedColorOutput) {
+        fsCode = packedFsCode;
+    }
+    FATAL_ERROR_IF(Isa::assemblyCached(fsCode, &fs), "Failed to assemble FS");
     FATAL_ERROR_IF(!Isa::PicoGpuBinary::areShadersCompatible(vs, fs), "VS is not compatible with FS");
 
     // Prepare addresses
     printf("Memory layout:\n");
-    AddressAllocator addressAllocator{Gpu::memorySize * 4};
+    AddressAllocator addressAllocator{gpuConfig.memorySize * 4};
     MemoryAddressType vertexBufferAddress = addressAllocator.allocate(54 * 4, "vertexBuffer");
     MemoryAddressType framebufferAddress = addressAllocator.allocate(100 * 100 * 4, "frameBuffer");
     MemoryAddressType depthBufferAddress = addressAllocator.allocate(100 * 100 * 4, "depthBuffer");
@@ -77,7 +111,7 @@ int sc_main(int argc, char *argv[]) {
 
     // Initialize GPU
     sc_clock clock("clock", 1, SC_NS, 0.5, 0, SC_NS, true);
-    Gpu gpu{"Gpu", clock};
+    Gpu gpu{"Gpu", clock, gpuConfig};
     gpu.config.GLOBAL.vsCustomInputComponents = vs.getVsCustomInputComponents().raw;
     gpu.config.GLOBAL.vsPsCustomComponents = vs.getVsPsCustomComponents().raw;
     gpu.config.GLOBAL.framebufferWidth.write(100);
@@ -90,6 +124,7 @@ int sc_main(int argc, char *argv[]) {
     gpu.config.VS.uniformsData[0][1] = Conversions::floatBytesToUint(20.f);
     gpu.config.FS.shaderAddress = fsAddress;
     gpu.config.FS.uniforms = fs.getUniforms().raw;
+    gpu.config.FS.packedColorOutput = fs.hasPackedColorOutput();
     gpu.config.OM.framebufferAddress = framebufferAddress;
     gpu.config.OM.depthEnable = 1;
     gpu.config.OM.depthBufferAddress = depthBufferAddress;
@@ -133,6 +168,13 @@ int sc_main(int argc, char *argv[]) {
     auto pixels = std::make_unique<uint32_t[]>(100 * 100);
     gpu.commandStreamer.blitFromMemory(framebufferAddress, pixels.get(), 100 * 100, &profiling["Read screen"]);
 
+    // Read the last dword of memory, which is in a page never written
+    uint32_t untouchedDword = 0xffffffff;
+    if (gpuConfig.memoryBackend == MemoryBackend::Sparse) {
+        const MemoryAddressType untouchedAddress = (gpuConfig.memorySize - 1) * 4;
+        gpu.commandStreamer.blitFromMemory(untouchedAddress, &untouchedDword, 1, &profiling["Read untouched memory"]);
+    }
+
     // Print profiling results
     gpu.commandStreamer.waitForIdle();
     printf("Profiling data:\n");
@@ -140,6 +182,19 @@ int sc_main(int argc, char *argv[]) {
         printf("\t%s: %s\n", it.first, it.second.to_string().c_str());
     }
 
+    const double cyclesCount = sc_time_stamp() / clock.period();
+    printf("Average memory bandwidth: %.3f bytes per cycle\n", gpu.memoryController.profiling.outBytesTransferred.read().to_uint() / cyclesCount);
+
+    if (gpuConfig.memoryBackend == MemoryBackend::Sparse) {
+        // All allocated buffers are written and they are contiguous from address 0
+        const size_t pageSizeInBytes = MemoryStorage::pageSizeInDwords * 4;
+        const size_t writtenPagesCount = (addressAllocator.getAllocatedSize() + pageSizeInBytes - 1) / pageSizeInBytes;
+        const size_t residentPagesCount = gpu.memory.getResidentPagesCount();
+        printf("Resident memory pages: %zu\n", residentPagesCount);
+        FATAL_ERROR_IF(untouchedDword != 0, "Untouched memory should read as zero. Got 0x", std::hex, untouchedDword);
+        FATAL_ERROR_IF(residentPagesCount != writtenPagesCount, "Expected ", writtenPagesCount, " resident memory pages, got ", residentPagesCount);
+    }
+
     // Save to a file
     stbi_write_png("result.png", 100, 100, 4, pixels.get(), 100 * 4);
 
@@ -4,6 +4,7 @@
 #include "gpu/util/vcd_trace.h"
 #include "gpu_tests/test_utils.h"
 
+#include <string>
 #include <systemc.h>
 
 SC_MODULE(Client0) {
@@ -11,6 +12,7 @@ SC_MODULE(Client0) {
     sc_out<bool> outEnable;
     sc_out<bool> outWrite;
     sc_out<MemoryAddressType> outAddress;
+    sc_out<MemoryBurstLengthType> outBurstLength;
     sc_out<MemoryDataType> outData;
     sc_in<MemoryDataType> inpData;
     sc_in<bool> inpCompleted;
@@ -24,6 +26,7 @@ SC_MODULE(Client0) {
 
     void main() {
         bool success = true;
+        outBurstLength = 1; // only single dword requests are tested
         wait(3);
 
         // Issue a memory write
@@ -92,6 +95,7 @@ SC_MODULE(Client1) {
     sc_out<bool> outEnable;
     sc_out<bool> outWrite;
     sc_out<MemoryAddressType> outAddress;
+    sc_out<MemoryBurstLengthType> outBurstLength;
     sc_out<MemoryDataType> outData;
     sc_in<MemoryDataType> inpData;
     sc_in<bool> inpCompleted;
@@ -105,6 +109,7 @@ SC_MODULE(Client1) {
 
     void main() {
         bool success = true;
+        outBurstLength = 1; // only single dword requests are tested
         wait(14);
 
         // Issue a memory read as client 1
@@ -136,13 +141,10 @@ SC_MODULE(Client1) {
         wait(1);
         outEnable = 0;
         outWrite = 0;
-        // there should be a total of 7 cycles of latency
-        // - 4 for the write on the other client (latch + transfer + operation + transfer)
-        // - 3 for the write on this client (transfer + operation + transfer). Latch latency is hidden.
-        wait(1);
-        ASSERT_EQ(false, inpCompleted);
-        wait(1);
-        ASSERT_EQ(false, inpCompleted);
+        // there should be a total of 5 cycles of latency
+        // - 4 for the write on this client (latch + transfer + operation + transfer)
+        // - 1 for the write on the other client, which is issued to memory in the previous cycle. Requests are
+        //   pipelined, so its remaining latency is hidden.
         wait(1);
         ASSERT_EQ(false, inpCompleted);
         wait(1);
@@ -156,7 +158,7 @@ SC_MODULE(Client1) {
         SUMMARY_RESULT("Writing 0xabcdef12 at 0xc address with client1");
 
         // Issue a memory read simultaneously with the other client
-        wait(10);
+        wait(12);
         outEnable = 1;
         outWrite = 0;
         outAddress = 0x8;
@@ -170,10 +172,6 @@ SC_MODULE(Client1) {
         wait(1);
         ASSERT_EQ(false, inpCompleted);
         wait(1);
-        ASSERT_EQ(false, inpCompleted);
-        wait(1);
-        ASSERT_EQ(false, inpCompleted);
-        wait(1);
         ASSERT_EQ(true, inpCompleted);
         ASSERT_EQ(0x12345678, inpData.read());
         wait(1);
@@ -183,25 +181,157 @@ SC_MODULE(Client1) {
     }
 };
 
+struct BurstRequest {
+    const char *description;
+    size_t issueCycle;
+    bool write;
+    uint32_t address;
+    std::vector<uint32_t> data;    // burst written or expected to be read
+    std::vector<size_t> latencies; // cycles until each read dword or the whole write is completed, empty if not checked
+};
+
+// Issues requests in the given cycles, even if previous ones are not completed yet, and checks their completions
+// in a separate thread.
+SC_MODULE(BurstClient) {
+    sc_in_clk inpClk;
+    sc_out<bool> outEnable;
+    sc_out<bool> outWrite;
+    sc_out<MemoryAddressType> outAddress;
+    sc_out<MemoryBurstLengthType> outBurstLength;
+    sc_out<MemoryDataType> outData;
+    sc_in<MemoryDataType> inpData;
+    sc_in<bool> inpCompleted;
+
+    const std::vector<BurstRequest> requests;
+
+    TESTER(name(), requests.size());
+
+    SC_HAS_PROCESS(BurstClient);
+    BurstClient(sc_module_name name, const std::vector<BurstRequest> &requests)
+        : requests(requests) {
+        SC_THREAD(issueRequests);
+        sensitive << inpClk.pos();
+        SC_THREAD(checkCompletions);
+        sensitive << inpClk.pos();
+    }
+
+    static size_t getCycle() {
+        return static_cast<size_t>(sc_time_stamp() / sc_time(1, SC_NS));
+    }
+
+    void issueRequests() {
+        for (const BurstRequest &request : requests) {
+            while (getCycle() < request.issueCycle) {
+                wait(1);
+            }
+            outEnable = 1;
+            outWrite = request.write;
+            outAddress = request.address;
+            outBurstLength = request.data.size();
+            outData = request.write ? request.data[0] : 0;
+
+            // Remaining dwords of a write burst are sent in the following cycles
+            for (size_t dwordIndex = 1; request.write && dwordIndex < request.data.size(); dwordIndex++) {
+                wait(1);
+                outEnable = 0;
+                outWrite = 0;
+                outData = request.data[dwordIndex];
+            }
+            wait(1);
+            outEnable = 0;
+            outWrite = 0;
+            outData = 0;
+        }
+    }
+
+    void checkCompletions() {
+        bool success = true;
+        for (const BurstRequest &request : requests) {
+            if (request.latencies.empty()) {
+                continue;
+            }
+            for (size_t completionIndex = 0; completionIndex < request.latencies.size(); completionIndex++) {
+                while (getCycle() < request.issueCycle + request.latencies[completionIndex]) {
+                    ASSERT_EQ(false, inpCompleted);
+                    wait(1);
+                }
+                ASSERT_EQ(true, inpCompleted);
+                if (!request.write) {
+                    ASSERT_EQ(request.data[completionIndex], inpData.read());
+                }
+                wait(1);
+            }
+            if (&request == &requests.back()) {
+                // Completions of following requests may come in the next cycle, so only the last one is checked for
+                // being a pulse. Earlier ones are covered by checks of cycles before the next expected completion.
+                ASSERT_EQ(false, inpCompleted);
+            }
+            SUMMARY_RESULT(request.description);
+        }
+    }
+};
+
 int sc_main(int argc, char *argv[]) {
     sc_set_time_resolution(100, SC_PS);
     sc_clock clock("my_clock", 1, SC_NS, 0.5, 0, SC_NS, true);
 
     PortConnector ports = {};
 
-    Memory<32> mem("mem");
-    MemoryController<2> memController("memController");
+    Memory mem("mem", 32);
+    MemoryController memController("memController", 4);
     Client0 client0{"client0"};
     Client1 client1{"client1"};
 
+    // Burst clients start after client0 and client1 are done. A request issued in cycle T is issued to memory in
+    // cycle T+2, if it is free. Read dwords are then forwarded in consecutive cycles starting at T+4 and a write of N
+    // dwords is completed at T+3+N. Memory is free again after N cycles.
+    std::vector<BurstRequest> client2Requests = {
+        {"Writing 4 dwords burst at 0x40 address with client2", 70, true, 0x40, {0xc0, 0xc1, 0xc2, 0xc3}, {7}},
+        {"Reading 4 dwords burst at 0x40 address with client2", 80, false, 0x40, {0xc0, 0xc1, 0xc2, 0xc3}, {4, 5, 6, 7}},
+        {"Reading 3 dwords burst at 0x40 address with client2 interleaved with client3", 90, false, 0x40, {0xc0, 0xc1, 0xc2}, {6, 7, 8}},
+
+        // The second burst is issued to memory right after the first one, so its dwords follow without a gap
+        {"Reading 2 dwords burst at 0x40 address with client2", 100, false, 0x40, {0xc0, 0xc1}, {4, 5}},
+        {"Reading 2 dwords burst at 0x48 address with client2 back-to-back", 101, false, 0x48, {0xc2, 0xc3}, {5, 6}},
+
+        // Several requests queued at once, but not more than requestQueueDepth
+        {"Reading 0xc0 at 0x40 address with client2", 120, false, 0x40, {0xc0}, {4}},
+        {"Reading 0xc1 at 0x44 address with client2 queued", 121, false, 0x44, {0xc1}, {4}},
+        {"Reading 0xc2 at 0x48 address with client2 queued", 122, false, 0x48, {0xc2}, {4}},
+        {"Reading 0xc3 at 0x4c address with client2 queued", 123, false, 0x4c, {0xc3}, {4}},
+    };
+    std::vector<BurstRequest> client3Requests = {
+        // Client2 was served last, so client3 goes first
+        {"Reading 2 dwords burst at 0x48 address with client3 interleaved with client2", 90, false, 0x48, {0xc2, 0xc3}, {4, 5}},
+
+        // The read is issued right after the last dword of the write is sent, so it must see the written data
+        {"Writing 2 dwords burst at 0x50 address with client3", 110, true, 0x50, {0xd0, 0xd1}, {5}},
+        {"Reading 2 dwords burst at 0x50 address with client3 directly after writing", 112, false, 0x50, {0xd0, 0xd1}, {4, 5}},
+    };
+
+    // Read bursts issued in consecutive cycles complete slower than they come, so the queue of client2 is filled up.
+    // Completions are not checked, because the simulation is stopped at the first request not fitting in the queue.
+    const bool queueOverflow = argc > 1 && std::string{argv[1]} == "overflow";
+    const size_t overflowCycle = 70 + memController.requestQueueDepth + 1;
+    if (queueOverflow) {
+        client2Requests.clear();
+        for (size_t requestIndex = 0; requestIndex <= memController.requestQueueDepth; requestIndex++) {
+            client2Requests.push_back({"", 70 + requestIndex, false, 0x40, {0xc0, 0xc1, 0xc2, 0xc3}, {}});
+        }
+        client3Requests.clear();
+    }
+
+    BurstClient client2{"client2", client2Requests};
+    BurstClient client3{"client3", client3Requests};
+
     // Bind mem with memController
     ports.connectMemoryToClient(memController.memory, mem, "MEMCTL_MEM");
 
     // Bind client0 with memController
-    ports.connectMemoryToClient<MemoryClientType::ReadWrite, MemoryServerType::SeparateOutData>(client0, memController.clients[0], "MEMCTL_CLIENT0");
-    ports.connectMemoryToClient<MemoryClientType::ReadWrite, MemoryServerType::SeparateOutData>(client1, memController.clients[1], "MEMCTL_CLIENT1");
-    sc_in<MemoryDataType> *portsForRead[] = {&client0.inpData, &client1.inpData};
-    ports.connectPortsMultiple(portsForRead, memController.outData, "MEMCTL_dataForRead");
+    ports.connectMemoryToClient(client0, memController.clients[0], "MEMCTL_CLIENT0");
+    ports.connectMemoryToClient(client1, memController.clients[1], "MEMCTL_CLIENT1");
+    ports.connectMemoryToClient(client2, memController.clients[2], "MEMCTL_CLIENT2");
+    ports.connectMemoryToClient(client3, memController.clients[3], "MEMCTL_CLIENT3");
 
     // Setup trace
     VcdTrace trace{"memory"};
@@ -213,13 +343,28 @@ int sc_main(int argc, char *argv[]) {
     memController.inpClock(clock);
     client0.inpClk(clock);
     client1.inpClk(clock);
+    client2.inpClk(clock);
+    client3.inpClk(clock);
 
     // Bind profiling ports to dummy signals
     ports.connectPort(memController.profiling.outBusy, "MEMCTL_busy");
     ports.connectPort(memController.profiling.outReadsPerformed, "MEMCTL_reads");
     ports.connectPort(memController.profiling.outWritesPerformed, "MEMCTL_writes");
+    ports.connectPort(memController.profiling.outBytesTransferred, "MEMCTL_bytesTransferred");
+
+    if (queueOverflow) {
+        bool success = false;
+        try {
+            sc_start({130, SC_NS});
+        } catch (const std::exception &) {
+            // Fatal errors stop the simulation by throwing, so the overflow must be reported in the expected cycle
+            success = sc_time_stamp() == sc_time(overflowCycle, SC_NS);
+        }
+        Log() << "Overflowing request queue of client2 " << (success ? "SUCCEEDED" : "FAILED");
+        return !success || client0.verify() || client1.verify();
+    }
 
-    sc_start({65, SC_NS});
+    sc_start({130, SC_NS});
 
-    return client0.verify() || client1.verify();
+    return client0.verify() || client1.verify() || client2.verify() || client3.verify();
 }
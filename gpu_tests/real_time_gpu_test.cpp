@@ -1,5 +1,5 @@
 #include "gpu/gpu.h"
-#include "gpu/isa/assembler/assembler.h"
+#include "gpu/isa/assembler/binary_cache.h"
 #include "gpu/util/conversions.h"
 #include "gpu/util/vcd_trace.h"
 
@@ -41,8 +41,8 @@ public:
         vs.reset();
         fs.reset();
 
-        FATAL_ERROR_IF(Isa::assembly(vsCode, &vs), "Failed to assemble VS");
-        FATAL_ERROR_IF(Isa::assembly(fsCode, &fs), "Failed to assemble FS");
+        FATAL_ERROR_IF(Isa::assemblyCached(vsCode, &vs), "Failed to assemble VS");
+        FATAL_ERROR_IF(Isa::assemblyCached(fsCode, &fs), "Failed to assemble FS");
         FATAL_ERROR_IF(!Isa::PicoGpuBinary::areShadersCompatible(vs, fs), "VS is not compatible with FS");
 
         gpu.config.GLOBAL.vsCustomInputComponents = vs.getVsCustomInputComponents().raw;
@@ -57,6 +57,7 @@ public:
         uploadData(addresses.fs, fs.getData().data(), fs.getSizeInDwords());
         gpu.config.FS.shaderAddress = addresses.fs;
         gpu.config.FS.uniforms = fs.getUniforms().raw;
+        gpu.config.FS.packedColorOutput = fs.hasPackedColorOutput();
     }
 
     void clearFrameBuffer(uint32_t *color) {
@@ -116,7 +117,7 @@ private:
     }
 
     uint32_t allocateDwords(uint32_t dwordsCount, const std::string &label) {
-        if (memoryUsed + dwordsCount >= 4 * Gpu::memorySize) {
+        if (memoryUsed + dwordsCount >= 4 * gpu.gpuConfig.memorySize) {
             summarizeMemory();
             FATAL_ERROR("Out of memory");
         }
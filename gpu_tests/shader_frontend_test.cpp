@@ -7,6 +7,7 @@
 #include "gpu_tests/debug_memory.h"
 #include "gpu_tests/test_utils.h"
 
+#include <set>
 #include <systemc.h>
 
 SC_MODULE(Tester) {
@@ -24,13 +25,17 @@ SC_MODULE(Tester) {
         sc_in<sc_uint<32>> inpData;
     } response;
 
-    TESTER("Tester", 6);
+    TESTER("Tester", 7);
 
     uint32_t longShaderAddress;
     uint32_t shortShaderAddress;
+    constexpr static uint32_t longShaderInstructionsCount = 450;
+
+    size_t threadGroupsPerShaderUnit = 1;
+    sc_time clockPeriod = {};
 
     SC_HAS_PROCESS(Tester);
-    Tester(::sc_core::sc_module_name, DebugMemory<1024> & memory) {
+    Tester(::sc_core::sc_module_name, DebugMemory &memory) {
         generateShaders(memory);
 
         SC_THREAD(main);
@@ -46,6 +51,8 @@ SC_MODULE(Tester) {
         }
 
         expectResponse(123);
+
+        verifyThreadGroupsOverlap();
     }
 
 private:
@@ -79,6 +86,35 @@ private:
     }
 
     void expectResponse(uint32_t clientToken) {
+        bool success = true;
+        const uint32_t receivedClientToken = receiveResponse(success);
+        ASSERT_EQ(clientToken, receivedClientToken);
+        SUMMARY_RESULT("ShaderFrontend test with client token " + std::to_string(clientToken));
+    }
+
+    void verifyThreadGroupsOverlap() {
+        // Long requests are sent back to back. With a single thread group per shader unit, the first two requests
+        // occupy both units and the third one is accepted only after one of them is finished. With more groups, the
+        // unit which has the program loaded accepts all of them while it is still executing the first one.
+        sendRequest(longShaderAddress, 200);
+        const sc_time firstRequestTime = sc_time_stamp();
+        sendRequest(longShaderAddress, 201);
+        sendRequest(longShaderAddress, 202);
+        const uint32_t cyclesBetweenRequests = static_cast<uint32_t>((sc_time_stamp() - firstRequestTime) / clockPeriod);
+
+        // Units working in parallel may finish in any order
+        bool success = true;
+        std::set<uint32_t> receivedClientTokens = {};
+        for (int i = 0; i < 3; i++) {
+            receivedClientTokens.insert(receiveResponse(success));
+        }
+        const std::set<uint32_t> expectedClientTokens = {200, 201, 202};
+        ASSERT_EQ(true, receivedClientTokens == expectedClientTokens);
+        ASSERT_EQ(threadGroupsPerShaderUnit > 1, cyclesBetweenRequests < longShaderInstructionsCount);
+        SUMMARY_RESULT("ShaderFrontend test with overlapping thread groups");
+    }
+
+    uint32_t receiveResponse(bool &success) {
         struct Response {
             ShaderFrontendResponse response;
             uint32_t shaderOutputs[12];
@@ -86,8 +122,6 @@ private:
         Transfer::receiveArray(response.inpSending, response.inpData, response.outReceiving,
                                reinterpret_cast<uint32_t *>(&shaderFrontendResponse), sizeof(Response) / sizeof(uint32_t));
 
-        bool success = true;
-        ASSERT_EQ(clientToken, shaderFrontendResponse.response.dword0.clientToken);
         ASSERT_EQ(110, shaderFrontendResponse.shaderOutputs[0]);
         ASSERT_EQ(1020, shaderFrontendResponse.shaderOutputs[1]);
         ASSERT_EQ(130, shaderFrontendResponse.shaderOutputs[2]);
@@ -100,10 +134,10 @@ private:
         ASSERT_EQ(1100, shaderFrontendResponse.shaderOutputs[9]);
         ASSERT_EQ(210, shaderFrontendResponse.shaderOutputs[10]);
         ASSERT_EQ(1120, shaderFrontendResponse.shaderOutputs[11]);
-        SUMMARY_RESULT("ShaderFrontend test with client token " + std::to_string(clientToken));
+        return shaderFrontendResponse.response.dword0.clientToken;
     }
 
-    void generateShaders(DebugMemory<1024> & memory) {
+    void generateShaders(DebugMemory &memory) {
         Isa::PicoGpuBinary binary = {};
         auto &data = binary.getData();
 
@@ -126,7 +160,7 @@ private:
             "#output r12.xyzw\n"
             "iadd r3.xz r0 100\n"
             "iadd r3.yw r0 1000\n";
-        for (int i = 0; i < 450; i++) {
+        for (int i = 0; i < longShaderInstructionsCount; i++) {
             code += "mov r2 r2\n"; // just some garbage instructions that take time
         }
         code += "mov r12 r3\n";
@@ -143,11 +177,15 @@ int sc_main(int argc, char *argv[]) {
 
     PortConnector ports = {};
 
-    DebugMemory<1024> memory{"memory"};
+    const size_t threadGroupsPerShaderUnit = argc > 1 ? std::stoul(argv[1]) : 1;
+
+    DebugMemory memory{"memory", 1024};
     Tester tester{"tester", memory};
-    ShaderFrontend<1, 2> shaderFrontend{"shaderFrontend"};
-    ShaderUnit shaderUnit0{"shaderUnit0"};
-    ShaderUnit shaderUnit1{"shaderUnit1"};
+    tester.threadGroupsPerShaderUnit = threadGroupsPerShaderUnit;
+    tester.clockPeriod = clock.period();
+    ShaderFrontend shaderFrontend{"shaderFrontend", 1, 2, threadGroupsPerShaderUnit};
+    ShaderUnit shaderUnit0{"shaderUnit0", ShaderExecutionMode::Interpreter, {}, threadGroupsPerShaderUnit};
+    ShaderUnit shaderUnit1{"shaderUnit1", ShaderExecutionMode::Interpreter, {}, threadGroupsPerShaderUnit};
     ShaderUnit *shaderUnits[] = {&shaderUnit0, &shaderUnit1};
 
     // Connect clocks
@@ -179,12 +217,37 @@ int sc_main(int argc, char *argv[]) {
     ports.connectPort(shaderUnit0.profiling.outBusy, "SU0_busy");
     ports.connectPort(shaderUnit0.profiling.outThreadsStarted, "SU0_threadsStarted");
     ports.connectPort(shaderUnit0.profiling.outThreadsFinished, "SU0_threadsFinished");
+    ports.connectPort(shaderUnit0.profiling.outLaneInstructionsSaved, "SU0_laneInstructionsSaved");
     ports.connectPort(shaderUnit1.profiling.outBusy, "SU1_busy");
     ports.connectPort(shaderUnit1.profiling.outThreadsStarted, "SU1_threadsStarted");
     ports.connectPort(shaderUnit1.profiling.outThreadsFinished, "SU1_threadsFinished");
+    ports.connectPort(shaderUnit1.profiling.outLaneInstructionsSaved, "SU1_laneInstructionsSaved");
     ports.connectPort(shaderFrontend.profiling.outBusy, "SF_busy");
     ports.connectPort(shaderFrontend.profiling.outIsaFetches, "SF_isaFetches");
 
+    // Shaders do not sample textures, so TextureUnit interfaces are bound to dummy signals
+    for (int i = 0; i < 2; i++) {
+        const std::string prefix = "SU" + std::to_string(i) + "_TU";
+        ports.connectPort(shaderUnits[i]->texture.request.outSending, prefix + "_req_sending");
+        ports.connectPort(shaderUnits[i]->texture.request.outData, prefix + "_req_data");
+        ports.connectPort(shaderUnits[i]->texture.request.inpReceiving, prefix + "_req_receiving");
+        ports.connectPort(shaderUnits[i]->texture.response.outReceiving, prefix + "_resp_receiving");
+        ports.connectPort(shaderUnits[i]->texture.response.inpSending, prefix + "_resp_sending");
+        ports.connectPort(shaderUnits[i]->texture.response.inpData, prefix + "_resp_data");
+    }
+
+    // Shaders do not access memory, so memory interfaces are bound to dummy signals
+    for (int i = 0; i < 2; i++) {
+        const std::string prefix = "SU" + std::to_string(i) + "_MEM";
+        ports.connectPort(shaderUnits[i]->memory.outEnable, prefix + "_enable");
+        ports.connectPort(shaderUnits[i]->memory.outWrite, prefix + "_write");
+        ports.connectPort(shaderUnits[i]->memory.outAddress, prefix + "_address");
+        ports.connectPort(shaderUnits[i]->memory.outBurstLength, prefix + "_burstLength");
+        ports.connectPort(shaderUnits[i]->memory.outData, prefix + "_dataForWrite");
+        ports.connectPort(shaderUnits[i]->memory.inpData, prefix + "_dataForRead");
+        ports.connectPort(shaderUnits[i]->memory.inpCompleted, prefix + "_completed");
+    }
+
     // Run the simulation
     sc_start({200000, SC_NS});
     return tester.verify();
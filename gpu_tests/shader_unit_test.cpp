@@ -1,4 +1,5 @@
 #include "gpu/blocks/shader_array/shader_unit.h"
+#include "gpu/definitions/custom_components.h"
 #include "gpu/isa/assembler/assembler.h"
 #include "gpu/util/conversions.h"
 #include "gpu/util/port_connector.h"
@@ -23,7 +24,9 @@ SC_MODULE(Tester) {
         sc_in<sc_uint<32>> inpData;
     } response;
 
-    TESTER("Tester", 5);
+    sc_in<sc_uint<32>> inpLaneInstructionsSaved;
+
+    TESTER("Tester", 22);
 
     SC_CTOR(Tester) {
         SC_THREAD(main);
@@ -377,13 +380,578 @@ SC_MODULE(Tester) {
         return testCase;
     }
 
+    TestCase createControlFlowTestCase() {
+        // Sum of numbers from 1 to x, where odd numbers are multiplied by 10. Negative inputs are flagged in w.
+        const char *code = R"code(
+            #vertexShader
+            #input r0.x
+            #output r12.xyzw
+
+            iinit r1 0
+            loop
+                icmple r3.x r0 r1
+                break r3.x
+                iadd r1.x r1 1
+
+                idiv r4.x r1 2
+                imul r4.x r4 2
+                icmpeq r4.x r4 r1
+                if r4.x
+                    iadd r2.x r2 r1
+                else
+                    imul r5.x r1 10
+                    iadd r2.x r2 r5
+                endif
+            endloop
+
+            mov r12 r2
+            iinit r6 0
+            icmplt r6.x r0 r6
+            if r6.x
+                iinit r12.w 1
+            endif
+        )code";
+
+        Isa::PicoGpuBinary binary = {};
+        int result = Isa::assembly(code, &binary);
+        FATAL_ERROR_IF(result != 0, "Failed to assemble code");
+
+        TestCase testCase{"control flow"};
+        testCase.appendStoreCommand(binary);
+        testCase.appendExecuteCommand(intToNonZeroCount(4));
+        testCase.appendShaderInputs({
+            0,
+            3,
+            4,
+            -2,
+        });
+        testCase.appendExpectedOutputs({
+            0, 0, 0, 0,
+            10 + 2 + 30, 0, 0, 0,
+            10 + 2 + 30 + 4, 0, 0, 0,
+            0, 0, 0, 1,
+        });
+        return testCase;
+    }
+
+    TestCase createDivergentBreakTestCase() {
+        // Each lane counts up to its input and breaks inside an if. Lanes, which did not break, have to continue
+        // in the else branch and the rest of the iteration, even when all lanes executing the if branch broke.
+        const char *code = R"code(
+            #vertexShader
+            #input r0.x
+            #output r12.xyzw
+
+            iinit r1 0
+            iinit r2 0
+            iinit r3 0
+            loop
+                iadd r1.x r1 1
+                icmpeq r4.x r1 r0
+                if r4.x
+                    break r4.x
+                    iinit r6.x 7
+                else
+                    iadd r3.x r3 1
+                endif
+                iadd r2.x r2 1
+            endloop
+
+            swizzle r7 r3.xxxx
+            swizzle r8 r1.xxxx
+            swizzle r9 r6.xxxx
+            iinit r5 100
+            iadd r12.x r2 r5
+            mov r12.y r7
+            mov r12.z r8
+            mov r12.w r9
+        )code";
+
+        Isa::PicoGpuBinary binary = {};
+        int result = Isa::assembly(code, &binary);
+        FATAL_ERROR_IF(result != 0, "Failed to assemble code");
+
+        TestCase testCase{"divergent break"};
+        testCase.appendStoreCommand(binary);
+        testCase.appendExecuteCommand(intToNonZeroCount(3));
+        testCase.appendShaderInputs({
+            1,
+            2,
+            3,
+        });
+        testCase.appendExpectedOutputs({
+            100, 0, 1, 0,
+            101, 1, 2, 0,
+            102, 2, 3, 0,
+        });
+        return testCase;
+    }
+
+    TestCase createDivergentElseTestCase() {
+        // The first lane writes r1 in the if branch. Uniform instructions are executed by the first lane, so the
+        // else branch must not treat r1 as uniform, even though it is zeroed in all lanes entering the if.
+        const char *code = R"code(
+            #vertexShader
+            #input r0.x
+            #output r12.xyzw
+
+            iinit r3 0
+            icmpeq r4.x r0 r3
+            if r4.x
+                iinit r1.x 5
+            else
+                iadd r2.x r1 1
+            endif
+
+            swizzle r5 r1.xxxx
+            mov r12.x r2
+            mov r12.y r5
+        )code";
+
+        Isa::PicoGpuBinary binary = {};
+        int result = Isa::assembly(code, &binary);
+        FATAL_ERROR_IF(result != 0, "Failed to assemble code");
+
+        TestCase testCase{"divergent else"};
+        testCase.appendStoreCommand(binary);
+        testCase.appendExecuteCommand(intToNonZeroCount(3));
+        testCase.appendShaderInputs({
+            0,
+            1,
+            2,
+        });
+        testCase.appendExpectedOutputs({
+            0, 5, 0, 0,
+            1, 0, 0, 0,
+            1, 0, 0, 0,
+        });
+        return testCase;
+    }
+
+    TestCase createMatrixTestCase() {
+        const char *code = R"code(
+            #vertexShader
+            #uniformMatrix
+            #input r0.xyzw
+            #output r12.xyzw
+            #output r13.xyzw
+
+            finit r4 1.f 2.f 3.f 4.f
+            finit r5 0.f 1.f 0.f 0.f
+            finit r6 0.f 0.f 2.f 0.f
+            finit r7 1.f 0.f 0.f 1.f
+            fmatmul r12 r4 r0
+
+            finit r13 13.f
+            fmatmul r13.xw umat r0
+        )code";
+
+        Isa::PicoGpuBinary binary = {};
+        int result = Isa::assembly(code, &binary);
+        FATAL_ERROR_IF(result != 0, "Failed to assemble code");
+
+        TestCase testCase{"matrix"};
+        testCase.appendStoreCommand(binary);
+        testCase.appendExecuteCommand(intToNonZeroCount(1));
+        testCase.appendShaderInputs({
+            // Per-thread input
+            Conversions::floatBytesToInt(1),
+            Conversions::floatBytesToInt(2),
+            Conversions::floatBytesToInt(3),
+            Conversions::floatBytesToInt(4),
+            // Uniform matrix
+            Conversions::floatBytesToInt(2), Conversions::floatBytesToInt(0), Conversions::floatBytesToInt(0), Conversions::floatBytesToInt(0),
+            Conversions::floatBytesToInt(0), Conversions::floatBytesToInt(3), Conversions::floatBytesToInt(0), Conversions::floatBytesToInt(0),
+            Conversions::floatBytesToInt(0), Conversions::floatBytesToInt(0), Conversions::floatBytesToInt(4), Conversions::floatBytesToInt(0),
+            Conversions::floatBytesToInt(1), Conversions::floatBytesToInt(1), Conversions::floatBytesToInt(1), Conversions::floatBytesToInt(1),
+        });
+        testCase.appendExpectedOutputs({
+            // Matrix stored in registers
+            Conversions::floatBytesToInt(1.f + 4.f + 9.f + 16.f),
+            Conversions::floatBytesToInt(2.f),
+            Conversions::floatBytesToInt(6.f),
+            Conversions::floatBytesToInt(1.f + 4.f),
+            // Uniform matrix. We initialized everything to 13 and then written result to x,w components
+            Conversions::floatBytesToInt(2.f),
+            Conversions::floatBytesToInt(13.f),
+            Conversions::floatBytesToInt(13.f),
+            Conversions::floatBytesToInt(1.f + 2.f + 3.f + 4.f),
+        });
+
+        testCase.floatOutputs = {true, true, true, true, true, true, true, true};
+        return testCase;
+    }
+
+    TestCase createTranscendentalTestCase() {
+        const char *code = R"code(
+            #vertexShader
+            #input r0.xyzw
+            #output r12.xyzw
+            #output r13.xyzw
+
+            fsqrt r12.x r0
+            frsq  r12.y r0
+            fexp2 r12.z r0
+            flog2 r12.w r0
+            fsin  r13.x r0
+            fcos  r13.y r0
+            fpow  r13.zw r0 r0
+        )code";
+
+        Isa::PicoGpuBinary binary = {};
+        int result = Isa::assembly(code, &binary);
+        FATAL_ERROR_IF(result != 0, "Failed to assemble code");
+
+        TestCase testCase{"transcendental"};
+        testCase.appendStoreCommand(binary);
+        testCase.appendExecuteCommand(intToNonZeroCount(1));
+        testCase.appendShaderInputs({
+            Conversions::floatBytesToInt(16),
+            Conversions::floatBytesToInt(4),
+            Conversions::floatBytesToInt(3),
+            Conversions::floatBytesToInt(8),
+        });
+        testCase.appendExpectedOutputs({
+            Conversions::floatBytesToInt(4.f),
+            Conversions::floatBytesToInt(0.5f),
+            Conversions::floatBytesToInt(8.f),
+            Conversions::floatBytesToInt(3.f),
+            Conversions::floatBytesToInt(sinf(16.f)),
+            Conversions::floatBytesToInt(cosf(4.f)),
+            Conversions::floatBytesToInt(27.f),
+            Conversions::floatBytesToInt(16777216.f),
+        });
+
+        testCase.floatOutputs = {true, true, true, true, true, true, true, true};
+        return testCase;
+    }
+
+    TestCase createBitwiseTestCase() {
+        const char *code = R"code(
+            #vertexShader
+            #input r0.xyzw
+            #input r1.xyzw
+            #output r12.xyzw
+            #output r13.xyzw
+
+            iand r12.x r0 r1
+            ior  r12.y r0 r1
+            ixor r12.z r0 r1
+            ishl r12.w r0 r1
+            ishr r13.xw r0 r1
+            finit r2 1.f 0.5f -1.f 2.f
+            f2unorm8 r13.yz r2
+        )code";
+
+        Isa::PicoGpuBinary binary = {};
+        int result = Isa::assembly(code, &binary);
+        FATAL_ERROR_IF(result != 0, "Failed to assemble code");
+
+        TestCase testCase{"bitwise"};
+        testCase.appendStoreCommand(binary);
+        testCase.appendExecuteCommand(intToNonZeroCount(1));
+        testCase.appendShaderInputs({
+            0b1010, 0b1010, 0b1010, -16,
+            0b1100, 0b1100, 0b1100, 4,
+        });
+        testCase.appendExpectedOutputs({
+            0b1000,
+            0b1110,
+            0b0110,
+            -256,
+            0,
+            static_cast<int32_t>(0xff007fff),
+            static_cast<int32_t>(0xff007fff),
+            0x0fffffff, // shifts are logical
+        });
+        return testCase;
+    }
+
+    TestCase createFaddChainTestCase(const char *name, bool dependent) {
+        // Both programs execute the same number of fadds with the same inputs and outputs. Each instruction of the
+        // dependent chain reads the result of the previous one, so it has to wait for its latency.
+        const char *dependentCode = R"code(
+            #vertexShader
+            #input r0.xyzw
+            #output r12.xyzw
+            fadd r1 r0 r0
+            fadd r2 r1 r1
+            fadd r3 r2 r2
+            fadd r4 r3 r3
+            fadd r5 r4 r4
+            fadd r6 r5 r5
+            fadd r7 r6 r6
+            fadd r12 r7 r7
+        )code";
+        const char *independentCode = R"code(
+            #vertexShader
+            #input r0.xyzw
+            #output r12.xyzw
+            fadd r1 r0 r0
+            fadd r2 r0 r0
+            fadd r3 r0 r0
+            fadd r4 r0 r0
+            fadd r5 r0 r0
+            fadd r6 r0 r0
+            fadd r7 r0 r0
+            fadd r12 r0 r0
+        )code";
+
+        Isa::PicoGpuBinary binary = {};
+        int result = Isa::assembly(dependent ? dependentCode : independentCode, &binary);
+        FATAL_ERROR_IF(result != 0, "Failed to assemble code");
+
+        TestCase testCase{name};
+        testCase.appendStoreCommand(binary);
+        testCase.appendExecuteCommand(intToNonZeroCount(1));
+        const int32_t input = Conversions::floatBytesToInt(1.f);
+        const int32_t output = Conversions::floatBytesToInt(dependent ? 256.f : 2.f);
+        testCase.appendShaderInputs({input, input, input, input});
+        testCase.appendExpectedOutputs({output, output, output, output});
+        return testCase;
+    }
+
+    uint32_t executeTestCaseAndCountCycles(const TestCase &testCase) {
+        const sc_time startTime = sc_time_stamp();
+        executeTestCase(testCase);
+        return static_cast<uint32_t>((sc_time_stamp() - startTime) / clockPeriod);
+    }
+
+    void verifyDependencyStalls() {
+        const uint32_t dependentCycles = executeTestCaseAndCountCycles(createFaddChainTestCase("dependent fadds", true));
+        const uint32_t independentCycles = executeTestCaseAndCountCycles(createFaddChainTestCase("independent fadds", false));
+
+        // With ShaderUnitTiming::createTypical() fadd has a latency of 4 and is issued in 1 cycle. The dependent chain
+        // issues every 4 cycles and its last result is ready 4 cycles after the last issue, i.e. 7 * 4 + 4 = 32
+        // cycles. Independent fadds issue back to back and the last result is ready after 7 + 4 = 11 cycles.
+        // Functional mode spends a cycle per instruction in both cases.
+        bool success = true;
+        const uint32_t expectedDifference = timed ? 32 - 11 : 0;
+        ASSERT_EQ(expectedDifference, dependentCycles - independentCycles);
+        SUMMARY_RESULT("dependency stalls");
+    }
+
+    void verifyLaneInstructionsSaved() {
+        // finit and the first fadd depend only on immediates, so they are executed once instead of in each of the
+        // 3 threads. The last fadd reads an input.
+        const char *code = R"code(
+            #vertexShader
+            #input r0.xyzw
+            #output r12.xyzw
+            finit r1 1.f 2.f 3.f 4.f
+            fadd r2 r1 r1
+            fadd r12 r0 r2
+        )code";
+        Isa::PicoGpuBinary binary = {};
+        int result = Isa::assembly(code, &binary);
+        FATAL_ERROR_IF(result != 0, "Failed to assemble code");
+
+        TestCase testCase{"uniform instructions"};
+        testCase.appendStoreCommand(binary);
+        testCase.appendExecuteCommand(intToNonZeroCount(3));
+        testCase.appendShaderInputs({
+            Conversions::floatBytesToInt(10.f), Conversions::floatBytesToInt(20.f), Conversions::floatBytesToInt(30.f), Conversions::floatBytesToInt(40.f),
+            Conversions::floatBytesToInt(50.f), Conversions::floatBytesToInt(60.f), Conversions::floatBytesToInt(70.f), Conversions::floatBytesToInt(80.f),
+            Conversions::floatBytesToInt(90.f), Conversions::floatBytesToInt(100.f), Conversions::floatBytesToInt(110.f), Conversions::floatBytesToInt(120.f),
+        });
+        testCase.appendExpectedOutputs({
+            Conversions::floatBytesToInt(12.f), Conversions::floatBytesToInt(24.f), Conversions::floatBytesToInt(36.f), Conversions::floatBytesToInt(48.f),
+            Conversions::floatBytesToInt(52.f), Conversions::floatBytesToInt(64.f), Conversions::floatBytesToInt(76.f), Conversions::floatBytesToInt(88.f),
+            Conversions::floatBytesToInt(92.f), Conversions::floatBytesToInt(104.f), Conversions::floatBytesToInt(116.f), Conversions::floatBytesToInt(128.f),
+        });
+
+        const uint32_t savedBefore = inpLaneInstructionsSaved.read().to_uint();
+        executeTestCase(testCase);
+        const uint32_t savedAfter = inpLaneInstructionsSaved.read().to_uint();
+
+        bool success = true;
+        ASSERT_EQ(2u * (3 - 1), savedAfter - savedBefore);
+        SUMMARY_RESULT("lane instructions saved");
+    }
+
+    std::vector<uint32_t> executeProgram(Isa::PicoGpuBinary &binary, uint32_t threadCount, const std::vector<int32_t> &inputs,
+                                         const std::vector<int32_t> &uniforms, size_t outputsCount) {
+        TestCase testCase{"program"};
+        testCase.appendStoreCommand(binary);
+        testCase.appendExecuteCommand(intToNonZeroCount(threadCount));
+        testCase.inputDataStream.insert(testCase.inputDataStream.end(), inputs.begin(), inputs.end());
+        testCase.inputDataStream.insert(testCase.inputDataStream.end(), uniforms.begin(), uniforms.end());
+        Transfer::sendArray(request.inpReceiving, request.outSending, request.outData,
+                            testCase.inputDataStream.data(), testCase.inputDataStream.size());
+
+        std::vector<uint32_t> outputs(outputsCount);
+        Transfer::receiveArray(response.inpSending, response.inpData, response.outReceiving, outputs.data(), outputs.size());
+        return outputs;
+    }
+
+    void verifyOptimization(const char *name, const char *code, uint32_t threadCount, const std::vector<int32_t> &inputs,
+                            const std::vector<int32_t> &uniforms, size_t outputsCount) {
+        Isa::PicoGpuBinary binary = {};
+        Isa::PicoGpuBinary optimizedBinary = {};
+        const std::string optimizedCode = std::string{"#optimize\n"} + code;
+        FATAL_ERROR_IF(Isa::assembly(code, &binary) != 0, "Failed to assemble code");
+        FATAL_ERROR_IF(Isa::assembly(optimizedCode.c_str(), &optimizedBinary) != 0, "Failed to assemble code");
+
+        const std::vector<uint32_t> expectedOutputs = executeProgram(binary, threadCount, inputs, uniforms, outputsCount);
+        const std::vector<uint32_t> actualOutputs = executeProgram(optimizedBinary, threadCount, inputs, uniforms, outputsCount);
+
+        bool success = true;
+        ASSERT_EQ(true, optimizedBinary.getInstructionsCount() < optimizedBinary.getUnoptimizedInstructionsCount());
+        for (size_t i = 0; i < outputsCount; i++) {
+            ASSERT_EQ(expectedOutputs[i], actualOutputs[i]);
+        }
+        SUMMARY_RESULT(name);
+    }
+
+    void verifyOptimizations() {
+        const int32_t one = Conversions::floatBytesToInt(1.f);
+        const int32_t two = Conversions::floatBytesToInt(2.f);
+        const int32_t three = Conversions::floatBytesToInt(3.f);
+        const int32_t zero = Conversions::floatBytesToInt(0.f);
+
+        verifyOptimization("optimized copy propagation", R"code(
+            #vertexShader
+            #input r0.xyzw
+            #output r12.xyzw
+            mov r1 r0
+            mov r2 r1
+            fadd r3 r2 r1
+            mov r4 r3
+            fmul r12 r4 r2
+        )code",
+                           2, {one, two, three, zero, three, two, one, one}, {}, 8);
+
+        // r1 is never overwritten, so it is known after the if. r2 is written in one of the branches, so it is not.
+        verifyOptimization("optimized constant folding", R"code(
+            #vertexShader
+            #input r0.xyzw
+            #output r12.xyzw
+            finit r1 2.f 3.f 4.f 5.f
+            finit r2 1.f
+            if r0.w
+                fadd r2 r2 r1
+            else
+                fsub r2 r2 r1
+            endif
+            fmul r3 r1 r1
+            fadd r12 r2 r3
+            fadd r12 r12 r0
+        )code",
+                           3, {one, two, three, zero, three, two, one, one, zero, zero, zero, one}, {}, 12);
+
+        verifyOptimization("optimized fmad fusion", R"code(
+            #vertexShader
+            #input r0.xyzw
+            #input r1.xyzw
+            #output r12.xyzw
+            fmul r2 r0 r1
+            fadd r12 r2 r0
+        )code",
+                           2, {one, two, three, zero, three, two, one, one, two, two, three, three, one, zero, one, zero}, {}, 8);
+
+        // The uniform is overwritten before being read and no zeroed register is read, so lduni and initregs are removed.
+        // Uniform values are still sent with the request.
+        verifyOptimization("optimized lduni and initregs", R"code(
+            #vertexShader
+            #input r0.xyzw
+            #output r12.xyzw
+            #uniform r1.xyzw
+            finit r1 1.f 2.f 3.f 4.f
+            fadd r12 r0 r1
+        )code",
+                           2, {one, two, three, zero, three, two, one, one}, {three, three, three, three}, 8);
+    }
+
+    void verifySpecialization(const char *name, const char *code, uint32_t threadCount, const std::vector<int32_t> &inputs,
+                              const Isa::PicoGpuBinary::UniformValues &uniformValues, size_t outputsCount) {
+        Isa::PicoGpuBinary binary = {};
+        Isa::PicoGpuBinary specializedBinary = {};
+        FATAL_ERROR_IF(Isa::assembly(code, &binary) != 0, "Failed to assemble code");
+        binary.specialize(uniformValues, specializedBinary);
+        FATAL_ERROR_IF(specializedBinary.hasError(), "Failed to specialize code");
+
+        // The specialized program has no uniforms, so their values are sent only to the original one
+        std::vector<int32_t> uniforms = {};
+        const CustomShaderComponents uniformsInfo = binary.getUniforms();
+        for (size_t uniformIndex = 0u; uniformIndex < uniformsInfo.registersCount; uniformIndex++) {
+            for (size_t componentIndex = 0u; componentIndex < uniformsInfo.getCustomComponents(uniformIndex); componentIndex++) {
+                uniforms.push_back(uniformValues[uniformIndex][componentIndex]);
+            }
+        }
+        const std::vector<uint32_t> expectedOutputs = executeProgram(binary, threadCount, inputs, uniforms, outputsCount);
+        const std::vector<uint32_t> actualOutputs = executeProgram(specializedBinary, threadCount, inputs, {}, outputsCount);
+
+        bool success = true;
+        for (size_t i = 0; i < outputsCount; i++) {
+            ASSERT_EQ(expectedOutputs[i], actualOutputs[i]);
+        }
+        SUMMARY_RESULT(name);
+    }
+
+    void verifySpecializations() {
+        const int32_t one = Conversions::floatBytesToInt(1.f);
+        const int32_t two = Conversions::floatBytesToInt(2.f);
+        const int32_t three = Conversions::floatBytesToInt(3.f);
+        const int32_t zero = Conversions::floatBytesToInt(0.f);
+
+        // The condition depends only on a uniform, so the if branch is removed
+        verifySpecialization("specialized branch", R"code(
+            #vertexShader
+            #input r0.xyzw
+            #output r12.xyzw
+            #uniform r1.xy
+            #uniform r2.x
+            fmul r3 r0 r1
+            if r2.x
+                fadd r12 r3 r0
+            else
+                fsub r12 r3 r1
+            endif
+        )code",
+                             2, {one, two, three, zero, three, two, one, one}, {{{two, three, 0, 0}, {0, 0, 0, 0}}}, 8);
+
+        // Each lane counts from its input to the limit in r1.y with steps of r1.x. The limit is swizzled outside of
+        // the loop, so its value is known in all iterations.
+        verifySpecialization("specialized loop", R"code(
+            #vertexShader
+            #input r0.x
+            #output r12.xyzw
+            #uniform r1.xy
+            swizzle r4 r1.yyyy
+            mov r2 r0
+            loop
+                icmple r3.x r4 r2
+                break r3.x
+                iadd r2.x r2 r1
+                iadd r5.x r5 1
+            endloop
+            swizzle r6 r5.xxxx
+            mov r12.x r2
+            mov r12.y r6
+        )code",
+                             3, {0, 4, 11}, {{{3, 10, 0, 0}}}, 12);
+    }
+
     void main() {
         executeTestCase(createSimpleTestCase());
         executeTestCase(createManualTestCase());
         executeTestCase(createFloatTestCase());
         executeTestCase(createNegationTestCase());
         executeTestCase(createVectorProductsTestCase());
+        executeTestCase(createControlFlowTestCase());
+        executeTestCase(createDivergentBreakTestCase());
+        executeTestCase(createDivergentElseTestCase());
+        executeTestCase(createMatrixTestCase());
+        executeTestCase(createTranscendentalTestCase());
+        executeTestCase(createBitwiseTestCase());
+        verifyDependencyStalls();
+        verifyLaneInstructionsSaved();
+        verifyOptimizations();
+        verifySpecializations();
     }
+
+    bool timed = false;
+    sc_time clockPeriod = {};
 };
 
 int sc_main(int argc, char *argv[]) {
@@ -392,8 +960,27 @@ int sc_main(int argc, char *argv[]) {
 
     PortConnector ports = {};
 
+    ShaderExecutionMode executionMode = ShaderExecutionMode::Interpreter;
+    ShaderUnitTiming timing = {};
+    for (int argIndex = 1; argIndex < argc; argIndex++) {
+        const std::string arg = argv[argIndex];
+        if (arg == "interpreter") {
+            executionMode = ShaderExecutionMode::Interpreter;
+        } else if (arg == "compiled") {
+            executionMode = ShaderExecutionMode::Compiled;
+        } else if (arg == "differential") {
+            executionMode = ShaderExecutionMode::Differential;
+        } else if (arg == "timed") {
+            timing = ShaderUnitTiming::createTypical();
+        } else {
+            FATAL_ERROR("Unknown argument: ", arg);
+        }
+    }
+
     Tester tester{"tester"};
-    ShaderUnit shaderUnit{"shaderUnit"};
+    tester.timed = !timing.functionalOnly;
+    tester.clockPeriod = clock.period();
+    ShaderUnit shaderUnit{"shaderUnit", executionMode, timing};
 
     sc_signal<bool> requestSending;
     sc_signal<sc_uint<32>> requestData;
@@ -425,10 +1012,28 @@ int sc_main(int argc, char *argv[]) {
     ADD_TRACE(responeSending);
     ADD_TRACE(responseData);
 
-    // Bind profiling ports to dummy signals
+    // Bind profiling ports to dummy signals. Saved lane instructions are checked by the tester.
     ports.connectPort(shaderUnit.profiling.outBusy, "SU_busy");
     ports.connectPort(shaderUnit.profiling.outThreadsStarted, "SU_threadsStarted");
     ports.connectPort(shaderUnit.profiling.outThreadsFinished, "SU_threadsFinished");
+    ports.connectPorts(tester.inpLaneInstructionsSaved, shaderUnit.profiling.outLaneInstructionsSaved, "SU_laneInstructionsSaved");
+
+    // Shaders do not sample textures, so TextureUnit interface is bound to dummy signals
+    ports.connectPort(shaderUnit.texture.request.outSending, "SU_TU_req_sending");
+    ports.connectPort(shaderUnit.texture.request.outData, "SU_TU_req_data");
+    ports.connectPort(shaderUnit.texture.request.inpReceiving, "SU_TU_req_receiving");
+    ports.connectPort(shaderUnit.texture.response.outReceiving, "SU_TU_resp_receiving");
+    ports.connectPort(shaderUnit.texture.response.inpSending, "SU_TU_resp_sending");
+    ports.connectPort(shaderUnit.texture.response.inpData, "SU_TU_resp_data");
+
+    // Shaders do not access memory, so memory interface is bound to dummy signals
+    ports.connectPort(shaderUnit.memory.outEnable, "SU_MEM_enable");
+    ports.connectPort(shaderUnit.memory.outWrite, "SU_MEM_write");
+    ports.connectPort(shaderUnit.memory.outAddress, "SU_MEM_address");
+    ports.connectPort(shaderUnit.memory.outBurstLength, "SU_MEM_burstLength");
+    ports.connectPort(shaderUnit.memory.outData, "SU_MEM_dataForWrite");
+    ports.connectPort(shaderUnit.memory.inpData, "SU_MEM_dataForRead");
+    ports.connectPort(shaderUnit.memory.inpCompleted, "SU_MEM_completed");
 
     sc_start({200000, SC_NS});
 
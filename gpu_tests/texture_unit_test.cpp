@@ -0,0 +1,209 @@
+#include "gpu/blocks/shader_array/shader_unit.h"
+#include "gpu/blocks/texture_unit.h"
+#include "gpu/isa/assembler/assembler.h"
+#include "gpu/util/conversions.h"
+#include "gpu/util/port_connector.h"
+#include "gpu/util/transfer.h"
+#include "gpu/util/vcd_trace.h"
+#include "gpu_tests/debug_memory.h"
+#include "gpu_tests/test_utils.h"
+
+#include <systemc.h>
+
+// Texture is 4x4 texels. Red is set in the right half, green in the bottom half and blue in a checkerboard
+// pattern, so bilinear filtering between texel centers gives exact values.
+constexpr uint32_t textureSize = 4;
+uint32_t getTexel(uint32_t x, uint32_t y) {
+    const uint32_t r = x >= 2 ? 0xff : 0;
+    const uint32_t g = y >= 2 ? 0xff : 0;
+    const uint32_t b = (x + y) % 2 ? 0xff : 0;
+    return r | g << 8 | b << 16 | 0xff000000;
+}
+
+SC_MODULE(Tester) {
+    sc_in_clk inpClock;
+
+    struct {
+        sc_out<bool> outSending;
+        sc_out<sc_uint<32>> outData;
+        sc_in<bool> inpReceiving;
+    } request;
+
+    struct {
+        sc_out<bool> outReceiving;
+        sc_in<bool> inpSending;
+        sc_in<sc_uint<32>> inpData;
+    } response;
+
+    struct {
+        sc_out<MemoryAddressType> outAddress;
+        sc_out<sc_uint<16>> outWidth;
+        sc_out<sc_uint<16>> outHeight;
+        sc_out<bool> outMortonLayout;
+        sc_out<bool> outBilinearFilter;
+        sc_in<sc_uint<32>> inpCacheHits;
+        sc_in<sc_uint<32>> inpCacheMisses;
+    } texture;
+
+    TESTER("Tester", 3);
+
+    constexpr static uint32_t linearTextureAddress = 0x400;
+    constexpr static uint32_t mortonTextureAddress = 0x800;
+
+    SC_HAS_PROCESS(Tester);
+    Tester(::sc_core::sc_module_name, DebugMemory &memory) {
+        uploadTextures(memory);
+
+        SC_THREAD(main);
+        sensitive << inpClock.pos();
+    }
+
+    void main() {
+        Isa::PicoGpuBinary binary = {};
+        const char *code = R"code(
+            #vertexShader
+            #input r0.xyzw
+            #output r12.xyzw
+            sample r12 r0
+        )code";
+        int result = Isa::assembly(code, &binary);
+        FATAL_ERROR_IF(result != 0, "Failed to assemble code");
+        Transfer::sendArray(request.inpReceiving, request.outSending, request.outData, binary.getData().data(), binary.getData().size());
+
+        const float nearestCoordinates[] = {0.1f, 0.1f, 0.9f, 0.1f, 0.6f, 0.9f, 0.3f, 0.6f};
+        const uint32_t nearestTexels[] = {getTexel(0, 0), getTexel(3, 0), getTexel(2, 3), getTexel(1, 2)};
+
+        // Each row of a linear texture is one cache line. Rows 0, 3 and 2 are loaded and row 0 is hit once.
+        setTexture(linearTextureAddress, false, false);
+        executeAndVerify("Nearest filtering with linear layout", nearestCoordinates, 4, nearestTexels, 1, 3);
+
+        // Each quadrant of a Morton texture is one cache line. Cache is invalidated, because the texture changed.
+        setTexture(mortonTextureAddress, true, false);
+        executeAndVerify("Nearest filtering with Morton layout", nearestCoordinates, 4, nearestTexels, 1, 7);
+
+        // Four texels around the center hit all quadrants already in cache
+        const float bilinearCoordinates[] = {0.5f, 0.5f};
+        setTexture(mortonTextureAddress, true, true);
+        executeAndVerify("Bilinear filtering with Morton layout", bilinearCoordinates, 1, nullptr, 5, 7);
+    }
+
+private:
+    void uploadTextures(DebugMemory & memory) {
+        uint32_t linearTexels[textureSize * textureSize];
+        uint32_t mortonTexels[textureSize * textureSize];
+        for (uint32_t y = 0; y < textureSize; y++) {
+            for (uint32_t x = 0; x < textureSize; x++) {
+                linearTexels[TextureUnit::calculateTexelIndex(x, y, textureSize, textureSize, false)] = getTexel(x, y);
+                mortonTexels[TextureUnit::calculateTexelIndex(x, y, textureSize, textureSize, true)] = getTexel(x, y);
+            }
+        }
+        memory.blitToMemory(linearTextureAddress, linearTexels, textureSize * textureSize);
+        memory.blitToMemory(mortonTextureAddress, mortonTexels, textureSize * textureSize);
+    }
+
+    void setTexture(uint32_t address, bool mortonLayout, bool bilinearFilter) {
+        texture.outAddress = address;
+        texture.outWidth = textureSize;
+        texture.outHeight = textureSize;
+        texture.outMortonLayout = mortonLayout;
+        texture.outBilinearFilter = bilinearFilter;
+    }
+
+    // Texels are expected to be returned unchanged. Null texels mean the result should be 0.5 in all color channels.
+    void executeAndVerify(const char *name, const float *coordinates, uint32_t threadCount, const uint32_t *expectedTexels,
+                          uint32_t expectedCacheHits, uint32_t expectedCacheMisses) {
+        Isa::Command::CommandExecuteIsa command = {};
+        command.commandType = Isa::Command::CommandType::ExecuteIsa;
+        command.threadCount = intToNonZeroCount(threadCount);
+        uint32_t inputs[Isa::commandSizeInDwords + 4 * Isa::simdSize] = {};
+        std::copy_n(reinterpret_cast<uint32_t *>(&command), sizeof(command) / sizeof(uint32_t), inputs);
+        uint32_t *shaderInputs = inputs + sizeof(command) / sizeof(uint32_t);
+        for (uint32_t thread = 0; thread < threadCount; thread++) {
+            shaderInputs[4 * thread + 0] = Conversions::floatBytesToUint(coordinates[2 * thread + 0]);
+            shaderInputs[4 * thread + 1] = Conversions::floatBytesToUint(coordinates[2 * thread + 1]);
+        }
+        Transfer::sendArray(request.inpReceiving, request.outSending, request.outData, inputs, sizeof(command) / sizeof(uint32_t) + 4 * threadCount);
+
+        uint32_t outputs[4 * Isa::simdSize] = {};
+        Transfer::receiveArray(response.inpSending, response.inpData, response.outReceiving, outputs, 4 * threadCount);
+
+        bool success = true;
+        for (uint32_t thread = 0; thread < threadCount; thread++) {
+            for (uint32_t channel = 0; channel < 4; channel++) {
+                const float actual = Conversions::uintBytesToFloat(outputs[4 * thread + channel]);
+                if (expectedTexels) {
+                    const float expected = ((expectedTexels[thread] >> (8 * channel)) & 0xff) / 255.f;
+                    ASSERT_EQ(expected, actual);
+                } else {
+                    ASSERT_EQ(channel == 3 ? 1.f : 0.5f, actual);
+                }
+            }
+        }
+        ASSERT_EQ(expectedCacheHits, texture.inpCacheHits.read());
+        ASSERT_EQ(expectedCacheMisses, texture.inpCacheMisses.read());
+        SUMMARY_RESULT(name);
+    }
+};
+
+int sc_main(int argc, char *argv[]) {
+    sc_set_time_resolution(100, SC_PS);
+    sc_clock clock("my_clock", 1, SC_NS, 0.5, 0, SC_NS, true);
+
+    PortConnector ports = {};
+
+    DebugMemory memory{"memory", 1024};
+    Tester tester{"tester", memory};
+    ShaderUnit shaderUnit{"shaderUnit"};
+    TextureUnit textureUnit{"textureUnit", 1, 2, 2};
+
+    // Connect clocks
+    tester.inpClock(clock);
+    memory.inpClock(clock);
+    shaderUnit.inpClock(clock);
+    textureUnit.inpClock(clock);
+
+    // Connect tester to the shader unit
+    ports.connectHandshake(tester.request, shaderUnit.request, "TESTER_SU_REQ");
+    ports.connectHandshake(shaderUnit.response, tester.response, "TESTER_SU_RESP");
+
+    // Connect shader unit to the texture unit
+    ports.connectHandshake(shaderUnit.texture.request, textureUnit.clientInterfaces[0].request, "SU_TU_REQ");
+    ports.connectHandshake(textureUnit.clientInterfaces[0].response, shaderUnit.texture.response, "SU_TU_RESP");
+
+    // Connect texture unit to memory
+    ports.connectMemoryToClient<MemoryClientType::ReadOnly>(textureUnit.memory, memory, "TU");
+
+    // Connect texture state
+    ports.connectPorts(textureUnit.texture.inpAddress, tester.texture.outAddress, "TU_address");
+    ports.connectPorts(textureUnit.texture.inpWidth, tester.texture.outWidth, "TU_width");
+    ports.connectPorts(textureUnit.texture.inpHeight, tester.texture.outHeight, "TU_height");
+    ports.connectPorts(textureUnit.texture.inpMortonLayout, tester.texture.outMortonLayout, "TU_mortonLayout");
+    ports.connectPorts(textureUnit.texture.inpBilinearFilter, tester.texture.outBilinearFilter, "TU_bilinearFilter");
+    ports.connectPorts(tester.texture.inpCacheHits, textureUnit.profiling.outCacheHits, "TU_cacheHits");
+    ports.connectPorts(tester.texture.inpCacheMisses, textureUnit.profiling.outCacheMisses, "TU_cacheMisses");
+
+    // Create a vcd trace
+    VcdTrace trace{TEST_NAME};
+    ADD_TRACE(clock);
+    ports.addSignalsToTrace(trace);
+
+    // Bind profiling ports to dummy signals
+    ports.connectPort(shaderUnit.profiling.outBusy, "SU_busy");
+    ports.connectPort(shaderUnit.profiling.outThreadsStarted, "SU_threadsStarted");
+    ports.connectPort(shaderUnit.profiling.outThreadsFinished, "SU_threadsFinished");
+    ports.connectPort(shaderUnit.profiling.outLaneInstructionsSaved, "SU_laneInstructionsSaved");
+    ports.connectPort(textureUnit.profiling.outBusy, "TU_busy");
+
+    // Shader does not access memory directly, so memory interface is bound to dummy signals
+    ports.connectPort(shaderUnit.memory.outEnable, "SU_MEM_enable");
+    ports.connectPort(shaderUnit.memory.outWrite, "SU_MEM_write");
+    ports.connectPort(shaderUnit.memory.outAddress, "SU_MEM_address");
+    ports.connectPort(shaderUnit.memory.outBurstLength, "SU_MEM_burstLength");
+    ports.connectPort(shaderUnit.memory.outData, "SU_MEM_dataForWrite");
+    ports.connectPort(shaderUnit.memory.inpData, "SU_MEM_dataForRead");
+    ports.connectPort(shaderUnit.memory.inpCompleted, "SU_MEM_completed");
+
+    // Run the simulation
+    sc_start({20000, SC_NS});
+    return tester.verify();
+}
@@ -0,0 +1,94 @@
+#include "gpu/isa/assembler/assembler.h"
+#include "gpu/isa/assembler/disassembler.h"
+#include "gpu/isa/assembler/shader_analyzer.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Prints disassembly and estimated cost of shaders without simulating them.
+// Usage: ShaderAnalyzer [--functional] [--lanesPerCycle N] [--timing opcode=latency,issueCycles]... shader.asm...
+// By default, ShaderUnitTiming::createTypical() is used. Each --timing option overrides a single opcode, e.g.
+// --timing fmul_imm=6,2.
+
+bool parseOpcodeTiming(const std::string &arg, ShaderUnitTiming &timing) {
+    const size_t equalsPosition = arg.find('=');
+    const size_t commaPosition = arg.find(',', equalsPosition);
+    if (equalsPosition == std::string::npos || commaPosition == std::string::npos) {
+        return false;
+    }
+
+    const std::string name = arg.substr(0, equalsPosition);
+    for (uint32_t opcodeIndex = 0; opcodeIndex < static_cast<uint32_t>(Isa::Opcode::COUNT); opcodeIndex++) {
+        const Isa::Opcode opcode = static_cast<Isa::Opcode>(opcodeIndex);
+        if (name == Isa::getOpcodeName(opcode)) {
+            try {
+                timing[opcode].latency = std::stoul(arg.substr(equalsPosition + 1, commaPosition - equalsPosition - 1));
+                timing[opcode].issueCycles = std::stoul(arg.substr(commaPosition + 1));
+            } catch (const std::exception &) {
+                return false;
+            }
+            return timing[opcode].issueCycles > 0; // ShaderUnit rejects instructions issued in 0 cycles
+        }
+    }
+    return false;
+}
+
+int sc_main(int argc, char *argv[]) {
+    ShaderUnitTiming timing = ShaderUnitTiming::createTypical();
+    std::vector<std::string> paths = {};
+    for (int argIndex = 1; argIndex < argc; argIndex++) {
+        const std::string arg = argv[argIndex];
+        if (arg == "--functional") {
+            timing.functionalOnly = true;
+        } else if (arg == "--lanesPerCycle" && argIndex + 1 < argc) {
+            try {
+                timing.lanesPerCycle = std::stoul(argv[++argIndex]);
+            } catch (const std::exception &) {
+                timing.lanesPerCycle = 0; // reported below with the usage
+            }
+        } else if (arg == "--timing" && argIndex + 1 < argc) {
+            if (!parseOpcodeTiming(argv[++argIndex], timing)) {
+                std::cerr << "Invalid opcode timing: " << argv[argIndex] << "\n";
+                return 1;
+            }
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty() || timing.lanesPerCycle == 0) {
+        std::cerr << "Usage: " << argv[0] << " [--functional] [--lanesPerCycle N] [--timing opcode=latency,issueCycles]... shader.asm...\n";
+        return 1;
+    }
+
+    bool success = true;
+    for (const std::string &path : paths) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cerr << "Cannot open " << path << "\n";
+            success = false;
+            continue;
+        }
+        std::stringstream source = {};
+        source << file.rdbuf();
+
+        Isa::PicoGpuBinary binary = {};
+        if (Isa::assembly(source.str().c_str(), &binary) != 0) {
+            std::cerr << "Failed to assemble " << path << "\n";
+            success = false;
+            continue;
+        }
+
+        const auto &data = binary.getData();
+        std::cout << "==== " << path << "\n";
+        std::cout << Isa::disassembly(data.data(), data.size()) << "\n";
+        Isa::printShaderStatistics(Isa::analyzeShader(data.data(), data.size(), timing), std::cout);
+        std::cout << "\n";
+    }
+    return success ? 0 : 1;
+}